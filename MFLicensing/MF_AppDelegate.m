@@ -11,7 +11,7 @@
 #import "MF_AppDelegate.h"
 #import "mfmathlib.h"
 #import "mflicensing.h"
-#import "md5.h"
+#import "mflicensingdigest.h"
 #include <stdlib.h>
 
 @implementation MF_AppDelegate
@@ -86,20 +86,13 @@ static unsigned char samplePrivateKey[] = "1048790829713117586646307642085933640
 
 -(IBAction)generateDigestHash:(id)sender
 {
-    MD5_CTX md5ctx;
-    MD5_Init(&md5ctx);
-    
-    union {
-        unsigned char c[16];
-        mfU128 u128;
-    } md5hash;
+    mfLicensingDigest digest;
 
     NSString *stringToBeHashed = [_digestInput stringValue];
     NSData *dataToBeHashed = [stringToBeHashed dataUsingEncoding:NSUTF8StringEncoding];
-    MD5_Update(&md5ctx, (void *)[dataToBeHashed bytes], [dataToBeHashed length]);
-    MD5_Final(md5hash.c, &md5ctx);
+    mfLicensingComputeDigest(&mfLicensingDigestMD5, [dataToBeHashed bytes], [dataToBeHashed length], &digest);
 
-    NSString *hash = [self decimalValueFromU128:&md5hash.u128];
+    NSString *hash = [self decimalValueFromU128:&digest.md5hash];
     [_digestOutput setStringValue:hash];
 }
 
@@ -9,21 +9,54 @@
 //
 
 #include "mflicensing.h"
+#include "mflicensinginternal.h"
 #include <errno.h>
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 
-static unsigned char defaultEncodingCharacters[] = "ACDEFGHJKLMNPQRSTUVWXYZ2345679";
+#ifdef MFLICENSING_INSTRUMENTATION
+#if defined(__x86_64__) || defined(__i386__)
+#include <x86intrin.h>
+#define MF_STATS_TICKS() __rdtsc()
+#elif defined(__APPLE__)
+#include <mach/mach_time.h>
+#define MF_STATS_TICKS() mach_absolute_time()
+#else
+#include <time.h>
+static unsigned long long mfLicensingStatsTicks( void )
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+#define MF_STATS_TICKS() mfLicensingStatsTicks()
+#endif
 
-void randomize128UsingIntSeed( mfU128 *x, unsigned int seed );
-void randomize256UsingSeed( mfU256 *x, unsigned short int seed[3] );
+static __thread mfLicensingStats mfLicensingThreadStats;
+
+static void *mfLicensingStatsMalloc( size_t size )
+{
+    mfLicensingThreadStats.allocations++;
+    mfLicensingThreadStats.allocated_bytes += size;
+    return malloc(size);
+}
 
-typedef struct {
-    unsigned int encoding_base;
-    unsigned int bits_in_key;
-    unsigned char *codec_characters;
-    unsigned char *bits_ordering;
-} mfLicensingCodecParams;
+#define MF_STATS_PHASE_BEGIN(phase) unsigned long long mf_stats_##phase = MF_STATS_TICKS()
+#define MF_STATS_PHASE_END(phase) do { \
+        mfLicensingThreadStats.cycles[phase] += MF_STATS_TICKS() - mf_stats_##phase; \
+        mfLicensingThreadStats.calls[phase]++; \
+    } while(0)
+#define MF_STATS_COUNT(counter) (mfLicensingThreadStats.counter++)
+#define MF_MALLOC(size) mfLicensingStatsMalloc(size)
+#else
+#define MF_STATS_PHASE_BEGIN(phase)
+#define MF_STATS_PHASE_END(phase)
+#define MF_STATS_COUNT(counter)
+#define MF_MALLOC(size) malloc(size)
+#endif
+
+static unsigned char defaultEncodingCharacters[] = "ACDEFGHJKLMNPQRSTUVWXYZ2345679";
 
 void mfLicensingInitializeDefaultVector( mfLicensingVector *vector )
 {
@@ -37,6 +70,8 @@ void mfLicensingInitializeDefaultVector( mfLicensingVector *vector )
     vector->salt_seed[1] = 0x7514;
     vector->salt_seed[2] = 0x45B4;
     vector->private_key = 0;
+    vector->check_character = 0;
+    vector->scheme = MF_LICENSING_SCHEME_LRAND48;
 }
 int mfLicensingSetPrivateKey( mfLicensingVector *vector, const mfLicensingPrivateKey *key )
 {
@@ -73,6 +108,7 @@ int mfLicensingSetEncodingCharacters( mfLicensingVector *vector, const unsigned
             }
             char_j++;
         }
+        char_i++;
     }
     vector->coded_chars = characters;
     return 0;
@@ -91,6 +127,22 @@ int mfLicensingSetKeyIndexLength( mfLicensingVector *vector, unsigned char bits
     vector->index_bits = bits;
     return 0;
 }
+int mfLicensingSetCheckCharacter( mfLicensingVector *vector, unsigned char enabled )
+{
+    if( enabled > 1 ) {
+        return -1;
+    }
+    vector->check_character = enabled;
+    return 0;
+}
+int mfLicensingSetScheme( mfLicensingVector *vector, unsigned char scheme )
+{
+    if( (scheme != MF_LICENSING_SCHEME_LRAND48) && (scheme != MF_LICENSING_SCHEME_PHILOX) ) {
+        return -1;
+    }
+    vector->scheme = scheme;
+    return 0;
+}
 int mfLicensingSetScramblingSeed( mfLicensingVector *vector, unsigned short int seed[3])
 {
     vector->scrambling_seed[0] = seed[0];
@@ -141,15 +193,46 @@ int mfLicensingInitializePrivateKeyFromPrime( mfLicensingPrivateKey *key, const
     return 0;
 }
 
-int mfLicensingInitializeCodecParams(mfLicensingCodecParams *codec_params, mfLicensingVector *vector)
+unsigned int mfLicensingKeyBits( unsigned int encoding_base, unsigned int key_length )
 {
     mfU256 encoded_base;
     mfU256 max_key;
     mfU256 ignored;
 
+    // Step 1: find out the largest value that could be created using the key length and encoding chars
+    mfZero256(&encoded_base);
+    encoded_base.l128.l64.l32.l16.l8 = encoding_base;
+    mfZero256(&max_key);
+    max_key.l128.l64.l32.l16.l8 = 1;
+    if( key_length == 0 || encoding_base < 2 ) {
+        // cannot generate a key of 0 length, or encode anything with a single character..
+        return 0;
+    }
+    while( key_length-- ) {
+        mfMultiplyU256(&max_key, &encoded_base, &max_key, &ignored);
+        // while we will not use the data in "ignored", we should check for overflow
+        if( mfIsZero256(&ignored) == 0 && key_length > 0 ) {
+            // the requested key would contain more than 256-bit of data, unsupported.
+            return 0;
+        }
+    }
+    // Step 2: find out how many bits of data can be reliably encoded
+    return mfBitLengthU256(&max_key) - 1;
+}
+
+int mfLicensingInitializeCodecParams(mfLicensingCodecParams *codec_params, mfLicensingVector *vector)
+{
     if( vector->private_key == 0 || vector->coded_chars == 0 ) {
         return 0;
     }
+    // check_character is a flag, the keys are key_length + check_character characters long
+    if( vector->check_character > 1 ) {
+        return 0;
+    }
+    // A scheme of 0, as left by a vector zeroed and filled field by field, is the first scheme
+    if( (vector->scheme != 0) && (vector->scheme != MF_LICENSING_SCHEME_LRAND48) && (vector->scheme != MF_LICENSING_SCHEME_PHILOX) ) {
+        return 0;
+    }
 
     // Compute key encoding base
     unsigned char encoding_chars = 0;
@@ -171,39 +254,23 @@ int mfLicensingInitializeCodecParams(mfLicensingCodecParams *codec_params, mfLic
 
 
     // Compute total key length in bits
-    // Step 1: find out the largest value that could be created using the key length and encoding chars
-    mfZero256(&encoded_base);
-    encoded_base.l128.l64.l32.l16.l8 = encoding_chars;
-    mfZero256(&max_key);
-    max_key.l128.l64.l32.l16.l8 = 1;
-    unsigned char encoded_key_length = vector->key_length;
-    if( encoded_key_length == 0 ) {
-        // cannot generate a key of 0 length..
+    unsigned char binary_key_length = (unsigned char)mfLicensingKeyBits(encoding_chars, vector->key_length);
+    if( binary_key_length == 0 ) {
         return 0;
     }
-    while( encoded_key_length-- ) {
-        mfMultiplyU256(&max_key, &encoded_base, &max_key, &ignored);
-        // while we will not use the data in "ignored", we should check for overflow
-        if( mfIsZero256(&ignored) == 0 && encoded_key_length > 0 ) {
-            // the requested key would contain more than 256-bit of data, unsupported.
-            return 0;
-        }
-    }
-    // Step 2: find out how many bits of data can be reliably encoded
-    unsigned char binary_key_length = 0;
-    while( mfIsZero256(&max_key) == 0 ) {
-        binary_key_length++;
-        mfShiftRight256By1(&max_key);
-    }
-    binary_key_length--;
     codec_params->bits_in_key = binary_key_length;
 
 
 
     // Determine encoding characters weight and bits ordering
     // Step 1: scramble the encoding characters
-    seed48(vector->scrambling_seed);
-    unsigned char *scrambled_encoding_char = malloc(encoding_chars);
+    // nrand48 is used with a private state, rather than seed48/lrand48, so concurrent
+    // calls from multiple threads do not interfere with each other
+    unsigned short int scrambling_state[3];
+    scrambling_state[0] = vector->scrambling_seed[0];
+    scrambling_state[1] = vector->scrambling_seed[1];
+    scrambling_state[2] = vector->scrambling_seed[2];
+    unsigned char *scrambled_encoding_char = MF_MALLOC(encoding_chars);
     if( scrambled_encoding_char == 0 ) return 0; // failed malloc
     unsigned char scrambled_chars = 0;
     while( scrambled_chars < encoding_chars ) {
@@ -211,7 +278,7 @@ int mfLicensingInitializeCodecParams(mfLicensingCodecParams *codec_params, mfLic
     }
     scrambled_chars = 0;
     while( scrambled_chars < encoding_chars ) {
-        unsigned int scrambled_char = lrand48() % encoding_chars;
+        unsigned int scrambled_char = nrand48(scrambling_state) % encoding_chars;
         if( scrambled_encoding_char[scrambled_char] == 0 ) {
             scrambled_encoding_char[scrambled_char] = vector->coded_chars[scrambled_chars];
             scrambled_chars++;
@@ -222,16 +289,16 @@ int mfLicensingInitializeCodecParams(mfLicensingCodecParams *codec_params, mfLic
 
 
     // Step 2: scramble the bits ordering
-    unsigned char *bits = malloc(binary_key_length);
+    unsigned char *bits = MF_MALLOC(binary_key_length);
     if( bits == 0 ) { free(codec_params->codec_characters); return 0; }
 
-    unsigned char *bit_indexes = malloc(binary_key_length);
+    unsigned char *bit_indexes = MF_MALLOC(binary_key_length);
     if( bit_indexes == 0 ) { free(bits); free(codec_params->codec_characters); return 0; }
 
     for( int i=0; i < binary_key_length; i++ ) { bits[i] = 0; bit_indexes[i] = 0; }
     unsigned char scrambled_bits = 0;
     while (scrambled_bits < binary_key_length) {
-        unsigned int rnd_i = lrand48() % binary_key_length;
+        unsigned int rnd_i = nrand48(scrambling_state) % binary_key_length;
         if( bits[rnd_i] == 0 ) {
             // that bit index is still free
             bit_indexes[scrambled_bits] = rnd_i;
@@ -256,237 +323,399 @@ int mfLicensingInitializeCodecParams(mfLicensingCodecParams *codec_params, mfLic
 
 unsigned char* mfLicensingGenerateLicense( mfLicensingVector *vector, mfLicensingDigest *digest, unsigned int index )
 {
-    mfU256 validator; mfZero256(&validator);
-    mfU256 binary_key; mfZero256(&binary_key);
-    unsigned char *bits = 0;
+    mfLicensingContext context;
+    if( mfLicensingInitializeContext(&context, vector) != 0 ) {
+        // some codec parameters couldn't be validated
+        return 0;
+    }
+    unsigned char *encoded_key = mfLicensingGenerateLicenseWithContext(&context, digest, index);
+    mfLicensingReleaseContext(&context);
+    return encoded_key;
+}
+
+unsigned char* mfLicensingGenerateLicenseWithContext( mfLicensingContext *context, mfLicensingDigest *digest, unsigned int index )
+{
     unsigned char *encoded_key = 0;
+    unsigned int size;
 
-    // Retrieve codec parameters
-    mfLicensingCodecParams codec_params;
-    if( mfLicensingInitializeCodecParams(&codec_params, vector) == 0 )
-    {
-        // some codec parameters couldn't be validated
+    if( context->vector == 0 ) {
         return 0;
     }
-    // Pre-allocate all needed memory blocks
-    bits = malloc(codec_params.bits_in_key);
-    encoded_key = malloc(vector->key_length+1); // +1 for null terminator
-    if( bits == 0 || encoded_key == 0 ) {
-        if( bits != 0 ) free(bits);
-        if( encoded_key != 0 ) free( encoded_key );
-        free( codec_params.bits_ordering );
-        free( codec_params.codec_characters );
+
+    size = context->vector->key_length + context->vector->check_character + 1; // +1 for null terminator
+    encoded_key = MF_MALLOC(size);
+    if( encoded_key == 0 ) {
+        return 0;
+    }
+
+    if( mfLicensingGenerateLicenseToBuffer(context, digest, index, encoded_key, size) != 0 ) {
+        free( encoded_key );
+        return 0;
+    }
+    return encoded_key;
+}
+
+int mfLicensingGenerateLicenseToBuffer( mfLicensingContext *context, mfLicensingDigest *digest, unsigned int index, unsigned char *license, unsigned int size )
+{
+    MF_STATS_COUNT(generate_calls);
+
+    if( context->vector == 0 || size < (unsigned int)context->vector->key_length + context->vector->check_character + 1 ) {
+        return -1;
+    }
+    if( mfLicensingEncodeLicense(context, &context->salt, digest, index, license) == 0 ) {
+        return -1;
+    }
+    return 0;
+}
+
+// Check character, Luhn mod N over the character weights: starting from the last character of the key every other
+// weight is doubled, the check character being the weight bringing the sum to a multiple of the encoding base.
+// The doubling is a permutation of the weights for any encoding base, any single character error changes the sum;
+// two adjacent characters swapped change it unless their weights are 0 and encoding_base - 1 (even bases only).
+unsigned int mfLicensingCheckDouble(unsigned int weight, unsigned int encoding_base)
+{
+    weight <<= 1;
+    if( weight >= encoding_base ) {
+        // odd bases: 2 * weight mod encoding_base, even bases: sum of the base N digits of 2 * weight
+        weight -= encoding_base - ((encoding_base & 0x01) ^ 0x01);
+    }
+    return weight;
+}
+
+// Returns 1 if the license is key_length characters long followed by the matching check character, 0 otherwise
+int mfLicensingVerifyCheckCharacter(mfLicensingContext *context, const unsigned char *license)
+{
+    unsigned int key_length = context->vector->key_length;
+    unsigned int encoding_base = context->codec_params.encoding_base;
+    unsigned int check_sum = 0;
+    unsigned int character_i = 0;
+    while( character_i < key_length ) {
+        // the weight of the null terminator is 0xFF, short keys are rejected here
+        unsigned int weight = context->character_weights[ license[character_i] ];
+        if( weight == 0xFF ) {
+            return 0;
+        }
+        check_sum += ((key_length - 1 - character_i) & 0x01) ? weight : mfLicensingCheckDouble(weight, encoding_base);
+        character_i++;
+    }
+    if( context->character_weights[ license[key_length] ] != (encoding_base - check_sum % encoding_base) % encoding_base ) {
         return 0;
     }
+    return license[key_length + 1] == 0;
+}
 
-    // Compute the validator bits for the index and digest
+// Number of characters encoded at once, the largest number for which encoding_base^characters fits in 32 bits
+unsigned int mfLicensingEncodingChunk(unsigned int encoding_base)
+{
+    unsigned int characters = 0;
+    unsigned long long divisor = encoding_base;
+    while( divisor <= 0xFFFFFFFF ) {
+        divisor *= encoding_base;
+        characters++;
+    }
+    return characters;
+}
+
+// Computes the 256-bit validator for the digest and index, salt being the 256-bit salt of the vector
+void mfLicensingComputeValidator(mfLicensingContext *context, const mfU256 *salt, mfLicensingDigest *digest, unsigned int index, mfU256 *validator)
+{
+    mfZero256(validator);
     {
-        mfU256 salt;
         mfU128 index_block;
         mfU256 mixed_block;
         mfU512 pivot;
         mfU256 ignored;
         
-        // Compute 128-bit representation of the index and 256-bit salt
-        randomize128UsingIntSeed(&index_block, index);
-        randomize256UsingSeed(&salt, vector->salt_seed);
+        // Compute 128-bit representation of the index
+        MF_STATS_PHASE_BEGIN(mfLicensingPhaseIndexRandomize);
+        if( context->vector->scheme == MF_LICENSING_SCHEME_PHILOX ) {
+            unsigned int key[2];
+            mfLicensingCounterKey(context->vector, key);
+            mfLicensingCounterIndexBlock(key, index, &index_block);
+        } else {
+            randomize128UsingIntSeed(&index_block, index);
+        }
+        MF_STATS_PHASE_END(mfLicensingPhaseIndexRandomize);
         
         // Multiply the 128-bit index representation by the digest, produces 256-bit result
+        MF_STATS_PHASE_BEGIN(mfLicensingPhaseValidatorMultiply);
         mfMultiplyU128(&digest->md5hash, &index_block, &mixed_block.l128, &mixed_block.h128);
         
         // Multiply previous result with 256-bit salt, produces 512-bit result
-        mfMultiplyU256(&salt, &mixed_block, &pivot.l256, &pivot.h256);
+        mfMultiplyU256(salt, &mixed_block, &pivot.l256, &pivot.h256);
+        MF_STATS_PHASE_END(mfLicensingPhaseValidatorMultiply);
         
         // Take most significant 256-bits of previous result, divide by the private key
-        mfDivideU256(&pivot.h256, &vector->private_key->data, &ignored, &validator);
+        MF_STATS_PHASE_BEGIN(mfLicensingPhaseValidatorDivide);
+        mfDivideU256(&pivot.h256, &context->vector->private_key->data, &ignored, validator);
+        MF_STATS_PHASE_END(mfLicensingPhaseValidatorDivide);
         // Remainder is the "validator" for the key
     }
+}
+
+// Generates the license key for the digest and index into encoded_key (key_length + check_character + 1 bytes), salt being the
+// 256-bit salt of the vector.  Returns 1 if the key was generated, 0 otherwise.
+int mfLicensingEncodeLicense(mfLicensingContext *context, const mfU256 *salt, mfLicensingDigest *digest, unsigned int index, unsigned char *encoded_key)
+{
+    mfU256 validator;
+    mfLicensingComputeValidator(context, salt, digest, index, &validator);
+    return mfLicensingEncodeValidator(context, index, &validator, encoded_key);
+}
+
+// Scatters the index and validator bits into the binary key and encodes it into encoded_key (key_length + check_character + 1 bytes)
+// Returns 1 if the key was generated, 0 otherwise.
+int mfLicensingEncodeValidator(mfLicensingContext *context, unsigned int index, const mfU256 *validator, unsigned char *encoded_key)
+{
+    mfU256 binary_key;
+    mfLicensingVector *vector = context->vector;
+    mfLicensingCodecParams *codec_params = &context->codec_params;
 
-    // Compute the binary representation of the key
+    // Compute the binary representation of the key, the bit stored at position bit_i of the scrambled
+    // ordering being bit (bits_in_key - 1 - bits_ordering[bit_i]) of the binary key
+    MF_STATS_PHASE_BEGIN(mfLicensingPhaseBitScatter);
     {
+        // Bits are gathered in 32-bit words, then stored in the binary key
+        unsigned int key_words[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+
         // Store the index bits
         unsigned char index_bits = vector->index_bits;
         unsigned int bit_i = 0;
-        unsigned int rnd_i;
+        unsigned int key_bit_i;
         
         while( bit_i < index_bits ) {
-            rnd_i = codec_params.bits_ordering[bit_i];
-            bits[rnd_i] = index & 0x01;
+            key_bit_i = codec_params->bits_in_key - 1 - codec_params->bits_ordering[bit_i];
+            key_words[key_bit_i >> 5] |= (index & 0x01) << (key_bit_i & 0x1F);
             index = index >> 1;
             bit_i ++;
         }
         // Ensure the index specified did fit entirely
-        if( index == 0 ) {
-            
-            // Store as many validator bits as key will allow
-            while( bit_i < codec_params.bits_in_key ) {
-                rnd_i = codec_params.bits_ordering[bit_i];
-                bits[rnd_i] = validator.l128.l64.l32.l16.l8 & 0x01;
-                mfShiftRight256By1(&validator);
-                bit_i ++;
-            }
-            
-            // Create a flat binary representation of the scrambled bits
-            mfZero256(&binary_key);
-            bit_i = 0;
-            while( bit_i < codec_params.bits_in_key ) {
-                mfShiftLeft256By1(&binary_key);
-                binary_key.l128.l64.l32.l16.l8 = binary_key.l128.l64.l32.l16.l8 | bits[bit_i];
-                bit_i ++;
-            }
+        if( index != 0 ) {
+            return 0;
+        }
+
+        // Store as many validator bits as key will allow
+        unsigned int validator_i = 0;
+        while( bit_i < codec_params->bits_in_key ) {
+            key_bit_i = codec_params->bits_in_key - 1 - codec_params->bits_ordering[bit_i];
+            key_words[key_bit_i >> 5] |= (unsigned int)((validator->b[validator_i >> 3] >> (validator_i & 0x07)) & 0x01) << (key_bit_i & 0x1F);
+            validator_i ++;
+            bit_i ++;
+        }
+
+        unsigned int byte_i = 32;
+        while( byte_i-- ) {
+            binary_key.b[byte_i] = (key_words[byte_i >> 2] >> ((byte_i & 0x03) * 8)) & 0xFF;
         }
+
         // make sure the binary key contains data
         if( mfIsZero256(&binary_key) == 1 ) {
-            free( bits );
-            free( encoded_key );
-            free( codec_params.bits_ordering );
-            free( codec_params.codec_characters );
             return 0;
         }
     }
+    MF_STATS_PHASE_END(mfLicensingPhaseBitScatter);
 
     // Encode the binary key using the encoding characters
     // binary_key contains the scrambled bits
+    MF_STATS_PHASE_BEGIN(mfLicensingPhaseEncode);
     {
         mfU256 left_to_encode;
         mfU256 remainder;
-        mfU256 encoded_base;
-
-        mfZero256(&encoded_base);
-        encoded_base.l128.l64.l32.l16.l8 = codec_params.encoding_base;
+        mfU256 chunk_divisor;
+        unsigned int encoding_base = codec_params->encoding_base;
+        unsigned int chunk_characters = mfLicensingEncodingChunk(encoding_base);
 
-        // Successively divide the binary key by the encoding base to get the encoded character indexes
+        // Successively divide the binary key by encoding_base^chunk_characters, the remainder holding the
+        // weights of the next chunk_characters encoded characters, least significant first
         unsigned int coded_key_i = 0;
+        mfZero256(&chunk_divisor);
         while( coded_key_i < vector->key_length ) {
-            mfDivideU256(&binary_key, &encoded_base, &left_to_encode, &remainder);
-            encoded_key[coded_key_i] = codec_params.codec_characters[remainder.l128.l64.l32.l16.l8];
+            unsigned int characters = vector->key_length - coded_key_i;
+            if( characters > chunk_characters ) characters = chunk_characters;
+            unsigned int divisor = 1;
+            unsigned int character_i = characters;
+            while( character_i-- ) divisor *= encoding_base;
+            chunk_divisor.b[0] = divisor & 0xFF;
+            chunk_divisor.b[1] = (divisor >> 8) & 0xFF;
+            chunk_divisor.b[2] = (divisor >> 16) & 0xFF;
+            chunk_divisor.b[3] = (divisor >> 24) & 0xFF;
+            mfDivideU256(&binary_key, &chunk_divisor, &left_to_encode, &remainder);
+            unsigned int weights = remainder.b[0] | (remainder.b[1] << 8) | (remainder.b[2] << 16) | ((unsigned int)remainder.b[3] << 24);
+            while( characters-- ) {
+                encoded_key[coded_key_i++] = codec_params->codec_characters[weights % encoding_base];
+                weights /= encoding_base;
+            }
             mfCopy256(&left_to_encode, &binary_key);
-            coded_key_i++;
+        }
+        if( vector->check_character ) {
+            // the check character is computed from the weights of the characters just encoded
+            unsigned int check_sum = 0;
+            unsigned int character_i = coded_key_i;
+            while( character_i-- ) {
+                unsigned int weight = context->character_weights[ encoded_key[character_i] ];
+                check_sum += ((coded_key_i - 1 - character_i) & 0x01) ? weight : mfLicensingCheckDouble(weight, encoding_base);
+            }
+            encoded_key[coded_key_i++] = codec_params->codec_characters[(encoding_base - check_sum % encoding_base) % encoding_base];
         }
         encoded_key[coded_key_i] = 0; // null terminator for the string
 
         // binary_key should be 0
         if( mfIsZero256(&binary_key) == 0 ) {
             // something went wrong...
-            free( bits );
-            free( encoded_key );
-            free( codec_params.bits_ordering );
-            free( codec_params.codec_characters );
             return 0;
         }
     }
+    MF_STATS_PHASE_END(mfLicensingPhaseEncode);
 
-    // All done, clean up and return
-    free( bits );
-    free( codec_params.bits_ordering );
-    free( codec_params.codec_characters );
-    return encoded_key;
+    return 1;
 }
 
-int mfLicensingValidateLicense( mfLicensingVector *vector, mfLicensingDigest *digest, const unsigned char *license)
+void mfLicensingInitializeCharacterWeights(unsigned char *character_weights, mfLicensingCodecParams *codec_params)
 {
-    mfU256 binary_key; mfZero256(&binary_key);
-    unsigned int index = 0;
-    unsigned char *bits = 0;
-    unsigned char *expected_license = 0;
+    unsigned int c = 256;
+    while( c-- ) {
+        character_weights[c] = 0xFF;
+    }
+    unsigned char weight = codec_params->encoding_base;
+    while( weight-- ) {
+        character_weights[ codec_params->codec_characters[weight] ] = weight;
+    }
+}
 
-    // Retrieve codec parameters
-    mfLicensingCodecParams codec_params;
-    if( mfLicensingInitializeCodecParams(&codec_params, vector) == 0 )
-    {
-        // some codec parameters couldn't be validated
-        return 0;
+int mfLicensingDecodeBinaryKeyCharacters(mfU256 *binary_key, mfLicensingCodecParams *codec_params, const unsigned char *character_weights, unsigned char key_length, unsigned char check_character, const unsigned char *license)
+{
+    mfZero256(binary_key);
+
+    // Find the end of the license key, process it in reverse order; the check character, if any, follows
+    // the key_length characters decoded
+    unsigned int coded_key_i = 0;
+    while( license[coded_key_i] != 0 ) {
+        if( coded_key_i > key_length + check_character ) {
+            // the license key is longer than expected, no need to look any further
+            return 0;
+        }
+        coded_key_i++;
     }
-    // Pre-allocate required memory blocks
-    bits = malloc( codec_params.bits_in_key );
-    if( bits == 0 ) {
-        free( codec_params.bits_ordering );
-        free( codec_params.codec_characters );
+    if( coded_key_i != key_length + check_character ) {
         return 0;
     }
+    coded_key_i = key_length;
 
-    // Compute the binary equivalent for the license
-    {
-        // Find the end of the license key, process it in reverse order
-        unsigned int coded_key_i = 0;
-        while( license[coded_key_i] != 0 ) {
-            if( coded_key_i > 100 ) {
-                // the license key should not be that long, most likely invalid pointer or data
-                break;
-            }
-            coded_key_i++;
-        }
-        if( coded_key_i == vector->key_length ) {
-            mfU256 encoded_base; mfZero256(&encoded_base);
-            mfU256 extended_weight; mfZero256(&extended_weight);
-            
-            encoded_base.l128.l64.l32.l16.l8 = codec_params.encoding_base;
-            
-            while( coded_key_i-- ) {
-                // retrieve next character to decode
-                unsigned char coded_char = license[coded_key_i];
-                // find the weight of the character
-                unsigned char weight = 0;
-                while( weight < codec_params.encoding_base ) {
-                    if( coded_char == codec_params.codec_characters[weight] ) {
-                        break;  // character match, weight identified
-                    }
-                    weight++;
-                }
-                if( weight < codec_params.encoding_base ) {
-                    extended_weight.l128.l64.l32.l16.l8 = weight;
-
-                    mfU256 temp, overflow;
-                    mfMultiplyU256(&binary_key, &encoded_base, &temp, &overflow);
-                    if((mfIsZero256(&overflow) == 0) ||
-                       (mfAddU256(&temp, &extended_weight, &binary_key) == 1) ) {
-                        // resulting binary key is larger than we can support.
-                        mfZero256(&binary_key);
-                        break;
-                    }                    
-                } else {
-                    // Invalid character detected
-                    mfZero256(&binary_key);
-                    break;
-                }
-            }
+    mfU256 encoded_base; mfZero256(&encoded_base);
+    mfU256 extended_weight; mfZero256(&extended_weight);
+
+    encoded_base.l128.l64.l32.l16.l8 = codec_params->encoding_base;
+
+    while( coded_key_i-- ) {
+        // find the weight of the next character to decode
+        unsigned char weight = character_weights[ license[coded_key_i] ];
+        if( weight == 0xFF ) {
+            // Invalid character detected
+            mfZero256(binary_key);
+            return 0;
         }
-        if( mfIsZero256(&binary_key) ) {
-            free( codec_params.bits_ordering );
-            free( codec_params.codec_characters );
+        extended_weight.l128.l64.l32.l16.l8 = weight;
+
+        mfU256 temp, overflow;
+        mfMultiplyU256(binary_key, &encoded_base, &temp, &overflow);
+        if((mfIsZero256(&overflow) == 0) ||
+           (mfAddU256(&temp, &extended_weight, binary_key) == 1) ) {
+            // resulting binary key is larger than we can support.
+            mfZero256(binary_key);
             return 0;
         }
     }
-    
-    // Explode the binary key into bits
+    return mfIsZero256(binary_key) ? 0 : 1;
+}
+
+int mfLicensingDecodeBinaryKey(mfU256 *binary_key, mfLicensingCodecParams *codec_params, const unsigned char *character_weights, unsigned char key_length, unsigned char check_character, const unsigned char *license)
+{
+    MF_STATS_PHASE_BEGIN(mfLicensingPhaseDecode);
+    int decoded = mfLicensingDecodeBinaryKeyCharacters(binary_key, codec_params, character_weights, key_length, check_character, license);
+    MF_STATS_PHASE_END(mfLicensingPhaseDecode);
+    return decoded;
+}
+
+void mfLicensingExtractIndex(unsigned int *index, mfU256 *validator_bits, mfLicensingCodecParams *codec_params, unsigned char index_bits, mfU256 *binary_key)
+{
+    unsigned char bits[256];
+
+    MF_STATS_PHASE_BEGIN(mfLicensingPhaseBitScatter);
+
+    // Explode the binary key into bits, bits[0] being the most significant, then drop them from the binary key
     {
-        unsigned int bit_i = codec_params.bits_in_key;
+        unsigned int bit_i = codec_params->bits_in_key;
         while( bit_i-- ) {
-            bits[ bit_i ] = binary_key.l128.l64.l32.l16.l8 & 0x01;
-            mfShiftRight256By1(&binary_key);
+            unsigned int key_bit_i = codec_params->bits_in_key - 1 - bit_i;
+            bits[ bit_i ] = (binary_key->b[key_bit_i >> 3] >> (key_bit_i & 0x07)) & 0x01;
         }
+        mfShiftRightU256ByN(binary_key, codec_params->bits_in_key);
     }
 
     // Retrieve the index from the exploded bits
     {
-        unsigned int bit_i = vector->index_bits;
+        unsigned int bit_i = index_bits;
         unsigned int rnd_i;
+        *index = 0;
         while( bit_i-- ) {
-            rnd_i = codec_params.bits_ordering[ bit_i ];
-            index = (index << 1) | bits[rnd_i];
+            rnd_i = codec_params->bits_ordering[ bit_i ];
+            *index = (*index << 1) | bits[rnd_i];
         }
     }
 
-    // Generate what would be the expected license for the given digest and the index decoded
-    {
-        expected_license = mfLicensingGenerateLicense(vector, digest, index);
+    // Retrieve the validator bits, least significant bit first
+    if( validator_bits != 0 ) {
+        unsigned int bit_i = index_bits;
+        unsigned int validator_i = 0;
+        mfZero256(validator_bits);
+        while( bit_i < codec_params->bits_in_key ) {
+            validator_bits->b[validator_i >> 3] |= bits[ codec_params->bits_ordering[bit_i] ] << (validator_i & 0x07);
+            validator_i++;
+            bit_i++;
+        }
+    }
+    MF_STATS_PHASE_END(mfLicensingPhaseBitScatter);
+}
+
+int mfLicensingValidateLicense( mfLicensingVector *vector, mfLicensingDigest *digest, const unsigned char *license)
+{
+    mfLicensingContext context;
+    if( mfLicensingInitializeContext(&context, vector) != 0 ) {
+        // some codec parameters couldn't be validated
+        return 0;
     }
+    int valid = mfLicensingValidateLicenseWithContext(&context, digest, license);
+    mfLicensingReleaseContext(&context);
+    return valid;
+}
+
+int mfLicensingValidateLicenseWithContext( mfLicensingContext *context, mfLicensingDigest *digest, const unsigned char *license)
+{
+    mfU256 binary_key;
+    unsigned int index = 0;
+    unsigned char expected_license[255 + 2]; // key_length, check character and null terminator
+
+    MF_STATS_COUNT(validate_calls);
 
-    // Free up allocated resources except the expected license
-    free( bits );
-    free( codec_params.bits_ordering );
-    free( codec_params.codec_characters );
-    if( expected_license == 0 ) {
+    if( context->vector == 0 ) {
+        return 0;
+    }
+    mfLicensingVector *vector = context->vector;
+
+    // Reject typing errors before doing any arithmetic
+    if( vector->check_character && mfLicensingVerifyCheckCharacter(context, license) == 0 ) {
+        return 0;
+    }
+
+    // Compute the binary equivalent for the license
+    if( mfLicensingDecodeBinaryKey(&binary_key, &context->codec_params, context->character_weights, vector->key_length, vector->check_character, license) == 0 ) {
+        return 0;
+    }
+
+    // Retrieve the index from the binary key
+    mfLicensingExtractIndex(&index, 0, &context->codec_params, vector->index_bits, &binary_key);
+
+    // Generate what would be the expected license for the given digest and the index decoded
+    if( mfLicensingEncodeLicense(context, &context->salt, digest, index, expected_license) == 0 ) {
         return 0;
     }
 
@@ -495,38 +724,454 @@ int mfLicensingValidateLicense( mfLicensingVector *vector, mfLicensingDigest *di
         unsigned int coded_key_i = vector->key_length;
         while( coded_key_i-- ) {
             if( expected_license[coded_key_i] != license[coded_key_i] ) {
-                free( expected_license );
                 return 0;
             }
         }
     }
     // License is matching the expected value
-    free( expected_license );
+    return 1;
+}
+
+int mfLicensingInitializeContext( mfLicensingContext *context, mfLicensingVector *vector )
+{
+    MF_STATS_PHASE_BEGIN(mfLicensingPhaseCodecSetup);
+    if( mfLicensingInitializeCodecParams(&context->codec_params, vector) == 0 ) {
+        // some codec parameters couldn't be validated
+        context->vector = 0;
+        return -1;
+    }
+    MF_STATS_PHASE_END(mfLicensingPhaseCodecSetup);
+    context->vector = vector;
+    context->external_codec_params = 0;
+    mfLicensingInitializeCharacterWeights(context->character_weights, &context->codec_params);
+
+    // The salt only depends on the vector, compute it once
+    MF_STATS_PHASE_BEGIN(mfLicensingPhaseSaltRandomize);
+    if( vector->scheme == MF_LICENSING_SCHEME_PHILOX ) {
+        unsigned int key[2];
+        mfLicensingCounterKey(vector, key);
+        mfLicensingCounterSalt(key, &context->salt);
+    } else {
+        randomize256UsingSeed(&context->salt, vector->salt_seed);
+    }
+    MF_STATS_PHASE_END(mfLicensingPhaseSaltRandomize);
+    return 0;
+}
 
+void mfLicensingReleaseContext( mfLicensingContext *context )
+{
+    if( context->vector == 0 ) return;
+    if( context->external_codec_params == 0 ) {
+        free( context->codec_params.bits_ordering );
+        free( context->codec_params.codec_characters );
+    }
+    context->vector = 0;
+}
+
+int mfLicensingDecodeLicense( mfLicensingContext *context, const unsigned char *license, unsigned int *index, mfU256 *validator_bits )
+{
+    mfU256 binary_key;
+
+    MF_STATS_COUNT(decode_calls);
+    if( context->vector == 0 ) {
+        return 0;
+    }
+    if( context->vector->check_character && mfLicensingVerifyCheckCharacter(context, license) == 0 ) {
+        return 0;
+    }
+    if( mfLicensingDecodeBinaryKey(&binary_key, &context->codec_params, context->character_weights, context->vector->key_length, context->vector->check_character, license) == 0 ) {
+        return 0;
+    }
+    // No bits may be set past bits_in_key, they would be dropped and the key taken for another one
+    mfLicensingExtractIndex(index, validator_bits, &context->codec_params, context->vector->index_bits, &binary_key);
+    if( mfIsZero256(&binary_key) == 0 ) {
+        return 0;
+    }
+    return 1;
+}
+
+unsigned int mfLicensingDecodeLicenses( mfLicensingContext *context, const unsigned char **licenses, unsigned int count, unsigned int *indexes, mfU256 *validator_bits, unsigned char *decoded )
+{
+    unsigned int decoded_count = 0;
+    unsigned int license_i = 0;
+    while( license_i < count ) {
+        int result = mfLicensingDecodeLicense(context, licenses[license_i], &indexes[license_i], validator_bits != 0 ? &validator_bits[license_i] : 0);
+        if( decoded != 0 ) {
+            decoded[license_i] = (unsigned char)result;
+        }
+        decoded_count += result;
+        license_i++;
+    }
+    return decoded_count;
+}
+
+int mfLicensingOpenKeyIterator( mfLicensingKeyIterator *iterator, mfLicensingContext *context, mfLicensingDigest *digest, unsigned int first_index )
+{
+    if( context->vector == 0 ) {
+        return -1;
+    }
+    unsigned char index_bits = context->vector->index_bits;
+    unsigned int last_index = index_bits >= 32 ? 0xFFFFFFFF : (1u << index_bits) - 1;
+    if( first_index > last_index ) {
+        return -1;
+    }
+
+    mfCopy256(&context->salt, &iterator->salt);
+    mfCopy128(&digest->md5hash, &iterator->digest.md5hash);
+
+    iterator->context = context;
+    iterator->next_index = first_index;
+    iterator->last_index = last_index;
+    iterator->exhausted = 0;
+    return 0;
+}
+
+int mfLicensingKeyIteratorNext( mfLicensingKeyIterator *iterator, unsigned char *license, unsigned int *index )
+{
+    while( iterator->exhausted == 0 ) {
+        unsigned int key_index = iterator->next_index;
+        if( key_index == iterator->last_index ) {
+            iterator->exhausted = 1;
+        } else {
+            iterator->next_index++;
+        }
+        MF_STATS_COUNT(generate_calls);
+
+        if( mfLicensingEncodeLicense(iterator->context, &iterator->salt, &iterator->digest, key_index, license) == 1 ) {
+            if( index != 0 ) {
+                *index = key_index;
+            }
+            return 1;
+        }
+        // no key can be generated for this index, skip it
+    }
+    return 0;
+}
+
+#define MF_LICENSING_SEPARATOR_WEIGHT 0xFE
+#define MF_LICENSING_INVALID_WEIGHT 0xFF
+
+int mfLicensingInitializeKeyFormat( mfLicensingKeyFormat *format, mfLicensingContext *context, const unsigned char *separators, mfLicensingCasePolicy case_policy )
+{
+    if( context->vector == 0 ) {
+        return -1;
+    }
+    memcpy(format->input_weights, context->character_weights, sizeof(format->input_weights));
+
+    // Both cases of a letter share the weight of whichever case is an encoding character
+    if( case_policy == mfLicensingCaseInsensitive ) {
+        unsigned char upper = 'Z' + 1;
+        while( upper-- > 'A' ) {
+            unsigned char lower = upper - 'A' + 'a';
+            unsigned char upper_weight = format->input_weights[upper];
+            unsigned char lower_weight = format->input_weights[lower];
+            if( upper_weight != MF_LICENSING_INVALID_WEIGHT && lower_weight != MF_LICENSING_INVALID_WEIGHT ) {
+                // both cases are distinct encoding characters
+                return -1;
+            }
+            if( upper_weight != MF_LICENSING_INVALID_WEIGHT ) {
+                format->input_weights[lower] = upper_weight;
+            } else {
+                format->input_weights[upper] = lower_weight;
+            }
+        }
+    }
+
+    if( separators != 0 ) {
+        while( *separators != 0 ) {
+            if( format->input_weights[*separators] != MF_LICENSING_INVALID_WEIGHT &&
+                format->input_weights[*separators] != MF_LICENSING_SEPARATOR_WEIGHT ) {
+                // the separator would be ambiguous with an encoding character
+                return -1;
+            }
+            format->input_weights[*separators] = MF_LICENSING_SEPARATOR_WEIGHT;
+            separators++;
+        }
+    }
+
+    // The first character being the least significant, the key is decoded chunk by chunk from the start of
+    // the input; chunk i starts at character chunk_characters * i and the weight of the last one still fits
+    // in 256 bits, see mfLicensingInitializeCodecParams
+    unsigned int encoding_base = context->codec_params.encoding_base;
+    unsigned int key_length = context->vector->key_length;
+    format->chunk_characters = mfLicensingEncodingChunk(encoding_base);
+    format->chunk_count = (key_length + format->chunk_characters - 1) / format->chunk_characters;
+    if( format->chunk_count > MF_LICENSING_MAX_KEY_CHUNKS ) {
+        return -1;
+    }
+
+    mfU256 chunk_base, ignored;
+    unsigned int chunk_multiplier = 1;
+    unsigned int character_i = format->chunk_characters;
+    while( character_i-- ) chunk_multiplier *= encoding_base;
+    mfZero256(&chunk_base);
+    chunk_base.b[0] = chunk_multiplier & 0xFF;
+    chunk_base.b[1] = (chunk_multiplier >> 8) & 0xFF;
+    chunk_base.b[2] = (chunk_multiplier >> 16) & 0xFF;
+    chunk_base.b[3] = (chunk_multiplier >> 24) & 0xFF;
+
+    mfZero256(&format->chunk_powers[0]);
+    format->chunk_powers[0].b[0] = 1;
+    unsigned int chunk_i = 1;
+    while( chunk_i < format->chunk_count ) {
+        mfMultiplyU256(&format->chunk_powers[chunk_i - 1], &chunk_base, &format->chunk_powers[chunk_i], &ignored);
+        chunk_i++;
+    }
+
+    format->context = context;
+    return 0;
+}
+
+// Decodes the license key entered by the user into binary_key, skipping separators.
+// Returns 1 if the key could be decoded, 0 otherwise (invalid characters, length or check character, overflow).
+static int mfLicensingDecodeFormattedKey( mfU256 *binary_key, const mfLicensingKeyFormat *format, const unsigned char *input )
+{
+    mfLicensingVector *vector = format->context->vector;
+    unsigned int key_length = vector->key_length;
+    unsigned int encoding_base = format->context->codec_params.encoding_base;
+    unsigned int chunks[MF_LICENSING_MAX_KEY_CHUNKS];
+    unsigned int chunk_i = 0;
+    unsigned int chunk_weight = 1;
+    unsigned int chunk_characters = 0;
+    unsigned int characters = 0;
+    unsigned int check_sum = 0;
+    unsigned int check_weight = MF_LICENSING_INVALID_WEIGHT;
+
+    // Single pass over the input, folding the weights in 32-bit chunks and computing the check sum
+    chunks[0] = 0;
+    while( *input != 0 ) {
+        unsigned char weight = format->input_weights[*input++];
+        if( weight == MF_LICENSING_SEPARATOR_WEIGHT ) {
+            continue;
+        }
+        if( weight == MF_LICENSING_INVALID_WEIGHT ) {
+            // invalid character, no need to look any further
+            return 0;
+        }
+        if( characters == key_length ) {
+            if( vector->check_character == 0 || check_weight != MF_LICENSING_INVALID_WEIGHT ) {
+                // the key is longer than expected
+                return 0;
+            }
+            check_weight = weight;
+            continue;
+        }
+        if( chunk_characters == format->chunk_characters ) {
+            chunks[++chunk_i] = 0;
+            chunk_weight = 1;
+            chunk_characters = 0;
+        }
+        chunks[chunk_i] += weight * chunk_weight;
+        chunk_weight *= encoding_base;
+        chunk_characters++;
+        check_sum += ((key_length - 1 - characters) & 0x01) ? weight : mfLicensingCheckDouble(weight, encoding_base);
+        characters++;
+    }
+    if( characters != key_length ) {
+        return 0;
+    }
+    if( vector->check_character && check_weight != (encoding_base - check_sum % encoding_base) % encoding_base ) {
+        // typing error
+        return 0;
+    }
+
+    // Add the chunks to the binary key, each multiplied by its weight
+    mfZero256(binary_key);
+    chunk_i++;
+    while( chunk_i-- ) {
+        if( chunks[chunk_i] != 0 ) {
+            mfU256 chunk_value, term, overflow;
+            mfZero256(&chunk_value);
+            chunk_value.b[0] = chunks[chunk_i] & 0xFF;
+            chunk_value.b[1] = (chunks[chunk_i] >> 8) & 0xFF;
+            chunk_value.b[2] = (chunks[chunk_i] >> 16) & 0xFF;
+            chunk_value.b[3] = (chunks[chunk_i] >> 24) & 0xFF;
+            mfMultiplyU256(&format->chunk_powers[chunk_i], &chunk_value, &term, &overflow);
+            if( mfIsZero256(&overflow) == 0 || mfAddU256(binary_key, &term, binary_key) == 1 ) {
+                // resulting binary key is larger than we can support
+                return 0;
+            }
+        }
+    }
+    return mfIsZero256(binary_key) ? 0 : 1;
+}
+
+int mfLicensingValidateFormattedLicense( mfLicensingKeyFormat *format, mfLicensingDigest *digest, const unsigned char *input )
+{
+    mfU256 binary_key;
+    mfU256 validator_bits;
+    mfU256 validator;
+    unsigned int index = 0;
+
+    MF_STATS_COUNT(validate_calls);
+
+    mfLicensingContext *context = format->context;
+    if( context == 0 || context->vector == 0 ) {
+        return 0;
+    }
+
+    MF_STATS_PHASE_BEGIN(mfLicensingPhaseDecode);
+    int decoded = mfLicensingDecodeFormattedKey(&binary_key, format, input);
+    MF_STATS_PHASE_END(mfLicensingPhaseDecode);
+    if( decoded == 0 ) {
+        return 0;
+    }
+
+    // Retrieve the index and validator bits, no bits may be set past bits_in_key
+    mfLicensingExtractIndex(&index, &validator_bits, &context->codec_params, context->vector->index_bits, &binary_key);
+    if( mfIsZero256(&binary_key) == 0 ) {
+        return 0;
+    }
+
+    // Compare the validator bits stored in the key with the expected validator; the key being canonical,
+    // this is equivalent to generating the expected key and comparing the characters
+    mfLicensingComputeValidator(context, &context->salt, digest, index, &validator);
+    {
+        unsigned int validator_bit_count = context->codec_params.bits_in_key - context->vector->index_bits;
+        unsigned int byte_i = 0;
+        while( validator_bit_count >= 8 ) {
+            if( validator_bits.b[byte_i] != validator.b[byte_i] ) {
+                return 0;
+            }
+            validator_bit_count -= 8;
+            byte_i++;
+        }
+        if( ((validator_bits.b[byte_i] ^ validator.b[byte_i]) & ((1 << validator_bit_count) - 1)) != 0 ) {
+            return 0;
+        }
+    }
     return 1;
 }
 
 void randomize128UsingIntSeed( mfU128 *x, unsigned int seed )
 {
+    // equivalent to srand48( seed ) followed by lrand48() calls
     unsigned short int long_seed[3];
-    long_seed[0] = seed & 0xFFFF;
-    long_seed[1] = (seed >> 16) & 0xFFFF;
-    long_seed[2] = 0x4267;
-    srand48( seed );
-    *((unsigned int *)&x->l64.l32) = (unsigned int)(lrand48() & 0xFFFFFFFF);
-    *((unsigned int *)&x->l64.h32) = (unsigned int)(lrand48() & 0xFFFFFFFF);
-    *((unsigned int *)&x->h64.l32) = (unsigned int)(lrand48() & 0xFFFFFFFF);
-    *((unsigned int *)&x->h64.h32) = (unsigned int)(lrand48() & 0xFFFFFFFF);
+    long_seed[0] = 0x330E;
+    long_seed[1] = seed & 0xFFFF;
+    long_seed[2] = (seed >> 16) & 0xFFFF;
+    *((unsigned int *)&x->l64.l32) = (unsigned int)(nrand48(long_seed) & 0xFFFFFFFF);
+    *((unsigned int *)&x->l64.h32) = (unsigned int)(nrand48(long_seed) & 0xFFFFFFFF);
+    *((unsigned int *)&x->h64.l32) = (unsigned int)(nrand48(long_seed) & 0xFFFFFFFF);
+    *((unsigned int *)&x->h64.h32) = (unsigned int)(nrand48(long_seed) & 0xFFFFFFFF);
 }
 void randomize256UsingSeed( mfU256 *x, unsigned short int seed[3] )
 {
-    seed48( seed );
-    *((unsigned int *)&x->l128.l64.l32) = (unsigned int)(lrand48() & 0xFFFFFFFF);
-    *((unsigned int *)&x->l128.l64.h32) = (unsigned int)(lrand48() & 0xFFFFFFFF);
-    *((unsigned int *)&x->l128.h64.l32) = (unsigned int)(lrand48() & 0xFFFFFFFF);
-    *((unsigned int *)&x->l128.h64.h32) = (unsigned int)(lrand48() & 0xFFFFFFFF);
-    *((unsigned int *)&x->h128.l64.l32) = (unsigned int)(lrand48() & 0xFFFFFFFF);
-    *((unsigned int *)&x->h128.l64.h32) = (unsigned int)(lrand48() & 0xFFFFFFFF);
-    *((unsigned int *)&x->h128.h64.l32) = (unsigned int)(lrand48() & 0xFFFFFFFF);
-    *((unsigned int *)&x->h128.h64.h32) = (unsigned int)(lrand48() & 0xFFFFFFFF);
-}
\ No newline at end of file
+    unsigned short int long_seed[3];
+    long_seed[0] = seed[0];
+    long_seed[1] = seed[1];
+    long_seed[2] = seed[2];
+    *((unsigned int *)&x->l128.l64.l32) = (unsigned int)(nrand48(long_seed) & 0xFFFFFFFF);
+    *((unsigned int *)&x->l128.l64.h32) = (unsigned int)(nrand48(long_seed) & 0xFFFFFFFF);
+    *((unsigned int *)&x->l128.h64.l32) = (unsigned int)(nrand48(long_seed) & 0xFFFFFFFF);
+    *((unsigned int *)&x->l128.h64.h32) = (unsigned int)(nrand48(long_seed) & 0xFFFFFFFF);
+    *((unsigned int *)&x->h128.l64.l32) = (unsigned int)(nrand48(long_seed) & 0xFFFFFFFF);
+    *((unsigned int *)&x->h128.l64.h32) = (unsigned int)(nrand48(long_seed) & 0xFFFFFFFF);
+    *((unsigned int *)&x->h128.h64.l32) = (unsigned int)(nrand48(long_seed) & 0xFFFFFFFF);
+    *((unsigned int *)&x->h128.h64.h32) = (unsigned int)(nrand48(long_seed) & 0xFFFFFFFF);
+}
+
+// Philox4x32-10 counter-based generator (Salmon et al., "Parallel Random Numbers: As Easy as 1, 2, 3"),
+// output is the 128-bit block for the counter under key
+void mfLicensingPhilox( const unsigned int key[2], const unsigned int counter[4], unsigned int output[4] )
+{
+    unsigned int k0 = key[0], k1 = key[1];
+    unsigned int c0 = counter[0], c1 = counter[1], c2 = counter[2], c3 = counter[3];
+    unsigned int round_i = 0;
+    while( round_i < 10 ) {
+        unsigned long long p0 = (unsigned long long)0xD2511F53 * c0;
+        unsigned long long p1 = (unsigned long long)0xCD9E8D57 * c2;
+        c0 = (unsigned int)(p1 >> 32) ^ c1 ^ k0;
+        c1 = (unsigned int)p1;
+        c2 = (unsigned int)(p0 >> 32) ^ c3 ^ k1;
+        c3 = (unsigned int)p0;
+        k0 += 0x9E3779B9;
+        k1 += 0xBB67AE85;
+        round_i++;
+    }
+    output[0] = c0;
+    output[1] = c1;
+    output[2] = c2;
+    output[3] = c3;
+}
+
+// Key of the counter-based generator, from the salt seed of the vector
+void mfLicensingCounterKey( const mfLicensingVector *vector, unsigned int key[2] )
+{
+    key[0] = (unsigned int)vector->salt_seed[0] | ((unsigned int)vector->salt_seed[1] << 16);
+    key[1] = vector->salt_seed[2];
+}
+
+// Stores the 32-bit words in b, least significant word first, whatever the byte order of the host
+static void mfLicensingStoreWords( const unsigned int *words, unsigned int count, unsigned char *b )
+{
+    unsigned int word_i = 0;
+    while( word_i < count ) {
+        b[word_i * 4] = (unsigned char)words[word_i];
+        b[word_i * 4 + 1] = (unsigned char)(words[word_i] >> 8);
+        b[word_i * 4 + 2] = (unsigned char)(words[word_i] >> 16);
+        b[word_i * 4 + 3] = (unsigned char)(words[word_i] >> 24);
+        word_i++;
+    }
+}
+
+// 128-bit index block of MF_LICENSING_SCHEME_PHILOX, block of counter (index, 0, 0, 0)
+void mfLicensingCounterIndexBlock( const unsigned int key[2], unsigned int index, mfU128 *x )
+{
+    unsigned int counter[4] = { index, 0, 0, 0 };
+    unsigned int words[4];
+    mfLicensingPhilox(key, counter, words);
+    mfLicensingStoreWords(words, 4, x->b);
+}
+
+// 256-bit salt of MF_LICENSING_SCHEME_PHILOX, blocks of counters (0, 0, 0, 1) and (1, 0, 0, 1), kept apart
+// from the index blocks by the last word of the counter
+void mfLicensingCounterSalt( const unsigned int key[2], mfU256 *x )
+{
+    unsigned int counter[4] = { 0, 0, 0, 1 };
+    unsigned int words[8];
+    mfLicensingPhilox(key, counter, words);
+    counter[0] = 1;
+    mfLicensingPhilox(key, counter, words + 4);
+    mfLicensingStoreWords(words, 8, x->b);
+}
+
+int mfLicensingStatsEnabled( void )
+{
+#ifdef MFLICENSING_INSTRUMENTATION
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+void mfLicensingStatsSnapshot( mfLicensingStats *stats )
+{
+#ifdef MFLICENSING_INSTRUMENTATION
+    memcpy(stats, &mfLicensingThreadStats, sizeof(mfLicensingStats));
+#else
+    memset(stats, 0, sizeof(mfLicensingStats));
+#endif
+}
+
+void mfLicensingStatsReset( void )
+{
+#ifdef MFLICENSING_INSTRUMENTATION
+    memset(&mfLicensingThreadStats, 0, sizeof(mfLicensingStats));
+#endif
+}
+
+const char *mfLicensingPhaseName( mfLicensingPhase phase )
+{
+    switch( phase ) {
+        case mfLicensingPhaseCodecSetup: return "codec_setup";
+        case mfLicensingPhaseIndexRandomize: return "index_randomize";
+        case mfLicensingPhaseSaltRandomize: return "salt_randomize";
+        case mfLicensingPhaseValidatorMultiply: return "validator_multiply";
+        case mfLicensingPhaseValidatorDivide: return "validator_divide";
+        case mfLicensingPhaseBitScatter: return "bit_scatter";
+        case mfLicensingPhaseEncode: return "encode";
+        case mfLicensingPhaseDecode: return "decode";
+        default: return "unknown";
+    }
+}
@@ -45,6 +45,7 @@ typedef struct {
 
 // 128-bit license key digest; usually a MD5 hash
 //-----------------------------------------------
+// see mflicensingdigest.h to compute it from MD5 or a truncated SHA-256
 typedef struct {
     mfU128 md5hash;
 } mfLicensingDigest;
@@ -57,6 +58,8 @@ typedef struct {
 // salt_seed: array of 3 16-bit numbers, used to generate intermediate multiplier
 // key_length: number of characters contained in the final license key
 // index_bits: number of bits to reserve in the final key for the key index
+// check_character: 1 to append a check character to the key_length characters of the keys, 0 otherwise
+// scheme: key scheme, MF_LICENSING_SCHEME_LRAND48 (default) or MF_LICENSING_SCHEME_PHILOX
 typedef struct {
     const mfLicensingPrivateKey *private_key;
     const unsigned char *coded_chars;
@@ -64,13 +67,56 @@ typedef struct {
     unsigned short int salt_seed[3];
     unsigned char key_length;
     unsigned char index_bits;
+    unsigned char check_character;
+    unsigned char scheme;
 } mfLicensingVector;
 
+// Key schemes, how the 128-bit index block and the 256-bit salt are generated
+//----------------------------------------------------------------------------
+// MF_LICENSING_SCHEME_LRAND48: the lrand48 generator seeded with the index, and with the salt seed; the keys
+//   generated since the first version of the library
+// MF_LICENSING_SCHEME_PHILOX: the Philox4x32-10 counter-based generator keyed with the salt seed, the counter
+//   holding the index; blocks are the same on every platform, don't depend on the C library and are computed
+//   for any number of indexes at once in SIMD lanes.  Keys differ from the ones of the first scheme.
+#define MF_LICENSING_SCHEME_LRAND48 1
+#define MF_LICENSING_SCHEME_PHILOX 2
+
+// Codec parameters derived from a licensing vector
+//-------------------------------------------------
+// encoding_base: number of encoding characters
+// bits_in_key: number of bits that can be reliably stored in a key of vector->key_length characters
+// codec_characters: scrambled encoding characters, indexed by weight
+// bits_ordering: scrambled bit positions, index bits first followed by validator bits
+typedef struct {
+    unsigned int encoding_base;
+    unsigned int bits_in_key;
+    unsigned char *codec_characters;
+    unsigned char *bits_ordering;
+} mfLicensingCodecParams;
+
+// Licensing Context structure, holding the codec parameters computed once for a vector
+//-------------------------------------------------------------------------------------
+// vector: the licensing vector the context was initialized from
+// codec_params: scrambled characters and bits ordering derived from the vector
+// character_weights: reverse lookup of codec_params.codec_characters, 0xFF for invalid characters
+// salt: 256-bit salt generated from vector->salt_seed
+// external_codec_params: 1 if codec_params points to memory not owned by the context (see mflicensingblob.h)
+typedef struct {
+    mfLicensingVector *vector;
+    mfLicensingCodecParams codec_params;
+    unsigned char character_weights[256];
+    mfU256 salt;
+    int external_codec_params;
+} mfLicensingContext;
+
 // mfLicensingInitializeDefaultVector
 //-----------------------------------
 // Set the default values for the specified licensing vector
 //
-// Completely optional if all the value sof mfLicensingVector are set manually
+// A vector whose fields are set manually instead must set all of them: check_character to 0 or 1
+// and scheme to MF_LICENSING_SCHEME_LRAND48 (or 0, the same scheme) or MF_LICENSING_SCHEME_PHILOX,
+// other values are rejected by mfLicensingInitializeContext.  Calling this function first is
+// recommended.
 void mfLicensingInitializeDefaultVector( mfLicensingVector *vector );
 
 // mfLicensingSetPrivateKey
@@ -116,6 +162,29 @@ int mfLicensingSetKeyLength( mfLicensingVector *vector, unsigned char characters
 // This value should not exceed 32.
 int mfLicensingSetKeyIndexLength( mfLicensingVector *vector, unsigned char bits );
 
+// mfLicensingSetCheckCharacter
+//-----------------------------
+// Sets vector->check_character to the value specified (0 or 1)
+//
+// When enabled, a check character computed from the key_length characters of the key is appended to
+// the keys generated, which are then key_length + 1 characters long.  Validation verifies the check
+// character before anything else, so most typing errors (any single character changed, almost any two
+// adjacent characters swapped) are rejected without decoding the key.  The check character adds no
+// security: it can be computed by anyone, the validator bits are what authenticates a key.
+//
+// Keys generated with and without a check character are not interchangeable, the setting must not
+// be changed for a vector that already issued keys.
+int mfLicensingSetCheckCharacter( mfLicensingVector *vector, unsigned char enabled );
+
+// mfLicensingSetScheme
+//---------------------
+// Sets vector->scheme, MF_LICENSING_SCHEME_LRAND48 or MF_LICENSING_SCHEME_PHILOX
+//
+// Returns 0 on success, -1 if the scheme is unknown.
+//
+// The scheme must not be changed for a vector that already issued keys.
+int mfLicensingSetScheme( mfLicensingVector *vector, unsigned char scheme );
+
 // mfLicensingSetScramblingSeed
 //-----------------------------
 // Sets vector->scrambling_seed to the 3 16-bit values specified
@@ -156,4 +225,206 @@ unsigned char* mfLicensingGenerateLicense( mfLicensingVector *vector, mfLicensin
 // Returns 1 if the key is valid, 0 otherwise.
 int mfLicensingValidateLicense( mfLicensingVector *vector, mfLicensingDigest *digest, const unsigned char *license);
 
+// mfLicensingInitializeContext
+//-----------------------------
+// Computes the codec parameters of the vector specified and stores them in the context.
+//
+// The vector must remain valid and unchanged for as long as the context is in use.  The
+// context must be released using mfLicensingReleaseContext once no longer needed.
+//
+// Returns 0 on success, -1 if the vector parameters couldn't be validated: no private key or
+// characters, more than 100 characters, keys of more than 256 bits, a check_character other than
+// 0 or 1 or an unknown scheme.
+int mfLicensingInitializeContext( mfLicensingContext *context, mfLicensingVector *vector );
+
+// mfLicensingReleaseContext
+//--------------------------
+// Frees the memory allocated by mfLicensingInitializeContext
+void mfLicensingReleaseContext( mfLicensingContext *context );
+
+// mfLicensingGenerateLicenseWithContext
+//--------------------------------------
+// Same as mfLicensingGenerateLicense, using the codec parameters already computed in the context.
+//
+// Returns 0 if an error occured (insufficient index bits, index too large, etc)
+unsigned char* mfLicensingGenerateLicenseWithContext( mfLicensingContext *context, mfLicensingDigest *digest, unsigned int index );
+
+// mfLicensingGenerateLicenseToBuffer
+//-----------------------------------
+// Same as mfLicensingGenerateLicenseWithContext, writing the null-terminated key into license rather than
+// allocating it.  size is the number of bytes available in license, at least key_length + 1 (+ 1 more when
+// the vector has a check character).
+//
+// Returns 0 on success, -1 if an error occured (buffer too small, index too large, etc)
+int mfLicensingGenerateLicenseToBuffer( mfLicensingContext *context, mfLicensingDigest *digest, unsigned int index, unsigned char *license, unsigned int size );
+
+// mfLicensingValidateLicenseWithContext
+//--------------------------------------
+// Same as mfLicensingValidateLicense, using the codec parameters already computed in the context.
+//
+// Returns 1 if the key is valid, 0 otherwise.
+int mfLicensingValidateLicenseWithContext( mfLicensingContext *context, mfLicensingDigest *digest, const unsigned char *license );
+
+// mfLicensingDecodeLicense
+//-------------------------
+// Extracts the index and the raw validator bits stored in a license key without computing
+// the expected validator.  No digest is needed, which makes this considerably cheaper than
+// mfLicensingValidateLicense; the key is NOT validated.
+//
+// validator_bits receives the (bits_in_key - index_bits) validator bits found in the key,
+// least significant bit first.  It may be 0 if only the index is of interest.
+//
+// Returns 1 if the key could be decoded, 0 otherwise (invalid length, characters or check character, or
+// a value that doesn't fit in the bits of the key, which no key generated has).
+int mfLicensingDecodeLicense( mfLicensingContext *context, const unsigned char *license, unsigned int *index, mfU256 *validator_bits );
+
+// mfLicensingDecodeLicenses
+//--------------------------
+// Batched form of mfLicensingDecodeLicense, decoding count license keys.
+//
+// indexes, validator_bits and decoded are arrays of count entries; validator_bits and decoded
+// may be 0.  decoded[i] is set to 1 if licenses[i] could be decoded, 0 otherwise, out of range values
+// included as with mfLicensingDecodeLicense.
+//
+// Returns the number of license keys successfully decoded.
+unsigned int mfLicensingDecodeLicenses( mfLicensingContext *context, const unsigned char **licenses, unsigned int count, unsigned int *indexes, mfU256 *validator_bits, unsigned char *decoded );
+
+// Sequential Key Iterator structure
+//----------------------------------
+// Generates the license keys of one digest in index order, one key at a time.  The codec parameters and
+// the salt come from the context; no memory is allocated, keys are written into a buffer provided by the
+// caller.
+//
+// context: licensing context the keys are generated with, must remain valid while the iterator is in use
+// digest: copy of the digest the keys are generated for
+// salt: copy of the 256-bit salt of the context
+// next_index: index of the next key to generate
+// last_index: largest index that can be stored in the index bits of the vector
+// exhausted: 1 once the key for last_index has been generated
+typedef struct {
+    mfLicensingContext *context;
+    mfLicensingDigest digest;
+    mfU256 salt;
+    unsigned int next_index;
+    unsigned int last_index;
+    int exhausted;
+} mfLicensingKeyIterator;
+
+// mfLicensingOpenKeyIterator
+//---------------------------
+// Prepares the iterator to generate the keys of the digest specified, starting at first_index.
+//
+// Returns 0 on success, -1 if the context isn't initialized or first_index doesn't fit in the index bits.
+int mfLicensingOpenKeyIterator( mfLicensingKeyIterator *iterator, mfLicensingContext *context, mfLicensingDigest *digest, unsigned int first_index );
+
+// mfLicensingKeyIteratorNext
+//---------------------------
+// Writes the license key of the next index into license, which must hold vector->key_length + 1 characters
+// (+ 1 with a check character), and the index of the key into index (may be 0).  Indexes for which no key
+// can be generated are skipped.
+//
+// Returns 1 if a key was written, 0 once all the keys have been generated.
+int mfLicensingKeyIteratorNext( mfLicensingKeyIterator *iterator, unsigned char *license, unsigned int *index );
+
+// Case policy applied to license keys entered by users
+//-----------------------------------------------------
+// mfLicensingCaseSensitive: characters must match the encoding characters exactly
+// mfLicensingCaseInsensitive: a letter matches the encoding character of either case
+typedef enum {
+    mfLicensingCaseSensitive = 0,
+    mfLicensingCaseInsensitive
+} mfLicensingCasePolicy;
+
+#define MF_LICENSING_MAX_KEY_CHUNKS 16
+
+// Key Format structure, describing how users enter license keys
+//--------------------------------------------------------------
+// context: licensing context the keys are validated with, must remain valid while the format is in use
+// input_weights: weight of every input character once case folded, 0xFE for separators, 0xFF for invalid characters
+// chunk_characters: number of characters decoded at once
+// chunk_count: number of chunks in a key of vector->key_length characters
+// chunk_powers: weight of each chunk in the binary key, encoding_base^(chunk_characters * chunk)
+typedef struct {
+    mfLicensingContext *context;
+    unsigned char input_weights[256];
+    unsigned int chunk_characters;
+    unsigned int chunk_count;
+    mfU256 chunk_powers[MF_LICENSING_MAX_KEY_CHUNKS];
+} mfLicensingKeyFormat;
+
+// mfLicensingInitializeKeyFormat
+//-------------------------------
+// Prepares the key format for validating keys as entered by users: the characters of separators (may be 0)
+// are ignored wherever they appear and case_policy determines how letters are matched.
+//
+// Returns 0 on success, -1 if the context isn't initialized, a separator is also an encoding character or
+// the encoding characters contain both cases of a letter with mfLicensingCaseInsensitive.
+int mfLicensingInitializeKeyFormat( mfLicensingKeyFormat *format, mfLicensingContext *context, const unsigned char *separators, mfLicensingCasePolicy case_policy );
+
+// mfLicensingValidateFormattedLicense
+//------------------------------------
+// Same as mfLicensingValidateLicenseWithContext, for a license key as entered by the user ("acdef-ghjkl-...").
+// The key is decoded in a single pass over the input, without building a cleaned copy, and rejected as soon
+// as an invalid character or one character too many is found.
+//
+// Returns 1 if the key is valid, 0 otherwise.
+int mfLicensingValidateFormattedLicense( mfLicensingKeyFormat *format, mfLicensingDigest *digest, const unsigned char *input );
+
+// Instrumentation
+//----------------
+// When the library is compiled with MFLICENSING_INSTRUMENTATION defined, the time spent in each phase
+// of the key generation, validation and decoding as well as the number of calls and memory allocations
+// are accumulated in thread-local counters.  Without MFLICENSING_INSTRUMENTATION the counters are
+// compiled out entirely and mfLicensingStatsSnapshot always returns zeroed statistics.
+//
+// Time is measured in CPU cycles (time stamp counter) on x86, in mach absolute time units on other
+// Apple platforms and in nanoseconds elsewhere.
+typedef enum {
+    mfLicensingPhaseCodecSetup = 0,         // mfLicensingInitializeCodecParams
+    mfLicensingPhaseIndexRandomize,         // index block of the key scheme
+    mfLicensingPhaseSaltRandomize,          // salt of the key scheme
+    mfLicensingPhaseValidatorMultiply,      // digest x index block x salt
+    mfLicensingPhaseValidatorDivide,        // reduction by the private key
+    mfLicensingPhaseBitScatter,             // index and validator bits to/from the binary key
+    mfLicensingPhaseEncode,                 // binary key to characters
+    mfLicensingPhaseDecode,                 // characters to binary key
+    mfLicensingPhaseCount
+} mfLicensingPhase;
+
+// Statistics accumulated by the calling thread
+//---------------------------------------------
+// cycles: time spent in each phase
+// calls: number of times each phase was executed
+// generate_calls, validate_calls, decode_calls: number of calls to the public entry points
+// allocations, allocated_bytes: number and total size of the memory blocks allocated
+typedef struct {
+    unsigned long long cycles[mfLicensingPhaseCount];
+    unsigned long long calls[mfLicensingPhaseCount];
+    unsigned long long generate_calls;
+    unsigned long long validate_calls;
+    unsigned long long decode_calls;
+    unsigned long long allocations;
+    unsigned long long allocated_bytes;
+} mfLicensingStats;
+
+// mfLicensingStatsEnabled
+//------------------------
+// Returns 1 if the library was compiled with MFLICENSING_INSTRUMENTATION, 0 otherwise.
+int mfLicensingStatsEnabled( void );
+
+// mfLicensingStatsSnapshot
+//-------------------------
+// Copies the statistics accumulated by the calling thread into stats.
+void mfLicensingStatsSnapshot( mfLicensingStats *stats );
+
+// mfLicensingStatsReset
+//----------------------
+// Resets the statistics accumulated by the calling thread.
+void mfLicensingStatsReset( void );
+
+// mfLicensingPhaseName
+//---------------------
+// Returns a short, constant name for the phase specified, suitable for exporting metrics.
+const char *mfLicensingPhaseName( mfLicensingPhase phase );
+
 #endif
@@ -0,0 +1,257 @@
+//
+//  mflicensing.hpp
+//  MFLicensing
+//  https://github.com/freshcode/MFLicensing
+//
+//
+//  C++ interface to the licensing library.
+//
+//  The C interface returns keys allocated with malloc and refers to the encoding characters and
+//  the private key of a vector through pointers the caller must keep valid.  This header wraps it:
+//
+//  - mf::Vector owns its encoding characters, its private key and its initialized licensing
+//    context; it can be moved but not copied, and is released automatically.
+//  - mf::LicenseKey stores a key inline, in a fixed capacity array, keys never touch the heap.
+//  - Inputs are std::string_view and std::span.
+//
+//      auto vector = mf::Vector::create({ .private_key = "1048790829713117586646307642..." });
+//      mf::Digest digest = mf::digest_of(std::string_view("John Appleseed"));
+//      std::optional<mf::LicenseKey> key = vector->generate(digest, 1);
+//      bool valid = vector->validate(digest, user_input);
+//
+//  Once created, a vector is only read: generate and validate allocate nothing and may be called
+//  from any number of threads at once, first calls included, the instruction sets used for the
+//  arithmetic, SHA-256 and batch validation being selected and published atomically.  Moving,
+//  assigning or destroying a vector must not overlap with the calls using it.  Creating a vector
+//  allocates its codec parameters.
+//
+//  Header only, requires C++20 (std::span and designated initializers).
+//
+//  Licensing
+//  ---------
+//  Public Domain
+//  By Freshcode, Cutting edge Mac, iPhone & iPad software development. http://madefresh.ca/
+//
+
+#ifndef MFLicensing_mflicensing_hpp
+#define MFLicensing_mflicensing_hpp
+
+extern "C" {
+#include "mflicensing.h"
+#include "mflicensingdigest.h"
+}
+
+#include <array>
+#include <cstddef>
+#include <cstring>
+#include <optional>
+#include <span>
+#include <string>
+#include <string_view>
+#include <utility>
+
+namespace mf {
+
+using Digest = mfLicensingDigest;
+
+// Digest of data, MD5 unless another provider is specified (see mflicensingdigest.h)
+inline Digest digest_of(std::span<const std::byte> data, const mfLicensingDigestProvider &provider = mfLicensingDigestMD5) noexcept
+{
+    Digest digest;
+    mfLicensingComputeDigest(&provider, data.data(), static_cast<unsigned long>(data.size()), &digest);
+    return digest;
+}
+inline Digest digest_of(std::string_view data, const mfLicensingDigestProvider &provider = mfLicensingDigestMD5) noexcept
+{
+    return digest_of(std::as_bytes(std::span<const char>(data.data(), data.size())), provider);
+}
+
+// Digest made of the 16 bytes specified, a digest computed elsewhere for instance
+inline Digest digest_from_bytes(std::span<const unsigned char, 16> bytes) noexcept
+{
+    Digest digest;
+    std::memcpy(digest.md5hash.b, bytes.data(), 16);
+    return digest;
+}
+
+// LicenseKey
+//-----------
+// A license key stored inline, null-terminated so it can be handed to the C functions as is.
+class LicenseKey {
+public:
+    static constexpr std::size_t capacity = 255;
+
+    LicenseKey() noexcept = default;
+
+    // The key is left empty if the text is longer than capacity or contains a null character
+    explicit LicenseKey(std::string_view key) noexcept { assign(key); }
+
+    // Returns false, leaving the key empty, if the text is longer than capacity or contains a null character
+    bool assign(std::string_view key) noexcept
+    {
+        if( key.size() > capacity || key.find('\0') != std::string_view::npos ) {
+            clear();
+            return false;
+        }
+        std::memcpy(data_.data(), key.data(), key.size());
+        data_[key.size()] = 0;
+        length_ = key.size();
+        return true;
+    }
+    void clear() noexcept { data_[0] = 0; length_ = 0; }
+
+    std::string_view view() const noexcept { return std::string_view(c_str(), length_); }
+    const char *c_str() const noexcept { return reinterpret_cast<const char *>(data_.data()); }
+    const unsigned char *data() const noexcept { return data_.data(); }
+    std::size_t size() const noexcept { return length_; }
+    bool empty() const noexcept { return length_ == 0; }
+    std::string str() const { return std::string(view()); }
+
+    friend bool operator==(const LicenseKey &a, const LicenseKey &b) noexcept { return a.view() == b.view(); }
+    friend bool operator==(const LicenseKey &a, std::string_view b) noexcept { return a.view() == b; }
+
+private:
+    friend class Vector;
+
+    std::size_t length_ = 0;
+    std::array<unsigned char, capacity + 1> data_ = {};
+};
+
+// Vector
+//-------
+// A licensing vector owning its parameters, with its licensing context initialized.
+class Vector {
+public:
+    // Parameters left unset keep the values of mfLicensingInitializeDefaultVector
+    struct Options {
+        std::string_view private_key = {};                          // decimal representation of a 256-bit prime
+        std::string_view characters = {};                           // encoding characters
+        std::optional<unsigned int> key_length = {};
+        std::optional<unsigned int> index_bits = {};
+        bool check_character = false;
+        std::optional<std::array<unsigned short, 3>> scrambling_seed = {};
+        std::optional<std::array<unsigned short, 3>> salt_seed = {};
+        unsigned int scheme = MF_LICENSING_SCHEME_LRAND48;             // MF_LICENSING_SCHEME_LRAND48 or MF_LICENSING_SCHEME_PHILOX
+    };
+
+    // Returns std::nullopt if the private key or another parameter is invalid
+    static std::optional<Vector> create(const Options &options)
+    {
+        Vector vector;
+        mfLicensingInitializeDefaultVector(&vector.vector_);
+        if( options.characters.empty() ) {
+            vector.characters_ = reinterpret_cast<const char *>(vector.vector_.coded_chars);
+        } else {
+            vector.characters_ = options.characters;
+        }
+        std::string private_key(options.private_key);
+        if( private_key.empty() || private_key.find('\0') != std::string::npos || vector.characters_.find('\0') != std::string::npos ) {
+            return std::nullopt;
+        }
+        if( mfLicensingInitializePrivateKeyFromPrime(&vector.private_key_, reinterpret_cast<const unsigned char *>(private_key.c_str())) != 0 ) {
+            return std::nullopt;
+        }
+        if( options.key_length && (*options.key_length == 0 || *options.key_length > 255 ||
+                                   mfLicensingSetKeyLength(&vector.vector_, static_cast<unsigned char>(*options.key_length)) != 0) ) {
+            return std::nullopt;
+        }
+        if( options.index_bits && (*options.index_bits > 32 ||
+                                   mfLicensingSetKeyIndexLength(&vector.vector_, static_cast<unsigned char>(*options.index_bits)) != 0) ) {
+            return std::nullopt;
+        }
+        mfLicensingSetCheckCharacter(&vector.vector_, options.check_character ? 1 : 0);
+        if( options.scrambling_seed ) {
+            std::array<unsigned short, 3> seed = *options.scrambling_seed;
+            mfLicensingSetScramblingSeed(&vector.vector_, seed.data());
+        }
+        if( options.salt_seed ) {
+            std::array<unsigned short, 3> seed = *options.salt_seed;
+            mfLicensingSetSaltSeed(&vector.vector_, seed.data());
+        }
+        if( options.scheme > 0xFF || mfLicensingSetScheme(&vector.vector_, static_cast<unsigned char>(options.scheme)) != 0 ) {
+            return std::nullopt;
+        }
+        if( mfLicensingSetEncodingCharacters(&vector.vector_, reinterpret_cast<const unsigned char *>(vector.characters_.c_str())) != 0 ||
+            mfLicensingSetPrivateKey(&vector.vector_, &vector.private_key_) != 0 ||
+            mfLicensingInitializeContext(&vector.context_, &vector.vector_) != 0 ) {
+            return std::nullopt;
+        }
+        // Keys generated must fit in a LicenseKey
+        if( vector.vector_.key_length + vector.vector_.check_character > LicenseKey::capacity ) {
+            return std::nullopt;
+        }
+        return std::optional<Vector>(std::move(vector));
+    }
+
+    Vector(Vector &&other) noexcept { take(other); }
+    Vector &operator=(Vector &&other) noexcept
+    {
+        if( this != &other ) {
+            mfLicensingReleaseContext(&context_);
+            take(other);
+        }
+        return *this;
+    }
+    Vector(const Vector &) = delete;
+    Vector &operator=(const Vector &) = delete;
+    ~Vector() { mfLicensingReleaseContext(&context_); }
+
+    // Generates the key of digest and index, std::nullopt if index doesn't fit in the index bits
+    std::optional<LicenseKey> generate(const Digest &digest, unsigned int index) const noexcept
+    {
+        LicenseKey key;
+        Digest copy = digest;
+        if( mfLicensingGenerateLicenseToBuffer(&context_, &copy, index, key.data_.data(), static_cast<unsigned int>(key.data_.size())) != 0 ) {
+            return std::nullopt;
+        }
+        key.length_ = std::strlen(key.c_str());
+        return key;
+    }
+
+    // Returns true if key is a valid key of digest
+    bool validate(const Digest &digest, const LicenseKey &key) const noexcept
+    {
+        Digest copy = digest;
+        return mfLicensingValidateLicenseWithContext(&context_, &copy, key.data()) != 0;
+    }
+    bool validate(const Digest &digest, std::string_view key) const noexcept
+    {
+        LicenseKey copy;
+        return copy.assign(key) && validate(digest, copy);
+    }
+
+    // Number of characters of the keys, check character included
+    std::size_t key_length() const noexcept { return vector_.key_length + vector_.check_character; }
+    unsigned int index_bits() const noexcept { return vector_.index_bits; }
+    std::string_view characters() const noexcept { return characters_; }
+
+    // Licensing context of the vector, for the C functions and mflicensingasync.hpp.  The context
+    // must not be modified; the C functions take a non-const pointer but only read it.
+    mfLicensingContext &context() const noexcept { return context_; }
+
+private:
+    Vector() noexcept { context_.vector = 0; }
+
+    // Takes the parameters and context of other, the pointers of the C structures are updated to
+    // refer to this vector; other is left released
+    void take(Vector &other) noexcept
+    {
+        characters_ = std::move(other.characters_);
+        private_key_ = other.private_key_;
+        vector_ = other.vector_;
+        vector_.coded_chars = reinterpret_cast<const unsigned char *>(characters_.c_str());
+        vector_.private_key = &private_key_;
+        context_ = other.context_;
+        if( context_.vector != 0 ) context_.vector = &vector_;
+        other.context_.vector = 0;
+    }
+
+    std::string characters_;
+    mfLicensingPrivateKey private_key_;
+    mfLicensingVector vector_;
+    mutable mfLicensingContext context_;
+};
+
+} // namespace mf
+
+#endif
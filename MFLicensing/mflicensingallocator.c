@@ -0,0 +1,704 @@
+//
+//  mflicensingallocator.c
+//  MFLicensing
+//  https://github.com/freshcode/MFLicensing
+//
+//  Public Domain
+//  By Freshcode, Cutting edge Mac, iPhone & iPad software development. http://madefresh.ca/
+//
+
+#include "mflicensingallocator.h"
+#include <stdint.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/file.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// File layout, multi-byte fields in the byte order of the host:
+//    0  header (64 bytes)
+//   64  digest table: capacity and count (32 bytes) followed by capacity entries of 32 bytes
+//  ...  nodes and digest tables allocated as needed, up to header.used
+//
+// Offsets are relative to the start of the file, 0 standing for none.  Space is never reused: when
+// the digest table grows a new one is allocated and the header switched to it in a single store.
+#define MF_ALLOCATOR_MAGIC "MFLA"
+#define MF_ALLOCATOR_VERSION 1
+#define MF_ALLOCATOR_HEADER_SIZE 64
+#define MF_ALLOCATOR_INITIAL_TABLE 1024
+#define MF_ALLOCATOR_MIN_FILE_SIZE 65536
+#define MF_ALLOCATOR_LEAF_BITS 12           // a leaf holds 64 words of 64 bits
+#define MF_ALLOCATOR_NODE_BITS 6            // an inner node has 64 children
+#define MF_ALLOCATOR_MAX_HEIGHT 4           // inner levels needed for 32 index bits
+#define MF_ALLOCATOR_NONE UINT64_MAX
+#define MF_ALLOCATOR_FULL UINT64_MAX
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#define MF_ALLOCATOR_HOST_BYTE_ORDER 2
+#else
+#define MF_ALLOCATOR_HOST_BYTE_ORDER 1
+#endif
+
+typedef struct {
+    char magic[4];
+    uint16_t version;
+    uint8_t byte_order;
+    uint8_t index_bits;
+    uint64_t used;                          // end of the space allocated
+    uint64_t table;                         // offset of the digest table
+    uint32_t clean;                         // 1 once closed cleanly, 0 while open
+    uint8_t reserved[36];
+} mfLicensingAllocatorHeader;
+
+typedef struct {
+    uint64_t capacity;                      // number of entries, a power of 2
+    uint64_t count;                         // entries in use
+    uint64_t reserved[2];
+} mfLicensingAllocatorTable;
+
+// Entries are in use once root is set, digest being written first
+typedef struct {
+    unsigned char digest[16];
+    uint64_t root;
+    uint64_t reserved;
+} mfLicensingAllocatorEntry;
+
+// full: bit i set once word i of a leaf has all its bits set, or once child i of an inner node is full
+// slot: words of index bits in a leaf, offsets of the children in an inner node (0 for a child not
+// created yet, all its indexes being free)
+typedef struct {
+    uint64_t full;
+    uint64_t slot[64];
+} mfLicensingAllocatorNode;
+
+#define MF_ALLOCATOR_HEADER(allocator) ((mfLicensingAllocatorHeader *)(allocator)->map)
+#define MF_ALLOCATOR_NODE(allocator, offset) ((mfLicensingAllocatorNode *)((allocator)->map + (offset)))
+#define MF_ALLOCATOR_TABLE(allocator, offset) ((mfLicensingAllocatorTable *)((allocator)->map + (offset)))
+#define MF_ALLOCATOR_ENTRY(allocator, table, entry_i) \
+    ((mfLicensingAllocatorEntry *)((allocator)->map + (table) + sizeof(mfLicensingAllocatorTable)) + (entry_i))
+
+static unsigned int mfLicensingAllocatorLowestBit( uint64_t word )
+{
+#if defined(__GNUC__)
+    return (unsigned int)__builtin_ctzll(word);
+#else
+    unsigned int bit_i = 0;
+    while( (word & 1) == 0 ) {
+        word >>= 1;
+        bit_i++;
+    }
+    return bit_i;
+#endif
+}
+
+// Number of index bits below the children of the nodes at height, the leaves being at height 0
+static unsigned int mfLicensingAllocatorShift( unsigned int height )
+{
+    return height == 0 ? 6 : MF_ALLOCATOR_LEAF_BITS + MF_ALLOCATOR_NODE_BITS * (height - 1);
+}
+
+static uint64_t mfLicensingAllocatorCapacity( mfLicensingIndexAllocator *allocator )
+{
+    return (uint64_t)1 << allocator->index_bits;
+}
+
+static uint64_t mfLicensingAllocatorHash( const unsigned char *digest )
+{
+    uint64_t low, high;
+    memcpy(&low, digest, 8);
+    memcpy(&high, digest + 8, 8);
+    low ^= high * 0x9E3779B97F4A7C15ULL;
+    low ^= low >> 32;
+    low *= 0xD6E8FEB86659FD93ULL;
+    return low ^ (low >> 32);
+}
+
+#pragma mark -
+#pragma mark File
+
+// Writes the pages holding size bytes at offset to disk
+static int mfLicensingAllocatorSync( mfLicensingIndexAllocator *allocator, uint64_t offset, uint64_t size )
+{
+    uint64_t page_size = (uint64_t)sysconf(_SC_PAGESIZE);
+    uint64_t start = offset - offset % page_size;
+
+    return msync(allocator->map + start, (size_t)(offset + size - start), MS_SYNC);
+}
+
+// Writes the pages holding size bytes at offset to disk when every allocation is synced.  Used to
+// order the writes that must reach the disk before others, a node before the link to it for instance.
+static int mfLicensingAllocatorPersist( mfLicensingIndexAllocator *allocator, uint64_t offset, uint64_t size )
+{
+    if( (allocator->flags & MF_LICENSING_ALLOCATOR_SYNC) == 0 ) {
+        return 0;
+    }
+    return mfLicensingAllocatorSync(allocator, offset, size);
+}
+
+// Ends an operation: the whole file is synced when every allocation is
+static int mfLicensingAllocatorCommit( mfLicensingIndexAllocator *allocator )
+{
+    if( (allocator->flags & MF_LICENSING_ALLOCATOR_SYNC) == 0 ) {
+        return 0;
+    }
+    return msync(allocator->map, allocator->map_size, MS_SYNC);
+}
+
+// Extends the file to hold at least size bytes, doubling it to keep the number of mappings low.  The new
+// mapping is created before the previous one is released, which remains valid on failure.
+static int mfLicensingAllocatorGrow( mfLicensingIndexAllocator *allocator, uint64_t size )
+{
+    uint64_t page_size = (uint64_t)sysconf(_SC_PAGESIZE);
+    uint64_t map_size = (uint64_t)allocator->map_size * 2;
+    unsigned char *map;
+
+    if( map_size < size ) {
+        map_size = size;
+    }
+    map_size = (map_size + page_size - 1) / page_size * page_size;
+    if( map_size != (unsigned long)map_size || ftruncate(allocator->fd, (off_t)map_size) != 0 ) {
+        return -1;
+    }
+    map = mmap(0, (size_t)map_size, PROT_READ | PROT_WRITE, MAP_SHARED, allocator->fd, 0);
+    if( map == MAP_FAILED ) {
+        return -1;
+    }
+    munmap(allocator->map, allocator->map_size);
+    allocator->map = map;
+    allocator->map_size = (unsigned long)map_size;
+    return 0;
+}
+
+// Allocates size zeroed bytes at the end of the space used.  Returns their offset, 0 on failure.
+//
+// The space is accounted for in the header before being used, a crash leaves it unused at worst.  The
+// mapping may move: pointers into it must be computed again from offsets after the call.
+static uint64_t mfLicensingAllocatorReserve( mfLicensingIndexAllocator *allocator, uint64_t size )
+{
+    uint64_t offset = MF_ALLOCATOR_HEADER(allocator)->used;
+
+    if( offset + size > allocator->map_size && mfLicensingAllocatorGrow(allocator, offset + size) != 0 ) {
+        return 0;
+    }
+    MF_ALLOCATOR_HEADER(allocator)->used = offset + size;
+    memset(allocator->map + offset, 0, (size_t)size);
+    if( mfLicensingAllocatorPersist(allocator, offset, size) != 0 ) {
+        return 0;
+    }
+    return offset;
+}
+
+#pragma mark -
+#pragma mark Digest Table
+
+static uint64_t mfLicensingAllocatorCreateTable( mfLicensingIndexAllocator *allocator, uint64_t capacity )
+{
+    uint64_t table = mfLicensingAllocatorReserve(allocator, sizeof(mfLicensingAllocatorTable) + capacity * sizeof(mfLicensingAllocatorEntry));
+    if( table != 0 ) {
+        MF_ALLOCATOR_TABLE(allocator, table)->capacity = capacity;
+    }
+    return table;
+}
+
+// Returns the index of the entry of digest in table, or of the empty entry where it would be inserted
+static uint64_t mfLicensingAllocatorProbe( mfLicensingIndexAllocator *allocator, uint64_t table, const unsigned char *digest )
+{
+    uint64_t mask = MF_ALLOCATOR_TABLE(allocator, table)->capacity - 1;
+    uint64_t entry_i = mfLicensingAllocatorHash(digest) & mask;
+
+    for(;;) {
+        mfLicensingAllocatorEntry *entry = MF_ALLOCATOR_ENTRY(allocator, table, entry_i);
+        if( entry->root == 0 || memcmp(entry->digest, digest, 16) == 0 ) {
+            return entry_i;
+        }
+        entry_i = (entry_i + 1) & mask;
+    }
+}
+
+// Moves the entries to a table twice as large, switching the header to it once it is complete
+static int mfLicensingAllocatorGrowTable( mfLicensingIndexAllocator *allocator )
+{
+    uint64_t old_table = MF_ALLOCATOR_HEADER(allocator)->table;
+    uint64_t capacity = MF_ALLOCATOR_TABLE(allocator, old_table)->capacity;
+    uint64_t table = mfLicensingAllocatorCreateTable(allocator, capacity * 2);
+    uint64_t entry_i;
+
+    if( table == 0 ) {
+        return -1;
+    }
+    for( entry_i = 0; entry_i < capacity; entry_i++ ) {
+        mfLicensingAllocatorEntry *entry = MF_ALLOCATOR_ENTRY(allocator, old_table, entry_i);
+        if( entry->root != 0 ) {
+            *MF_ALLOCATOR_ENTRY(allocator, table, mfLicensingAllocatorProbe(allocator, table, entry->digest)) = *entry;
+        }
+    }
+    MF_ALLOCATOR_TABLE(allocator, table)->count = MF_ALLOCATOR_TABLE(allocator, old_table)->count;
+    // Synced whatever the flags: once the header points to it, the table holds every digest allocated so far
+    if( mfLicensingAllocatorSync(allocator, table, sizeof(mfLicensingAllocatorTable) + capacity * 2 * sizeof(mfLicensingAllocatorEntry)) != 0 ) {
+        return -1;
+    }
+    MF_ALLOCATOR_HEADER(allocator)->table = table;
+    return mfLicensingAllocatorPersist(allocator, 0, MF_ALLOCATOR_HEADER_SIZE);
+}
+
+// Returns the offset of the root node of digest, 0 if digest has none and create is 0 or on failure.
+static uint64_t mfLicensingAllocatorRoot( mfLicensingIndexAllocator *allocator, const mfLicensingDigest *digest, int create )
+{
+    const unsigned char *bytes = digest->md5hash.b;
+    uint64_t table = MF_ALLOCATOR_HEADER(allocator)->table;
+    uint64_t entry_i = mfLicensingAllocatorProbe(allocator, table, bytes);
+    mfLicensingAllocatorTable *table_info = MF_ALLOCATOR_TABLE(allocator, table);
+    uint64_t root;
+
+    if( MF_ALLOCATOR_ENTRY(allocator, table, entry_i)->root != 0 || create == 0 ) {
+        return MF_ALLOCATOR_ENTRY(allocator, table, entry_i)->root;
+    }
+
+    // Keep the table at most half full so probing stays short
+    if( (table_info->count + 1) * 2 > table_info->capacity ) {
+        if( mfLicensingAllocatorGrowTable(allocator) != 0 ) {
+            return 0;
+        }
+        table = MF_ALLOCATOR_HEADER(allocator)->table;
+        entry_i = mfLicensingAllocatorProbe(allocator, table, bytes);
+    }
+
+    root = mfLicensingAllocatorReserve(allocator, sizeof(mfLicensingAllocatorNode));
+    if( root == 0 ) {
+        return 0;
+    }
+    // The digest must be in place before the entry becomes used by setting its root
+    memcpy(MF_ALLOCATOR_ENTRY(allocator, table, entry_i)->digest, bytes, 16);
+    if( mfLicensingAllocatorPersist(allocator, table + sizeof(mfLicensingAllocatorTable) + entry_i * sizeof(mfLicensingAllocatorEntry), sizeof(mfLicensingAllocatorEntry)) != 0 ) {
+        return 0;
+    }
+    MF_ALLOCATOR_ENTRY(allocator, table, entry_i)->root = root;
+    MF_ALLOCATOR_TABLE(allocator, table)->count++;
+    return root;
+}
+
+#pragma mark -
+#pragma mark Bitmaps
+
+// Returns the lowest index not in use below node, MF_ALLOCATOR_NONE if node is full.  Summaries found
+// claiming a child isn't full while it is, left over by an interrupted update, are corrected.
+static uint64_t mfLicensingAllocatorFindFree( mfLicensingIndexAllocator *allocator, uint64_t node_offset, unsigned int height, uint64_t base )
+{
+    mfLicensingAllocatorNode *node = MF_ALLOCATOR_NODE(allocator, node_offset);
+    unsigned int shift = mfLicensingAllocatorShift(height);
+    uint64_t not_full = ~node->full;
+
+    while( not_full != 0 ) {
+        unsigned int slot_i = mfLicensingAllocatorLowestBit(not_full);
+        uint64_t slot = node->slot[slot_i];
+        uint64_t slot_base = base + ((uint64_t)slot_i << shift);
+
+        if( height == 0 ) {
+            if( slot != MF_ALLOCATOR_FULL ) {
+                return slot_base + mfLicensingAllocatorLowestBit(~slot);
+            }
+        } else {
+            uint64_t index;
+            if( slot == 0 ) {
+                return slot_base;
+            }
+            index = mfLicensingAllocatorFindFree(allocator, slot, height - 1, slot_base);
+            if( index != MF_ALLOCATOR_NONE ) {
+                return index;
+            }
+        }
+        node->full |= (uint64_t)1 << slot_i;
+        not_full &= not_full - 1;
+    }
+    return MF_ALLOCATOR_NONE;
+}
+
+// Stores in path the offsets of the nodes leading to index, path[0] being the leaf.  Missing nodes are
+// created when create is set, otherwise returns 0 if a node is missing.  Returns 1 on success, -1 on failure.
+static int mfLicensingAllocatorDescend( mfLicensingIndexAllocator *allocator, uint64_t root, uint64_t index, uint64_t *path, int create )
+{
+    unsigned int height = allocator->height;
+    uint64_t node = root;
+
+    for(;;) {
+        unsigned int child_i;
+        uint64_t child;
+
+        path[height] = node;
+        if( height == 0 ) {
+            return 1;
+        }
+        child_i = (index >> mfLicensingAllocatorShift(height)) & 63;
+        child = MF_ALLOCATOR_NODE(allocator, node)->slot[child_i];
+        if( child == 0 ) {
+            if( create == 0 ) {
+                return 0;
+            }
+            child = mfLicensingAllocatorReserve(allocator, sizeof(mfLicensingAllocatorNode));
+            if( child == 0 ) {
+                return -1;
+            }
+            MF_ALLOCATOR_NODE(allocator, node)->slot[child_i] = child;
+        }
+        node = child;
+        height--;
+    }
+}
+
+// Marks the ancestors of a leaf on path as full for as long as their child is
+static void mfLicensingAllocatorPropagateFull( mfLicensingIndexAllocator *allocator, const uint64_t *path, uint64_t index )
+{
+    unsigned int height = 0;
+
+    while( height < allocator->height && MF_ALLOCATOR_NODE(allocator, path[height])->full == MF_ALLOCATOR_FULL ) {
+        height++;
+        MF_ALLOCATOR_NODE(allocator, path[height])->full |= (uint64_t)1 << ((index >> mfLicensingAllocatorShift(height)) & 63);
+    }
+}
+
+// Clears the bit of index in the leaf on path.  Summaries are cleared before the bit: at worst an index
+// is seen as used while free, never the reverse.
+static void mfLicensingAllocatorClear( mfLicensingIndexAllocator *allocator, const uint64_t *path, uint64_t index )
+{
+    mfLicensingAllocatorNode *leaf = MF_ALLOCATOR_NODE(allocator, path[0]);
+    unsigned int word_i = (index >> 6) & 63;
+    unsigned int height;
+
+    for( height = allocator->height; height > 0; height-- ) {
+        MF_ALLOCATOR_NODE(allocator, path[height])->full &= ~((uint64_t)1 << ((index >> mfLicensingAllocatorShift(height)) & 63));
+    }
+    leaf->full &= ~((uint64_t)1 << word_i);
+    leaf->slot[word_i] &= ~((uint64_t)1 << (index & 63));
+}
+
+// Sets the bits of free indexes of the leaf, starting at index, until count indexes are stored in indexes
+// or the leaf is full.  Returns the number of indexes stored.
+static unsigned int mfLicensingAllocatorTakeFromLeaf( mfLicensingIndexAllocator *allocator, const uint64_t *path, uint64_t index, unsigned int *indexes, unsigned int count )
+{
+    mfLicensingAllocatorNode *leaf = MF_ALLOCATOR_NODE(allocator, path[0]);
+    uint64_t capacity = mfLicensingAllocatorCapacity(allocator);
+    uint64_t leaf_base = index & ~(((uint64_t)1 << MF_ALLOCATOR_LEAF_BITS) - 1);
+    unsigned int word_i = (index >> 6) & 63;
+    unsigned int taken = 0;
+
+    while( word_i < 64 && taken < count ) {
+        uint64_t word = leaf->slot[word_i];
+        while( word != MF_ALLOCATOR_FULL && taken < count ) {
+            unsigned int bit_i = mfLicensingAllocatorLowestBit(~word);
+            uint64_t free_index = leaf_base + ((uint64_t)word_i << 6) + bit_i;
+            if( free_index >= capacity ) {
+                break;
+            }
+            word |= (uint64_t)1 << bit_i;
+            indexes[taken++] = (unsigned int)free_index;
+        }
+        leaf->slot[word_i] = word;
+        if( word != MF_ALLOCATOR_FULL ) {
+            break;
+        }
+        leaf->full |= (uint64_t)1 << word_i;
+        word_i++;
+    }
+    mfLicensingAllocatorPropagateFull(allocator, path, index);
+    return taken;
+}
+
+#pragma mark -
+#pragma mark Recovery
+
+static int mfLicensingAllocatorValidOffset( mfLicensingIndexAllocator *allocator, uint64_t offset, uint64_t size )
+{
+    return offset >= MF_ALLOCATOR_HEADER_SIZE && offset % 8 == 0 && offset <= allocator->map_size && size <= allocator->map_size - offset;
+}
+
+// Checks the nodes below node, raising *end to the end of the furthest one
+static int mfLicensingAllocatorCheckNode( mfLicensingIndexAllocator *allocator, uint64_t node, unsigned int height, uint64_t *end )
+{
+    unsigned int slot_i;
+
+    if( !mfLicensingAllocatorValidOffset(allocator, node, sizeof(mfLicensingAllocatorNode)) ) {
+        return -1;
+    }
+    if( node + sizeof(mfLicensingAllocatorNode) > *end ) {
+        *end = node + sizeof(mfLicensingAllocatorNode);
+    }
+    if( height == 0 ) {
+        return 0;
+    }
+    for( slot_i = 0; slot_i < 64; slot_i++ ) {
+        uint64_t child = MF_ALLOCATOR_NODE(allocator, node)->slot[slot_i];
+        if( child != 0 && mfLicensingAllocatorCheckNode(allocator, child, height - 1, end) != 0 ) {
+            return -1;
+        }
+    }
+    return 0;
+}
+
+// Checks the digest table is within the file and its capacity a power of 2
+static int mfLicensingAllocatorCheckTable( mfLicensingIndexAllocator *allocator )
+{
+    uint64_t table = MF_ALLOCATOR_HEADER(allocator)->table;
+    uint64_t capacity;
+
+    if( !mfLicensingAllocatorValidOffset(allocator, table, sizeof(mfLicensingAllocatorTable)) ) {
+        return -1;
+    }
+    capacity = MF_ALLOCATOR_TABLE(allocator, table)->capacity;
+    if( capacity == 0 || (capacity & (capacity - 1)) != 0 ||
+        capacity > (allocator->map_size - table - sizeof(mfLicensingAllocatorTable)) / sizeof(mfLicensingAllocatorEntry) ) {
+        return -1;
+    }
+    return 0;
+}
+
+// Run when the file wasn't closed cleanly: checks every node is within the file, brings the space used
+// up to the furthest node, in case the header update was lost, and counts the digests again.
+static int mfLicensingAllocatorRecover( mfLicensingIndexAllocator *allocator )
+{
+    mfLicensingAllocatorHeader *header = MF_ALLOCATOR_HEADER(allocator);
+    uint64_t table = header->table;
+    uint64_t end = header->used;
+    uint64_t capacity = MF_ALLOCATOR_TABLE(allocator, table)->capacity;
+    uint64_t count = 0, entry_i;
+
+    if( table + sizeof(mfLicensingAllocatorTable) + capacity * sizeof(mfLicensingAllocatorEntry) > end ) {
+        end = table + sizeof(mfLicensingAllocatorTable) + capacity * sizeof(mfLicensingAllocatorEntry);
+    }
+    for( entry_i = 0; entry_i < capacity; entry_i++ ) {
+        uint64_t root = MF_ALLOCATOR_ENTRY(allocator, table, entry_i)->root;
+        if( root == 0 ) {
+            continue;
+        }
+        if( mfLicensingAllocatorCheckNode(allocator, root, allocator->height, &end) != 0 ) {
+            return -1;
+        }
+        count++;
+    }
+    if( end > allocator->map_size ) {
+        return -1;
+    }
+    header->used = end;
+    MF_ALLOCATOR_TABLE(allocator, table)->count = count;
+    return 0;
+}
+
+#pragma mark -
+#pragma mark Allocator
+
+int mfLicensingOpenIndexAllocator( mfLicensingIndexAllocator *allocator, const char *path, const mfLicensingVector *vector, int flags )
+{
+    static const unsigned char empty_header[MF_ALLOCATOR_HEADER_SIZE] = { 0 };
+    mfLicensingAllocatorHeader *header;
+    struct stat info;
+
+    memset(allocator, 0, sizeof(mfLicensingIndexAllocator));
+    allocator->fd = -1;
+    if( vector->index_bits > 32 ) {
+        return -1;
+    }
+    allocator->index_bits = vector->index_bits;
+    allocator->height = vector->index_bits <= MF_ALLOCATOR_LEAF_BITS ? 0 :
+        (vector->index_bits - MF_ALLOCATOR_LEAF_BITS + MF_ALLOCATOR_NODE_BITS - 1) / MF_ALLOCATOR_NODE_BITS;
+    allocator->flags = flags;
+
+    allocator->fd = open(path, O_RDWR | O_CREAT, 0600);
+    if( allocator->fd < 0 ) {
+        return -1;
+    }
+    if( flock(allocator->fd, LOCK_EX | LOCK_NB) != 0 || fstat(allocator->fd, &info) != 0 ) {
+        goto failed;
+    }
+    if( info.st_size < MF_ALLOCATOR_MIN_FILE_SIZE ) {
+        if( info.st_size != 0 && info.st_size < MF_ALLOCATOR_HEADER_SIZE ) {
+            goto failed;
+        }
+        if( ftruncate(allocator->fd, MF_ALLOCATOR_MIN_FILE_SIZE) != 0 ) {
+            goto failed;
+        }
+        info.st_size = MF_ALLOCATOR_MIN_FILE_SIZE;
+    }
+    if( (uint64_t)info.st_size != (unsigned long)info.st_size ) {
+        goto failed;
+    }
+    allocator->map_size = (unsigned long)info.st_size;
+    allocator->map = mmap(0, allocator->map_size, PROT_READ | PROT_WRITE, MAP_SHARED, allocator->fd, 0);
+    if( allocator->map == MAP_FAILED ) {
+        allocator->map = 0;
+        goto failed;
+    }
+    header = MF_ALLOCATOR_HEADER(allocator);
+
+    // A new file, or one whose creation was interrupted before its header was written
+    if( memcmp(header, empty_header, MF_ALLOCATOR_HEADER_SIZE) == 0 ) {
+        uint64_t table = MF_ALLOCATOR_HEADER_SIZE;
+        memcpy(header->magic, MF_ALLOCATOR_MAGIC, 4);
+        header->version = MF_ALLOCATOR_VERSION;
+        header->byte_order = MF_ALLOCATOR_HOST_BYTE_ORDER;
+        header->index_bits = allocator->index_bits;
+        header->used = table;
+        header->table = mfLicensingAllocatorCreateTable(allocator, MF_ALLOCATOR_INITIAL_TABLE);
+        if( header->table != table ) {
+            goto failed;
+        }
+        header = MF_ALLOCATOR_HEADER(allocator);
+    } else {
+        if( memcmp(header->magic, MF_ALLOCATOR_MAGIC, 4) != 0 || header->version != MF_ALLOCATOR_VERSION ||
+            header->byte_order != MF_ALLOCATOR_HOST_BYTE_ORDER || header->index_bits != allocator->index_bits ||
+            header->used > allocator->map_size || mfLicensingAllocatorCheckTable(allocator) != 0 ) {
+            goto failed;
+        }
+        if( header->clean != 1 && mfLicensingAllocatorRecover(allocator) != 0 ) {
+            goto failed;
+        }
+    }
+
+    // Marked as in use on disk before any change, a crash is then detected when opened again
+    header->clean = 0;
+    if( msync(allocator->map, allocator->map_size, MS_SYNC) != 0 ) {
+        goto failed;
+    }
+    return 0;
+
+failed:
+    if( allocator->map != 0 ) {
+        munmap(allocator->map, allocator->map_size);
+        allocator->map = 0;
+    }
+    close(allocator->fd);
+    allocator->fd = -1;
+    return -1;
+}
+
+void mfLicensingCloseIndexAllocator( mfLicensingIndexAllocator *allocator )
+{
+    if( allocator->map == 0 ) {
+        return;
+    }
+    // The file is only marked clean once everything else is on disk
+    if( msync(allocator->map, allocator->map_size, MS_SYNC) == 0 ) {
+        MF_ALLOCATOR_HEADER(allocator)->clean = 1;
+        msync(allocator->map, MF_ALLOCATOR_HEADER_SIZE, MS_SYNC);
+    }
+    munmap(allocator->map, allocator->map_size);
+    close(allocator->fd);
+    allocator->map = 0;
+    allocator->fd = -1;
+}
+
+int mfLicensingAllocateIndex( mfLicensingIndexAllocator *allocator, const mfLicensingDigest *digest, unsigned int *index )
+{
+    return mfLicensingAllocateIndexes(allocator, digest, index, 1) == 1 ? 0 : -1;
+}
+
+unsigned int mfLicensingAllocateIndexes( mfLicensingIndexAllocator *allocator, const mfLicensingDigest *digest, unsigned int *indexes, unsigned int count )
+{
+    uint64_t path[MF_ALLOCATOR_MAX_HEIGHT + 1];
+    uint64_t root;
+    unsigned int allocated = 0;
+
+    if( count == 0 ) {
+        return 0;
+    }
+    root = mfLicensingAllocatorRoot(allocator, digest, 1);
+    if( root == 0 ) {
+        return 0;
+    }
+
+    // Each round takes the lowest free index and as many of the following free indexes of its leaf as needed
+    while( allocated < count ) {
+        unsigned int taken;
+        uint64_t index = mfLicensingAllocatorFindFree(allocator, root, allocator->height, 0);
+        if( index >= mfLicensingAllocatorCapacity(allocator) ) {
+            break;
+        }
+        if( mfLicensingAllocatorDescend(allocator, root, index, path, 1) != 1 ) {
+            break;
+        }
+        taken = mfLicensingAllocatorTakeFromLeaf(allocator, path, index, indexes + allocated, count - allocated);
+        if( taken == 0 ) {
+            break;
+        }
+        allocated += taken;
+    }
+
+    // Indexes that couldn't be synced are freed again, none of them is returned
+    if( allocated != 0 && mfLicensingAllocatorCommit(allocator) != 0 ) {
+        while( allocated != 0 ) {
+            allocated--;
+            if( mfLicensingAllocatorDescend(allocator, root, indexes[allocated], path, 0) == 1 ) {
+                mfLicensingAllocatorClear(allocator, path, indexes[allocated]);
+            }
+        }
+        return 0;
+    }
+    return allocated;
+}
+
+int mfLicensingMarkIndex( mfLicensingIndexAllocator *allocator, const mfLicensingDigest *digest, unsigned int index )
+{
+    uint64_t path[MF_ALLOCATOR_MAX_HEIGHT + 1];
+    mfLicensingAllocatorNode *leaf;
+    unsigned int word_i = (index >> 6) & 63;
+    uint64_t bit = (uint64_t)1 << (index & 63);
+    uint64_t root;
+
+    if( index >= mfLicensingAllocatorCapacity(allocator) ) {
+        return -1;
+    }
+    root = mfLicensingAllocatorRoot(allocator, digest, 1);
+    if( root == 0 || mfLicensingAllocatorDescend(allocator, root, index, path, 1) != 1 ) {
+        return -1;
+    }
+    leaf = MF_ALLOCATOR_NODE(allocator, path[0]);
+    if( leaf->slot[word_i] & bit ) {
+        return 0;
+    }
+    leaf->slot[word_i] |= bit;
+    if( leaf->slot[word_i] == MF_ALLOCATOR_FULL ) {
+        leaf->full |= (uint64_t)1 << word_i;
+        mfLicensingAllocatorPropagateFull(allocator, path, index);
+    }
+    return mfLicensingAllocatorCommit(allocator) == 0 ? 1 : -1;
+}
+
+int mfLicensingFreeIndex( mfLicensingIndexAllocator *allocator, const mfLicensingDigest *digest, unsigned int index )
+{
+    uint64_t path[MF_ALLOCATOR_MAX_HEIGHT + 1];
+    mfLicensingAllocatorNode *leaf;
+    uint64_t root;
+
+    if( index >= mfLicensingAllocatorCapacity(allocator) ) {
+        return -1;
+    }
+    root = mfLicensingAllocatorRoot(allocator, digest, 0);
+    if( root == 0 || mfLicensingAllocatorDescend(allocator, root, index, path, 0) != 1 ) {
+        return 0;
+    }
+    leaf = MF_ALLOCATOR_NODE(allocator, path[0]);
+    if( (leaf->slot[(index >> 6) & 63] & ((uint64_t)1 << (index & 63))) == 0 ) {
+        return 0;
+    }
+    mfLicensingAllocatorClear(allocator, path, index);
+    return mfLicensingAllocatorCommit(allocator) == 0 ? 1 : -1;
+}
+
+int mfLicensingIsIndexAllocated( mfLicensingIndexAllocator *allocator, const mfLicensingDigest *digest, unsigned int index )
+{
+    uint64_t path[MF_ALLOCATOR_MAX_HEIGHT + 1];
+    uint64_t root;
+
+    if( index >= mfLicensingAllocatorCapacity(allocator) ) {
+        return 0;
+    }
+    root = mfLicensingAllocatorRoot(allocator, digest, 0);
+    if( root == 0 || mfLicensingAllocatorDescend(allocator, root, index, path, 0) != 1 ) {
+        return 0;
+    }
+    return (MF_ALLOCATOR_NODE(allocator, path[0])->slot[(index >> 6) & 63] >> (index & 63)) & 1;
+}
+
+int mfLicensingSyncIndexAllocator( mfLicensingIndexAllocator *allocator )
+{
+    return msync(allocator->map, allocator->map_size, MS_SYNC) == 0 ? 0 : -1;
+}
@@ -0,0 +1,117 @@
+//
+//  mflicensingallocator.h
+//  MFLicensing
+//  https://github.com/freshcode/MFLicensing
+//
+//
+//  Persistent allocator of key indexes.
+//
+//  Every key generated for a digest must use an index of its own, between 0 and 2^index_bits - 1.
+//  The allocator keeps track of the indexes used by each digest in a memory-mapped file and hands
+//  out the lowest free index of a digest in a handful of memory accesses, whatever the number of
+//  indexes already used, rather than querying a database for the largest index issued.
+//
+//  Each digest has a hierarchical bitmap: leaves hold one bit per index, 4096 indexes per leaf, and
+//  each inner node one bit per child, set once the child is full, along with the location of its 64
+//  children.  Finding a free index follows the first child not full at each level, 5 levels at
+//  most for 32 index bits.  Nodes are only created for the ranges of indexes in use.  Digests are
+//  found in an open addressing table stored in the same file.
+//
+//  Crash safety: the file is updated in an order that keeps it consistent at any point, the
+//  indexes allocated by a process that crashes are never allocated again.  Indexes only survive a
+//  power failure or an operating system crash once synced, either with
+//  mfLicensingSyncIndexAllocator or, for every allocation, by opening the allocator with
+//  MF_LICENSING_ALLOCATOR_SYNC; allocate indexes by batches with mfLicensingAllocateIndexes to
+//  spread the cost of syncing.  A file not closed cleanly is checked when opened again.
+//
+//  An allocator must not be used by several threads at once; the file is locked, only one
+//  allocator may have it open at a time.
+//
+//  Licensing
+//  ---------
+//  Public Domain
+//  By Freshcode, Cutting edge Mac, iPhone & iPad software development. http://madefresh.ca/
+//
+
+#ifndef MFLicensing_mflicensingallocator_h
+#define MFLicensing_mflicensingallocator_h
+
+#include "mflicensing.h"
+
+// Flags of mfLicensingOpenIndexAllocator
+#define MF_LICENSING_ALLOCATOR_SYNC 1       // sync the file to disk before returning indexes allocated
+
+// Index Allocator structure
+//--------------------------
+// fd: descriptor of the file, locked for as long as the allocator is open
+// map, map_size: mapping of the whole file
+// index_bits: index bits of the vector, indexes allocated are below 2^index_bits
+// height: number of inner node levels above the leaves
+// flags: flags the allocator was opened with
+typedef struct {
+    int fd;
+    unsigned char *map;
+    unsigned long map_size;
+    unsigned char index_bits;
+    unsigned char height;
+    int flags;
+} mfLicensingIndexAllocator;
+
+// mfLicensingOpenIndexAllocator
+//------------------------------
+// Opens the allocator file at path, creating it if it doesn't exist, for the indexes of vector.
+//
+// Returns 0 on success, -1 if the file can't be created, mapped or locked (another allocator has it
+// open), isn't an allocator file, was created for a different number of index bits or is corrupted.
+int mfLicensingOpenIndexAllocator( mfLicensingIndexAllocator *allocator, const char *path, const mfLicensingVector *vector, int flags );
+
+// mfLicensingCloseIndexAllocator
+//-------------------------------
+// Syncs the file, marks it as closed cleanly and releases it.
+void mfLicensingCloseIndexAllocator( mfLicensingIndexAllocator *allocator );
+
+// mfLicensingAllocateIndex
+//-------------------------
+// Allocates the lowest free index of digest and stores it in index.
+//
+// Returns 0 on success, -1 if every index of digest is in use or the file couldn't be extended or synced.
+int mfLicensingAllocateIndex( mfLicensingIndexAllocator *allocator, const mfLicensingDigest *digest, unsigned int *index );
+
+// mfLicensingAllocateIndexes
+//---------------------------
+// Allocates the count lowest free indexes of digest and stores them in indexes, in increasing order.
+// The file is synced once for all of them with MF_LICENSING_ALLOCATOR_SYNC.
+//
+// Returns the number of indexes allocated, less than count if the indexes of digest ran out or the
+// file couldn't be extended.  Returns 0 if the file couldn't be synced, the indexes being left free.
+unsigned int mfLicensingAllocateIndexes( mfLicensingIndexAllocator *allocator, const mfLicensingDigest *digest, unsigned int *indexes, unsigned int count );
+
+// mfLicensingMarkIndex
+//---------------------
+// Marks index as used by digest, to import the indexes of the keys issued before the allocator.
+//
+// Returns 1 if the index was free, 0 if it was already in use, -1 if index is out of range or the file
+// couldn't be extended or synced.
+int mfLicensingMarkIndex( mfLicensingIndexAllocator *allocator, const mfLicensingDigest *digest, unsigned int index );
+
+// mfLicensingFreeIndex
+//---------------------
+// Frees index so it may be allocated again, when the key using it was revoked for instance.
+//
+// Returns 1 if the index was in use, 0 if it was already free, -1 if index is out of range or the file
+// couldn't be synced.
+int mfLicensingFreeIndex( mfLicensingIndexAllocator *allocator, const mfLicensingDigest *digest, unsigned int index );
+
+// mfLicensingIsIndexAllocated
+//----------------------------
+// Returns 1 if index is in use by digest, 0 otherwise.
+int mfLicensingIsIndexAllocated( mfLicensingIndexAllocator *allocator, const mfLicensingDigest *digest, unsigned int index );
+
+// mfLicensingSyncIndexAllocator
+//------------------------------
+// Writes the changes made to the file to disk.
+//
+// Returns 0 on success, -1 on error.
+int mfLicensingSyncIndexAllocator( mfLicensingIndexAllocator *allocator );
+
+#endif
@@ -0,0 +1,182 @@
+//
+//  mflicensingasync.cpp
+//  MFLicensing
+//  https://github.com/freshcode/MFLicensing
+//
+//  Public Domain
+//  By Freshcode, Cutting edge Mac, iPhone & iPad software development. http://madefresh.ca/
+//
+
+#include "mflicensingasync.hpp"
+
+extern "C" {
+#include "mflicensingbatch.h"
+}
+
+#include <cstring>
+
+namespace mf {
+
+#define MF_ASYNC_MAX_BATCH 64
+
+ValidateAwaitable::ValidateAwaitable(Pool &pool, mfLicensingContext &context, const mfLicensingDigest &digest, std::string_view key)
+    : pool_(pool)
+{
+    request_.kind = Request::Validate;
+    request_.context = &context;
+    request_.digest = digest;
+    request_.index = 0;
+    request_.next = nullptr;
+    request_.result = 0;
+    if( key.size() <= max_key_length + 1 && key.find('\0') == std::string_view::npos ) {
+        std::memcpy(request_.key, key.data(), key.size());
+        request_.key[key.size()] = 0;
+        request_.result = -1;   // pending
+    }
+}
+
+GenerateAwaitable::GenerateAwaitable(Pool &pool, mfLicensingContext &context, const mfLicensingDigest &digest, unsigned int index)
+    : pool_(pool)
+{
+    request_.kind = Request::Generate;
+    request_.context = &context;
+    request_.digest = digest;
+    request_.index = index;
+    request_.key[0] = 0;
+    request_.result = 0;
+    request_.next = nullptr;
+}
+
+Pool::Pool() : Pool(Options())
+{
+}
+
+Pool::Pool(Options options) : options_(std::move(options))
+{
+    unsigned int threads = options_.threads;
+    if( threads == 0 ) threads = std::thread::hardware_concurrency();
+    if( threads == 0 ) threads = 1;
+    if( options_.max_batch == 0 ) options_.max_batch = 1;
+    if( options_.max_batch > MF_ASYNC_MAX_BATCH ) options_.max_batch = MF_ASYNC_MAX_BATCH;
+    if( options_.max_queued == 0 ) options_.max_queued = 1;
+
+    workers_.reserve(threads);
+    for( unsigned int thread_i = 0; thread_i < threads; thread_i++ ) {
+        workers_.emplace_back([this] { run(); });
+    }
+}
+
+Pool::~Pool()
+{
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        stopping_ = true;
+    }
+    wake_.notify_all();
+    for( std::thread &worker : workers_ ) {
+        worker.join();
+    }
+}
+
+Pool &Pool::shared()
+{
+    static Pool pool;
+    return pool;
+}
+
+bool Pool::submit(Request *request)
+{
+    request->next = nullptr;
+    {
+        std::lock_guard<std::mutex> guard(lock_);
+        if( queued_ < options_.max_queued ) {
+            if( tail_ ) tail_->next = request;
+            else head_ = request;
+            tail_ = request;
+            queued_++;
+            request = nullptr;
+        }
+    }
+    if( request != nullptr ) {
+        // The queue is full, the submitter waits for its own request
+        perform(&request, 1);
+        return false;
+    }
+    wake_.notify_one();
+    return true;
+}
+
+void Pool::run()
+{
+    Request *batch[MF_ASYNC_MAX_BATCH];
+
+    for(;;) {
+        unsigned int count = 0;
+        {
+            std::unique_lock<std::mutex> guard(lock_);
+            wake_.wait(guard, [this] { return head_ != nullptr || stopping_; });
+            if( head_ == nullptr ) {
+                // stopping and nothing left to do
+                return;
+            }
+            while( head_ != nullptr && count < options_.max_batch ) {
+                batch[count++] = head_;
+                head_ = head_->next;
+            }
+            if( head_ == nullptr ) tail_ = nullptr;
+            queued_ -= count;
+        }
+        // More requests are waiting, let another worker take them
+        if( count == options_.max_batch ) wake_.notify_one();
+
+        perform(batch, count);
+
+        // The requests live in the frames of the coroutines, they must not be touched once resumed
+        for( unsigned int request_i = 0; request_i < count; request_i++ ) {
+            std::coroutine_handle<> continuation = batch[request_i]->continuation;
+            if( options_.resume ) options_.resume(continuation);
+            else continuation.resume();
+        }
+    }
+}
+
+void Pool::perform(Request **batch, unsigned int count)
+{
+    mfLicensingDigest digests[MF_ASYNC_MAX_BATCH];
+    const unsigned char *licenses[MF_ASYNC_MAX_BATCH];
+    unsigned char valid[MF_ASYNC_MAX_BATCH];
+    Request *grouped[MF_ASYNC_MAX_BATCH];
+    bool done[MF_ASYNC_MAX_BATCH] = {};
+
+    for( unsigned int request_i = 0; request_i < count; request_i++ ) {
+        Request *request = batch[request_i];
+        if( done[request_i] ) continue;
+
+        if( request->kind == Request::Generate ) {
+            // Generated in place, into the request
+            request->result = mfLicensingGenerateLicenseToBuffer(request->context, &request->digest, request->index, request->key, sizeof(request->key)) == 0 ? 1 : 0;
+            continue;
+        }
+
+        // Validations of the same context are performed together
+        unsigned int grouped_count = 0;
+        for( unsigned int other_i = request_i; other_i < count; other_i++ ) {
+            Request *other = batch[other_i];
+            if( done[other_i] || other->kind != Request::Validate || other->context != request->context ) continue;
+            digests[grouped_count] = other->digest;
+            licenses[grouped_count] = other->key;
+            grouped[grouped_count++] = other;
+            done[other_i] = true;
+        }
+        if( grouped_count == 1 ) {
+            request->result = mfLicensingValidateLicenseWithContext(request->context, &request->digest, request->key);
+        } else {
+            mfLicensingValidateLicenses(request->context, digests, licenses, grouped_count, valid);
+            for( unsigned int grouped_i = 0; grouped_i < grouped_count; grouped_i++ ) {
+                grouped[grouped_i]->result = valid[grouped_i];
+            }
+        }
+    }
+}
+
+} // namespace mf
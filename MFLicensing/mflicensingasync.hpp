@@ -0,0 +1,180 @@
+//
+//  mflicensingasync.hpp
+//  MFLicensing
+//  https://github.com/freshcode/MFLicensing
+//
+//
+//  C++20 coroutine interface to key validation and generation.
+//
+//  Validating a key costs a few microseconds of bignum arithmetic, generating one with the functions
+//  taking a vector several more; coroutine based services calling the C functions inline stall their
+//  event loop for that long per key.  The awaitables below hand the work to a pool of worker
+//  threads instead:
+//
+//      bool valid = co_await mf::validate(context, digest, key);
+//      std::optional<std::string> key = co_await mf::generate(context, digest, index);
+//
+//  The calling coroutine is suspended, a worker performs the operation and resumes it.  Each worker
+//  takes every request queued, up to the batch size of the pool, and validates the keys of a same
+//  context together with mfLicensingValidateLicenses (see mflicensingbatch.h), so throughput grows
+//  with the number of concurrent requests while a lone request is still served immediately.
+//
+//  Requests are stored in the awaitable, within the frame of the suspended coroutine, and keys are
+//  generated in place: nothing is allocated per request until generate's co_await returns the key
+//  as a std::string.  The context, and the key passed to validate, must remain valid until the
+//  co_await completes, which is the case for any argument of the co_await expression.
+//
+//  At most max_queued requests wait for a worker.  Past that, the coroutine submitting a request
+//  isn't suspended: its thread performs the request itself, which slows the submitters down to the
+//  pace of the workers without failing requests, and can't deadlock when workers resume coroutines
+//  that submit more requests.
+//
+//  By default the coroutine is resumed on the worker thread that completed the request; services
+//  that need to continue on their own thread provide a resume function when creating their pool.
+//
+//  Build
+//  -----
+//  Compile mflicensingasync.cpp with -std=c++20 (-fcoroutines for gcc 10) along with the C files
+//  of the library.
+//
+//  Licensing
+//  ---------
+//  Public Domain
+//  By Freshcode, Cutting edge Mac, iPhone & iPad software development. http://madefresh.ca/
+//
+
+#ifndef MFLicensing_mflicensingasync_hpp
+#define MFLicensing_mflicensingasync_hpp
+
+extern "C" {
+#include "mflicensing.h"
+}
+
+#include <condition_variable>
+#include <coroutine>
+#include <functional>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+namespace mf {
+
+// Longest key_length of a vector; keys validated and generated may have a check character more
+constexpr std::size_t max_key_length = 255;
+
+// A validation or generation request, stored in the awaitable of the suspended coroutine
+struct Request {
+    enum Kind { Validate, Generate };
+
+    Kind kind;
+    mfLicensingContext *context;
+    mfLicensingDigest digest;
+    unsigned int index;
+    unsigned char key[max_key_length + 2];  // key to validate or key generated, check character and terminator included
+    int result;                             // 1 if valid or generated, 0 otherwise
+    std::coroutine_handle<> continuation;
+    Request *next;
+};
+
+// Pool
+//-----
+// Fixed set of worker threads performing the requests of the awaitables.  Destroying the pool
+// completes the requests already queued, then stops the workers.
+class Pool {
+public:
+    struct Options {
+        unsigned int threads = 0;           // 0: one per hardware thread
+        unsigned int max_batch = 16;        // requests taken by a worker at once, at most 64
+        std::size_t max_queued = 4096;      // requests waiting for a worker, at least 1
+        std::function<void(std::coroutine_handle<>)> resume;   // resumes inline on the worker when empty
+    };
+
+    Pool();
+    explicit Pool(Options options);
+    ~Pool();
+    Pool(const Pool &) = delete;
+    Pool &operator=(const Pool &) = delete;
+
+    // Pool used when none is specified, created on first use with the default options
+    static Pool &shared();
+
+    // Queues request and returns true, its continuation is resumed once the request is completed.
+    // Returns false if max_queued requests are already waiting: the request is then performed by
+    // the calling thread before returning and its continuation isn't used.
+    bool submit(Request *request);
+
+    unsigned int threads() const { return static_cast<unsigned int>(workers_.size()); }
+
+private:
+    void run();
+    void perform(Request **batch, unsigned int count);
+
+    Options options_;
+    std::mutex lock_;
+    std::condition_variable wake_;
+    Request *head_ = nullptr;
+    Request *tail_ = nullptr;
+    std::size_t queued_ = 0;
+    bool stopping_ = false;
+    std::vector<std::thread> workers_;
+};
+
+// Awaitable returned by validate, the co_await yields true if the key is valid
+class ValidateAwaitable {
+public:
+    ValidateAwaitable(Pool &pool, mfLicensingContext &context, const mfLicensingDigest &digest, std::string_view key);
+
+    // Keys too long or containing a null character are invalid without suspending
+    bool await_ready() const noexcept { return request_.result == 0; }
+    bool await_suspend(std::coroutine_handle<> continuation)
+    {
+        request_.continuation = continuation;
+        return pool_.submit(&request_);
+    }
+    bool await_resume() const noexcept { return request_.result != 0; }
+
+private:
+    Pool &pool_;
+    Request request_;
+};
+
+// Awaitable returned by generate, the co_await yields the key or std::nullopt on failure
+class GenerateAwaitable {
+public:
+    GenerateAwaitable(Pool &pool, mfLicensingContext &context, const mfLicensingDigest &digest, unsigned int index);
+
+    bool await_ready() const noexcept { return false; }
+    bool await_suspend(std::coroutine_handle<> continuation)
+    {
+        request_.continuation = continuation;
+        return pool_.submit(&request_);
+    }
+    std::optional<std::string> await_resume() const
+    {
+        if( request_.result == 0 ) return std::nullopt;
+        return std::string(reinterpret_cast<const char *>(request_.key));
+    }
+
+private:
+    Pool &pool_;
+    Request request_;
+};
+
+// Same as mfLicensingValidateLicenseWithContext, performed by a worker of pool
+inline ValidateAwaitable validate(mfLicensingContext &context, const mfLicensingDigest &digest, std::string_view key, Pool &pool = Pool::shared())
+{
+    return ValidateAwaitable(pool, context, digest, key);
+}
+
+// Same as mfLicensingGenerateLicenseWithContext, performed by a worker of pool
+inline GenerateAwaitable generate(mfLicensingContext &context, const mfLicensingDigest &digest, unsigned int index, Pool &pool = Pool::shared())
+{
+    return GenerateAwaitable(pool, context, digest, index);
+}
+
+} // namespace mf
+
+#endif
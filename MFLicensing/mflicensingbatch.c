@@ -0,0 +1,363 @@
+//
+//  mflicensingbatch.c
+//  MFLicensing
+//  https://github.com/freshcode/MFLicensing
+//
+//  Public Domain
+//  By Freshcode, Cutting edge Mac, iPhone & iPad software development. http://madefresh.ca/
+//
+
+#include "mflicensingbatch.h"
+#include "mflicensinginternal.h"
+#include <stdint.h>
+#include <string.h>
+
+#if !defined(MFLICENSING_NO_SIMD) && (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define MF_BATCH_X86 1
+#include <immintrin.h>
+#endif
+
+#if defined(__GNUC__) || defined(__clang__)
+#define MF_BATCH_ALIGNED __attribute__((aligned(64)))
+#else
+#define MF_BATCH_ALIGNED
+#endif
+
+#define MF_BATCH_LANES 16
+#define MF_BATCH_MAX_CHUNKS 16
+
+// Parameters shared by all the keys validated against a context
+//--------------------------------------------------------------
+// chunk_count: number of chunks of characters decoded at once, chunk_multiplier: base^characters per chunk
+// bit_position: position in the binary key of the index bits followed by the validator bits
+// high_mask: bits of the binary key past bits_in_key, which must be 0
+// salt: 256-bit salt, shifted_key: private key shifted left by 0 to 7 bits; 32-bit limbs
+// scheme: key scheme of the vector, round_key: keys of the 10 Philox rounds for MF_LICENSING_SCHEME_PHILOX
+typedef struct {
+    unsigned int scheme;
+    unsigned int chunk_count;
+    unsigned int chunk_characters;
+    uint64_t chunk_multiplier;
+    unsigned int index_bits;
+    unsigned int validator_bits;
+    unsigned short int bit_position[256];
+    uint64_t high_mask[8];
+    uint64_t salt[8];
+    uint64_t shifted_key[8][9];
+    uint64_t round_key[10][2];
+} mfLicensingBatchParams;
+
+// Block of keys validated together, structure-of-arrays: limb j of key i is at [j][i]
+//------------------------------------------------------------------------------------
+// chunks: character weights folded chunk_characters at a time, most significant chunk first
+// digest: 128-bit digest of each key
+// mismatch: set by the kernel, 0 for the keys found to be valid
+typedef struct {
+    uint64_t chunks[MF_BATCH_MAX_CHUNKS][MF_BATCH_LANES];
+    uint64_t digest[4][MF_BATCH_LANES];
+    uint64_t mismatch[MF_BATCH_LANES];
+} MF_BATCH_ALIGNED mfLicensingBatchBlock;
+
+#pragma mark - Kernels
+
+// Portable kernel, one key at a time; operands are always smaller than 2^32
+#define MF_BATCH_KERNEL mfLicensingBatchKernelPortable
+#define MF_BATCH_TARGET
+#define MF_LANE uint64_t
+#define MF_LANE_WIDTH 1
+#define MF_LANE_MUL(a, b) ((a) * (b))
+#include "mflicensingbatchkernel.h"
+#undef MF_BATCH_KERNEL
+#undef MF_BATCH_TARGET
+#undef MF_LANE
+#undef MF_LANE_WIDTH
+#undef MF_LANE_MUL
+
+#ifdef MF_BATCH_X86
+typedef uint64_t mfLane4 __attribute__((vector_size(32)));
+typedef uint64_t mfLane8 __attribute__((vector_size(64)));
+
+#define MF_BATCH_KERNEL mfLicensingBatchKernelAVX2
+#define MF_BATCH_TARGET __attribute__((target("avx2")))
+#define MF_LANE mfLane4
+#define MF_LANE_WIDTH 4
+#define MF_LANE_MUL(a, b) ((mfLane4)_mm256_mul_epu32((__m256i)(a), (__m256i)(b)))
+#include "mflicensingbatchkernel.h"
+#undef MF_BATCH_KERNEL
+#undef MF_BATCH_TARGET
+#undef MF_LANE
+#undef MF_LANE_WIDTH
+#undef MF_LANE_MUL
+
+#define MF_BATCH_KERNEL mfLicensingBatchKernelAVX512
+#define MF_BATCH_TARGET __attribute__((target("avx512f")))
+#define MF_LANE mfLane8
+#define MF_LANE_WIDTH 8
+#define MF_LANE_MUL(a, b) ((mfLane8)_mm512_mul_epu32((__m512i)(a), (__m512i)(b)))
+#include "mflicensingbatchkernel.h"
+#undef MF_BATCH_KERNEL
+#undef MF_BATCH_TARGET
+#undef MF_LANE
+#undef MF_LANE_WIDTH
+#undef MF_LANE_MUL
+#endif
+
+typedef void (*mfLicensingBatchKernelFunction)( const mfLicensingBatchParams *params, mfLicensingBatchBlock *block );
+
+// Kernels compiled in, the selected one is only accessed atomically: a validation uses the kernel
+// selected when it starts
+typedef struct {
+    mfLicensingBatchKernelFunction function;
+    const char *name;
+} mfLicensingBatchKernelEntry;
+
+static const mfLicensingBatchKernelEntry mfLicensingBatchKernelPortableEntry = { mfLicensingBatchKernelPortable, "portable" };
+#ifdef MF_BATCH_X86
+static const mfLicensingBatchKernelEntry mfLicensingBatchKernelAVX2Entry = { mfLicensingBatchKernelAVX2, "avx2" };
+static const mfLicensingBatchKernelEntry mfLicensingBatchKernelAVX512Entry = { mfLicensingBatchKernelAVX512, "avx512" };
+#endif
+
+static const mfLicensingBatchKernelEntry *mfLicensingBatchKernel = 0;
+
+static const mfLicensingBatchKernelEntry *mfLicensingSelectBatchKernel( void )
+{
+    const mfLicensingBatchKernelEntry *kernel = __atomic_load_n(&mfLicensingBatchKernel, __ATOMIC_ACQUIRE);
+    if( kernel == 0 ) {
+        const mfLicensingBatchKernelEntry *selected = &mfLicensingBatchKernelPortableEntry;
+#ifdef MF_BATCH_X86
+        __builtin_cpu_init();
+        if( __builtin_cpu_supports("avx512f") ) {
+            selected = &mfLicensingBatchKernelAVX512Entry;
+        } else if( __builtin_cpu_supports("avx2") ) {
+            selected = &mfLicensingBatchKernelAVX2Entry;
+        }
+#endif
+        // Keeps a kernel set by mfLicensingSetBatchKernel in the meantime, loaded into kernel
+        if( __atomic_compare_exchange_n(&mfLicensingBatchKernel, &kernel, selected, 0, __ATOMIC_ACQ_REL, __ATOMIC_ACQUIRE) ) {
+            kernel = selected;
+        }
+    }
+    return kernel;
+}
+
+const char *mfLicensingBatchKernelName( void )
+{
+    return mfLicensingSelectBatchKernel()->name;
+}
+
+int mfLicensingSetBatchKernel( const char *name )
+{
+    const mfLicensingBatchKernelEntry *kernel = 0;
+    if( strcmp(name, "portable") == 0 ) {
+        kernel = &mfLicensingBatchKernelPortableEntry;
+    }
+#ifdef MF_BATCH_X86
+    __builtin_cpu_init();
+    if( strcmp(name, "avx2") == 0 && __builtin_cpu_supports("avx2") ) {
+        kernel = &mfLicensingBatchKernelAVX2Entry;
+    }
+    if( strcmp(name, "avx512") == 0 && __builtin_cpu_supports("avx512f") ) {
+        kernel = &mfLicensingBatchKernelAVX512Entry;
+    }
+#endif
+    if( kernel == 0 ) return -1;
+    __atomic_store_n(&mfLicensingBatchKernel, kernel, __ATOMIC_RELEASE);
+    return 0;
+}
+
+#pragma mark - Batch validation
+
+static void mfLicensingLoadLimbs( uint64_t *limbs, const unsigned char *bytes, unsigned int limb_count )
+{
+    unsigned int limb_i = 0;
+    while( limb_i < limb_count ) {
+        limbs[limb_i] = (uint64_t)bytes[limb_i*4] |
+                        ((uint64_t)bytes[limb_i*4+1] << 8) |
+                        ((uint64_t)bytes[limb_i*4+2] << 16) |
+                        ((uint64_t)bytes[limb_i*4+3] << 24);
+        limb_i++;
+    }
+}
+
+// Returns 0 if the context cannot be validated by the kernels, in which case the keys are validated one by one
+static int mfLicensingInitializeBatchParams( mfLicensingBatchParams *params, mfLicensingContext *context )
+{
+    mfLicensingVector *vector = context->vector;
+    mfLicensingCodecParams *codec_params = &context->codec_params;
+
+    params->scheme = vector->scheme == MF_LICENSING_SCHEME_PHILOX ? MF_LICENSING_SCHEME_PHILOX : MF_LICENSING_SCHEME_LRAND48;
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+    // the index block of MF_LICENSING_SCHEME_LRAND48 is computed in host byte order by randomize128UsingIntSeed
+    if( params->scheme != MF_LICENSING_SCHEME_PHILOX ) {
+        return 0;
+    }
+#endif
+    if( params->scheme == MF_LICENSING_SCHEME_PHILOX ) {
+        unsigned int round_key[2];
+        unsigned int round_i = 0;
+        mfLicensingCounterKey(vector, round_key);
+        while( round_i < 10 ) {
+            params->round_key[round_i][0] = round_key[0];
+            params->round_key[round_i][1] = round_key[1];
+            round_key[0] += 0x9E3779B9;
+            round_key[1] += 0xBB67AE85;
+            round_i++;
+        }
+    }
+
+    // The reduction by the private key expects a key of at least 2^248, as enforced by mfLicensingSetPrivateKey
+    const mfU256 *private_key = &vector->private_key->data;
+    if( private_key->b[31] == 0 ) {
+        return 0;
+    }
+
+    // Decode as many characters at once as possible while base^characters fits in a 32-bit limb
+    params->chunk_characters = 0;
+    params->chunk_multiplier = 1;
+    while( params->chunk_multiplier * codec_params->encoding_base <= 0xFFFFFFFF ) {
+        params->chunk_multiplier *= codec_params->encoding_base;
+        params->chunk_characters++;
+    }
+    params->chunk_count = (vector->key_length + params->chunk_characters - 1) / params->chunk_characters;
+    if( params->chunk_count > MF_BATCH_MAX_CHUNKS ) {
+        return 0;
+    }
+
+    // Bits are numbered from the most significant bit of the binary key, see mfLicensingExtractIndex
+    params->index_bits = vector->index_bits;
+    params->validator_bits = codec_params->bits_in_key - vector->index_bits;
+    unsigned int bit_i = codec_params->bits_in_key;
+    while( bit_i-- ) {
+        params->bit_position[bit_i] = codec_params->bits_in_key - 1 - codec_params->bits_ordering[bit_i];
+    }
+    unsigned int limb_i = 8;
+    while( limb_i-- ) {
+        unsigned int first_bit = limb_i * 32;
+        if( first_bit >= codec_params->bits_in_key ) {
+            params->high_mask[limb_i] = 0xFFFFFFFF;
+        } else if( codec_params->bits_in_key - first_bit >= 32 ) {
+            params->high_mask[limb_i] = 0;
+        } else {
+            params->high_mask[limb_i] = (0xFFFFFFFF << (codec_params->bits_in_key - first_bit)) & 0xFFFFFFFF;
+        }
+    }
+
+    mfLicensingLoadLimbs(params->salt, context->salt.b, 8);
+
+    uint64_t key[9];
+    mfLicensingLoadLimbs(key, private_key->b, 8);
+    key[8] = 0;
+    unsigned int shift = 8;
+    while( shift-- ) {
+        limb_i = 9;
+        while( limb_i-- ) {
+            uint64_t shifted = key[limb_i] << shift;
+            if( limb_i > 0 ) shifted |= key[limb_i-1] >> (32 - shift);
+            params->shifted_key[shift][limb_i] = shifted & 0xFFFFFFFF;
+        }
+    }
+    return 1;
+}
+
+// Fills lane of the block with the license key, returns 0 if the key has an invalid length, characters or check character
+static int mfLicensingLoadBatchLane( mfLicensingBatchBlock *block, unsigned int lane, const mfLicensingBatchParams *params, mfLicensingContext *context, const mfLicensingDigest *digest, const unsigned char *license )
+{
+    unsigned int key_length = context->vector->key_length;
+    unsigned int check_character = context->vector->check_character;
+    unsigned int coded_key_i = 0;
+    while( license[coded_key_i] != 0 ) {
+        if( coded_key_i >= key_length + check_character ) {
+            return 0;
+        }
+        coded_key_i++;
+    }
+    if( coded_key_i != key_length + check_character ) {
+        return 0;
+    }
+    coded_key_i = key_length;
+
+    // The last character of the key is the most significant
+    unsigned int encoding_base = context->codec_params.encoding_base;
+    unsigned int check_sum = 0;
+    unsigned int chunk_i = 0;
+    unsigned int chunk_length = key_length - (params->chunk_count - 1) * params->chunk_characters;
+    while( chunk_i < params->chunk_count ) {
+        uint64_t chunk = 0;
+        while( chunk_length-- ) {
+            unsigned char weight = context->character_weights[ license[--coded_key_i] ];
+            if( weight == 0xFF ) {
+                return 0;
+            }
+            chunk = chunk * encoding_base + weight;
+            check_sum += ((key_length - 1 - coded_key_i) & 0x01) ? weight : mfLicensingCheckDouble(weight, encoding_base);
+        }
+        block->chunks[chunk_i++][lane] = chunk;
+        chunk_length = params->chunk_characters;
+    }
+    if( check_character && context->character_weights[ license[key_length] ] != (encoding_base - check_sum % encoding_base) % encoding_base ) {
+        return 0;
+    }
+
+    uint64_t digest_limbs[4];
+    mfLicensingLoadLimbs(digest_limbs, digest->md5hash.b, 4);
+    unsigned int limb_i = 4;
+    while( limb_i-- ) {
+        block->digest[limb_i][lane] = digest_limbs[limb_i];
+    }
+    return 1;
+}
+
+static void mfLicensingClearBatchLane( mfLicensingBatchBlock *block, unsigned int lane )
+{
+    unsigned int i = MF_BATCH_MAX_CHUNKS;
+    while( i-- ) block->chunks[i][lane] = 0;
+    i = 4;
+    while( i-- ) block->digest[i][lane] = 0;
+}
+
+unsigned int mfLicensingValidateLicenses( mfLicensingContext *context, const mfLicensingDigest *digests, const unsigned char **licenses, unsigned int count, unsigned char *valid )
+{
+    unsigned int valid_count = 0;
+    unsigned int license_i;
+    mfLicensingBatchParams params;
+
+    if( context->vector == 0 || mfLicensingInitializeBatchParams(&params, context) == 0 ) {
+        // Validate the keys one by one
+        for( license_i = 0; license_i < count; license_i++ ) {
+            int result = mfLicensingValidateLicenseWithContext(context, (mfLicensingDigest *)&digests[license_i], licenses[license_i]);
+            if( valid != 0 ) {
+                valid[license_i] = (unsigned char)result;
+            }
+            valid_count += result;
+        }
+        return valid_count;
+    }
+
+    mfLicensingBatchKernelFunction kernel = mfLicensingSelectBatchKernel()->function;
+    mfLicensingBatchBlock block;
+    unsigned char loaded[MF_BATCH_LANES];
+
+    for( license_i = 0; license_i < count; license_i += MF_BATCH_LANES ) {
+        unsigned int lane;
+        for( lane = 0; lane < MF_BATCH_LANES; lane++ ) {
+            loaded[lane] = 0;
+            if( license_i + lane < count ) {
+                loaded[lane] = (unsigned char)mfLicensingLoadBatchLane(&block, lane, &params, context, &digests[license_i + lane], licenses[license_i + lane]);
+            }
+            if( loaded[lane] == 0 ) {
+                mfLicensingClearBatchLane(&block, lane);
+            }
+        }
+
+        kernel(&params, &block);
+
+        for( lane = 0; lane < MF_BATCH_LANES && license_i + lane < count; lane++ ) {
+            int result = loaded[lane] && block.mismatch[lane] == 0;
+            if( valid != 0 ) {
+                valid[license_i + lane] = (unsigned char)result;
+            }
+            valid_count += result;
+        }
+    }
+    return valid_count;
+}
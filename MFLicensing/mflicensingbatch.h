@@ -0,0 +1,57 @@
+//
+//  mflicensingbatch.h
+//  MFLicensing
+//  https://github.com/freshcode/MFLicensing
+//
+//
+//  Batch validation of license keys.
+//
+//  Validating a large number of license keys (re-validating an entire customer base, processing
+//  a backlog of activations, ...) repeats the exact same sequence of operations for every key:
+//  decode, extract the index, compute the index block, multiply by the digest and the salt,
+//  reduce by the private key and compare the validator bits.  The batch validator stores blocks
+//  of 16 keys structure-of-arrays style (limb j of every key stored together) and performs the
+//  arithmetic on 32-bit limbs across SIMD lanes: 8 keys per instruction with AVX-512, 4 with AVX2.
+//  The instruction set is selected at runtime; other processors use the same code one key at a
+//  time.
+//
+//  Results are identical to calling mfLicensingValidateLicenseWithContext for every key.
+//
+//  Licensing
+//  ---------
+//  Public Domain
+//  By Freshcode, Cutting edge Mac, iPhone & iPad software development. http://madefresh.ca/
+//
+
+#ifndef MFLicensing_mflicensingbatch_h
+#define MFLicensing_mflicensingbatch_h
+
+#include "mflicensing.h"
+
+// mfLicensingValidateLicenses
+//----------------------------
+// Batched form of mfLicensingValidateLicenseWithContext, validating count license keys, each
+// against its own digest.
+//
+// digests and licenses are arrays of count entries.  valid may be 0, otherwise valid[i] is set
+// to 1 if licenses[i] is valid for digests[i], 0 otherwise.
+//
+// Returns the number of valid license keys.
+unsigned int mfLicensingValidateLicenses( mfLicensingContext *context, const mfLicensingDigest *digests, const unsigned char **licenses, unsigned int count, unsigned char *valid );
+
+// mfLicensingBatchKernelName
+//---------------------------
+// Returns the name of the instruction set used by mfLicensingValidateLicenses: "avx512", "avx2"
+// or "portable".  Defining MFLICENSING_NO_SIMD at build time always selects "portable".
+const char *mfLicensingBatchKernelName( void );
+
+// mfLicensingSetBatchKernel
+//--------------------------
+// Selects the instruction set used by mfLicensingValidateLicenses by name, overriding the runtime
+// selection, to compare the kernels with each other.  Validations in progress in other threads finish
+// with the kernel they started with.
+//
+// Returns 0 on success, -1 if the kernel isn't compiled in or the processor doesn't support it.
+int mfLicensingSetBatchKernel( const char *name );
+
+#endif
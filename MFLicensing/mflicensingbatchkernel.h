@@ -0,0 +1,157 @@
+//
+//  mflicensingbatchkernel.h
+//  MFLicensing
+//  https://github.com/freshcode/MFLicensing
+//
+//  Arithmetic of the batch validator, on one block of MF_BATCH_LANES keys.
+//
+//  This file is included by mflicensingbatch.c once per instruction set, with the following
+//  defined beforehand:
+//  MF_BATCH_KERNEL: name of the function to define
+//  MF_BATCH_TARGET: function attributes (target instruction set)
+//  MF_LANE: type holding MF_LANE_WIDTH 64-bit lanes, a vector type or uint64_t
+//  MF_LANE_MUL(a, b): lane by lane product of the low 32 bits of a and b
+//
+//  Every limb is 32 bits wide and stored in a 64-bit lane so products and carries fit in the lane.
+//
+//  Public Domain
+//  By Freshcode, Cutting edge Mac, iPhone & iPad software development. http://madefresh.ca/
+//
+
+#define MF_LANE_SET(s) ((MF_LANE){0} + (uint64_t)(s))
+#define MF_LANE_LOAD(p) (*(const MF_LANE *)(p))
+#define MF_LANE_STORE(p, v) (*(MF_LANE *)(p) = (v))
+
+MF_BATCH_TARGET
+static void MF_BATCH_KERNEL( const mfLicensingBatchParams *params, mfLicensingBatchBlock *block )
+{
+    const MF_LANE limb_mask = MF_LANE_SET(0xFFFFFFFF);
+    unsigned int lane;
+
+    for( lane = 0; lane < MF_BATCH_LANES; lane += MF_LANE_WIDTH ) {
+        MF_LANE binary_key[8];
+        MF_LANE index_block[4];
+        MF_LANE digest[4];
+        MF_LANE mixed_block[8];
+        MF_LANE pivot[16];
+        MF_LANE validator[9];
+        MF_LANE t, carry, mismatch;
+        unsigned int i, j;
+
+        // Decode: binary_key = binary_key * base^k + chunk, most significant chunk first
+        {
+            const MF_LANE multiplier = MF_LANE_SET(params->chunk_multiplier);
+            MF_LANE overflow = MF_LANE_SET(0);
+            for( i = 0; i < 8; i++ ) binary_key[i] = MF_LANE_SET(0);
+            for( j = 0; j < params->chunk_count; j++ ) {
+                carry = MF_LANE_LOAD(&block->chunks[j][lane]);
+                for( i = 0; i < 8; i++ ) {
+                    t = MF_LANE_MUL(binary_key[i], multiplier) + carry;
+                    binary_key[i] = t & limb_mask;
+                    carry = t >> 32;
+                }
+                overflow |= carry;
+            }
+
+            // Keys that overflowed 256 bits, decoded to 0 or have bits set past bits_in_key are invalid
+            MF_LANE any_bit = MF_LANE_SET(0);
+            mismatch = overflow;
+            for( i = 0; i < 8; i++ ) {
+                any_bit |= binary_key[i];
+                mismatch |= binary_key[i] & MF_LANE_SET(params->high_mask[i]);
+            }
+            mismatch |= (any_bit - 1) >> 63;
+        }
+
+        // Extract the index and compute its 128-bit representation
+        {
+            MF_LANE index = MF_LANE_SET(0);
+            for( i = 0; i < params->index_bits; i++ ) {
+                unsigned int p = params->bit_position[i];
+                index |= ((binary_key[p >> 5] >> (p & 0x1F)) & 1) << i;
+            }
+            if( params->scheme == MF_LICENSING_SCHEME_PHILOX ) {
+                // Philox4x32-10 block of the counter (index, 0, 0, 0)
+                MF_LANE c0 = index, c1 = MF_LANE_SET(0), c2 = MF_LANE_SET(0), c3 = MF_LANE_SET(0);
+                for( i = 0; i < 10; i++ ) {
+                    MF_LANE p0 = MF_LANE_MUL(c0, MF_LANE_SET(0xD2511F53));
+                    MF_LANE p1 = MF_LANE_MUL(c2, MF_LANE_SET(0xCD9E8D57));
+                    c0 = (p1 >> 32) ^ c1 ^ MF_LANE_SET(params->round_key[i][0]);
+                    c1 = p1 & limb_mask;
+                    c2 = (p0 >> 32) ^ c3 ^ MF_LANE_SET(params->round_key[i][1]);
+                    c3 = p0 & limb_mask;
+                }
+                index_block[0] = c0;
+                index_block[1] = c1;
+                index_block[2] = c2;
+                index_block[3] = c3;
+            } else {
+                // the lrand48 generator x = (0x5DEECE66D * x + 0xB) mod 2^48 seeded with (index << 16) | 0x330E
+                MF_LANE x_low = ((index & MF_LANE_SET(0xFFFF)) << 16) | MF_LANE_SET(0x330E);
+                MF_LANE x_high = index >> 16;
+                for( i = 0; i < 4; i++ ) {
+                    MF_LANE low = MF_LANE_MUL(x_low, MF_LANE_SET(0xDEECE66D)) + MF_LANE_SET(0xB);
+                    MF_LANE high = (low >> 32) + MF_LANE_MUL(x_high, MF_LANE_SET(0xDEECE66D)) + (x_low << 2) + x_low;
+                    x_low = low & limb_mask;
+                    x_high = high & MF_LANE_SET(0xFFFF);
+                    index_block[i] = (x_high << 15) | (x_low >> 17);
+                }
+            }
+        }
+
+        // Multiply the index block by the digest, produces 256-bit result
+        for( i = 0; i < 4; i++ ) digest[i] = MF_LANE_LOAD(&block->digest[i][lane]);
+        for( i = 0; i < 8; i++ ) mixed_block[i] = MF_LANE_SET(0);
+        for( i = 0; i < 4; i++ ) {
+            carry = MF_LANE_SET(0);
+            for( j = 0; j < 4; j++ ) {
+                t = MF_LANE_MUL(digest[i], index_block[j]) + mixed_block[i+j] + carry;
+                mixed_block[i+j] = t & limb_mask;
+                carry = t >> 32;
+            }
+            mixed_block[i+4] = carry;
+        }
+
+        // Multiply previous result with the 256-bit salt, produces 512-bit result
+        for( i = 0; i < 16; i++ ) pivot[i] = MF_LANE_SET(0);
+        for( i = 0; i < 8; i++ ) {
+            const MF_LANE salt = MF_LANE_SET(params->salt[i]);
+            carry = MF_LANE_SET(0);
+            for( j = 0; j < 8; j++ ) {
+                t = MF_LANE_MUL(salt, mixed_block[j]) + pivot[i+j] + carry;
+                pivot[i+j] = t & limb_mask;
+                carry = t >> 32;
+            }
+            pivot[i+8] = carry;
+        }
+
+        // Reduce the most significant 256-bits by the private key; the key being at least 2^248,
+        // the quotient fits in 8 bits and the remainder is found by substracting key << 7 .. key << 0
+        for( i = 0; i < 8; i++ ) validator[i] = pivot[i+8];
+        validator[8] = MF_LANE_SET(0);
+        for( j = 8; j--; ) {
+            MF_LANE difference[9];
+            MF_LANE borrow = MF_LANE_SET(0);
+            for( i = 0; i < 9; i++ ) {
+                t = validator[i] - MF_LANE_SET(params->shifted_key[j][i]) - borrow;
+                difference[i] = t & limb_mask;
+                borrow = t >> 63;
+            }
+            MF_LANE keep = borrow - 1; // all ones when validator >= key << j
+            for( i = 0; i < 9; i++ ) {
+                validator[i] = (difference[i] & keep) | (validator[i] & ~keep);
+            }
+        }
+
+        // Compare the validator bits stored in the key with the expected validator
+        for( i = 0; i < params->validator_bits; i++ ) {
+            unsigned int p = params->bit_position[params->index_bits + i];
+            mismatch |= ((binary_key[p >> 5] >> (p & 0x1F)) ^ (validator[i >> 5] >> (i & 0x1F))) & 1;
+        }
+        MF_LANE_STORE(&block->mismatch[lane], mismatch);
+    }
+}
+
+#undef MF_LANE_SET
+#undef MF_LANE_LOAD
+#undef MF_LANE_STORE
@@ -0,0 +1,205 @@
+//
+//  mflicensingblob.c
+//  MFLicensing
+//  https://github.com/freshcode/MFLicensing
+//
+//  Public Domain
+//  By Freshcode, Cutting edge Mac, iPhone & iPad software development. http://madefresh.ca/
+//
+
+#include "mflicensingblob.h"
+#include "mflicensinginternal.h"
+#include <stdint.h>
+#include <string.h>
+
+#define MF_BLOB_MAGIC "MFLC"
+#define MF_BLOB_VERSION_OFFSET 4
+#define MF_BLOB_SIZE_OFFSET 6
+#define MF_BLOB_CHECKSUM_OFFSET 8
+#define MF_BLOB_PARAMS_OFFSET 16
+#define MF_BLOB_SEEDS_OFFSET 24
+#define MF_BLOB_PRIVATE_KEY_OFFSET 40
+#define MF_BLOB_SALT_OFFSET 72
+#define MF_BLOB_CODED_CHARS_OFFSET 104
+#define MF_BLOB_CODEC_CHARACTERS_OFFSET 232
+#define MF_BLOB_CHARACTER_WEIGHTS_OFFSET 360
+#define MF_BLOB_BITS_ORDERING_OFFSET 616
+#define MF_BLOB_MAX_CHARACTERS 128
+
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_BIG_ENDIAN__)
+#define MF_BLOB_HOST_BYTE_ORDER 2
+#else
+#define MF_BLOB_HOST_BYTE_ORDER 1
+#endif
+
+static uint32_t mfLicensingBlobLoad32( const unsigned char *p )
+{
+    return (uint32_t)p[0] | ((uint32_t)p[1] << 8) | ((uint32_t)p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+// Fletcher checksum of the 32-bit words of data: sum of the words in the low 32 bits, sum of the running sums
+// in the high 32 bits, both modulo 2^32.  Any single word changed or two words swapped changes the checksum;
+// a table driven CRC would take longer than everything else attaching a context does.
+static uint64_t mfLicensingBlobChecksum( const unsigned char *data, unsigned long size )
+{
+    uint32_t sum = 0;
+    uint32_t sum_of_sums = 0;
+    unsigned long word_i = size / 4;
+    while( word_i-- ) {
+        sum += mfLicensingBlobLoad32(data);
+        sum_of_sums += sum;
+        data += 4;
+    }
+    return ((uint64_t)sum_of_sums << 32) | sum;
+}
+
+static void mfLicensingBlobStore( unsigned char *p, uint64_t value, unsigned int bytes )
+{
+    unsigned int byte_i = 0;
+    while( byte_i < bytes ) {
+        p[byte_i++] = value & 0xFF;
+        value >>= 8;
+    }
+}
+
+static uint64_t mfLicensingBlobLoad( const unsigned char *p, unsigned int bytes )
+{
+    uint64_t value = 0;
+    while( bytes-- ) {
+        value = (value << 8) | p[bytes];
+    }
+    return value;
+}
+
+unsigned int mfLicensingSerializeContext( mfLicensingContext *context, void *blob, unsigned int size )
+{
+    unsigned char *b = (unsigned char *)blob;
+    mfLicensingVector *vector = context->vector;
+
+    if( vector == 0 || size < MF_LICENSING_BLOB_SIZE ) {
+        return 0;
+    }
+    memset(b, 0, MF_LICENSING_BLOB_SIZE);
+
+    memcpy(b, MF_BLOB_MAGIC, 4);
+    mfLicensingBlobStore(&b[MF_BLOB_VERSION_OFFSET], MF_LICENSING_BLOB_VERSION, 2);
+    mfLicensingBlobStore(&b[MF_BLOB_SIZE_OFFSET], MF_LICENSING_BLOB_SIZE, 2);
+
+    unsigned char *params = &b[MF_BLOB_PARAMS_OFFSET];
+    params[0] = MF_BLOB_HOST_BYTE_ORDER;
+    params[1] = (unsigned char)context->codec_params.encoding_base;
+    params[2] = vector->key_length;
+    params[3] = vector->index_bits;
+    params[4] = (unsigned char)context->codec_params.bits_in_key;
+    params[5] = vector->check_character;
+    params[6] = vector->scheme == MF_LICENSING_SCHEME_PHILOX ? MF_LICENSING_SCHEME_PHILOX : MF_LICENSING_SCHEME_LRAND48;
+
+    unsigned char *seeds = &b[MF_BLOB_SEEDS_OFFSET];
+    unsigned int seed_i = 3;
+    while( seed_i-- ) {
+        seeds[seed_i*2] = vector->scrambling_seed[seed_i] & 0xFF;
+        seeds[seed_i*2+1] = vector->scrambling_seed[seed_i] >> 8;
+        seeds[6+seed_i*2] = vector->salt_seed[seed_i] & 0xFF;
+        seeds[6+seed_i*2+1] = vector->salt_seed[seed_i] >> 8;
+    }
+
+    memcpy(&b[MF_BLOB_PRIVATE_KEY_OFFSET], vector->private_key->data.b, 32);
+    memcpy(&b[MF_BLOB_SALT_OFFSET], context->salt.b, 32);
+    memcpy(&b[MF_BLOB_CODED_CHARS_OFFSET], vector->coded_chars, context->codec_params.encoding_base);
+    memcpy(&b[MF_BLOB_CODEC_CHARACTERS_OFFSET], context->codec_params.codec_characters, context->codec_params.encoding_base);
+    memcpy(&b[MF_BLOB_CHARACTER_WEIGHTS_OFFSET], context->character_weights, 256);
+    memcpy(&b[MF_BLOB_BITS_ORDERING_OFFSET], context->codec_params.bits_ordering, context->codec_params.bits_in_key);
+
+    mfLicensingBlobStore(&b[MF_BLOB_CHECKSUM_OFFSET], mfLicensingBlobChecksum(&b[MF_BLOB_PARAMS_OFFSET], MF_LICENSING_BLOB_SIZE - MF_BLOB_PARAMS_OFFSET), 8);
+    return MF_LICENSING_BLOB_SIZE;
+}
+
+// Returns 1 if the parameters found in the blob can be used safely, 0 otherwise
+static int mfLicensingBlobIsConsistent( const unsigned char *b )
+{
+    const unsigned char *params = &b[MF_BLOB_PARAMS_OFFSET];
+    unsigned int encoding_base = params[1];
+    unsigned int bits_in_key = params[4];
+    const unsigned char *coded_chars = &b[MF_BLOB_CODED_CHARS_OFFSET];
+    const unsigned char *codec_characters = &b[MF_BLOB_CODEC_CHARACTERS_OFFSET];
+    const unsigned char *character_weights = &b[MF_BLOB_CHARACTER_WEIGHTS_OFFSET];
+    const unsigned char *bits_ordering = &b[MF_BLOB_BITS_ORDERING_OFFSET];
+
+    if( encoding_base < 2 || encoding_base > 100 || params[2] == 0 || params[3] > 32 ||
+        params[3] >= bits_in_key || params[5] > 1 ||
+        (params[6] != 0 && params[6] != MF_LICENSING_SCHEME_LRAND48 && params[6] != MF_LICENSING_SCHEME_PHILOX) ) {
+        return 0;
+    }
+    // The keys decoded must hold exactly the bits the codec parameters scramble
+    if( bits_in_key != mfLicensingKeyBits(encoding_base, params[2]) ) {
+        return 0;
+    }
+    if( b[MF_BLOB_PRIVATE_KEY_OFFSET + 31] == 0 || (b[MF_BLOB_PRIVATE_KEY_OFFSET] & 0x01) == 0 ) {
+        return 0;
+    }
+    if( coded_chars[encoding_base] != 0 ) {
+        return 0;
+    }
+    unsigned int weight = encoding_base;
+    while( weight-- ) {
+        if( coded_chars[weight] == 0 || character_weights[ codec_characters[weight] ] != weight ) {
+            return 0;
+        }
+    }
+    unsigned int bit_i = bits_in_key;
+    while( bit_i-- ) {
+        if( bits_ordering[bit_i] >= bits_in_key ) {
+            return 0;
+        }
+    }
+    return 1;
+}
+
+int mfLicensingAttachContext( mfLicensingCompiledContext *compiled, const void *blob, unsigned long size )
+{
+    const unsigned char *b = (const unsigned char *)blob;
+    compiled->context.vector = 0;
+
+    if( size < MF_LICENSING_BLOB_SIZE || memcmp(b, MF_BLOB_MAGIC, 4) != 0 ||
+        mfLicensingBlobLoad(&b[MF_BLOB_VERSION_OFFSET], 2) != MF_LICENSING_BLOB_VERSION ||
+        mfLicensingBlobLoad(&b[MF_BLOB_SIZE_OFFSET], 2) != MF_LICENSING_BLOB_SIZE ||
+        b[MF_BLOB_PARAMS_OFFSET] != MF_BLOB_HOST_BYTE_ORDER ) {
+        return -1;
+    }
+    if( mfLicensingBlobLoad(&b[MF_BLOB_CHECKSUM_OFFSET], 8) != mfLicensingBlobChecksum(&b[MF_BLOB_PARAMS_OFFSET], MF_LICENSING_BLOB_SIZE - MF_BLOB_PARAMS_OFFSET) ) {
+        return -1;
+    }
+    if( mfLicensingBlobIsConsistent(b) == 0 ) {
+        return -1;
+    }
+
+    const unsigned char *params = &b[MF_BLOB_PARAMS_OFFSET];
+    const unsigned char *seeds = &b[MF_BLOB_SEEDS_OFFSET];
+    mfLicensingVector *vector = &compiled->vector;
+    // The blob may be mapped at any address, the key is copied rather than accessed in place
+    memcpy(compiled->private_key.data.b, &b[MF_BLOB_PRIVATE_KEY_OFFSET], 32);
+    vector->private_key = &compiled->private_key;
+    vector->coded_chars = &b[MF_BLOB_CODED_CHARS_OFFSET];
+    unsigned int seed_i = 3;
+    while( seed_i-- ) {
+        vector->scrambling_seed[seed_i] = seeds[seed_i*2] | (seeds[seed_i*2+1] << 8);
+        vector->salt_seed[seed_i] = seeds[6+seed_i*2] | (seeds[6+seed_i*2+1] << 8);
+    }
+    vector->key_length = params[2];
+    vector->index_bits = params[3];
+    vector->check_character = params[5];
+    // 0 in blobs compiled before the key schemes
+    vector->scheme = params[6] == MF_LICENSING_SCHEME_PHILOX ? MF_LICENSING_SCHEME_PHILOX : MF_LICENSING_SCHEME_LRAND48;
+
+    // The codec parameters are only ever read, they point into the blob
+    mfLicensingContext *context = &compiled->context;
+    context->codec_params.encoding_base = params[1];
+    context->codec_params.bits_in_key = params[4];
+    context->codec_params.codec_characters = (unsigned char *)&b[MF_BLOB_CODEC_CHARACTERS_OFFSET];
+    context->codec_params.bits_ordering = (unsigned char *)&b[MF_BLOB_BITS_ORDERING_OFFSET];
+    memcpy(context->character_weights, &b[MF_BLOB_CHARACTER_WEIGHTS_OFFSET], 256);
+    memcpy(context->salt.b, &b[MF_BLOB_SALT_OFFSET], 32);
+    context->external_codec_params = 1;
+    context->vector = vector;
+    return 0;
+}
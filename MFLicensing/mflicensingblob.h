@@ -0,0 +1,77 @@
+//
+//  mflicensingblob.h
+//  MFLicensing
+//  https://github.com/freshcode/MFLicensing
+//
+//
+//  Compiled licensing contexts.
+//
+//  Initializing a licensing context scrambles the encoding characters and the bit positions and
+//  generates the salt, all from the seeds of the vector.  Short-lived processes validating a
+//  handful of keys spend a good part of their life doing so.  A context can instead be compiled
+//  once into a blob of MF_LICENSING_BLOB_SIZE bytes, stored in a file or built into the executable,
+//  and attached in place: the context points into the blob, nothing is parsed, scrambled or
+//  allocated.
+//
+//  Blob format, version 1 (multi-byte fields are little-endian):
+//    0  magic "MFLC"            4  version (16-bit)   6  size (16-bit)   8  checksum of bytes 16 to size (64-bit)
+//   16  byte order of the host that compiled the blob (1 little-endian, 2 big-endian), encoding base,
+//       key length, index bits, bits in key, check character, key scheme (0 in blobs compiled before
+//       the key schemes, the first scheme), 1 reserved byte
+//   24  scrambling seed (3 x 16-bit), salt seed (3 x 16-bit), 4 reserved bytes
+//   40  private key (32 bytes)  72  salt (32 bytes)
+//  104  encoding characters, null-terminated (128 bytes)
+//  232  scrambled encoding characters (128 bytes)
+//  360  character weights (256 bytes)
+//  616  scrambled bit positions (256 bytes)
+//
+//  The blob holds the private key: it must be protected like the vector it was compiled from.
+//
+//  Licensing
+//  ---------
+//  Public Domain
+//  By Freshcode, Cutting edge Mac, iPhone & iPad software development. http://madefresh.ca/
+//
+
+#ifndef MFLicensing_mflicensingblob_h
+#define MFLicensing_mflicensingblob_h
+
+#include "mflicensing.h"
+
+#define MF_LICENSING_BLOB_VERSION 1
+#define MF_LICENSING_BLOB_SIZE 872
+
+// Compiled Context structure, a licensing context attached to a blob
+//-------------------------------------------------------------------
+// vector: licensing vector, its encoding characters pointing into the blob
+// context: licensing context of vector, its codec parameters pointing into the blob
+// private_key: private key of vector, copied from the blob
+//
+// The structure must not be moved or copied once attached, context refers to vector and vector to
+// private_key.  The blob needs no particular alignment.
+typedef struct {
+    mfLicensingVector vector;
+    mfLicensingContext context;
+    mfLicensingPrivateKey private_key;
+} mfLicensingCompiledContext;
+
+// mfLicensingSerializeContext
+//----------------------------
+// Compiles the context specified into blob, which must hold at least MF_LICENSING_BLOB_SIZE bytes.
+//
+// Returns the number of bytes written (MF_LICENSING_BLOB_SIZE), 0 if the context isn't initialized
+// or blob is too small.
+unsigned int mfLicensingSerializeContext( mfLicensingContext *context, void *blob, unsigned int size );
+
+// mfLicensingAttachContext
+//-------------------------
+// Attaches compiled to the blob specified, size being the number of bytes available (the size of
+// the file mapped for instance).  compiled->context may then be used with every function taking a
+// licensing context, for as long as the blob remains mapped and unchanged.  Releasing the context
+// with mfLicensingReleaseContext is not required, the blob is never freed by the library.
+//
+// Returns 0 on success, -1 if the blob is truncated, corrupted (checksum mismatch), inconsistent,
+// of another version or was compiled on a host of another byte order.
+int mfLicensingAttachContext( mfLicensingCompiledContext *compiled, const void *blob, unsigned long size );
+
+#endif
@@ -0,0 +1,454 @@
+//
+//  mflicensingdigest.c
+//  MFLicensing
+//  https://github.com/freshcode/MFLicensing
+//
+//  Public Domain
+//  By Freshcode, Cutting edge Mac, iPhone & iPad software development. http://madefresh.ca/
+//
+
+#include "mflicensingdigest.h"
+#include <string.h>
+
+#if (defined(__x86_64__) || defined(__i386__)) && (defined(__GNUC__) || defined(__clang__))
+#define MF_SHA256_X86 1
+#include <immintrin.h>
+#include <cpuid.h>
+#elif defined(__aarch64__) && (defined(__ARM_FEATURE_SHA2) || defined(__ARM_FEATURE_CRYPTO))
+#define MF_SHA256_ARMV8 1
+#include <arm_neon.h>
+#endif
+
+#pragma mark - MD5
+
+static void mfLicensingMD5Init( mfLicensingDigestContext *context )
+{
+    MD5_Init(&context->state.md5);
+}
+
+static void mfLicensingMD5Update( mfLicensingDigestContext *context, const void *data, unsigned long size )
+{
+    MD5_Update(&context->state.md5, (void *)data, size);
+}
+
+static void mfLicensingMD5Final( mfLicensingDigestContext *context, mfLicensingDigest *digest )
+{
+    MD5_Final(digest->md5hash.b, &context->state.md5);
+}
+
+const mfLicensingDigestProvider mfLicensingDigestMD5 = {
+    "md5",
+    mfLicensingMD5Init,
+    mfLicensingMD5Update,
+    mfLicensingMD5Final,
+    0
+};
+
+#pragma mark - SHA-256 kernels
+
+static const uint32_t mfSHA256K[64] = {
+    0x428A2F98, 0x71374491, 0xB5C0FBCF, 0xE9B5DBA5, 0x3956C25B, 0x59F111F1, 0x923F82A4, 0xAB1C5ED5,
+    0xD807AA98, 0x12835B01, 0x243185BE, 0x550C7DC3, 0x72BE5D74, 0x80DEB1FE, 0x9BDC06A7, 0xC19BF174,
+    0xE49B69C1, 0xEFBE4786, 0x0FC19DC6, 0x240CA1CC, 0x2DE92C6F, 0x4A7484AA, 0x5CB0A9DC, 0x76F988DA,
+    0x983E5152, 0xA831C66D, 0xB00327C8, 0xBF597FC7, 0xC6E00BF3, 0xD5A79147, 0x06CA6351, 0x14292967,
+    0x27B70A85, 0x2E1B2138, 0x4D2C6DFC, 0x53380D13, 0x650A7354, 0x766A0ABB, 0x81C2C92E, 0x92722C85,
+    0xA2BFE8A1, 0xA81A664B, 0xC24B8B70, 0xC76C51A3, 0xD192E819, 0xD6990624, 0xF40E3585, 0x106AA070,
+    0x19A4C116, 0x1E376C08, 0x2748774C, 0x34B0BCB5, 0x391C0CB3, 0x4ED8AA4A, 0x5B9CCA4F, 0x682E6FF3,
+    0x748F82EE, 0x78A5636F, 0x84C87814, 0x8CC70208, 0x90BEFFFA, 0xA4506CEB, 0xBEF9A3F7, 0xC67178F2
+};
+
+static const uint32_t mfSHA256Initial[8] = {
+    0x6A09E667, 0xBB67AE85, 0x3C6EF372, 0xA54FF53A, 0x510E527F, 0x9B05688C, 0x1F83D9AB, 0x5BE0CD19
+};
+
+// Processes blocks of 64 bytes of data
+typedef void (*mfSHA256BlocksFunction)( uint32_t hash[8], const unsigned char *data, unsigned long blocks );
+
+// Processes blocks of 64 bytes of two independent messages
+typedef void (*mfSHA256Blocks2Function)( uint32_t hash_a[8], const unsigned char *data_a, uint32_t hash_b[8], const unsigned char *data_b, unsigned long blocks );
+
+#define MF_SHA256_ROTR(x, n) (((x) >> (n)) | ((x) << (32 - (n))))
+
+static void mfSHA256BlocksPortable( uint32_t hash[8], const unsigned char *data, unsigned long blocks )
+{
+    while( blocks-- ) {
+        uint32_t w[64];
+        unsigned int i;
+        for( i = 0; i < 16; i++ ) {
+            w[i] = ((uint32_t)data[i*4] << 24) | ((uint32_t)data[i*4+1] << 16) | ((uint32_t)data[i*4+2] << 8) | (uint32_t)data[i*4+3];
+        }
+        for( i = 16; i < 64; i++ ) {
+            uint32_t s0 = MF_SHA256_ROTR(w[i-15], 7) ^ MF_SHA256_ROTR(w[i-15], 18) ^ (w[i-15] >> 3);
+            uint32_t s1 = MF_SHA256_ROTR(w[i-2], 17) ^ MF_SHA256_ROTR(w[i-2], 19) ^ (w[i-2] >> 10);
+            w[i] = w[i-16] + s0 + w[i-7] + s1;
+        }
+
+        uint32_t a = hash[0], b = hash[1], c = hash[2], d = hash[3];
+        uint32_t e = hash[4], f = hash[5], g = hash[6], h = hash[7];
+        for( i = 0; i < 64; i++ ) {
+            uint32_t t1 = h + (MF_SHA256_ROTR(e, 6) ^ MF_SHA256_ROTR(e, 11) ^ MF_SHA256_ROTR(e, 25)) + ((e & f) ^ (~e & g)) + mfSHA256K[i] + w[i];
+            uint32_t t2 = (MF_SHA256_ROTR(a, 2) ^ MF_SHA256_ROTR(a, 13) ^ MF_SHA256_ROTR(a, 22)) + ((a & b) ^ (a & c) ^ (b & c));
+            h = g; g = f; f = e; e = d + t1;
+            d = c; c = b; b = a; a = t1 + t2;
+        }
+        hash[0] += a; hash[1] += b; hash[2] += c; hash[3] += d;
+        hash[4] += e; hash[5] += f; hash[6] += g; hash[7] += h;
+        data += 64;
+    }
+}
+
+#ifdef MF_SHA256_X86
+#define MF_SHA256_NI_TARGET __attribute__((target("sha,sse4.1,ssse3")))
+
+// The hash is kept as ABEF and CDGH as expected by sha256rnds2
+#define MF_SHA_NI_LOAD_STATE(hash, abef, cdgh) { \
+    __m128i dcba = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&(hash)[0]), 0xB1); \
+    __m128i efgh = _mm_shuffle_epi32(_mm_loadu_si128((const __m128i *)&(hash)[4]), 0x1B); \
+    abef = _mm_alignr_epi8(dcba, efgh, 8); \
+    cdgh = _mm_blend_epi16(efgh, dcba, 0xF0); \
+}
+
+#define MF_SHA_NI_STORE_STATE(hash, abef, cdgh) { \
+    __m128i feba = _mm_shuffle_epi32(abef, 0x1B); \
+    __m128i dchg = _mm_shuffle_epi32(cdgh, 0xB1); \
+    _mm_storeu_si128((__m128i *)&(hash)[0], _mm_blend_epi16(feba, dchg, 0xF0)); \
+    _mm_storeu_si128((__m128i *)&(hash)[4], _mm_alignr_epi8(dchg, feba, 8)); \
+}
+
+#define MF_SHA_NI_LOAD(w, data, n) \
+    w = _mm_shuffle_epi8(_mm_loadu_si128((const __m128i *)((data) + (n) * 16)), byte_swap)
+
+// Message words 4g .. 4g+3 from the previous 16 words, w0 holding the oldest
+#define MF_SHA_NI_SCHEDULE(w0, w1, w2, w3) \
+    w0 = _mm_sha256msg2_epu32(_mm_add_epi32(_mm_sha256msg1_epu32(w0, w1), _mm_alignr_epi8(w3, w2, 4)), w3)
+
+// Rounds 4g .. 4g+3
+#define MF_SHA_NI_ROUNDS(abef, cdgh, w, g) { \
+    __m128i wk = _mm_add_epi32(w, _mm_loadu_si128((const __m128i *)&mfSHA256K[(g) * 4])); \
+    cdgh = _mm_sha256rnds2_epu32(cdgh, abef, wk); \
+    abef = _mm_sha256rnds2_epu32(abef, cdgh, _mm_shuffle_epi32(wk, 0x0E)); \
+}
+
+MF_SHA256_NI_TARGET
+static void mfSHA256BlocksSHANI( uint32_t hash[8], const unsigned char *data, unsigned long blocks )
+{
+    const __m128i byte_swap = _mm_set_epi64x(0x0C0D0E0F08090A0BULL, 0x0405060700010203ULL);
+    __m128i abef, cdgh;
+    MF_SHA_NI_LOAD_STATE(hash, abef, cdgh);
+
+    while( blocks-- ) {
+        __m128i abef_saved = abef, cdgh_saved = cdgh;
+        __m128i w0, w1, w2, w3;
+        MF_SHA_NI_LOAD(w0, data, 0); MF_SHA_NI_ROUNDS(abef, cdgh, w0, 0);
+        MF_SHA_NI_LOAD(w1, data, 1); MF_SHA_NI_ROUNDS(abef, cdgh, w1, 1);
+        MF_SHA_NI_LOAD(w2, data, 2); MF_SHA_NI_ROUNDS(abef, cdgh, w2, 2);
+        MF_SHA_NI_LOAD(w3, data, 3); MF_SHA_NI_ROUNDS(abef, cdgh, w3, 3);
+        unsigned int g;
+        for( g = 4; g < 16; g += 4 ) {
+            MF_SHA_NI_SCHEDULE(w0, w1, w2, w3); MF_SHA_NI_ROUNDS(abef, cdgh, w0, g);
+            MF_SHA_NI_SCHEDULE(w1, w2, w3, w0); MF_SHA_NI_ROUNDS(abef, cdgh, w1, g + 1);
+            MF_SHA_NI_SCHEDULE(w2, w3, w0, w1); MF_SHA_NI_ROUNDS(abef, cdgh, w2, g + 2);
+            MF_SHA_NI_SCHEDULE(w3, w0, w1, w2); MF_SHA_NI_ROUNDS(abef, cdgh, w3, g + 3);
+        }
+        abef = _mm_add_epi32(abef, abef_saved);
+        cdgh = _mm_add_epi32(cdgh, cdgh_saved);
+        data += 64;
+    }
+
+    MF_SHA_NI_STORE_STATE(hash, abef, cdgh);
+}
+
+// Two messages interleaved: each sha256rnds2 depends on the previous one, the rounds of the
+// second message execute while the first waits
+MF_SHA256_NI_TARGET
+static void mfSHA256Blocks2SHANI( uint32_t hash_a[8], const unsigned char *data_a, uint32_t hash_b[8], const unsigned char *data_b, unsigned long blocks )
+{
+    const __m128i byte_swap = _mm_set_epi64x(0x0C0D0E0F08090A0BULL, 0x0405060700010203ULL);
+    __m128i abef_a, cdgh_a, abef_b, cdgh_b;
+    MF_SHA_NI_LOAD_STATE(hash_a, abef_a, cdgh_a);
+    MF_SHA_NI_LOAD_STATE(hash_b, abef_b, cdgh_b);
+
+    while( blocks-- ) {
+        __m128i abef_a_saved = abef_a, cdgh_a_saved = cdgh_a;
+        __m128i abef_b_saved = abef_b, cdgh_b_saved = cdgh_b;
+        __m128i a0, a1, a2, a3, b0, b1, b2, b3;
+        MF_SHA_NI_LOAD(a0, data_a, 0); MF_SHA_NI_LOAD(b0, data_b, 0);
+        MF_SHA_NI_ROUNDS(abef_a, cdgh_a, a0, 0); MF_SHA_NI_ROUNDS(abef_b, cdgh_b, b0, 0);
+        MF_SHA_NI_LOAD(a1, data_a, 1); MF_SHA_NI_LOAD(b1, data_b, 1);
+        MF_SHA_NI_ROUNDS(abef_a, cdgh_a, a1, 1); MF_SHA_NI_ROUNDS(abef_b, cdgh_b, b1, 1);
+        MF_SHA_NI_LOAD(a2, data_a, 2); MF_SHA_NI_LOAD(b2, data_b, 2);
+        MF_SHA_NI_ROUNDS(abef_a, cdgh_a, a2, 2); MF_SHA_NI_ROUNDS(abef_b, cdgh_b, b2, 2);
+        MF_SHA_NI_LOAD(a3, data_a, 3); MF_SHA_NI_LOAD(b3, data_b, 3);
+        MF_SHA_NI_ROUNDS(abef_a, cdgh_a, a3, 3); MF_SHA_NI_ROUNDS(abef_b, cdgh_b, b3, 3);
+        unsigned int g;
+        for( g = 4; g < 16; g += 4 ) {
+            MF_SHA_NI_SCHEDULE(a0, a1, a2, a3); MF_SHA_NI_SCHEDULE(b0, b1, b2, b3);
+            MF_SHA_NI_ROUNDS(abef_a, cdgh_a, a0, g); MF_SHA_NI_ROUNDS(abef_b, cdgh_b, b0, g);
+            MF_SHA_NI_SCHEDULE(a1, a2, a3, a0); MF_SHA_NI_SCHEDULE(b1, b2, b3, b0);
+            MF_SHA_NI_ROUNDS(abef_a, cdgh_a, a1, g + 1); MF_SHA_NI_ROUNDS(abef_b, cdgh_b, b1, g + 1);
+            MF_SHA_NI_SCHEDULE(a2, a3, a0, a1); MF_SHA_NI_SCHEDULE(b2, b3, b0, b1);
+            MF_SHA_NI_ROUNDS(abef_a, cdgh_a, a2, g + 2); MF_SHA_NI_ROUNDS(abef_b, cdgh_b, b2, g + 2);
+            MF_SHA_NI_SCHEDULE(a3, a0, a1, a2); MF_SHA_NI_SCHEDULE(b3, b0, b1, b2);
+            MF_SHA_NI_ROUNDS(abef_a, cdgh_a, a3, g + 3); MF_SHA_NI_ROUNDS(abef_b, cdgh_b, b3, g + 3);
+        }
+        abef_a = _mm_add_epi32(abef_a, abef_a_saved);
+        cdgh_a = _mm_add_epi32(cdgh_a, cdgh_a_saved);
+        abef_b = _mm_add_epi32(abef_b, abef_b_saved);
+        cdgh_b = _mm_add_epi32(cdgh_b, cdgh_b_saved);
+        data_a += 64;
+        data_b += 64;
+    }
+
+    MF_SHA_NI_STORE_STATE(hash_a, abef_a, cdgh_a);
+    MF_SHA_NI_STORE_STATE(hash_b, abef_b, cdgh_b);
+}
+
+static int mfSHA256HasSHANI( void )
+{
+    unsigned int eax, ebx, ecx, edx;
+    if( __get_cpuid(1, &eax, &ebx, &ecx, &edx) == 0 || (ecx & bit_SSSE3) == 0 || (ecx & bit_SSE4_1) == 0 ) {
+        return 0;
+    }
+    if( __get_cpuid_count(7, 0, &eax, &ebx, &ecx, &edx) == 0 ) {
+        return 0;
+    }
+    return (ebx >> 29) & 1;
+}
+#endif
+
+#ifdef MF_SHA256_ARMV8
+#define MF_SHA_ARMV8_LOAD(w, data, n) \
+    w = vreinterpretq_u32_u8(vrev32q_u8(vld1q_u8((data) + (n) * 16)))
+
+// Message words 4g .. 4g+3 from the previous 16 words, w0 holding the oldest
+#define MF_SHA_ARMV8_SCHEDULE(w0, w1, w2, w3) \
+    w0 = vsha256su1q_u32(vsha256su0q_u32(w0, w1), w2, w3)
+
+// Rounds 4g .. 4g+3
+#define MF_SHA_ARMV8_ROUNDS(abcd, efgh, w, g) { \
+    uint32x4_t wk = vaddq_u32(w, vld1q_u32(&mfSHA256K[(g) * 4])); \
+    uint32x4_t abcd_before = abcd; \
+    abcd = vsha256hq_u32(abcd, efgh, wk); \
+    efgh = vsha256h2q_u32(efgh, abcd_before, wk); \
+}
+
+static void mfSHA256BlocksARMv8( uint32_t hash[8], const unsigned char *data, unsigned long blocks )
+{
+    uint32x4_t abcd = vld1q_u32(&hash[0]);
+    uint32x4_t efgh = vld1q_u32(&hash[4]);
+
+    while( blocks-- ) {
+        uint32x4_t abcd_saved = abcd, efgh_saved = efgh;
+        uint32x4_t w0, w1, w2, w3;
+        MF_SHA_ARMV8_LOAD(w0, data, 0); MF_SHA_ARMV8_ROUNDS(abcd, efgh, w0, 0);
+        MF_SHA_ARMV8_LOAD(w1, data, 1); MF_SHA_ARMV8_ROUNDS(abcd, efgh, w1, 1);
+        MF_SHA_ARMV8_LOAD(w2, data, 2); MF_SHA_ARMV8_ROUNDS(abcd, efgh, w2, 2);
+        MF_SHA_ARMV8_LOAD(w3, data, 3); MF_SHA_ARMV8_ROUNDS(abcd, efgh, w3, 3);
+        unsigned int g;
+        for( g = 4; g < 16; g += 4 ) {
+            MF_SHA_ARMV8_SCHEDULE(w0, w1, w2, w3); MF_SHA_ARMV8_ROUNDS(abcd, efgh, w0, g);
+            MF_SHA_ARMV8_SCHEDULE(w1, w2, w3, w0); MF_SHA_ARMV8_ROUNDS(abcd, efgh, w1, g + 1);
+            MF_SHA_ARMV8_SCHEDULE(w2, w3, w0, w1); MF_SHA_ARMV8_ROUNDS(abcd, efgh, w2, g + 2);
+            MF_SHA_ARMV8_SCHEDULE(w3, w0, w1, w2); MF_SHA_ARMV8_ROUNDS(abcd, efgh, w3, g + 3);
+        }
+        abcd = vaddq_u32(abcd, abcd_saved);
+        efgh = vaddq_u32(efgh, efgh_saved);
+        data += 64;
+    }
+
+    vst1q_u32(&hash[0], abcd);
+    vst1q_u32(&hash[4], efgh);
+}
+#endif
+
+// Kernels compiled in, the selected one is only accessed atomically; threads selecting it at the
+// same time store the same entry
+typedef struct {
+    mfSHA256BlocksFunction blocks;
+    mfSHA256Blocks2Function blocks2;
+    const char *name;
+} mfSHA256Kernel;
+
+static const mfSHA256Kernel *mfSHA256Selected = 0;
+
+static const mfSHA256Kernel *mfSHA256SelectKernel( void );
+
+static void mfSHA256Blocks2Sequential( uint32_t hash_a[8], const unsigned char *data_a, uint32_t hash_b[8], const unsigned char *data_b, unsigned long blocks )
+{
+    mfSHA256BlocksFunction blocks1 = mfSHA256SelectKernel()->blocks;
+    blocks1(hash_a, data_a, blocks);
+    blocks1(hash_b, data_b, blocks);
+}
+
+static const mfSHA256Kernel mfSHA256KernelPortable = { mfSHA256BlocksPortable, mfSHA256Blocks2Sequential, "portable" };
+#if defined(MF_SHA256_X86)
+static const mfSHA256Kernel mfSHA256KernelSHANI = { mfSHA256BlocksSHANI, mfSHA256Blocks2SHANI, "sha-ni" };
+#elif defined(MF_SHA256_ARMV8)
+static const mfSHA256Kernel mfSHA256KernelARMv8 = { mfSHA256BlocksARMv8, mfSHA256Blocks2Sequential, "armv8" };
+#endif
+
+static const mfSHA256Kernel *mfSHA256SelectKernel( void )
+{
+    const mfSHA256Kernel *kernel = __atomic_load_n(&mfSHA256Selected, __ATOMIC_ACQUIRE);
+    if( kernel == 0 ) {
+        kernel = &mfSHA256KernelPortable;
+#if defined(MF_SHA256_X86)
+        if( mfSHA256HasSHANI() ) {
+            kernel = &mfSHA256KernelSHANI;
+        }
+#elif defined(MF_SHA256_ARMV8)
+        kernel = &mfSHA256KernelARMv8;
+#endif
+        __atomic_store_n(&mfSHA256Selected, kernel, __ATOMIC_RELEASE);
+    }
+    return kernel;
+}
+
+#define mfSHA256Blocks (mfSHA256SelectKernel()->blocks)
+#define mfSHA256Blocks2 (mfSHA256SelectKernel()->blocks2)
+
+const char *mfLicensingSHA256KernelName( void )
+{
+    return mfSHA256SelectKernel()->name;
+}
+
+#pragma mark - SHA-256
+
+static void mfLicensingSHA256Init( mfLicensingDigestContext *context )
+{
+    memcpy(context->state.sha256.hash, mfSHA256Initial, sizeof(mfSHA256Initial));
+    context->state.sha256.length = 0;
+}
+
+static void mfLicensingSHA256Update( mfLicensingDigestContext *context, const void *data, unsigned long size )
+{
+    const unsigned char *bytes = (const unsigned char *)data;
+    unsigned int buffered = (unsigned int)(context->state.sha256.length & 63);
+    context->state.sha256.length += size;
+
+    if( buffered != 0 ) {
+        unsigned int missing = 64 - buffered;
+        if( size < missing ) {
+            memcpy(&context->state.sha256.buffer[buffered], bytes, size);
+            return;
+        }
+        memcpy(&context->state.sha256.buffer[buffered], bytes, missing);
+        mfSHA256Blocks(context->state.sha256.hash, context->state.sha256.buffer, 1);
+        bytes += missing;
+        size -= missing;
+    }
+    if( size >= 64 ) {
+        mfSHA256Blocks(context->state.sha256.hash, bytes, size / 64);
+        bytes += size & ~63UL;
+        size &= 63;
+    }
+    memcpy(context->state.sha256.buffer, bytes, size);
+}
+
+// The digest is the first 128 bits of the hash, in the byte order of the hash
+static void mfLicensingSHA256Final( mfLicensingDigestContext *context, mfLicensingDigest *digest )
+{
+    unsigned char *buffer = context->state.sha256.buffer;
+    uint64_t bit_length = context->state.sha256.length << 3;
+    unsigned int buffered = (unsigned int)(context->state.sha256.length & 63);
+
+    buffer[buffered++] = 0x80;
+    if( buffered > 56 ) {
+        memset(&buffer[buffered], 0, 64 - buffered);
+        mfSHA256Blocks(context->state.sha256.hash, buffer, 1);
+        buffered = 0;
+    }
+    memset(&buffer[buffered], 0, 56 - buffered);
+    unsigned int byte_i = 8;
+    while( byte_i-- ) {
+        buffer[63 - byte_i] = (unsigned char)(bit_length >> (byte_i * 8));
+    }
+    mfSHA256Blocks(context->state.sha256.hash, buffer, 1);
+
+    unsigned int word_i = 4;
+    while( word_i-- ) {
+        uint32_t word = context->state.sha256.hash[word_i];
+        digest->md5hash.b[word_i*4] = (unsigned char)(word >> 24);
+        digest->md5hash.b[word_i*4+1] = (unsigned char)(word >> 16);
+        digest->md5hash.b[word_i*4+2] = (unsigned char)(word >> 8);
+        digest->md5hash.b[word_i*4+3] = (unsigned char)word;
+    }
+}
+
+// Messages are hashed in pairs: the blocks common to both messages are processed together, the
+// remaining blocks and the padding of each message separately
+static void mfLicensingSHA256Batch( const void **messages, const unsigned long *sizes, unsigned int count, mfLicensingDigest *digests )
+{
+    mfLicensingDigestContext context_a, context_b;
+    unsigned int message_i;
+
+    for( message_i = 0; message_i + 1 < count; message_i += 2 ) {
+        const unsigned char *data_a = (const unsigned char *)messages[message_i];
+        const unsigned char *data_b = (const unsigned char *)messages[message_i + 1];
+        unsigned long size_a = sizes[message_i];
+        unsigned long size_b = sizes[message_i + 1];
+        unsigned long blocks = (size_a < size_b ? size_a : size_b) / 64;
+
+        mfLicensingSHA256Init(&context_a);
+        mfLicensingSHA256Init(&context_b);
+        if( blocks != 0 ) {
+            mfSHA256Blocks2(context_a.state.sha256.hash, data_a, context_b.state.sha256.hash, data_b, blocks);
+            context_a.state.sha256.length = context_b.state.sha256.length = (uint64_t)blocks * 64;
+        }
+        mfLicensingSHA256Update(&context_a, data_a + blocks * 64, size_a - blocks * 64);
+        mfLicensingSHA256Update(&context_b, data_b + blocks * 64, size_b - blocks * 64);
+        mfLicensingSHA256Final(&context_a, &digests[message_i]);
+        mfLicensingSHA256Final(&context_b, &digests[message_i + 1]);
+    }
+    if( message_i < count ) {
+        mfLicensingSHA256Init(&context_a);
+        mfLicensingSHA256Update(&context_a, messages[message_i], sizes[message_i]);
+        mfLicensingSHA256Final(&context_a, &digests[message_i]);
+    }
+}
+
+const mfLicensingDigestProvider mfLicensingDigestSHA256 = {
+    "sha256",
+    mfLicensingSHA256Init,
+    mfLicensingSHA256Update,
+    mfLicensingSHA256Final,
+    mfLicensingSHA256Batch
+};
+
+#pragma mark - Digest computation
+
+void mfLicensingDigestInit( mfLicensingDigestContext *context, const mfLicensingDigestProvider *provider )
+{
+    context->provider = provider;
+    provider->init(context);
+}
+
+void mfLicensingDigestUpdate( mfLicensingDigestContext *context, const void *data, unsigned long size )
+{
+    context->provider->update(context, data, size);
+}
+
+void mfLicensingDigestFinal( mfLicensingDigestContext *context, mfLicensingDigest *digest )
+{
+    context->provider->final(context, digest);
+}
+
+void mfLicensingComputeDigest( const mfLicensingDigestProvider *provider, const void *data, unsigned long size, mfLicensingDigest *digest )
+{
+    mfLicensingDigestContext context;
+    mfLicensingDigestInit(&context, provider);
+    mfLicensingDigestUpdate(&context, data, size);
+    mfLicensingDigestFinal(&context, digest);
+}
+
+void mfLicensingComputeDigests( const mfLicensingDigestProvider *provider, const void **messages, const unsigned long *sizes, unsigned int count, mfLicensingDigest *digests )
+{
+    if( provider->batch != 0 ) {
+        provider->batch(messages, sizes, count, digests);
+        return;
+    }
+    unsigned int message_i;
+    for( message_i = 0; message_i < count; message_i++ ) {
+        mfLicensingComputeDigest(provider, messages[message_i], sizes[message_i], &digests[message_i]);
+    }
+}
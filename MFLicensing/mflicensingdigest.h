@@ -0,0 +1,104 @@
+//
+//  mflicensingdigest.h
+//  MFLicensing
+//  https://github.com/freshcode/MFLicensing
+//
+//
+//  Digest providers, producing the 128-bit mfLicensingDigest from arbitrary data.
+//
+//  Two providers are available:
+//  - mfLicensingDigestMD5: the MD5 hash of the data, as produced by md5.c
+//  - mfLicensingDigestSHA256: the SHA-256 hash of the data, truncated to its first 128 bits
+//
+//  SHA-256 is computed with the SHA extensions on x86 processors supporting them and with the
+//  ARMv8 cryptography extension when the library is built for it (-march=armv8-a+crypto, the
+//  default on Apple Silicon); other processors use a portable implementation.  The hashes are
+//  identical in every case.
+//
+//  Keys generated from a MD5 digest only validate against a MD5 digest; changing the provider
+//  of an existing product invalidates every key already issued for it.
+//
+//  Licensing
+//  ---------
+//  Public Domain
+//  By Freshcode, Cutting edge Mac, iPhone & iPad software development. http://madefresh.ca/
+//
+
+#ifndef MFLicensing_mflicensingdigest_h
+#define MFLicensing_mflicensingdigest_h
+
+#include <stdint.h>
+#include "mflicensing.h"
+#include "md5.h"
+
+typedef struct mfLicensingDigestProvider mfLicensingDigestProvider;
+
+// Digest context, holding the state of a digest being computed
+//-------------------------------------------------------------
+// provider: the provider set by mfLicensingDigestInit
+// state: state of the provider; custom providers may use up to sizeof(state.custom) bytes
+typedef struct {
+    const mfLicensingDigestProvider *provider;
+    union {
+        MD5_CTX md5;
+        struct {
+            uint32_t hash[8];
+            uint64_t length;
+            unsigned char buffer[64];
+        } sha256;
+        unsigned char custom[256];
+    } state;
+} mfLicensingDigestContext;
+
+// Digest provider
+//----------------
+// name: name of the hash function
+// init, update, final: streaming interface, called through mfLicensingDigestInit,
+//   mfLicensingDigestUpdate and mfLicensingDigestFinal
+// batch: may be 0, otherwise hashes count messages at once, see mfLicensingComputeDigests
+struct mfLicensingDigestProvider {
+    const char *name;
+    void (*init)( mfLicensingDigestContext *context );
+    void (*update)( mfLicensingDigestContext *context, const void *data, unsigned long size );
+    void (*final)( mfLicensingDigestContext *context, mfLicensingDigest *digest );
+    void (*batch)( const void **messages, const unsigned long *sizes, unsigned int count, mfLicensingDigest *digests );
+};
+
+extern const mfLicensingDigestProvider mfLicensingDigestMD5;
+extern const mfLicensingDigestProvider mfLicensingDigestSHA256;
+
+// mfLicensingDigestInit
+//----------------------
+// Starts computing a digest with the provider specified.
+void mfLicensingDigestInit( mfLicensingDigestContext *context, const mfLicensingDigestProvider *provider );
+
+// mfLicensingDigestUpdate
+//------------------------
+// Adds size bytes of data to the digest being computed.
+void mfLicensingDigestUpdate( mfLicensingDigestContext *context, const void *data, unsigned long size );
+
+// mfLicensingDigestFinal
+//-----------------------
+// Completes the digest and stores it in digest.  The context must be initialized again with
+// mfLicensingDigestInit before being reused.
+void mfLicensingDigestFinal( mfLicensingDigestContext *context, mfLicensingDigest *digest );
+
+// mfLicensingComputeDigest
+//-------------------------
+// Computes the digest of size bytes of data in a single call.
+void mfLicensingComputeDigest( const mfLicensingDigestProvider *provider, const void *data, unsigned long size, mfLicensingDigest *digest );
+
+// mfLicensingComputeDigests
+//--------------------------
+// Computes the digests of count messages; messages[i] holds sizes[i] bytes and its digest is
+// stored in digests[i].  The results are identical to calling mfLicensingComputeDigest for every
+// message; the SHA-256 provider hashes two messages at a time to keep the SHA units busy.
+void mfLicensingComputeDigests( const mfLicensingDigestProvider *provider, const void **messages, const unsigned long *sizes, unsigned int count, mfLicensingDigest *digests );
+
+// mfLicensingSHA256KernelName
+//----------------------------
+// Returns the name of the implementation used by mfLicensingDigestSHA256: "sha-ni", "armv8" or
+// "portable".
+const char *mfLicensingSHA256KernelName( void );
+
+#endif
@@ -0,0 +1,56 @@
+//
+//  mflicensinginternal.h
+//  MFLicensing
+//  https://github.com/freshcode/MFLicensing
+//
+//
+//  Functions of mflicensing.c shared with the other modules of the library.  They are not part of
+//  the API: this header isn't installed and the functions have hidden visibility, a shared library
+//  built from these sources doesn't export them.
+//
+//  Licensing
+//  ---------
+//  Public Domain
+//  By Freshcode, Cutting edge Mac, iPhone & iPad software development. http://madefresh.ca/
+//
+
+#ifndef MFLicensing_mflicensinginternal_h
+#define MFLicensing_mflicensinginternal_h
+
+#include "mflicensing.h"
+
+#if (defined(__GNUC__) || defined(__clang__)) && !defined(_WIN32)
+#define MF_LICENSING_INTERNAL __attribute__((visibility("hidden")))
+#else
+#define MF_LICENSING_INTERNAL
+#endif
+
+#pragma mark - Key schemes
+
+// Index block and salt of MF_LICENSING_SCHEME_LRAND48, from the lrand48 sequence of the seeds
+MF_LICENSING_INTERNAL void randomize128UsingIntSeed( mfU128 *x, unsigned int seed );
+MF_LICENSING_INTERNAL void randomize256UsingSeed( mfU256 *x, unsigned short int seed[3] );
+
+// Philox-4x32-10 block of a counter, and the key, index blocks and salt of MF_LICENSING_SCHEME_PHILOX
+MF_LICENSING_INTERNAL void mfLicensingPhilox( const unsigned int key[2], const unsigned int counter[4], unsigned int output[4] );
+MF_LICENSING_INTERNAL void mfLicensingCounterKey( const mfLicensingVector *vector, unsigned int key[2] );
+MF_LICENSING_INTERNAL void mfLicensingCounterIndexBlock( const unsigned int key[2], unsigned int index, mfU128 *x );
+MF_LICENSING_INTERNAL void mfLicensingCounterSalt( const unsigned int key[2], mfU256 *x );
+
+#pragma mark - Encoding
+
+MF_LICENSING_INTERNAL void mfLicensingComputeValidator( mfLicensingContext *context, const mfU256 *salt, mfLicensingDigest *digest, unsigned int index, mfU256 *validator );
+MF_LICENSING_INTERNAL int mfLicensingEncodeLicense( mfLicensingContext *context, const mfU256 *salt, mfLicensingDigest *digest, unsigned int index, unsigned char *encoded_key );
+MF_LICENSING_INTERNAL int mfLicensingEncodeValidator( mfLicensingContext *context, unsigned int index, const mfU256 *validator, unsigned char *encoded_key );
+MF_LICENSING_INTERNAL unsigned int mfLicensingEncodingChunk( unsigned int encoding_base );
+// Number of bits encoded by key_length characters of encoding_base, 0 if unsupported (no characters,
+// a base below 2 or keys of more than 256 bits)
+MF_LICENSING_INTERNAL unsigned int mfLicensingKeyBits( unsigned int encoding_base, unsigned int key_length );
+MF_LICENSING_INTERNAL void mfLicensingExtractIndex( unsigned int *index, mfU256 *validator_bits, mfLicensingCodecParams *codec_params, unsigned char index_bits, mfU256 *binary_key );
+
+#pragma mark - Check character
+
+MF_LICENSING_INTERNAL unsigned int mfLicensingCheckDouble( unsigned int weight, unsigned int encoding_base );
+MF_LICENSING_INTERNAL int mfLicensingVerifyCheckCharacter( mfLicensingContext *context, const unsigned char *license );
+
+#endif
@@ -0,0 +1,617 @@
+//
+//  mflicensingjournal.c
+//  MFLicensing
+//  https://github.com/freshcode/MFLicensing
+//
+//  Public Domain
+//  By Freshcode, Cutting edge Mac, iPhone & iPad software development. http://madefresh.ca/
+//
+
+#include "mflicensingjournal.h"
+#include "mflicensingdigest.h"
+#include "mflicensinginternal.h"
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <fcntl.h>
+#include <sched.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+// Header, little-endian:
+//    0  magic "MFLJ"            4  version (16-bit)     6  record size (16-bit)
+//    8  size of the file known to be durable (64-bit), updated after each sync
+//   16  creation time, microseconds since 1970 (64-bit)
+//   24  key length, index bits, check character, encoding base of the vector
+//   28  fingerprint of the vector (16 bytes), see mfLicensingJournalFingerprint
+//   44  reserved, zero
+#define MF_JOURNAL_MAGIC "MFLJ"
+#define MF_JOURNAL_VERSION_OFFSET 4
+#define MF_JOURNAL_RECORD_SIZE_OFFSET 6
+#define MF_JOURNAL_COMMITTED_OFFSET 8
+#define MF_JOURNAL_CREATED_OFFSET 16
+#define MF_JOURNAL_VECTOR_OFFSET 24
+#define MF_JOURNAL_FINGERPRINT_OFFSET 28
+#define MF_JOURNAL_FINGERPRINT_SIZE 16
+
+#define MF_JOURNAL_TIMESTAMP_OFFSET 0
+#define MF_JOURNAL_DIGEST_OFFSET 8
+#define MF_JOURNAL_INDEX_OFFSET 24
+#define MF_JOURNAL_VALIDATOR_OFFSET 28
+#define MF_JOURNAL_CHECKSUM_OFFSET 60
+
+// A record of zeros, a hole left by a crash, never has a valid checksum
+#define MF_JOURNAL_CHECKSUM_SEED 0x4D464C4A
+
+#define MF_JOURNAL_DEFAULT_CAPACITY 4096
+#define MF_JOURNAL_DEFAULT_COMMIT_RECORDS 1024
+#define MF_JOURNAL_IDLE_WAIT_US 100000
+#define MF_JOURNAL_CHECK_RECORDS 256
+
+static void mfLicensingJournalStore( unsigned char *p, uint64_t value, unsigned int bytes )
+{
+    unsigned int byte_i = 0;
+    while( byte_i < bytes ) {
+        p[byte_i++] = value & 0xFF;
+        value >>= 8;
+    }
+}
+
+static uint64_t mfLicensingJournalLoad( const unsigned char *p, unsigned int bytes )
+{
+    uint64_t value = 0;
+    while( bytes-- ) {
+        value = (value << 8) | p[bytes];
+    }
+    return value;
+}
+
+// Fletcher sum of the 32-bit words of the record before the checksum, folded to 32 bits
+static uint32_t mfLicensingJournalChecksum( const unsigned char *record )
+{
+    uint32_t sum = MF_JOURNAL_CHECKSUM_SEED;
+    uint32_t sum_of_sums = 0;
+    unsigned int offset;
+    for( offset = 0; offset < MF_JOURNAL_CHECKSUM_OFFSET; offset += 4 ) {
+        sum += (uint32_t)mfLicensingJournalLoad(record + offset, 4);
+        sum_of_sums += sum;
+    }
+    return sum ^ ((sum_of_sums << 16) | (sum_of_sums >> 16));
+}
+
+static int mfLicensingJournalRecordValid( const unsigned char *record )
+{
+    return mfLicensingJournalLoad(record + MF_JOURNAL_CHECKSUM_OFFSET, 4) == mfLicensingJournalChecksum(record);
+}
+
+static uint64_t mfLicensingJournalNow( void )
+{
+    struct timespec now;
+    clock_gettime(CLOCK_REALTIME, &now);
+    return (uint64_t)now.tv_sec * 1000000 + (uint64_t)now.tv_nsec / 1000;
+}
+
+static void mfLicensingJournalVectorParams( mfLicensingContext *context, unsigned char *params )
+{
+    params[0] = context->vector->key_length;
+    params[1] = context->vector->index_bits;
+    params[2] = context->vector->check_character;
+    params[3] = (unsigned char)context->codec_params.encoding_base;
+}
+
+// Truncated SHA-256 of the scheme, seeds, encoding characters and private key of the vector: the keys
+// of two vectors with the same parameters but another fingerprint differ
+static void mfLicensingJournalFingerprint( mfLicensingContext *context, unsigned char *fingerprint )
+{
+    const mfLicensingVector *vector = context->vector;
+    mfLicensingDigestContext digest_context;
+    mfLicensingDigest digest;
+    unsigned char seeds[13];
+    unsigned int seed_i;
+
+    seeds[0] = vector->scheme == MF_LICENSING_SCHEME_PHILOX ? MF_LICENSING_SCHEME_PHILOX : MF_LICENSING_SCHEME_LRAND48;
+    for( seed_i = 0; seed_i < 3; seed_i++ ) {
+        mfLicensingJournalStore(seeds + 1 + seed_i * 2, vector->scrambling_seed[seed_i], 2);
+        mfLicensingJournalStore(seeds + 7 + seed_i * 2, vector->salt_seed[seed_i], 2);
+    }
+    mfLicensingDigestInit(&digest_context, &mfLicensingDigestSHA256);
+    mfLicensingDigestUpdate(&digest_context, seeds, sizeof(seeds));
+    mfLicensingDigestUpdate(&digest_context, vector->coded_chars, context->codec_params.encoding_base);
+    mfLicensingDigestUpdate(&digest_context, vector->private_key->data.b, 32);
+    mfLicensingDigestFinal(&digest_context, &digest);
+    memcpy(fingerprint, digest.md5hash.b, MF_JOURNAL_FINGERPRINT_SIZE);
+}
+
+static int mfLicensingJournalWriteAll( int fd, const unsigned char *data, unsigned long size, uint64_t offset )
+{
+    while( size > 0 ) {
+        ssize_t written = pwrite(fd, data, size, (off_t)offset);
+        if( written < 0 ) {
+            if( errno == EINTR ) continue;
+            return -1;
+        }
+        data += written;
+        size -= (unsigned long)written;
+        offset += (uint64_t)written;
+    }
+    return 0;
+}
+
+static int mfLicensingJournalSyncFile( int fd )
+{
+#if defined(__linux__)
+    return fdatasync(fd);
+#else
+    return fsync(fd);
+#endif
+}
+
+#pragma mark -
+#pragma mark Writer
+
+// Marks records up to sequence durable and wakes the threads waiting for them
+static void mfLicensingJournalPublish( mfLicensingJournal *journal, unsigned long long sequence, int failed )
+{
+    pthread_mutex_lock(&journal->lock);
+    if( failed ) {
+        atomic_store(&journal->failed, 1);
+    } else {
+        atomic_store(&journal->durable, sequence);
+    }
+    if( journal->waiters ) {
+        pthread_cond_broadcast(&journal->committed);
+    }
+    pthread_mutex_unlock(&journal->lock);
+}
+
+// Syncs the records written, then records the durable size in the header; the header itself is synced
+// along with the next records, a stale durable size only makes opening the journal check more records.
+static void mfLicensingJournalCommit( mfLicensingJournal *journal, unsigned long long sequence, uint64_t offset )
+{
+    unsigned char committed[8];
+    int failed = atomic_load(&journal->failed);
+
+    if( !failed && journal->options.sync ) {
+        failed = mfLicensingJournalSyncFile(journal->fd) != 0;
+        if( !failed ) {
+            mfLicensingJournalStore(committed, offset, 8);
+            failed = mfLicensingJournalWriteAll(journal->fd, committed, 8, MF_JOURNAL_COMMITTED_OFFSET) != 0;
+        }
+    }
+    mfLicensingJournalPublish(journal, sequence, failed);
+}
+
+// Copies the records appended, up to the capacity of the buffer, into buffer and frees their slots.
+// Returns the number of records copied.
+static unsigned int mfLicensingJournalCollect( mfLicensingJournal *journal, unsigned long long tail, unsigned char *buffer )
+{
+    unsigned long long capacity = journal->mask + 1;
+    unsigned int count = 0;
+
+    while( count < capacity ) {
+        mfLicensingJournalSlot *slot = &journal->slots[(tail + count) & journal->mask];
+        if( atomic_load_explicit(&slot->sequence, memory_order_acquire) != tail + count + 1 ) {
+            break;
+        }
+        memcpy(buffer + (unsigned long)count * MF_LICENSING_JOURNAL_RECORD_SIZE, slot->record, MF_LICENSING_JOURNAL_RECORD_SIZE);
+        atomic_store_explicit(&slot->sequence, tail + count + capacity, memory_order_release);
+        count++;
+    }
+    return count;
+}
+
+static void *mfLicensingJournalWriterRun( void *argument )
+{
+    mfLicensingJournal *journal = (mfLicensingJournal *)argument;
+    unsigned long long tail = journal->first;
+    uint64_t offset = MF_LICENSING_JOURNAL_HEADER_SIZE + journal->first * MF_LICENSING_JOURNAL_RECORD_SIZE;
+    unsigned long long unsynced = 0;
+    uint64_t pending_since = 0;
+    unsigned char *buffer = journal->buffer;
+
+    for(;;) {
+        unsigned int count = mfLicensingJournalCollect(journal, tail, buffer);
+
+        if( count != 0 ) {
+            // Records keep being collected after a failure, so appending threads never wait for space forever
+            if( !atomic_load(&journal->failed) &&
+                mfLicensingJournalWriteAll(journal->fd, buffer, (unsigned long)count * MF_LICENSING_JOURNAL_RECORD_SIZE, offset) != 0 ) {
+                mfLicensingJournalPublish(journal, 0, 1);
+            }
+            offset += (uint64_t)count * MF_LICENSING_JOURNAL_RECORD_SIZE;
+            tail += count;
+            if( unsynced == 0 ) {
+                pending_since = mfLicensingJournalNow();
+            }
+            unsynced += count;
+            if( !journal->options.sync || unsynced >= journal->options.commit_records ) {
+                mfLicensingJournalCommit(journal, tail, offset);
+                unsynced = 0;
+            }
+            continue;
+        }
+
+        // The buffer is empty: sync what was written once the commit delay is over
+        if( unsynced != 0 ) {
+            uint64_t waited = mfLicensingJournalNow() - pending_since;
+            if( journal->options.commit_delay_us == 0 || waited >= journal->options.commit_delay_us || atomic_load(&journal->stopping) ) {
+                mfLicensingJournalCommit(journal, tail, offset);
+                unsynced = 0;
+                continue;
+            }
+        } else if( atomic_load(&journal->stopping) && atomic_load(&journal->head) == tail ) {
+            break;
+        }
+
+        // Wait for records, or for the end of the commit delay
+        pthread_mutex_lock(&journal->lock);
+        atomic_store(&journal->writer_waiting, 1);
+        if( atomic_load(&journal->slots[tail & journal->mask].sequence) != tail + 1 && !atomic_load(&journal->stopping) ) {
+            uint64_t wait_us = MF_JOURNAL_IDLE_WAIT_US;
+            struct timespec deadline;
+            if( unsynced != 0 ) {
+                uint64_t waited = mfLicensingJournalNow() - pending_since;
+                wait_us = waited < journal->options.commit_delay_us ? journal->options.commit_delay_us - waited : 0;
+            }
+            clock_gettime(CLOCK_REALTIME, &deadline);
+            deadline.tv_sec += (time_t)(wait_us / 1000000);
+            deadline.tv_nsec += (long)(wait_us % 1000000) * 1000;
+            if( deadline.tv_nsec >= 1000000000 ) {
+                deadline.tv_sec++;
+                deadline.tv_nsec -= 1000000000;
+            }
+            pthread_cond_timedwait(&journal->appended, &journal->lock, &deadline);
+        }
+        atomic_store(&journal->writer_waiting, 0);
+        pthread_mutex_unlock(&journal->lock);
+    }
+    return 0;
+}
+
+#pragma mark -
+#pragma mark Journal
+
+void mfLicensingInitializeJournalOptions( mfLicensingJournalOptions *options )
+{
+    options->capacity = MF_JOURNAL_DEFAULT_CAPACITY;
+    options->commit_records = MF_JOURNAL_DEFAULT_COMMIT_RECORDS;
+    options->commit_delay_us = 0;
+    options->sync = 1;
+}
+
+// Checks the header and the records up to the durable size of the file, and drops the records cut short
+// or corrupted after it.  Returns the number of records kept, -1 if the file isn't a journal of the vector
+// of context or a durable record is corrupted.
+static long long mfLicensingJournalRecover( int fd, mfLicensingContext *context )
+{
+    unsigned char header[MF_LICENSING_JOURNAL_HEADER_SIZE];
+    unsigned char params[4];
+    unsigned char fingerprint[MF_JOURNAL_FINGERPRINT_SIZE];
+    unsigned char record[MF_LICENSING_JOURNAL_RECORD_SIZE];
+    unsigned char records[MF_JOURNAL_CHECK_RECORDS * MF_LICENSING_JOURNAL_RECORD_SIZE];
+    uint64_t committed, offset;
+    struct stat info;
+
+    if( fstat(fd, &info) != 0 || pread(fd, header, sizeof(header), 0) != (ssize_t)sizeof(header) ) {
+        return -1;
+    }
+    mfLicensingJournalVectorParams(context, params);
+    mfLicensingJournalFingerprint(context, fingerprint);
+    if( memcmp(header, MF_JOURNAL_MAGIC, 4) != 0 ||
+        mfLicensingJournalLoad(header + MF_JOURNAL_VERSION_OFFSET, 2) != MF_LICENSING_JOURNAL_VERSION ||
+        mfLicensingJournalLoad(header + MF_JOURNAL_RECORD_SIZE_OFFSET, 2) != MF_LICENSING_JOURNAL_RECORD_SIZE ||
+        memcmp(header + MF_JOURNAL_VECTOR_OFFSET, params, 4) != 0 ||
+        memcmp(header + MF_JOURNAL_FINGERPRINT_OFFSET, fingerprint, MF_JOURNAL_FINGERPRINT_SIZE) != 0 ) {
+        return -1;
+    }
+    committed = mfLicensingJournalLoad(header + MF_JOURNAL_COMMITTED_OFFSET, 8);
+    if( committed < MF_LICENSING_JOURNAL_HEADER_SIZE || (committed - MF_LICENSING_JOURNAL_HEADER_SIZE) % MF_LICENSING_JOURNAL_RECORD_SIZE != 0 ||
+        committed > (uint64_t)info.st_size ) {
+        return -1;
+    }
+
+    // Records known to be durable were synced intact, a corrupted one is damage to the file
+    offset = MF_LICENSING_JOURNAL_HEADER_SIZE;
+    while( offset < committed ) {
+        uint64_t size = committed - offset < sizeof(records) ? committed - offset : sizeof(records);
+        uint64_t record_offset;
+        if( pread(fd, records, (size_t)size, (off_t)offset) != (ssize_t)size ) {
+            return -1;
+        }
+        for( record_offset = 0; record_offset < size; record_offset += MF_LICENSING_JOURNAL_RECORD_SIZE ) {
+            if( !mfLicensingJournalRecordValid(records + record_offset) ) {
+                return -1;
+            }
+        }
+        offset += size;
+    }
+
+    // Records written after the last sync may be missing, partly written or written out of order
+    offset = committed;
+    while( offset + MF_LICENSING_JOURNAL_RECORD_SIZE <= (uint64_t)info.st_size ) {
+        if( pread(fd, record, sizeof(record), (off_t)offset) != (ssize_t)sizeof(record) || !mfLicensingJournalRecordValid(record) ) {
+            break;
+        }
+        offset += MF_LICENSING_JOURNAL_RECORD_SIZE;
+    }
+    if( offset != (uint64_t)info.st_size && ftruncate(fd, (off_t)offset) != 0 ) {
+        return -1;
+    }
+    return (long long)((offset - MF_LICENSING_JOURNAL_HEADER_SIZE) / MF_LICENSING_JOURNAL_RECORD_SIZE);
+}
+
+static int mfLicensingJournalCreate( int fd, mfLicensingContext *context )
+{
+    unsigned char header[MF_LICENSING_JOURNAL_HEADER_SIZE];
+
+    memset(header, 0, sizeof(header));
+    memcpy(header, MF_JOURNAL_MAGIC, 4);
+    mfLicensingJournalStore(header + MF_JOURNAL_VERSION_OFFSET, MF_LICENSING_JOURNAL_VERSION, 2);
+    mfLicensingJournalStore(header + MF_JOURNAL_RECORD_SIZE_OFFSET, MF_LICENSING_JOURNAL_RECORD_SIZE, 2);
+    mfLicensingJournalStore(header + MF_JOURNAL_COMMITTED_OFFSET, MF_LICENSING_JOURNAL_HEADER_SIZE, 8);
+    mfLicensingJournalStore(header + MF_JOURNAL_CREATED_OFFSET, mfLicensingJournalNow(), 8);
+    mfLicensingJournalVectorParams(context, header + MF_JOURNAL_VECTOR_OFFSET);
+    mfLicensingJournalFingerprint(context, header + MF_JOURNAL_FINGERPRINT_OFFSET);
+    if( mfLicensingJournalWriteAll(fd, header, sizeof(header), 0) != 0 ) {
+        return -1;
+    }
+    return fsync(fd);
+}
+
+int mfLicensingOpenJournal( mfLicensingJournal *journal, const char *path, mfLicensingContext *context, const mfLicensingJournalOptions *options )
+{
+    unsigned long long capacity = 2;
+    unsigned long long slot_i;
+    long long records;
+    struct stat info;
+
+    memset(journal, 0, sizeof(mfLicensingJournal));
+    journal->fd = -1;
+    if( context->vector == 0 ) {
+        return -1;
+    }
+    journal->context = context;
+    if( options ) {
+        journal->options = *options;
+    } else {
+        mfLicensingInitializeJournalOptions(&journal->options);
+    }
+    while( capacity < journal->options.capacity && capacity < 0x80000000ULL ) {
+        capacity <<= 1;
+    }
+    journal->mask = capacity - 1;
+    if( journal->options.commit_records == 0 ) {
+        journal->options.commit_records = 1;
+    }
+
+    journal->fd = open(path, O_RDWR | O_CREAT, 0600);
+    if( journal->fd < 0 ) {
+        return -1;
+    }
+    if( fstat(journal->fd, &info) != 0 || (info.st_size == 0 && mfLicensingJournalCreate(journal->fd, context) != 0) ) {
+        close(journal->fd);
+        return -1;
+    }
+    records = mfLicensingJournalRecover(journal->fd, context);
+    if( records < 0 ) {
+        close(journal->fd);
+        return -1;
+    }
+    journal->first = (unsigned long long)records;
+
+    journal->slots = malloc(capacity * sizeof(mfLicensingJournalSlot));
+    journal->buffer = malloc(capacity * MF_LICENSING_JOURNAL_RECORD_SIZE);
+    if( journal->slots == 0 || journal->buffer == 0 ) {
+        free(journal->slots);
+        free(journal->buffer);
+        close(journal->fd);
+        return -1;
+    }
+    // Slot i is first ready to receive record first + i
+    for( slot_i = 0; slot_i < capacity; slot_i++ ) {
+        unsigned long long sequence = journal->first + slot_i;
+        atomic_init(&journal->slots[sequence & journal->mask].sequence, sequence);
+    }
+    atomic_init(&journal->head, journal->first);
+    atomic_init(&journal->durable, journal->first);
+    atomic_init(&journal->failed, 0);
+    atomic_init(&journal->writer_waiting, 0);
+    atomic_init(&journal->stopping, 0);
+    pthread_mutex_init(&journal->lock, 0);
+    pthread_cond_init(&journal->appended, 0);
+    pthread_cond_init(&journal->committed, 0);
+    if( pthread_create(&journal->writer, 0, mfLicensingJournalWriterRun, journal) != 0 ) {
+        pthread_cond_destroy(&journal->committed);
+        pthread_cond_destroy(&journal->appended);
+        pthread_mutex_destroy(&journal->lock);
+        free(journal->slots);
+        free(journal->buffer);
+        close(journal->fd);
+        return -1;
+    }
+    return 0;
+}
+
+int mfLicensingCloseJournal( mfLicensingJournal *journal )
+{
+    int failed;
+
+    pthread_mutex_lock(&journal->lock);
+    atomic_store(&journal->stopping, 1);
+    pthread_cond_signal(&journal->appended);
+    pthread_mutex_unlock(&journal->lock);
+    pthread_join(journal->writer, 0);
+
+    // The durable size written by the last commit is synced as well
+    failed = atomic_load(&journal->failed);
+    if( journal->options.sync && !failed && fsync(journal->fd) != 0 ) {
+        failed = 1;
+    }
+    if( close(journal->fd) != 0 ) {
+        failed = 1;
+    }
+    pthread_cond_destroy(&journal->committed);
+    pthread_cond_destroy(&journal->appended);
+    pthread_mutex_destroy(&journal->lock);
+    free(journal->slots);
+    free(journal->buffer);
+    journal->slots = 0;
+    journal->buffer = 0;
+    journal->fd = -1;
+    return failed ? -1 : 0;
+}
+
+long long mfLicensingJournalAppend( mfLicensingJournal *journal, const mfLicensingDigest *digest, unsigned int index, const unsigned char *license )
+{
+    unsigned char record[MF_LICENSING_JOURNAL_RECORD_SIZE];
+    mfLicensingJournalSlot *slot;
+    unsigned long long sequence;
+    unsigned char rebuilt[255 + 2]; // key_length, check character and null terminator
+    unsigned int decoded_index;
+    mfU256 validator_bits;
+
+    if( atomic_load_explicit(&journal->failed, memory_order_relaxed) ) {
+        return -1;
+    }
+    // The key is stored as its validator bits, rebuilt from them and the index when read: only record
+    // it if that gives license back
+    if( mfLicensingDecodeLicense(journal->context, license, &decoded_index, &validator_bits) == 0 || decoded_index != index ||
+        mfLicensingEncodeValidator(journal->context, index, &validator_bits, rebuilt) == 0 ||
+        memcmp(rebuilt, license, journal->context->vector->key_length + journal->context->vector->check_character) != 0 ) {
+        return -1;
+    }
+    mfLicensingJournalStore(record + MF_JOURNAL_TIMESTAMP_OFFSET, mfLicensingJournalNow(), 8);
+    memcpy(record + MF_JOURNAL_DIGEST_OFFSET, digest->md5hash.b, 16);
+    mfLicensingJournalStore(record + MF_JOURNAL_INDEX_OFFSET, index, 4);
+    memcpy(record + MF_JOURNAL_VALIDATOR_OFFSET, validator_bits.b, 32);
+    mfLicensingJournalStore(record + MF_JOURNAL_CHECKSUM_OFFSET, mfLicensingJournalChecksum(record), 4);
+
+    // Claim a sequence number, then wait for its slot to be free should the buffer be full
+    sequence = atomic_fetch_add(&journal->head, 1);
+    slot = &journal->slots[sequence & journal->mask];
+    while( atomic_load_explicit(&slot->sequence, memory_order_acquire) != sequence ) {
+        sched_yield();
+    }
+    memcpy(slot->record, record, MF_LICENSING_JOURNAL_RECORD_SIZE);
+    atomic_store(&slot->sequence, sequence + 1);
+
+    // The writer sets writer_waiting before checking for records one last time, so either it sees this
+    // record or the signal below wakes it
+    if( atomic_load(&journal->writer_waiting) ) {
+        pthread_mutex_lock(&journal->lock);
+        pthread_cond_signal(&journal->appended);
+        pthread_mutex_unlock(&journal->lock);
+    }
+    return (long long)sequence;
+}
+
+int mfLicensingJournalWait( mfLicensingJournal *journal, long long sequence )
+{
+    int durable;
+
+    if( sequence < 0 ) {
+        return -1;
+    }
+    if( atomic_load(&journal->durable) > (unsigned long long)sequence ) {
+        return 0;
+    }
+    pthread_mutex_lock(&journal->lock);
+    journal->waiters++;
+    while( atomic_load(&journal->durable) <= (unsigned long long)sequence && !atomic_load(&journal->failed) ) {
+        pthread_cond_wait(&journal->committed, &journal->lock);
+    }
+    journal->waiters--;
+    durable = atomic_load(&journal->durable) > (unsigned long long)sequence;
+    pthread_mutex_unlock(&journal->lock);
+    return durable ? 0 : -1;
+}
+
+int mfLicensingJournalIssueLicense( mfLicensingJournal *journal, mfLicensingDigest *digest, unsigned int index, unsigned char *license, unsigned int size )
+{
+    if( mfLicensingGenerateLicenseToBuffer(journal->context, digest, index, license, size) != 0 ) {
+        return -1;
+    }
+    return mfLicensingJournalWait(journal, mfLicensingJournalAppend(journal, digest, index, license));
+}
+
+#pragma mark -
+#pragma mark Reader
+
+int mfLicensingOpenJournalReader( mfLicensingJournalReader *reader, const char *path )
+{
+    struct stat info;
+    void *map;
+    int fd;
+
+    memset(reader, 0, sizeof(mfLicensingJournalReader));
+    fd = open(path, O_RDONLY);
+    if( fd < 0 ) {
+        return -1;
+    }
+    if( fstat(fd, &info) != 0 || info.st_size < MF_LICENSING_JOURNAL_HEADER_SIZE || (uint64_t)info.st_size != (unsigned long)info.st_size ) {
+        close(fd);
+        return -1;
+    }
+    map = mmap(0, (size_t)info.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    close(fd);
+    if( map == MAP_FAILED ) {
+        return -1;
+    }
+    reader->map = (const unsigned char *)map;
+    reader->size = (unsigned long)info.st_size;
+    if( memcmp(reader->map, MF_JOURNAL_MAGIC, 4) != 0 ||
+        mfLicensingJournalLoad(reader->map + MF_JOURNAL_VERSION_OFFSET, 2) != MF_LICENSING_JOURNAL_VERSION ||
+        mfLicensingJournalLoad(reader->map + MF_JOURNAL_RECORD_SIZE_OFFSET, 2) != MF_LICENSING_JOURNAL_RECORD_SIZE ) {
+        mfLicensingCloseJournalReader(reader);
+        return -1;
+    }
+#if defined(MADV_SEQUENTIAL)
+    madvise(map, reader->size, MADV_SEQUENTIAL);
+#endif
+    reader->offset = MF_LICENSING_JOURNAL_HEADER_SIZE;
+    reader->key_length = reader->map[MF_JOURNAL_VECTOR_OFFSET];
+    reader->index_bits = reader->map[MF_JOURNAL_VECTOR_OFFSET + 1];
+    reader->check_character = reader->map[MF_JOURNAL_VECTOR_OFFSET + 2];
+    reader->encoding_base = reader->map[MF_JOURNAL_VECTOR_OFFSET + 3];
+    return 0;
+}
+
+int mfLicensingJournalReaderNext( mfLicensingJournalReader *reader, mfLicensingJournalEntry *entry )
+{
+    const unsigned char *record = reader->map + reader->offset;
+
+    if( reader->offset + MF_LICENSING_JOURNAL_RECORD_SIZE > reader->size ) {
+        return 0;
+    }
+    if( !mfLicensingJournalRecordValid(record) ) {
+        // Past the durable size, the record was being written when the writer stopped
+        return reader->offset < mfLicensingJournalLoad(reader->map + MF_JOURNAL_COMMITTED_OFFSET, 8) ? -1 : 0;
+    }
+    entry->sequence = reader->sequence;
+    entry->timestamp = mfLicensingJournalLoad(record + MF_JOURNAL_TIMESTAMP_OFFSET, 8);
+    memcpy(entry->digest.md5hash.b, record + MF_JOURNAL_DIGEST_OFFSET, 16);
+    entry->index = (unsigned int)mfLicensingJournalLoad(record + MF_JOURNAL_INDEX_OFFSET, 4);
+    memcpy(entry->validator_bits.b, record + MF_JOURNAL_VALIDATOR_OFFSET, 32);
+    reader->offset += MF_LICENSING_JOURNAL_RECORD_SIZE;
+    reader->sequence++;
+    return 1;
+}
+
+void mfLicensingCloseJournalReader( mfLicensingJournalReader *reader )
+{
+    if( reader->map != 0 ) {
+        munmap((void *)reader->map, reader->size);
+    }
+    reader->map = 0;
+}
+
+int mfLicensingJournalEntryLicense( mfLicensingContext *context, const mfLicensingJournalEntry *entry, unsigned char *license, unsigned int size )
+{
+    if( context->vector == 0 || size < (unsigned int)context->vector->key_length + context->vector->check_character + 1 ) {
+        return -1;
+    }
+    return mfLicensingEncodeValidator(context, entry->index, &entry->validator_bits, license) == 1 ? 0 : -1;
+}
@@ -0,0 +1,208 @@
+//
+//  mflicensingjournal.h
+//  MFLicensing
+//  https://github.com/freshcode/MFLicensing
+//
+//
+//  Append-only journal of the license keys issued.
+//
+//  Every key issued is recorded (digest, index, key, timestamp) before being handed out, and must
+//  survive a crash once handed out.  Syncing the file for each key would limit issuance to one key
+//  per disk flush; the journal instead lets any number of threads append records to a shared
+//  buffer without locking, while a writer thread writes whatever was appended in one write and
+//  syncs the file once for all of it (group commit).  A thread waiting for its record to be
+//  durable is woken by the sync covering it: the more threads issue keys, the more records each
+//  sync covers.
+//
+//  Records have a fixed size of MF_LICENSING_JOURNAL_RECORD_SIZE bytes, little-endian:
+//    0  timestamp, microseconds since 1970 (64-bit)
+//    8  digest (16 bytes)
+//   24  index (32-bit)
+//   28  validator bits of the key (32 bytes), the key being rebuilt from them and its index
+//   60  checksum of bytes 0 to 59 (32-bit)
+//  following a 64 byte header naming the key length, index bits, check character and encoding
+//  base of the vector, and holding a fingerprint of its scheme, seeds, encoding characters and
+//  private key.  Records cut short or corrupted at the end of the file, by a crash while they were
+//  being written, are dropped when the journal is opened again.
+//
+//  mfLicensingJournalReader reads the records sequentially from a mapping of the file, for replay
+//  and audit; mfLicensingJournalEntryLicense rebuilds the key of a record.
+//
+//  Licensing
+//  ---------
+//  Public Domain
+//  By Freshcode, Cutting edge Mac, iPhone & iPad software development. http://madefresh.ca/
+//
+
+#ifndef MFLicensing_mflicensingjournal_h
+#define MFLicensing_mflicensingjournal_h
+
+#include "mflicensing.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define MF_LICENSING_JOURNAL_VERSION 1
+#define MF_LICENSING_JOURNAL_HEADER_SIZE 64
+#define MF_LICENSING_JOURNAL_RECORD_SIZE 64
+
+// Journal Options structure
+//--------------------------
+// capacity: number of records the append buffer holds, rounded up to a power of 2 (default 4096);
+//   appending waits for the writer when it is full
+// commit_records: the file is synced once this many records were written since the last sync
+//   (default 1024)
+// commit_delay_us: once the buffer is empty, time to wait for more records before syncing
+//   (default 0, sync as soon as the buffer is empty); a longer delay makes fewer, larger syncs
+// sync: 0 to only write the records to the file, leaving them to the operating system, they are
+//   then considered durable once written (default 1)
+typedef struct {
+    unsigned int capacity;
+    unsigned int commit_records;
+    unsigned int commit_delay_us;
+    int sync;
+} mfLicensingJournalOptions;
+
+// Journal Slot structure, a record of the append buffer
+//------------------------------------------------------
+// sequence: sequence number of the record the slot is ready to receive, plus one once the record
+//   is written into it
+typedef struct {
+    atomic_ullong sequence;
+    unsigned char record[MF_LICENSING_JOURNAL_RECORD_SIZE];
+} mfLicensingJournalSlot;
+
+// Journal structure
+//------------------
+// context: licensing context of the vector whose keys are recorded
+// slots, mask: append buffer of mask + 1 slots
+// buffer: records collected by the writer thread, written at once
+// head: sequence number of the next record appended
+// durable: number of records durable, every record whose sequence number is below it
+// first: sequence number of the first record appended by this journal, number of records already
+//   in the file when it was opened
+typedef struct {
+    mfLicensingContext *context;
+    mfLicensingJournalOptions options;
+    int fd;
+    mfLicensingJournalSlot *slots;
+    unsigned long long mask;
+    unsigned char *buffer;
+    atomic_ullong head;
+    atomic_ullong durable;
+    atomic_int failed;
+    atomic_int writer_waiting;
+    atomic_int stopping;
+    unsigned long long first;
+    unsigned int waiters;
+    pthread_mutex_t lock;
+    pthread_cond_t appended;
+    pthread_cond_t committed;
+    pthread_t writer;
+} mfLicensingJournal;
+
+// Journal Entry structure, a record read back
+//--------------------------------------------
+// sequence: position of the record in the journal, 0 for the first one
+// timestamp: microseconds since 1970
+// validator_bits: validator bits of the key, as returned by mfLicensingDecodeLicense
+typedef struct {
+    unsigned long long sequence;
+    unsigned long long timestamp;
+    mfLicensingDigest digest;
+    unsigned int index;
+    mfU256 validator_bits;
+} mfLicensingJournalEntry;
+
+// Journal Reader structure
+//-------------------------
+// map, size: read-only mapping of the file
+// offset: offset of the next record
+// key_length, index_bits, check_character, encoding_base: parameters of the vector, from the header
+typedef struct {
+    const unsigned char *map;
+    unsigned long size;
+    unsigned long offset;
+    unsigned long long sequence;
+    unsigned char key_length;
+    unsigned char index_bits;
+    unsigned char check_character;
+    unsigned char encoding_base;
+} mfLicensingJournalReader;
+
+// mfLicensingInitializeJournalOptions
+//------------------------------------
+// Sets the default values of the options.
+void mfLicensingInitializeJournalOptions( mfLicensingJournalOptions *options );
+
+// mfLicensingOpenJournal
+//-----------------------
+// Opens the journal at path for appending the keys of context, creating it if it doesn't exist, and
+// starts its writer thread.  options may be 0 for the defaults.  The records up to the size last
+// synced are checked; records cut short or corrupted after it are truncated.
+//
+// The context must remain valid until the journal is closed.
+//
+// Returns 0 on success, -1 if the file can't be opened, was created for another vector (key length,
+// index bits, check character, encoding base, or the fingerprint of its scheme, seeds, encoding
+// characters and private key) or a record synced before is corrupted.
+int mfLicensingOpenJournal( mfLicensingJournal *journal, const char *path, mfLicensingContext *context, const mfLicensingJournalOptions *options );
+
+// mfLicensingCloseJournal
+//------------------------
+// Writes and syncs the records appended, stops the writer thread and closes the file.
+//
+// Returns 0 on success, -1 if records couldn't be written.
+int mfLicensingCloseJournal( mfLicensingJournal *journal );
+
+// mfLicensingJournalAppend
+//-------------------------
+// Appends the record of license, generated for digest and index, without waiting for it to be
+// written.  May be called from any number of threads at once.
+//
+// Returns the sequence number of the record, -1 if license isn't a key of index for the vector or the
+// journal failed.
+long long mfLicensingJournalAppend( mfLicensingJournal *journal, const mfLicensingDigest *digest, unsigned int index, const unsigned char *license );
+
+// mfLicensingJournalWait
+//-----------------------
+// Waits until the record of the sequence number specified and all the ones before it are durable.
+//
+// Returns 0 once durable, -1 if the journal failed to write or sync them.
+int mfLicensingJournalWait( mfLicensingJournal *journal, long long sequence );
+
+// mfLicensingJournalIssueLicense
+//-------------------------------
+// Generates the key of digest and index into license, as mfLicensingGenerateLicenseToBuffer does, and
+// returns once its record is durable.
+//
+// Returns 0 on success, -1 if the key couldn't be generated or recorded.
+int mfLicensingJournalIssueLicense( mfLicensingJournal *journal, mfLicensingDigest *digest, unsigned int index, unsigned char *license, unsigned int size );
+
+// mfLicensingOpenJournalReader
+//-----------------------------
+// Maps the journal at path for reading.  Records appended afterwards aren't seen.
+//
+// Returns 0 on success, -1 if the file can't be mapped or isn't a journal.
+int mfLicensingOpenJournalReader( mfLicensingJournalReader *reader, const char *path );
+
+// mfLicensingJournalReaderNext
+//-----------------------------
+// Reads the next record into entry.
+//
+// Returns 1 if a record was read, 0 at the end of the journal (a record cut short at the end included),
+// -1 if the record is corrupted.
+int mfLicensingJournalReaderNext( mfLicensingJournalReader *reader, mfLicensingJournalEntry *entry );
+
+// mfLicensingCloseJournalReader
+//------------------------------
+void mfLicensingCloseJournalReader( mfLicensingJournalReader *reader );
+
+// mfLicensingJournalEntryLicense
+//-------------------------------
+// Rebuilds the key of entry into license, size being the number of bytes available (key_length + 1,
+// + 1 more for a check character).  The context must be the one of the vector the journal was written for.
+//
+// Returns 0 on success, -1 if the buffer is too small or the entry doesn't match the vector.
+int mfLicensingJournalEntryLicense( mfLicensingContext *context, const mfLicensingJournalEntry *entry, unsigned char *license, unsigned int size );
+
+#endif
@@ -0,0 +1,442 @@
+//
+//  mflicensingpipeline.c
+//  MFLicensing
+//  https://github.com/freshcode/MFLicensing
+//
+//  Public Domain
+//  By Freshcode, Cutting edge Mac, iPhone & iPad software development. http://madefresh.ca/
+//
+
+#include "mflicensingpipeline.h"
+#include <stdlib.h>
+#include <sched.h>
+
+// Number of times a thread yields the processor waiting for its queue before sleeping
+#define MF_PIPELINE_SPINS 64
+#define MF_PIPELINE_DEFAULT_BATCH 64
+
+// Arguments of a stage thread, freed by the thread
+typedef struct {
+    mfLicensingStage *stage;
+    mfLicensingPipelineQueue *input;
+    mfLicensingPipelineQueue *output;
+} mfLicensingStageThread;
+
+#pragma mark - Queues
+
+static int mfLicensingInitializeQueue( mfLicensingPipelineQueue *queue, unsigned int capacity, unsigned int producers, unsigned int consumers )
+{
+    unsigned long long size = 2;
+    while( size < capacity ) {
+        size <<= 1;
+    }
+    queue->cells = malloc(size * sizeof(void *));
+    queue->sequences = 0;
+    if( queue->cells == 0 ) {
+        return -1;
+    }
+    if( producers > 1 || consumers > 1 ) {
+        queue->sequences = malloc(size * sizeof(atomic_ullong));
+        if( queue->sequences == 0 ) {
+            free(queue->cells);
+            return -1;
+        }
+        unsigned long long cell_i = size;
+        while( cell_i-- ) {
+            atomic_init(&queue->sequences[cell_i], cell_i);
+        }
+    }
+    queue->mask = size - 1;
+    atomic_init(&queue->head, 0);
+    atomic_init(&queue->tail, 0);
+    atomic_init(&queue->producers, producers);
+    atomic_init(&queue->waiting, 0);
+    pthread_mutex_init(&queue->lock, 0);
+    pthread_cond_init(&queue->changed, 0);
+    return 0;
+}
+
+static void mfLicensingReleaseQueue( mfLicensingPipelineQueue *queue )
+{
+    pthread_cond_destroy(&queue->changed);
+    pthread_mutex_destroy(&queue->lock);
+    free(queue->sequences);
+    free(queue->cells);
+}
+
+// Adds up to count items without waiting, returns the number of items added
+static unsigned int mfLicensingQueueTryPush( mfLicensingPipelineQueue *queue, void **items, unsigned int count )
+{
+    unsigned long long position;
+    unsigned int added = 0;
+
+    if( queue->sequences == 0 ) {
+        // Single producer: the tail only moves here, the head only moves forward
+        position = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+        unsigned long long available = queue->mask + 1 - (position - atomic_load_explicit(&queue->head, memory_order_acquire));
+        while( added < count && added < available ) {
+            queue->cells[(position + added) & queue->mask] = items[added];
+            added++;
+        }
+        atomic_store_explicit(&queue->tail, position + added, memory_order_release);
+        return added;
+    }
+
+    // Claim the run of free cells at the tail, each one free once its sequence reaches its position
+    position = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+    while( 1 ) {
+        added = 0;
+        while( added < count &&
+               atomic_load_explicit(&queue->sequences[(position + added) & queue->mask], memory_order_acquire) == position + added ) {
+            added++;
+        }
+        if( added == 0 ) {
+            long long lag = (long long)(atomic_load_explicit(&queue->sequences[position & queue->mask], memory_order_acquire) - position);
+            if( lag < 0 ) {
+                // the cell still holds the item added a lap ago, the queue is full
+                return 0;
+            }
+            position = atomic_load_explicit(&queue->tail, memory_order_relaxed);
+            continue;
+        }
+        if( atomic_compare_exchange_weak_explicit(&queue->tail, &position, position + added, memory_order_relaxed, memory_order_relaxed) ) {
+            break;
+        }
+    }
+    unsigned int item_i = 0;
+    while( item_i < added ) {
+        queue->cells[(position + item_i) & queue->mask] = items[item_i];
+        atomic_store_explicit(&queue->sequences[(position + item_i) & queue->mask], position + item_i + 1, memory_order_release);
+        item_i++;
+    }
+    return added;
+}
+
+// Takes up to count items without waiting, returns the number of items taken
+static unsigned int mfLicensingQueueTryPop( mfLicensingPipelineQueue *queue, void **items, unsigned int count )
+{
+    unsigned long long position;
+    unsigned int taken = 0;
+
+    if( queue->sequences == 0 ) {
+        position = atomic_load_explicit(&queue->head, memory_order_relaxed);
+        unsigned long long available = atomic_load_explicit(&queue->tail, memory_order_acquire) - position;
+        while( taken < count && taken < available ) {
+            items[taken] = queue->cells[(position + taken) & queue->mask];
+            taken++;
+        }
+        atomic_store_explicit(&queue->head, position + taken, memory_order_release);
+        return taken;
+    }
+
+    // Claim the run of filled cells at the head, each one filled once its sequence reaches its position + 1
+    position = atomic_load_explicit(&queue->head, memory_order_relaxed);
+    while( 1 ) {
+        taken = 0;
+        while( taken < count &&
+               atomic_load_explicit(&queue->sequences[(position + taken) & queue->mask], memory_order_acquire) == position + taken + 1 ) {
+            taken++;
+        }
+        if( taken == 0 ) {
+            long long lag = (long long)(atomic_load_explicit(&queue->sequences[position & queue->mask], memory_order_acquire) - (position + 1));
+            if( lag < 0 ) {
+                // the cell wasn't filled yet, the queue is empty
+                return 0;
+            }
+            position = atomic_load_explicit(&queue->head, memory_order_relaxed);
+            continue;
+        }
+        if( atomic_compare_exchange_weak_explicit(&queue->head, &position, position + taken, memory_order_relaxed, memory_order_relaxed) ) {
+            break;
+        }
+    }
+    unsigned int item_i = 0;
+    while( item_i < taken ) {
+        items[item_i] = queue->cells[(position + item_i) & queue->mask];
+        atomic_store_explicit(&queue->sequences[(position + item_i) & queue->mask], position + item_i + queue->mask + 1, memory_order_release);
+        item_i++;
+    }
+    return taken;
+}
+
+// Wakes the threads sleeping on the queue, if any.  The fence orders the items added or taken before
+// the check, a thread going to sleep checking the queue again after announcing itself.
+static void mfLicensingQueueWake( mfLicensingPipelineQueue *queue )
+{
+    atomic_thread_fence(memory_order_seq_cst);
+    if( atomic_load_explicit(&queue->waiting, memory_order_relaxed) != 0 ) {
+        pthread_mutex_lock(&queue->lock);
+        pthread_cond_broadcast(&queue->changed);
+        pthread_mutex_unlock(&queue->lock);
+    }
+}
+
+// Adds count items, waiting while the queue is full
+static void mfLicensingQueuePush( mfLicensingPipelineQueue *queue, void **items, unsigned int count )
+{
+    unsigned int spins = 0;
+    while( count ) {
+        unsigned int added = mfLicensingQueueTryPush(queue, items, count);
+        if( added == 0 ) {
+            if( spins++ < MF_PIPELINE_SPINS ) {
+                sched_yield();
+                continue;
+            }
+            pthread_mutex_lock(&queue->lock);
+            atomic_fetch_add(&queue->waiting, 1);
+            atomic_thread_fence(memory_order_seq_cst);
+            added = mfLicensingQueueTryPush(queue, items, count);
+            if( added == 0 ) {
+                pthread_cond_wait(&queue->changed, &queue->lock);
+            }
+            atomic_fetch_sub(&queue->waiting, 1);
+            pthread_mutex_unlock(&queue->lock);
+            if( added == 0 ) continue;
+        }
+        spins = 0;
+        items += added;
+        count -= added;
+        mfLicensingQueueWake(queue);
+    }
+}
+
+// Takes up to count items, waiting while the queue is empty.  Returns 0 once the queue is empty and closed.
+static unsigned int mfLicensingQueuePop( mfLicensingPipelineQueue *queue, void **items, unsigned int count )
+{
+    unsigned int spins = 0;
+    while( 1 ) {
+        unsigned int taken = mfLicensingQueueTryPop(queue, items, count);
+        if( taken == 0 ) {
+            if( atomic_load(&queue->producers) == 0 ) {
+                // every item was added before the queue was closed
+                return mfLicensingQueueTryPop(queue, items, count);
+            }
+            if( spins++ < MF_PIPELINE_SPINS ) {
+                sched_yield();
+                continue;
+            }
+            pthread_mutex_lock(&queue->lock);
+            atomic_fetch_add(&queue->waiting, 1);
+            atomic_thread_fence(memory_order_seq_cst);
+            taken = mfLicensingQueueTryPop(queue, items, count);
+            if( taken == 0 && atomic_load(&queue->producers) != 0 ) {
+                pthread_cond_wait(&queue->changed, &queue->lock);
+            }
+            atomic_fetch_sub(&queue->waiting, 1);
+            pthread_mutex_unlock(&queue->lock);
+            if( taken == 0 ) continue;
+        }
+        mfLicensingQueueWake(queue);
+        return taken;
+    }
+}
+
+// Removes count producers from the queue, returns 1 if it closed the queue
+static int mfLicensingQueueRemoveProducers( mfLicensingPipelineQueue *queue, unsigned int count )
+{
+    if( count == 0 || atomic_fetch_sub(&queue->producers, count) != count ) {
+        return 0;
+    }
+    pthread_mutex_lock(&queue->lock);
+    pthread_cond_broadcast(&queue->changed);
+    pthread_mutex_unlock(&queue->lock);
+    return 1;
+}
+
+#pragma mark - Pipelines
+
+static void *mfLicensingStageThreadMain( void *argument )
+{
+    mfLicensingStageThread thread = *(mfLicensingStageThread *)argument;
+    void *items[MF_LICENSING_PIPELINE_MAX_BATCH];
+    unsigned int count;
+    free(argument);
+
+    while( (count = mfLicensingQueuePop(thread.input, items, thread.stage->batch)) != 0 ) {
+        thread.stage->function(thread.stage->context, items, count);
+        if( thread.output != 0 ) {
+            mfLicensingQueuePush(thread.output, items, count);
+        }
+    }
+    if( thread.output != 0 ) {
+        mfLicensingQueueRemoveProducers(thread.output, 1);
+    }
+    return 0;
+}
+
+static void mfLicensingReleasePipeline( mfLicensingPipeline *pipeline, unsigned int queue_count )
+{
+    while( queue_count-- ) {
+        mfLicensingReleaseQueue(&pipeline->queues[queue_count]);
+    }
+    free(pipeline->queues);
+    free(pipeline->threads);
+    free(pipeline->stages);
+}
+
+void mfLicensingInitializePipelineOptions( mfLicensingPipelineOptions *options )
+{
+    options->capacity = 1024;
+    options->submitters = 1;
+}
+
+int mfLicensingOpenPipeline( mfLicensingPipeline *pipeline, const mfLicensingStage *stages, unsigned int stage_count, const mfLicensingPipelineOptions *options )
+{
+    mfLicensingPipelineOptions defaults;
+    if( options == 0 ) {
+        mfLicensingInitializePipelineOptions(&defaults);
+        options = &defaults;
+    }
+    if( stage_count == 0 ) {
+        return -1;
+    }
+
+    pipeline->stage_count = stage_count;
+    pipeline->thread_count = 0;
+    pipeline->stages = malloc(stage_count * sizeof(mfLicensingStage));
+    pipeline->queues = malloc(stage_count * sizeof(mfLicensingPipelineQueue));
+    pipeline->threads = 0;
+    if( pipeline->stages == 0 || pipeline->queues == 0 ) {
+        mfLicensingReleasePipeline(pipeline, 0);
+        return -1;
+    }
+
+    unsigned int thread_count = 0;
+    unsigned int stage_i = 0;
+    while( stage_i < stage_count ) {
+        mfLicensingStage *stage = &pipeline->stages[stage_i];
+        *stage = stages[stage_i];
+        if( stage->threads == 0 ) stage->threads = 1;
+        if( stage->batch == 0 ) stage->batch = MF_PIPELINE_DEFAULT_BATCH;
+        if( stage->batch > MF_LICENSING_PIPELINE_MAX_BATCH ) stage->batch = MF_LICENSING_PIPELINE_MAX_BATCH;
+        thread_count += stage->threads;
+
+        // Queue i is filled by the submitters or the threads of stage i - 1, and emptied by the threads of stage i
+        unsigned int producers = stage_i == 0 ? (options->submitters ? options->submitters : 1) : pipeline->stages[stage_i - 1].threads;
+        if( mfLicensingInitializeQueue(&pipeline->queues[stage_i], options->capacity, producers, stage->threads) != 0 ) {
+            mfLicensingReleasePipeline(pipeline, stage_i);
+            return -1;
+        }
+        stage_i++;
+    }
+    pipeline->threads = malloc(thread_count * sizeof(pthread_t));
+    if( pipeline->threads == 0 ) {
+        mfLicensingReleasePipeline(pipeline, stage_count);
+        return -1;
+    }
+
+    // Start the threads; if one can't be, the producers that will never run are removed from their
+    // queue and the pipeline is closed, the threads started finishing with the pipeline
+    for( stage_i = 0; stage_i < stage_count; stage_i++ ) {
+        mfLicensingStage *stage = &pipeline->stages[stage_i];
+        unsigned int started = 0;
+        while( started < stage->threads ) {
+            mfLicensingStageThread *thread = malloc(sizeof(mfLicensingStageThread));
+            if( thread == 0 ) break;
+            thread->stage = stage;
+            thread->input = &pipeline->queues[stage_i];
+            thread->output = stage_i + 1 < stage_count ? &pipeline->queues[stage_i + 1] : 0;
+            if( pthread_create(&pipeline->threads[pipeline->thread_count], 0, mfLicensingStageThreadMain, thread) != 0 ) {
+                free(thread);
+                break;
+            }
+            pipeline->thread_count++;
+            started++;
+        }
+        if( started < stage->threads ) {
+            while( stage_i < stage_count ) {
+                if( stage_i + 1 < stage_count ) {
+                    mfLicensingQueueRemoveProducers(&pipeline->queues[stage_i + 1], pipeline->stages[stage_i].threads - started);
+                }
+                started = 0;
+                stage_i++;
+            }
+            mfLicensingQueueRemoveProducers(&pipeline->queues[0], atomic_load(&pipeline->queues[0].producers));
+            while( pipeline->thread_count-- ) {
+                pthread_join(pipeline->threads[pipeline->thread_count], 0);
+            }
+            mfLicensingReleasePipeline(pipeline, stage_count);
+            return -1;
+        }
+    }
+    return 0;
+}
+
+void mfLicensingPipelineSubmit( mfLicensingPipeline *pipeline, void **items, unsigned int count )
+{
+    mfLicensingQueuePush(&pipeline->queues[0], items, count);
+}
+
+void mfLicensingFinishPipeline( mfLicensingPipeline *pipeline )
+{
+    if( mfLicensingQueueRemoveProducers(&pipeline->queues[0], 1) == 0 ) {
+        // other submitters are still adding items
+        return;
+    }
+    unsigned int thread_i = pipeline->thread_count;
+    while( thread_i-- ) {
+        pthread_join(pipeline->threads[thread_i], 0);
+    }
+    mfLicensingReleasePipeline(pipeline, pipeline->stage_count);
+}
+
+#pragma mark - Licensing stages
+
+void mfLicensingDigestStage( void *context, void **items, unsigned int count )
+{
+    const mfLicensingDigestProvider *provider = (const mfLicensingDigestProvider *)context;
+    const void *messages[MF_LICENSING_PIPELINE_MAX_BATCH];
+    unsigned long sizes[MF_LICENSING_PIPELINE_MAX_BATCH];
+    mfLicensingDigest digests[MF_LICENSING_PIPELINE_MAX_BATCH];
+    mfLicensingIssuance *hashed[MF_LICENSING_PIPELINE_MAX_BATCH];
+    unsigned int hashed_count = 0;
+    unsigned int item_i = 0;
+
+    while( item_i < count && item_i < MF_LICENSING_PIPELINE_MAX_BATCH ) {
+        mfLicensingIssuance *issuance = (mfLicensingIssuance *)items[item_i++];
+        if( issuance->status != 0 ) continue;
+        messages[hashed_count] = issuance->data;
+        sizes[hashed_count] = issuance->size;
+        hashed[hashed_count++] = issuance;
+    }
+    if( hashed_count == 0 ) return;
+    mfLicensingComputeDigests(provider, messages, sizes, hashed_count, digests);
+    while( hashed_count-- ) {
+        hashed[hashed_count]->digest = digests[hashed_count];
+    }
+}
+
+void mfLicensingGenerateStage( void *context, void **items, unsigned int count )
+{
+    mfLicensingContext *licensing_context = (mfLicensingContext *)context;
+    unsigned int item_i = 0;
+    while( item_i < count ) {
+        mfLicensingIssuance *issuance = (mfLicensingIssuance *)items[item_i++];
+        if( issuance->status != 0 ) continue;
+        if( mfLicensingGenerateLicenseToBuffer(licensing_context, &issuance->digest, issuance->index, issuance->license, MF_LICENSING_ISSUANCE_KEY_SIZE) != 0 ) {
+            issuance->status = -1;
+        }
+    }
+}
+
+void mfLicensingFormatStage( void *context, void **items, unsigned int count )
+{
+    const mfLicensingKeyGrouping *grouping = (const mfLicensingKeyGrouping *)context;
+    unsigned int item_i = 0;
+    while( item_i < count ) {
+        mfLicensingIssuance *issuance = (mfLicensingIssuance *)items[item_i++];
+        if( issuance->status != 0 ) continue;
+        const unsigned char *c = issuance->license;
+        unsigned char *formatted = issuance->formatted;
+        unsigned int in_group = 0;
+        while( *c != 0 ) {
+            if( grouping->group != 0 && in_group == grouping->group ) {
+                *formatted++ = grouping->separator;
+                in_group = 0;
+            }
+            *formatted++ = *c++;
+            in_group++;
+        }
+        *formatted = 0;
+    }
+}
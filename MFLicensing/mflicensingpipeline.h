@@ -0,0 +1,171 @@
+//
+//  mflicensingpipeline.h
+//  MFLicensing
+//  https://github.com/freshcode/MFLicensing
+//
+//
+//  Pipelines, for issuing keys in bulk.
+//
+//  Issuing keys for a list of licensees takes several steps: reading each record, hashing it into
+//  a digest, generating the key, formatting it and writing it out.  Run one after the other, the
+//  hashing and the generation wait for the I/O and a single core is used.  A pipeline instead runs
+//  each step as a stage with threads of its own, the stages being connected by bounded queues: the
+//  steps of different items overlap and the costly stages are given as many threads as needed.
+//
+//  Items are pointers passed from stage to stage, each stage receiving them by batches.  Queues are
+//  lock-free ring buffers; a queue between a stage of one thread and another stage of one thread is
+//  single-producer single-consumer, the others multi-producer multi-consumer.  Threads only sleep
+//  when their queue is empty, or full, for a while.  Items leave the last stage in no particular
+//  order when a stage has several threads.
+//
+//  mfLicensingDigestStage, mfLicensingGenerateStage and mfLicensingFormatStage process items of
+//  type mfLicensingIssuance; the application provides the stage writing the keys out, and any
+//  other stage it needs.
+//
+//  Licensing
+//  ---------
+//  Public Domain
+//  By Freshcode, Cutting edge Mac, iPhone & iPad software development. http://madefresh.ca/
+//
+
+#ifndef MFLicensing_mflicensingpipeline_h
+#define MFLicensing_mflicensingpipeline_h
+
+#include "mflicensing.h"
+#include "mflicensingdigest.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define MF_LICENSING_PIPELINE_MAX_BATCH 256
+// Longest key and its terminating zero: key_length of 255 characters, followed by a check character
+#define MF_LICENSING_ISSUANCE_KEY_SIZE (255 + 1 + 1)
+
+// Stage function, processing count items at once
+typedef void (*mfLicensingStageFunction)( void *context, void **items, unsigned int count );
+
+// Stage structure
+//----------------
+// function, context: function called with context for every batch of items
+// threads: number of threads running the stage (0 for 1)
+// batch: maximum number of items per call, up to MF_LICENSING_PIPELINE_MAX_BATCH (0 for 64)
+typedef struct {
+    mfLicensingStageFunction function;
+    void *context;
+    unsigned int threads;
+    unsigned int batch;
+} mfLicensingStage;
+
+// Pipeline Options structure
+//---------------------------
+// capacity: number of items each queue holds, rounded up to a power of 2 (default 1024)
+// submitters: number of threads calling mfLicensingPipelineSubmit (default 1)
+typedef struct {
+    unsigned int capacity;
+    unsigned int submitters;
+} mfLicensingPipelineOptions;
+
+// Pipeline Queue structure, bounded ring buffer between two stages
+//-----------------------------------------------------------------
+// cells, sequences, mask: ring buffer of mask + 1 items; sequences is 0 for single-producer
+//   single-consumer queues, otherwise the sequence number each cell is ready for
+// head, tail: position of the next item taken and of the next item added
+// producers: number of threads still adding items, the queue is closed once it drops to 0
+// waiting, lock, changed: threads sleeping until items are added or taken, or the queue is closed
+typedef struct {
+    _Alignas(64) atomic_ullong head;
+    _Alignas(64) atomic_ullong tail;
+    _Alignas(64) void **cells;
+    atomic_ullong *sequences;
+    unsigned long long mask;
+    atomic_uint producers;
+    atomic_uint waiting;
+    pthread_mutex_t lock;
+    pthread_cond_t changed;
+} mfLicensingPipelineQueue;
+
+// Pipeline structure
+//-------------------
+// stages: copy of the stages, queues[i] feeding stages[i]
+// threads: threads running the stages
+typedef struct {
+    mfLicensingStage *stages;
+    unsigned int stage_count;
+    mfLicensingPipelineQueue *queues;
+    pthread_t *threads;
+    unsigned int thread_count;
+} mfLicensingPipeline;
+
+// Issuance structure, item of the licensing stages
+//-------------------------------------------------
+// data, size: licensee data the digest stage hashes
+// digest: digest of the data, set by the digest stage or by the application
+// index: index of the key
+// status: 0, or -1 once a stage failed to process the item, the licensing stages then skip it
+// license: key generated by the generate stage
+// formatted: key formatted by the format stage
+// user: for the application, the record the item was made of for instance
+typedef struct {
+    const void *data;
+    unsigned long size;
+    mfLicensingDigest digest;
+    unsigned int index;
+    int status;
+    unsigned char license[MF_LICENSING_ISSUANCE_KEY_SIZE];
+    unsigned char formatted[2 * MF_LICENSING_ISSUANCE_KEY_SIZE];
+    void *user;
+} mfLicensingIssuance;
+
+// Key Grouping structure, context of mfLicensingFormatStage
+//----------------------------------------------------------
+// group: number of characters per group, 0 to copy the key as is
+// separator: character inserted between the groups
+typedef struct {
+    unsigned int group;
+    unsigned char separator;
+} mfLicensingKeyGrouping;
+
+// mfLicensingInitializePipelineOptions
+//-------------------------------------
+// Sets the default values of the options.
+void mfLicensingInitializePipelineOptions( mfLicensingPipelineOptions *options );
+
+// mfLicensingOpenPipeline
+//------------------------
+// Starts the threads of stage_count stages, the items submitted going through stages[0] first.
+// options may be 0 for the defaults.
+//
+// Returns 0 on success, -1 if memory couldn't be allocated or the threads couldn't be started.
+int mfLicensingOpenPipeline( mfLicensingPipeline *pipeline, const mfLicensingStage *stages, unsigned int stage_count, const mfLicensingPipelineOptions *options );
+
+// mfLicensingPipelineSubmit
+//--------------------------
+// Adds count items to the pipeline, waiting while the first queue is full.  The items must remain
+// valid until the last stage is done with them.
+void mfLicensingPipelineSubmit( mfLicensingPipeline *pipeline, void **items, unsigned int count );
+
+// mfLicensingFinishPipeline
+//--------------------------
+// Declares the items of the calling thread all submitted.  Once every submitter did, returns when
+// every item went through the last stage, the threads stopped and the pipeline released; the other
+// submitters return at once.
+void mfLicensingFinishPipeline( mfLicensingPipeline *pipeline );
+
+// mfLicensingDigestStage
+//-----------------------
+// Stage function computing the digest of the data of mfLicensingIssuance items, context being the
+// mfLicensingDigestProvider; the items of a batch are hashed with mfLicensingComputeDigests.
+void mfLicensingDigestStage( void *context, void **items, unsigned int count );
+
+// mfLicensingGenerateStage
+//-------------------------
+// Stage function generating the license key of mfLicensingIssuance items, context being the
+// mfLicensingContext.  The status of the items whose key couldn't be generated is set to -1.
+void mfLicensingGenerateStage( void *context, void **items, unsigned int count );
+
+// mfLicensingFormatStage
+//-----------------------
+// Stage function formatting the license key of mfLicensingIssuance items in groups of characters,
+// context being the mfLicensingKeyGrouping ("ABCDE-FGHIJ-KLMNO" for groups of 5 and '-').
+void mfLicensingFormatStage( void *context, void **items, unsigned int count );
+
+#endif
@@ -0,0 +1,111 @@
+//
+//  mflicensingregistry.c
+//  MFLicensing
+//  https://github.com/freshcode/MFLicensing
+//
+//  Public Domain
+//  By Freshcode, Cutting edge Mac, iPhone & iPad software development. http://madefresh.ca/
+//
+
+#include "mflicensingregistry.h"
+#include <stdlib.h>
+
+void mfLicensingInitializeRegistry( mfLicensingRegistry *registry )
+{
+    registry->entries = 0;
+    registry->count = 0;
+    registry->capacity = 0;
+    unsigned int length = 257;
+    while( length-- ) {
+        registry->first_by_length[length] = -1;
+    }
+}
+
+void mfLicensingReleaseRegistry( mfLicensingRegistry *registry )
+{
+    while( registry->count ) {
+        registry->count--;
+        mfLicensingReleaseContext(&registry->entries[registry->count].context);
+    }
+    free( registry->entries );
+    mfLicensingInitializeRegistry(registry);
+}
+
+int mfLicensingRegistryAddVector( mfLicensingRegistry *registry, mfLicensingVector *vector )
+{
+    if( registry->count == registry->capacity ) {
+        unsigned int capacity = registry->capacity == 0 ? 8 : registry->capacity * 2;
+        mfLicensingRegistryEntry *entries = realloc(registry->entries, capacity * sizeof(mfLicensingRegistryEntry));
+        if( entries == 0 ) return -1; // failed realloc
+        registry->entries = entries;
+        registry->capacity = capacity;
+    }
+
+    int vector_id = registry->count;
+    mfLicensingRegistryEntry *entry = &registry->entries[vector_id];
+    if( mfLicensingInitializeContext(&entry->context, vector) != 0 ) {
+        return -1;
+    }
+
+    // Build the bitmap of the encoding characters
+    unsigned int word = 8;
+    while( word-- ) {
+        entry->charset[word] = 0;
+    }
+    const unsigned char *c = vector->coded_chars;
+    while( *c != 0 ) {
+        entry->charset[*c >> 5] |= 1u << (*c & 0x1F);
+        c++;
+    }
+
+    // Append the entry to the list of vectors sharing the same key length
+    entry->next = -1;
+    int *link = &registry->first_by_length[vector->key_length + vector->check_character];
+    while( *link != -1 ) {
+        link = &registry->entries[*link].next;
+    }
+    *link = vector_id;
+
+    registry->count++;
+    return vector_id;
+}
+
+mfLicensingContext *mfLicensingRegistryContext( mfLicensingRegistry *registry, int vector_id )
+{
+    if( vector_id < 0 || vector_id >= (int)registry->count ) {
+        return 0;
+    }
+    return &registry->entries[vector_id].context;
+}
+
+int mfLicensingRegistryValidateLicense( mfLicensingRegistry *registry, mfLicensingDigest *digest, const unsigned char *license )
+{
+    unsigned int charset[8] = { 0, 0, 0, 0, 0, 0, 0, 0 };
+
+    // Compute the length and the characters bitmap of the license in a single pass
+    unsigned int length = 0;
+    while( license[length] != 0 ) {
+        if( length >= 256 ) {
+            // no vector can produce a key this long
+            return -1;
+        }
+        charset[license[length] >> 5] |= 1u << (license[length] & 0x1F);
+        length++;
+    }
+
+    int vector_id = registry->first_by_length[length];
+    while( vector_id != -1 ) {
+        mfLicensingRegistryEntry *entry = &registry->entries[vector_id];
+        unsigned int word = 8;
+        unsigned int foreign_chars = 0;
+        while( word-- ) {
+            foreign_chars |= charset[word] & ~entry->charset[word];
+        }
+        if( foreign_chars == 0 &&
+            mfLicensingValidateLicenseWithContext(&entry->context, digest, license) == 1 ) {
+            return vector_id;
+        }
+        vector_id = entry->next;
+    }
+    return -1;
+}
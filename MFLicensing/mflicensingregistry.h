@@ -0,0 +1,85 @@
+//
+//  mflicensingregistry.h
+//  MFLicensing
+//  https://github.com/freshcode/MFLicensing
+//
+//
+//  Registry of licensing vectors, used to validate license keys of unknown origin.
+//
+//  When several products each use their own licensing vector, a license key provided without
+//  any indication of the product it belongs to would normally need to be validated against every
+//  vector in turn.  The registry indexes the vectors by key length and by the set of encoding
+//  characters they use, so that only the vectors that could have produced the key are tried.
+//  The codec parameters of each vector are computed once, when the vector is added.
+//
+//  Licensing
+//  ---------
+//  Public Domain
+//  By Freshcode, Cutting edge Mac, iPhone & iPad software development. http://madefresh.ca/
+//
+
+#ifndef MFLicensing_mflicensingregistry_h
+#define MFLicensing_mflicensingregistry_h
+
+#include "mflicensing.h"
+
+// Registry entry, one per licensing vector added
+//-----------------------------------------------
+// context: codec parameters computed for the vector
+// charset: bitmap of the encoding characters of the vector
+// next: index of the next entry with the same key length, -1 if none
+typedef struct {
+    mfLicensingContext context;
+    unsigned int charset[8];
+    int next;
+} mfLicensingRegistryEntry;
+
+// Licensing Registry structure
+//-----------------------------
+// entries: array of count entries, in the order the vectors were added
+// first_by_length: index of the first entry for each key length (check character included), -1 if none
+typedef struct {
+    mfLicensingRegistryEntry *entries;
+    unsigned int count;
+    unsigned int capacity;
+    int first_by_length[257];
+} mfLicensingRegistry;
+
+// mfLicensingInitializeRegistry
+//------------------------------
+// Initializes an empty registry.
+void mfLicensingInitializeRegistry( mfLicensingRegistry *registry );
+
+// mfLicensingReleaseRegistry
+//---------------------------
+// Frees all the memory allocated by the registry.  The vectors themselves are not modified.
+void mfLicensingReleaseRegistry( mfLicensingRegistry *registry );
+
+// mfLicensingRegistryAddVector
+//-----------------------------
+// Computes the codec parameters of the vector and adds it to the registry.
+//
+// The vector must remain valid and unchanged for as long as the registry is in use.
+//
+// Returns the identifier of the vector in the registry (0 for the first vector added, 1 for the
+// second, etc), -1 if the vector parameters couldn't be validated or memory couldn't be allocated.
+int mfLicensingRegistryAddVector( mfLicensingRegistry *registry, mfLicensingVector *vector );
+
+// mfLicensingRegistryContext
+//---------------------------
+// Returns the licensing context of the vector identified, 0 if the identifier is invalid.
+//
+// The pointer returned is only valid until the next call to mfLicensingRegistryAddVector.
+mfLicensingContext *mfLicensingRegistryContext( mfLicensingRegistry *registry, int vector_id );
+
+// mfLicensingRegistryValidateLicense
+//-----------------------------------
+// Validates a license key against the vectors of the registry which could have produced it.
+//
+// Only the vectors with the same key length as the license and whose encoding characters include
+// every character of the license are tried, in the order they were added.
+//
+// Returns the identifier of the first vector for which the key is valid, -1 if none.
+int mfLicensingRegistryValidateLicense( mfLicensingRegistry *registry, mfLicensingDigest *digest, const unsigned char *license );
+
+#endif
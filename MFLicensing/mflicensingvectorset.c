@@ -0,0 +1,264 @@
+//
+//  mflicensingvectorset.c
+//  MFLicensing
+//  https://github.com/freshcode/MFLicensing
+//
+//  Public Domain
+//  By Freshcode, Cutting edge Mac, iPhone & iPad software development. http://madefresh.ca/
+//
+
+#include "mflicensingvectorset.h"
+#include "mflicensingbatch.h"
+#include <stdlib.h>
+#include <sched.h>
+#include <time.h>
+
+// Keys of the previous snapshot are validated in batches of this many
+#define MF_VECTOR_SET_RETRY_BATCH 64
+
+static atomic_uint mfLicensingNextStripe;
+static __thread unsigned int mfLicensingThreadStripe;    // stripe of the thread + 1, 0 until assigned
+
+static unsigned long long mfLicensingVectorSetNow( void )
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000ULL + ts.tv_nsec / 1000;
+}
+
+#pragma mark - Snapshots
+
+mfLicensingSnapshot *mfLicensingCreateSnapshot( mfLicensingVector *vector )
+{
+    mfLicensingContext context;
+    if( mfLicensingInitializeContext(&context, vector) != 0 ) {
+        return 0;
+    }
+    mfLicensingSnapshot *snapshot = malloc(sizeof(mfLicensingSnapshot));
+    if( snapshot == 0 ) {
+        mfLicensingReleaseContext(&context);
+        return 0;
+    }
+
+    // The context is compiled into the blob of the snapshot, and the snapshot attached to it
+    unsigned int serialized = mfLicensingSerializeContext(&context, snapshot->blob, MF_LICENSING_BLOB_SIZE);
+    mfLicensingReleaseContext(&context);
+    if( serialized == 0 || mfLicensingAttachContext(&snapshot->compiled, snapshot->blob, MF_LICENSING_BLOB_SIZE) != 0 ) {
+        free(snapshot);
+        return 0;
+    }
+    atomic_init(&snapshot->references, 1);
+    return snapshot;
+}
+
+mfLicensingSnapshot *mfLicensingRetainSnapshot( mfLicensingSnapshot *snapshot )
+{
+    atomic_fetch_add_explicit(&snapshot->references, 1, memory_order_relaxed);
+    return snapshot;
+}
+
+void mfLicensingReleaseSnapshot( mfLicensingSnapshot *snapshot )
+{
+    if( atomic_fetch_sub_explicit(&snapshot->references, 1, memory_order_acq_rel) == 1 ) {
+        free(snapshot);
+    }
+}
+
+#pragma mark - Epochs
+
+// Announces the thread as using set, returns the generation it may use until mfLicensingLeaveVectorSet
+// and the counter to decrement then.  The counter is incremented before checking the epoch again, so
+// either the publication replacing the generation sees the thread, or the thread sees the new epoch
+// and the generation published with it.
+static mfLicensingVectorGeneration *mfLicensingEnterVectorSet( mfLicensingVectorSet *set, atomic_uint **readers )
+{
+    if( mfLicensingThreadStripe == 0 ) {
+        mfLicensingThreadStripe = atomic_fetch_add_explicit(&mfLicensingNextStripe, 1, memory_order_relaxed) % MF_LICENSING_VECTOR_SET_STRIPES + 1;
+    }
+    mfLicensingVectorSetStripe *stripe = &set->stripes[mfLicensingThreadStripe - 1];
+    while( 1 ) {
+        unsigned int epoch = atomic_load(&set->epoch);
+        atomic_uint *counter = &stripe->readers[epoch & 1];
+        atomic_fetch_add(counter, 1);
+        if( atomic_load(&set->epoch) == epoch ) {
+            *readers = counter;
+            return atomic_load(&set->generation);
+        }
+        // a publication started in between
+        atomic_fetch_sub(counter, 1);
+    }
+}
+
+static void mfLicensingLeaveVectorSet( atomic_uint *readers )
+{
+    atomic_fetch_sub_explicit(readers, 1, memory_order_release);
+}
+
+// Publishes next, waits for the threads that may be using the generation it replaces and frees it.
+// Called with the lock held.
+static void mfLicensingReplaceGeneration( mfLicensingVectorSet *set, mfLicensingVectorGeneration *next )
+{
+    mfLicensingVectorGeneration *retired = atomic_exchange(&set->generation, next);
+    unsigned int epoch = atomic_fetch_add(&set->epoch, 1);
+
+    // Threads entering from now on see the new epoch, only the ones counted for the previous one remain
+    unsigned int stripe_i = 0;
+    while( stripe_i < MF_LICENSING_VECTOR_SET_STRIPES ) {
+        while( atomic_load(&set->stripes[stripe_i].readers[epoch & 1]) != 0 ) {
+            sched_yield();
+        }
+        stripe_i++;
+    }
+
+    mfLicensingReleaseSnapshot(retired->current);
+    if( retired->previous != 0 ) {
+        mfLicensingReleaseSnapshot(retired->previous);
+    }
+    free(retired);
+}
+
+// Returns 1 if the previous snapshot of generation is in its grace window, 0 otherwise
+static int mfLicensingInGrace( const mfLicensingVectorGeneration *generation )
+{
+    return generation->previous != 0 && mfLicensingVectorSetNow() < generation->previous_until;
+}
+
+#pragma mark - Vector sets
+
+int mfLicensingInitializeVectorSet( mfLicensingVectorSet *set, mfLicensingSnapshot *snapshot )
+{
+    mfLicensingVectorGeneration *generation = malloc(sizeof(mfLicensingVectorGeneration));
+    if( generation == 0 ) {
+        return -1;
+    }
+    generation->current = mfLicensingRetainSnapshot(snapshot);
+    generation->previous = 0;
+    generation->previous_until = 0;
+    atomic_init(&set->generation, generation);
+    atomic_init(&set->epoch, 0);
+    unsigned int stripe_i = MF_LICENSING_VECTOR_SET_STRIPES;
+    while( stripe_i-- ) {
+        atomic_init(&set->stripes[stripe_i].readers[0], 0);
+        atomic_init(&set->stripes[stripe_i].readers[1], 0);
+    }
+    pthread_mutex_init(&set->lock, 0);
+    return 0;
+}
+
+void mfLicensingReleaseVectorSet( mfLicensingVectorSet *set )
+{
+    mfLicensingVectorGeneration *generation = atomic_load(&set->generation);
+    if( generation == 0 ) return;
+    mfLicensingReleaseSnapshot(generation->current);
+    if( generation->previous != 0 ) {
+        mfLicensingReleaseSnapshot(generation->previous);
+    }
+    free(generation);
+    atomic_store(&set->generation, 0);
+    pthread_mutex_destroy(&set->lock);
+}
+
+int mfLicensingPublishSnapshot( mfLicensingVectorSet *set, mfLicensingSnapshot *snapshot, unsigned int grace_ms )
+{
+    mfLicensingVectorGeneration *next = malloc(sizeof(mfLicensingVectorGeneration));
+    if( next == 0 ) {
+        return -1;
+    }
+    pthread_mutex_lock(&set->lock);
+    mfLicensingVectorGeneration *generation = atomic_load(&set->generation);
+    next->current = mfLicensingRetainSnapshot(snapshot);
+    next->previous = 0;
+    next->previous_until = 0;
+    if( grace_ms != 0 && generation->current != snapshot ) {
+        next->previous = mfLicensingRetainSnapshot(generation->current);
+        next->previous_until = mfLicensingVectorSetNow() + (unsigned long long)grace_ms * 1000;
+    }
+    mfLicensingReplaceGeneration(set, next);
+    pthread_mutex_unlock(&set->lock);
+    return 0;
+}
+
+int mfLicensingEndVectorSetGrace( mfLicensingVectorSet *set )
+{
+    mfLicensingVectorGeneration *next = malloc(sizeof(mfLicensingVectorGeneration));
+    if( next == 0 ) {
+        return -1;
+    }
+    pthread_mutex_lock(&set->lock);
+    mfLicensingVectorGeneration *generation = atomic_load(&set->generation);
+    if( generation->previous == 0 ) {
+        pthread_mutex_unlock(&set->lock);
+        free(next);
+        return 0;
+    }
+    next->current = mfLicensingRetainSnapshot(generation->current);
+    next->previous = 0;
+    next->previous_until = 0;
+    mfLicensingReplaceGeneration(set, next);
+    pthread_mutex_unlock(&set->lock);
+    return 0;
+}
+
+mfLicensingSnapshot *mfLicensingAcquireSnapshot( mfLicensingVectorSet *set )
+{
+    atomic_uint *readers;
+    mfLicensingVectorGeneration *generation = mfLicensingEnterVectorSet(set, &readers);
+    mfLicensingSnapshot *snapshot = mfLicensingRetainSnapshot(generation->current);
+    mfLicensingLeaveVectorSet(readers);
+    return snapshot;
+}
+
+#pragma mark - Validation
+
+int mfLicensingVectorSetValidateLicense( mfLicensingVectorSet *set, mfLicensingDigest *digest, const unsigned char *license )
+{
+    atomic_uint *readers;
+    mfLicensingVectorGeneration *generation = mfLicensingEnterVectorSet(set, &readers);
+    int valid = mfLicensingValidateLicenseWithContext(&generation->current->compiled.context, digest, license);
+    if( valid != 1 ) {
+        valid = 0;
+        if( mfLicensingInGrace(generation) &&
+            mfLicensingValidateLicenseWithContext(&generation->previous->compiled.context, digest, license) == 1 ) {
+            valid = 2;
+        }
+    }
+    mfLicensingLeaveVectorSet(readers);
+    return valid;
+}
+
+unsigned int mfLicensingVectorSetValidateLicenses( mfLicensingVectorSet *set, const mfLicensingDigest *digests, const unsigned char **licenses, unsigned int count, unsigned char *valid )
+{
+    atomic_uint *readers;
+    mfLicensingVectorGeneration *generation = mfLicensingEnterVectorSet(set, &readers);
+    unsigned int valid_count = mfLicensingValidateLicenses(&generation->current->compiled.context, digests, licenses, count, valid);
+
+    // The keys rejected are tried again against the previous snapshot, in batches
+    if( valid_count < count && mfLicensingInGrace(generation) ) {
+        mfLicensingDigest retry_digests[MF_VECTOR_SET_RETRY_BATCH];
+        const unsigned char *retry_licenses[MF_VECTOR_SET_RETRY_BATCH];
+        unsigned int retry_keys[MF_VECTOR_SET_RETRY_BATCH];
+        unsigned char retry_valid[MF_VECTOR_SET_RETRY_BATCH];
+        unsigned int key_i = 0;
+        while( key_i < count ) {
+            unsigned int retry_count = 0;
+            while( key_i < count && retry_count < MF_VECTOR_SET_RETRY_BATCH ) {
+                if( valid[key_i] == 0 ) {
+                    retry_digests[retry_count] = digests[key_i];
+                    retry_licenses[retry_count] = licenses[key_i];
+                    retry_keys[retry_count] = key_i;
+                    retry_count++;
+                }
+                key_i++;
+            }
+            if( retry_count == 0 ) break;
+            valid_count += mfLicensingValidateLicenses(&generation->previous->compiled.context, retry_digests, retry_licenses, retry_count, retry_valid);
+            while( retry_count-- ) {
+                if( retry_valid[retry_count] ) {
+                    valid[ retry_keys[retry_count] ] = 2;
+                }
+            }
+        }
+    }
+    mfLicensingLeaveVectorSet(readers);
+    return valid_count;
+}
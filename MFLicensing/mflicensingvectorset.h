@@ -0,0 +1,149 @@
+//
+//  mflicensingvectorset.h
+//  MFLicensing
+//  https://github.com/freshcode/MFLicensing
+//
+//
+//  Vector sets, for rotating the private key or seeds of a product without stopping validation.
+//
+//  A licensing vector is changed in place by its setters, every thread validating keys with it
+//  would have to be stopped while it is.  A snapshot is instead an immutable copy of a vector,
+//  compiled with its context into a blob (see mflicensingblob.h) so it refers to nothing the
+//  caller owns, and reference counted.  A vector set publishes one snapshot as the current one;
+//  publishing another replaces it atomically, the snapshot it replaces remaining accepted during
+//  a grace window so keys issued with it keep validating while customers are given new ones.
+//
+//  Validating against a set takes no lock: the threads validating keys announce themselves in
+//  per-thread counters of the current epoch, and publishing only waits for the threads that may
+//  still be using the previous state of the set to leave, a matter of one validation, before
+//  releasing the snapshots no longer in use.  Publishing never waits for the validating threads
+//  to pause, and they never wait for it.
+//
+//  Licensing
+//  ---------
+//  Public Domain
+//  By Freshcode, Cutting edge Mac, iPhone & iPad software development. http://madefresh.ca/
+//
+
+#ifndef MFLicensing_mflicensingvectorset_h
+#define MFLicensing_mflicensingvectorset_h
+
+#include "mflicensingblob.h"
+#include <pthread.h>
+#include <stdatomic.h>
+
+#define MF_LICENSING_VECTOR_SET_STRIPES 16
+
+// Snapshot structure, an immutable licensing vector and its context
+//------------------------------------------------------------------
+// references: number of references held, the snapshot is freed when it drops to 0
+// compiled: vector and context attached to blob, compiled.context is passed to the validation functions
+typedef struct {
+    atomic_uint references;
+    mfLicensingCompiledContext compiled;
+    unsigned char blob[MF_LICENSING_BLOB_SIZE];
+} mfLicensingSnapshot;
+
+// Vector Generation structure, state of a vector set between two publications
+//----------------------------------------------------------------------------
+// current: snapshot keys are validated against first
+// previous: snapshot replaced by current, 0 if none
+// previous_until: end of the grace window of previous, CLOCK_MONOTONIC microseconds
+typedef struct {
+    mfLicensingSnapshot *current;
+    mfLicensingSnapshot *previous;
+    unsigned long long previous_until;
+} mfLicensingVectorGeneration;
+
+// Vector Set Stripe structure, counters of the threads validating keys, on a cache line of its own
+//---------------------------------------------------------------------------------------------------
+// readers: number of threads using the set, for even and odd epochs
+typedef struct {
+    _Alignas(64) atomic_uint readers[2];
+} mfLicensingVectorSetStripe;
+
+// Vector Set structure
+//---------------------
+// generation: state published, replaced as a whole on each publication
+// epoch: incremented on each publication
+// stripes: threads are spread over the stripes to avoid contending for the same counters
+// lock: serializes the publications
+typedef struct {
+    _Atomic(mfLicensingVectorGeneration *) generation;
+    atomic_uint epoch;
+    mfLicensingVectorSetStripe stripes[MF_LICENSING_VECTOR_SET_STRIPES];
+    pthread_mutex_t lock;
+} mfLicensingVectorSet;
+
+// mfLicensingCreateSnapshot
+//--------------------------
+// Creates a snapshot of vector, holding one reference.  The vector may be changed or freed afterwards,
+// the snapshot doesn't refer to it.
+//
+// Returns the snapshot, 0 if the vector parameters couldn't be validated or memory couldn't be allocated.
+mfLicensingSnapshot *mfLicensingCreateSnapshot( mfLicensingVector *vector );
+
+// mfLicensingRetainSnapshot
+//--------------------------
+// Adds a reference to snapshot.  Returns snapshot.
+mfLicensingSnapshot *mfLicensingRetainSnapshot( mfLicensingSnapshot *snapshot );
+
+// mfLicensingReleaseSnapshot
+//---------------------------
+// Removes a reference from snapshot, freeing it once none is left.
+void mfLicensingReleaseSnapshot( mfLicensingSnapshot *snapshot );
+
+// mfLicensingInitializeVectorSet
+//-------------------------------
+// Initializes set with snapshot as its current snapshot, the set holding a reference to it.
+//
+// Returns 0 on success, -1 if memory couldn't be allocated.
+int mfLicensingInitializeVectorSet( mfLicensingVectorSet *set, mfLicensingSnapshot *snapshot );
+
+// mfLicensingReleaseVectorSet
+//----------------------------
+// Releases the snapshots held by set.  No thread may be using the set.
+void mfLicensingReleaseVectorSet( mfLicensingVectorSet *set );
+
+// mfLicensingPublishSnapshot
+//---------------------------
+// Makes snapshot the current snapshot of set, the set holding a reference to it.  Keys of the
+// snapshot it replaces remain valid for grace_ms milliseconds, 0 to reject them at once; a previous
+// snapshot still in its grace window is dropped.  Returns once no thread uses the snapshots dropped.
+//
+// Returns 0 on success, -1 if memory couldn't be allocated, the set being left unchanged.
+int mfLicensingPublishSnapshot( mfLicensingVectorSet *set, mfLicensingSnapshot *snapshot, unsigned int grace_ms );
+
+// mfLicensingEndVectorSetGrace
+//-----------------------------
+// Ends the grace window of the previous snapshot of set before it expires, releasing it.
+//
+// Returns 0 on success, -1 if memory couldn't be allocated.
+int mfLicensingEndVectorSetGrace( mfLicensingVectorSet *set );
+
+// mfLicensingAcquireSnapshot
+//---------------------------
+// Returns the current snapshot of set with a reference added, for work spanning many calls
+// (generating keys, validating with mfLicensingValidateLicenses, etc).  The reference must be
+// released with mfLicensingReleaseSnapshot.
+mfLicensingSnapshot *mfLicensingAcquireSnapshot( mfLicensingVectorSet *set );
+
+// mfLicensingVectorSetValidateLicense
+//------------------------------------
+// Validates license against the current snapshot of set, then against the previous one during its
+// grace window.  May be called from any number of threads at once, and while snapshots are published.
+//
+// Returns 1 if the license is valid for the current snapshot, 2 if it is only valid for the previous
+// snapshot, 0 otherwise.
+int mfLicensingVectorSetValidateLicense( mfLicensingVectorSet *set, mfLicensingDigest *digest, const unsigned char *license );
+
+// mfLicensingVectorSetValidateLicenses
+//-------------------------------------
+// Batched form of mfLicensingVectorSetValidateLicense, validating count license keys with
+// mfLicensingValidateLicenses.  valid[i] is set to 1, 2 or 0 as mfLicensingVectorSetValidateLicense
+// would return for licenses[i].  Every key of the batch is validated against the same state of the set.
+//
+// Returns the number of valid license keys.
+unsigned int mfLicensingVectorSetValidateLicenses( mfLicensingVectorSet *set, const mfLicensingDigest *digests, const unsigned char **licenses, unsigned int count, unsigned char *valid );
+
+#endif
@@ -22,12 +22,60 @@
 
 #include <stdio.h>
 #include <stdlib.h>
+#include <string.h>
 #include <assert.h>
 #include "mfmathlib.h"
 
+#if MFMATHLIB_BACKEND != MFMATHLIB_BACKEND_PORTABLE
+#include <stdint.h>
+#endif
+#if MFMATHLIB_BACKEND == MFMATHLIB_BACKEND_GMP
+#if defined(__has_include)
+#if !__has_include(<gmp.h>)
+#error "MFMATHLIB_BACKEND_GMP selected but gmp.h could not be found"
+#endif
+#endif
+#include <gmp.h>
+#if GMP_LIMB_BITS != 64 || GMP_NAIL_BITS != 0
+#error "MFMATHLIB_BACKEND_GMP requires 64-bit GMP limbs without nails"
+#endif
+#endif
+
+#pragma mark - Instrumentation counters
+#ifdef MFMATHLIB_INSTRUMENTATION
+static __thread mfMathStats mfMathThreadStats;
+
+// Inlined with a constant width, the class is resolved at compile time
+static inline unsigned int mfMathStatsWidthClass( unsigned int bytes )
+{
+    unsigned int width_class = 0;
+    while( width_class < MF_MATH_WIDTH_CLASSES - 1 && (1u << width_class) < bytes ) {
+        width_class++;
+    }
+    return width_class;
+}
+static inline void mfMathStatsCall( mfMathOperation operation, unsigned int bytes )
+{
+    mfMathThreadStats.calls[operation][mfMathStatsWidthClass(bytes)]++;
+    mfMathThreadStats.bytes[operation] += bytes;
+}
+static void *mfMathStatsMalloc( mfMathOperation operation, size_t size )
+{
+    mfMathThreadStats.allocations[operation]++;
+    mfMathThreadStats.allocated_bytes[operation] += size;
+    return malloc(size);
+}
+#define MF_STATS_CALL(operation, bytes) mfMathStatsCall(operation, bytes)
+#define MF_MALLOC(operation, size) mfMathStatsMalloc(operation, size)
+#else
+#define MF_STATS_CALL(operation, bytes)
+#define MF_MALLOC(operation, size) malloc(size)
+#endif
+
 #pragma mark - Extend
 void mfUintExtX( unsigned int s, mfU8 *d, unsigned int bytes)
 {
+    MF_STATS_CALL(mfMathOperationExtend, bytes);
     mfZeroX(d, bytes);
     d[0] = (unsigned char)(s & 0xFF);
     if( bytes > 1 ) {
@@ -45,11 +93,12 @@ void mfUintExtX( unsigned int s, mfU8 *d, unsigned int bytes)
 // Copy value of s into d
 void mfCopyX( const mfU8 *s, mfU8 *d, unsigned int bytes )
 {
+    MF_STATS_CALL(mfMathOperationCopy, bytes);
     while( bytes-- ) {
         d[bytes] = s[bytes];
     }
 }
-void mfCopy8( const mfU8 *s, mfU8 *d ) { *d = *s; }
+void mfCopy8( const mfU8 *s, mfU8 *d ) { MF_STATS_CALL(mfMathOperationCopy, 1); *d = *s; }
 void mfCopy16( const mfU16 *s, mfU16 *d ) { mfCopyX( s->b, d->b, sizeof(mfU16)); }
 void mfCopy32( const mfU32 *s, mfU32 *d ) { mfCopyX( s->b, d->b, sizeof(mfU32)); }
 void mfCopy64( const mfU64 *s, mfU64 *d ) { mfCopyX( s->b, d->b, sizeof(mfU64)); }
@@ -64,11 +113,12 @@ void mfCopy1024( const mfU1024 *s, mfU1024 *d ) { mfCopyX( s->b, d->b, sizeof(mf
 // 0 = zeroing completed
 void mfZeroX( mfU8 *d, unsigned int bytes )
 {
+    MF_STATS_CALL(mfMathOperationZero, bytes);
     while( bytes-- ) {
         d[bytes] = 0;
     }
 }
-void mfZero8( mfU8 *d ) { *d = 0; }
+void mfZero8( mfU8 *d ) { MF_STATS_CALL(mfMathOperationZero, 1); *d = 0; }
 void mfZero16( mfU16 *d ) { mfZeroX( d->b, sizeof(mfU16)); }
 void mfZero32( mfU32 *d ) { mfZeroX( d->b, sizeof(mfU32)); }
 void mfZero64( mfU64 *d ) { mfZeroX( d->b, sizeof(mfU64)); }
@@ -77,6 +127,699 @@ void mfZero256( mfU256 *d ) { mfZeroX( d->b, sizeof(mfU256)); }
 void mfZero512( mfU512 *d ) { mfZeroX( d->b, sizeof(mfU512)); }
 void mfZero1024( mfU1024 *d ) { mfZeroX( d->b, sizeof(mfU1024)); }
 
+#pragma mark - Backend
+// Fixed width operations of 64-bits and more are routed through mfBackendAdd, mfBackendSubstract,
+// mfBackendMultiply, mfBackendDivide, mfBackendShiftLeft, mfBackendShiftRight and mfBackendBitLength,
+// which share the signature of the mf*UX functions.
+#if MFMATHLIB_BACKEND == MFMATHLIB_BACKEND_PORTABLE
+
+const char *mfBackendName( void ) { return "portable"; }
+const char *mfMultiplyKernelName( void ) { return "portable"; }
+#define mfBackendAdd mfAddUX
+#define mfBackendSubstract mfSubstractUX
+#define mfBackendMultiply mfMultiplyUX
+#define mfBackendSquare mfSquareUX
+#define mfBackendDivide mfDivideUX
+#define mfBackendShiftLeft mfShiftLeftUXByN
+#define mfBackendShiftRight mfShiftRightUXByN
+#define mfBackendBitLength mfBitLengthUX
+
+#else
+
+#define MF_MAX_LIMBS (sizeof(mfU1024) / 8)
+
+#if MFMATHLIB_BACKEND == MFMATHLIB_BACKEND_GMP
+typedef mp_limb_t mfLimb;
+#else
+typedef uint64_t mfLimb;
+#endif
+
+// The backend functions are inlined into each fixed width function so the limb count is a constant
+#if defined(__GNUC__) || defined(__clang__)
+#define MF_INLINE static inline __attribute__((always_inline))
+#else
+#define MF_INLINE static inline
+#endif
+
+// Values are stored least significant byte first regardless of the host byte order, limbs are
+// copied directly on little endian hosts and assembled explicitly otherwise so the backends also
+// work on big endian hosts.
+static inline void mfLoadLimbs( const mfU8 *x, mfLimb *limbs, unsigned int count )
+{
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+    memcpy(limbs, x, count * 8);
+#else
+    unsigned int i;
+    for( i = 0; i < count; i++ ) {
+        const mfU8 *b = &x[i * 8];
+        limbs[i] = ((mfLimb)b[0]) | ((mfLimb)b[1] << 8) | ((mfLimb)b[2] << 16) | ((mfLimb)b[3] << 24) |
+                   ((mfLimb)b[4] << 32) | ((mfLimb)b[5] << 40) | ((mfLimb)b[6] << 48) | ((mfLimb)b[7] << 56);
+    }
+#endif
+}
+static inline void mfStoreLimbs( const mfLimb *limbs, mfU8 *x, unsigned int count )
+{
+#if defined(__BYTE_ORDER__) && (__BYTE_ORDER__ == __ORDER_LITTLE_ENDIAN__)
+    memcpy(x, limbs, count * 8);
+#else
+    unsigned int i, j;
+    for( i = 0; i < count; i++ ) {
+        mfLimb limb = limbs[i];
+        for( j = 0; j < 8; j++ ) {
+            x[i * 8 + j] = (mfU8)(limb & 0xFF);
+            limb >>= 8;
+        }
+    }
+#endif
+}
+
+// Number of leading zero bits of a non-zero limb
+static inline unsigned int mfCountLeadingZerosLimb( mfLimb x )
+{
+#if defined(__GNUC__) || defined(__clang__)
+    return (unsigned int)__builtin_clzll(x);
+#else
+    unsigned int zeros = 0;
+    while( (x >> 63) == 0 ) {
+        x <<= 1;
+        zeros++;
+    }
+    return zeros;
+#endif
+}
+
+// Shifts are decomposed into a number of whole limbs and a number of bits within a limb
+MF_INLINE void mfBackendShiftLeft( mfU8 *x, unsigned int n, unsigned int bytes )
+{
+    MF_STATS_CALL(mfMathOperationShiftLeftByN, bytes);
+    mfLimb l[MF_MAX_LIMBS];
+    unsigned int count = bytes / 8;
+    unsigned int word = n / 64;
+    unsigned int bit = n % 64;
+    unsigned int i;
+    mfLoadLimbs(x, l, count);
+    for( i = count; i-- > 0; ) {
+        mfLimb limb = 0;
+        if( i >= word ) {
+            limb = l[i - word] << bit;
+            if( bit != 0 && i > word ) limb |= l[i - word - 1] >> (64 - bit);
+        }
+        l[i] = limb;
+    }
+    mfStoreLimbs(l, x, count);
+}
+MF_INLINE void mfBackendShiftRight( mfU8 *x, unsigned int n, unsigned int bytes )
+{
+    MF_STATS_CALL(mfMathOperationShiftRightByN, bytes);
+    mfLimb l[MF_MAX_LIMBS];
+    unsigned int count = bytes / 8;
+    unsigned int word = n / 64;
+    unsigned int bit = n % 64;
+    unsigned int i;
+    mfLoadLimbs(x, l, count);
+    for( i = 0; i < count; i++ ) {
+        mfLimb limb = 0;
+        if( word < count - i ) {
+            limb = l[i + word] >> bit;
+            if( bit != 0 && word < count - i - 1 ) limb |= l[i + word + 1] << (64 - bit);
+        }
+        l[i] = limb;
+    }
+    mfStoreLimbs(l, x, count);
+}
+MF_INLINE unsigned int mfBackendBitLength( const mfU8 *x, unsigned int bytes )
+{
+    MF_STATS_CALL(mfMathOperationBitLength, bytes);
+    mfLimb l[MF_MAX_LIMBS];
+    unsigned int count = bytes / 8;
+    mfLoadLimbs(x, l, count);
+    while( count-- ) {
+        if( l[count] != 0 ) return count * 64 + 64 - mfCountLeadingZerosLimb(l[count]);
+    }
+    return 0;
+}
+
+#if MFMATHLIB_BACKEND == MFMATHLIB_BACKEND_NATIVE64
+
+const char *mfBackendName( void ) { return "native64"; }
+
+// (hi, lo) = a * b + c1 + c2, cannot overflow 128 bits
+static inline mfLimb mfMultiplyAddLimb( mfLimb a, mfLimb b, mfLimb c1, mfLimb c2, mfLimb *hi )
+{
+#if defined(__SIZEOF_INT128__)
+    unsigned __int128 t = (unsigned __int128)a * b + c1 + c2;
+    *hi = (mfLimb)(t >> 64);
+    return (mfLimb)t;
+#else
+    mfLimb al = a & 0xFFFFFFFF, ah = a >> 32;
+    mfLimb bl = b & 0xFFFFFFFF, bh = b >> 32;
+    mfLimb ll = al * bl, lh = al * bh, hl = ah * bl, hh = ah * bh;
+    mfLimb mid = (ll >> 32) + (lh & 0xFFFFFFFF) + (hl & 0xFFFFFFFF);
+    mfLimb lo = (ll & 0xFFFFFFFF) | (mid << 32);
+    mfLimb high = hh + (lh >> 32) + (hl >> 32) + (mid >> 32);
+    lo += c1; high += (lo < c1);
+    lo += c2; high += (lo < c2);
+    *hi = high;
+    return lo;
+#endif
+}
+
+static mfLimb mfAddLimbs( const mfLimb *a1, const mfLimb *a2, mfLimb *d, unsigned int count )
+{
+    mfLimb carry = 0;
+    unsigned int i;
+    for( i = 0; i < count; i++ ) {
+        mfLimb t = a1[i] + carry;
+        carry = (t < carry);
+        d[i] = t + a2[i];
+        carry += (d[i] < t);
+    }
+    return carry;
+}
+static mfLimb mfSubstractLimbs( const mfLimb *s1, const mfLimb *s2, mfLimb *d, unsigned int count )
+{
+    mfLimb borrow = 0;
+    unsigned int i;
+    for( i = 0; i < count; i++ ) {
+        mfLimb t = s1[i] - s2[i];
+        mfLimb b = (s1[i] < s2[i]);
+        d[i] = t - borrow;
+        borrow = b | (t < borrow);
+    }
+    return borrow;
+}
+MF_INLINE int mfBackendAdd( const mfU8 *a1, const mfU8 *a2, mfU8 *d, unsigned int bytes )
+{
+    MF_STATS_CALL(mfMathOperationAdd, bytes);
+    mfLimb x[MF_MAX_LIMBS], y[MF_MAX_LIMBS];
+    unsigned int count = bytes / 8;
+    mfLoadLimbs(a1, x, count);
+    mfLoadLimbs(a2, y, count);
+    mfLimb carry = mfAddLimbs(x, y, x, count);
+    mfStoreLimbs(x, d, count);
+    return carry ? 1 : 0;
+}
+MF_INLINE int mfBackendSubstract( const mfU8 *s1, const mfU8 *s2, mfU8 *d, unsigned int bytes )
+{
+    MF_STATS_CALL(mfMathOperationSubstract, bytes);
+    mfLimb x[MF_MAX_LIMBS], y[MF_MAX_LIMBS];
+    unsigned int count = bytes / 8;
+    mfLoadLimbs(s1, x, count);
+    mfLoadLimbs(s2, y, count);
+    mfLimb borrow = mfSubstractLimbs(x, y, x, count);
+    mfStoreLimbs(x, d, count);
+    return borrow ? 1 : 0;
+}
+// Schoolbook multiplication of count limbs, p receives 2 * count limbs
+static void mfMultiplyLimbs( const mfLimb *x, const mfLimb *y, mfLimb *p, unsigned int count )
+{
+    unsigned int i, j;
+    for( i = 0; i < 2 * count; i++ ) p[i] = 0;
+    for( i = 0; i < count; i++ ) {
+        mfLimb carry = 0;
+        for( j = 0; j < count; j++ ) {
+            p[i + j] = mfMultiplyAddLimb(x[i], y[j], p[i + j], carry, &carry);
+        }
+        p[i + count] = carry;
+    }
+}
+static void mfMultiplyLimbs2( const mfLimb *x, const mfLimb *y, mfLimb *p ) { mfMultiplyLimbs(x, y, p, 2); }
+static void mfMultiplyLimbs4( const mfLimb *x, const mfLimb *y, mfLimb *p ) { mfMultiplyLimbs(x, y, p, 4); }
+
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__)) && !defined(MFMATHLIB_NO_ADX)
+#include <cpuid.h>
+
+// MULX/ADCX/ADOX kernels for the 128 and 256-bit multiplications
+//
+// Each row multiplies one limb of x (held in rdx for mulx) by all the limbs of y.  The low halves
+// of the partial products are accumulated into p through the carry flag chain (adcx) while the
+// high halves are added to the next low half through the overflow flag chain (adox), so both
+// chains progress without serializing on a single flag.  p[i + count] is still zero when row i
+// starts, which lets the final limb fold both flags without losing a carry.
+static void mfMultiplyLimbs2Adx( const mfLimb *x, const mfLimb *y, mfLimb *p )
+{
+    mfLimb lo, h0, h1, zero;
+    unsigned int i;
+    p[0] = p[1] = p[2] = p[3] = 0;
+    for( i = 0; i < 2; i++ ) {
+        __asm__ volatile(
+            "xorl %k[zero], %k[zero]\n\t"
+            "mulxq 0(%[y]), %[lo], %[h0]\n\t"
+            "adcxq 0(%[p]), %[lo]\n\t"
+            "movq %[lo], 0(%[p])\n\t"
+            "mulxq 8(%[y]), %[lo], %[h1]\n\t"
+            "adoxq %[h0], %[lo]\n\t"
+            "adcxq 8(%[p]), %[lo]\n\t"
+            "movq %[lo], 8(%[p])\n\t"
+            "adoxq %[zero], %[h1]\n\t"
+            "adcxq %[zero], %[h1]\n\t"
+            "movq %[h1], 16(%[p])\n\t"
+            : [lo] "=&r" (lo), [h0] "=&r" (h0), [h1] "=&r" (h1), [zero] "=&r" (zero)
+            : "d" (x[i]), [y] "r" (y), [p] "r" (&p[i])
+            : "cc", "memory");
+    }
+}
+static void mfMultiplyLimbs4Adx( const mfLimb *x, const mfLimb *y, mfLimb *p )
+{
+    mfLimb lo, h0, h1, zero;
+    unsigned int i;
+    for( i = 0; i < 8; i++ ) p[i] = 0;
+    for( i = 0; i < 4; i++ ) {
+        __asm__ volatile(
+            "xorl %k[zero], %k[zero]\n\t"
+            "mulxq 0(%[y]), %[lo], %[h0]\n\t"
+            "adcxq 0(%[p]), %[lo]\n\t"
+            "movq %[lo], 0(%[p])\n\t"
+            "mulxq 8(%[y]), %[lo], %[h1]\n\t"
+            "adoxq %[h0], %[lo]\n\t"
+            "adcxq 8(%[p]), %[lo]\n\t"
+            "movq %[lo], 8(%[p])\n\t"
+            "mulxq 16(%[y]), %[lo], %[h0]\n\t"
+            "adoxq %[h1], %[lo]\n\t"
+            "adcxq 16(%[p]), %[lo]\n\t"
+            "movq %[lo], 16(%[p])\n\t"
+            "mulxq 24(%[y]), %[lo], %[h1]\n\t"
+            "adoxq %[h0], %[lo]\n\t"
+            "adcxq 24(%[p]), %[lo]\n\t"
+            "movq %[lo], 24(%[p])\n\t"
+            "adoxq %[zero], %[h1]\n\t"
+            "adcxq %[zero], %[h1]\n\t"
+            "movq %[h1], 32(%[p])\n\t"
+            : [lo] "=&r" (lo), [h0] "=&r" (h0), [h1] "=&r" (h1), [zero] "=&r" (zero)
+            : "d" (x[i]), [y] "r" (y), [p] "r" (&p[i])
+            : "cc", "memory");
+    }
+}
+
+static void mfResolveMultiplyKernels( void );
+static void mfResolveMultiplyLimbs2( const mfLimb *x, const mfLimb *y, mfLimb *p ) { mfResolveMultiplyKernels(); mfMultiplyLimbs2(x, y, p); }
+static void mfResolveMultiplyLimbs4( const mfLimb *x, const mfLimb *y, mfLimb *p ) { mfResolveMultiplyKernels(); mfMultiplyLimbs4(x, y, p); }
+typedef void (*mfMultiplyKernelFunction)( const mfLimb *x, const mfLimb *y, mfLimb *p );
+
+// Threads may resolve the kernels at the same time, they store the same values; the pointers are
+// only accessed atomically
+static mfMultiplyKernelFunction mfMultiplyKernel2Selected = mfResolveMultiplyLimbs2;
+static mfMultiplyKernelFunction mfMultiplyKernel4Selected = mfResolveMultiplyLimbs4;
+static const char *mfMultiplyKernel = 0;
+#define mfMultiplyKernel2 (__atomic_load_n(&mfMultiplyKernel2Selected, __ATOMIC_ACQUIRE))
+#define mfMultiplyKernel4 (__atomic_load_n(&mfMultiplyKernel4Selected, __ATOMIC_ACQUIRE))
+
+// Selects the kernels once, the ADX kernels are only used when the CPU supports BMI2 and ADX and
+// they produce the same products as the generic path on a set of known operands.
+static void mfResolveMultiplyKernels( void )
+{
+    unsigned int eax, ebx = 0, ecx, edx;
+    int use_adx = 0;
+    if( __get_cpuid_max(0, 0) >= 7 ) {
+        __cpuid_count(7, 0, eax, ebx, ecx, edx);
+        use_adx = (ebx & (1u << 8)) && (ebx & (1u << 19));    // BMI2, ADX
+    }
+    if( use_adx ) {
+        static const mfLimb samples[4][4] = {
+            { 0xFFFFFFFFFFFFFFFFULL, 0xFFFFFFFFFFFFFFFFULL, 0xFFFFFFFFFFFFFFFFULL, 0xFFFFFFFFFFFFFFFFULL },
+            { 0x0123456789ABCDEFULL, 0xFEDCBA9876543210ULL, 0x8000000000000001ULL, 0x7FFFFFFFFFFFFFFFULL },
+            { 0x0000000000000001ULL, 0x0000000000000000ULL, 0xFFFFFFFFFFFFFFFFULL, 0x0000000000000000ULL },
+            { 0x9E3779B97F4A7C15ULL, 0xC2B2AE3D27D4EB4FULL, 0x165667B19E3779F9ULL, 0xD6E8FEB86659FD93ULL },
+        };
+        unsigned int i, j, k;
+        for( i = 0; i < 4 && use_adx; i++ ) {
+            for( j = 0; j < 4 && use_adx; j++ ) {
+                mfLimb expected[8], product[8];
+                mfMultiplyLimbs(samples[i], samples[j], expected, 4);
+                mfMultiplyLimbs4Adx(samples[i], samples[j], product);
+                for( k = 0; k < 8; k++ ) if( product[k] != expected[k] ) use_adx = 0;
+                mfMultiplyLimbs(samples[i], samples[j], expected, 2);
+                mfMultiplyLimbs2Adx(samples[i], samples[j], product);
+                for( k = 0; k < 4; k++ ) if( product[k] != expected[k] ) use_adx = 0;
+            }
+        }
+    }
+    __atomic_store_n(&mfMultiplyKernel2Selected, use_adx ? mfMultiplyLimbs2Adx : mfMultiplyLimbs2, __ATOMIC_RELEASE);
+    __atomic_store_n(&mfMultiplyKernel4Selected, use_adx ? mfMultiplyLimbs4Adx : mfMultiplyLimbs4, __ATOMIC_RELEASE);
+    __atomic_store_n(&mfMultiplyKernel, use_adx ? "mulx/adx" : "generic", __ATOMIC_RELEASE);
+}
+
+const char *mfMultiplyKernelName( void )
+{
+    const char *name = __atomic_load_n(&mfMultiplyKernel, __ATOMIC_ACQUIRE);
+    if( name == 0 ) {
+        mfResolveMultiplyKernels();
+        name = __atomic_load_n(&mfMultiplyKernel, __ATOMIC_ACQUIRE);
+    }
+    return name;
+}
+#else
+#define mfMultiplyKernel2 mfMultiplyLimbs2
+#define mfMultiplyKernel4 mfMultiplyLimbs4
+const char *mfMultiplyKernelName( void ) { return "generic"; }
+#endif
+
+// Limb count from which the multiplication and squaring split their operands (Karatsuba).  The three
+// half size products save a quarter of the limb products but add passes of additions, which the
+// mulx kernels only recover above the 16 limbs of the widest type; lower it for other targets.
+#ifndef MFMATHLIB_KARATSUBA_THRESHOLD
+#define MFMATHLIB_KARATSUBA_THRESHOLD 32
+#endif
+
+// Schoolbook squaring of count limbs, p receives 2 * count limbs.  The products x[i] * x[j] with i < j
+// appear twice in the square, they are computed once and the sum doubled before adding the diagonal.
+static void mfSquareLimbs( const mfLimb *x, mfLimb *p, unsigned int count )
+{
+    unsigned int i, j;
+    for( i = 0; i < 2 * count; i++ ) p[i] = 0;
+    for( i = 0; i + 1 < count; i++ ) {
+        mfLimb carry = 0;
+        for( j = i + 1; j < count; j++ ) {
+            p[i + j] = mfMultiplyAddLimb(x[i], x[j], p[i + j], carry, &carry);
+        }
+        p[i + count] = carry;
+    }
+    mfLimb top = 0;
+    for( i = 0; i < 2 * count; i++ ) {
+        mfLimb next = p[i] >> 63;
+        p[i] = (p[i] << 1) | top;
+        top = next;
+    }
+    mfLimb carry = 0;
+    for( i = 0; i < count; i++ ) {
+        mfLimb square_hi, square_lo = mfMultiplyAddLimb(x[i], x[i], 0, 0, &square_hi);
+        mfLimb t = p[2 * i] + carry;
+        carry = (t < carry);
+        p[2 * i] = t + square_lo;
+        carry += (p[2 * i] < square_lo);
+        t = p[2 * i + 1] + carry;
+        carry = (t < carry);
+        p[2 * i + 1] = t + square_hi;
+        carry += (p[2 * i + 1] < square_hi);
+    }
+}
+
+// |x - y| of count limbs into d, returns 1 if x < y
+static int mfDifferenceLimbs( const mfLimb *x, const mfLimb *y, mfLimb *d, unsigned int count )
+{
+    unsigned int i = count;
+    while( i > 0 && x[i - 1] == y[i - 1] ) i--;
+    if( i > 0 && x[i - 1] < y[i - 1] ) {
+        mfSubstractLimbs(y, x, d, count);
+        return 1;
+    }
+    mfSubstractLimbs(x, y, d, count);
+    return 0;
+}
+
+// Adds the middle term of a Karatsuba product to p, given the low and high halves of the product
+// already in p: middle = low + high + m, or low + high - m when negative is set.  The middle term
+// fits in 2 * half + 1 limbs, its carry is propagated through the high half.
+static void mfAddKaratsubaMiddle( mfLimb *p, const mfLimb *m, int negative, unsigned int half )
+{
+    mfLimb middle[MF_MAX_LIMBS];
+    unsigned int i;
+    mfLimb carry = mfAddLimbs(p, &p[2 * half], middle, 2 * half);
+    if( negative ) {
+        carry -= mfSubstractLimbs(middle, m, middle, 2 * half);
+    } else {
+        carry += mfAddLimbs(middle, m, middle, 2 * half);
+    }
+    carry += mfAddLimbs(&p[half], middle, &p[half], 2 * half);
+    for( i = 3 * half; carry != 0 && i < 4 * half; i++ ) {
+        p[i] += carry;
+        carry = (p[i] < carry);
+    }
+}
+
+// Multiplication of count limbs, p receives 2 * count limbs.  From MFMATHLIB_KARATSUBA_THRESHOLD limbs,
+// x = x1 * B + x0 and y = y1 * B + y0 are multiplied with three half size products instead of four:
+// x * y = x1 * y1 * B^2 + (x1 * y1 + x0 * y0 + (x0 - x1) * (y1 - y0)) * B + x0 * y0
+static void mfMultiplyLimbsKaratsuba( const mfLimb *x, const mfLimb *y, mfLimb *p, unsigned int count )
+{
+    if( count < MFMATHLIB_KARATSUBA_THRESHOLD || (count & 1) != 0 ) {
+        if( count == 2 ) {
+            mfMultiplyKernel2(x, y, p);
+        } else if( count == 4 ) {
+            mfMultiplyKernel4(x, y, p);
+        } else {
+            mfMultiplyLimbs(x, y, p, count);
+        }
+        return;
+    }
+    mfLimb dx[MF_MAX_LIMBS / 2], dy[MF_MAX_LIMBS / 2], m[MF_MAX_LIMBS];
+    unsigned int half = count / 2;
+    mfMultiplyLimbsKaratsuba(x, y, p, half);
+    mfMultiplyLimbsKaratsuba(&x[half], &y[half], &p[count], half);
+    int negative = mfDifferenceLimbs(x, &x[half], dx, half);
+    negative ^= mfDifferenceLimbs(&y[half], y, dy, half);
+    mfMultiplyLimbsKaratsuba(dx, dy, m, half);
+    mfAddKaratsubaMiddle(p, m, negative, half);
+}
+
+// Squaring of count limbs, p receives 2 * count limbs, with the Karatsuba split from
+// MFMATHLIB_KARATSUBA_THRESHOLD limbs: the middle term is x1^2 + x0^2 - (x0 - x1)^2
+static void mfSquareLimbsKaratsuba( const mfLimb *x, mfLimb *p, unsigned int count )
+{
+    if( count < MFMATHLIB_KARATSUBA_THRESHOLD || (count & 1) != 0 ) {
+        // Up to 4 limbs the multiplication kernels are faster than the symmetric squaring
+        if( count <= 4 ) {
+            mfMultiplyLimbsKaratsuba(x, x, p, count);
+        } else {
+            mfSquareLimbs(x, p, count);
+        }
+        return;
+    }
+    mfLimb dx[MF_MAX_LIMBS / 2], m[MF_MAX_LIMBS];
+    unsigned int half = count / 2;
+    mfSquareLimbsKaratsuba(x, p, half);
+    mfSquareLimbsKaratsuba(&x[half], &p[count], half);
+    mfDifferenceLimbs(x, &x[half], dx, half);
+    mfSquareLimbsKaratsuba(dx, m, half);
+    mfAddKaratsubaMiddle(p, m, 1, half);
+}
+
+MF_INLINE void mfBackendMultiply( const mfU8 *s1, const mfU8 *s2, mfU8 *d, mfU8 *o, unsigned int bytes )
+{
+    MF_STATS_CALL(mfMathOperationMultiply, bytes);
+    mfLimb x[MF_MAX_LIMBS], y[MF_MAX_LIMBS], p[2 * MF_MAX_LIMBS];
+    unsigned int count = bytes / 8;
+    mfLoadLimbs(s1, x, count);
+    if( s1 == s2 ) {
+        mfSquareLimbsKaratsuba(x, p, count);
+    } else {
+        mfLoadLimbs(s2, y, count);
+        mfMultiplyLimbsKaratsuba(x, y, p, count);
+    }
+    mfStoreLimbs(p, d, count);
+    mfStoreLimbs(&p[count], o, count);
+}
+MF_INLINE void mfBackendSquare( const mfU8 *s, mfU8 *d, mfU8 *o, unsigned int bytes )
+{
+    MF_STATS_CALL(mfMathOperationMultiply, bytes);
+    mfLimb x[MF_MAX_LIMBS], p[2 * MF_MAX_LIMBS];
+    unsigned int count = bytes / 8;
+    mfLoadLimbs(s, x, count);
+    mfSquareLimbsKaratsuba(x, p, count);
+    mfStoreLimbs(p, d, count);
+    mfStoreLimbs(&p[count], o, count);
+}
+// (hi, lo) / d, with hi < d and the most significant bit of d set; returns the quotient, remainder in r
+static inline mfLimb mfDivideLimb( mfLimb hi, mfLimb lo, mfLimb d, mfLimb *r )
+{
+#if defined(__x86_64__) && (defined(__GNUC__) || defined(__clang__))
+    mfLimb quotient;
+    __asm__("divq %4" : "=a"(quotient), "=d"(*r) : "a"(lo), "d"(hi), "rm"(d) : "cc");
+    return quotient;
+#elif defined(__SIZEOF_INT128__)
+    unsigned __int128 dividend = ((unsigned __int128)hi << 64) | lo;
+    *r = (mfLimb)(dividend % d);
+    return (mfLimb)(dividend / d);
+#else
+    // Two 64 by 32-bit digit steps (Hacker's Delight, divlu)
+    const mfLimb b = (mfLimb)1 << 32;
+    mfLimb d1 = d >> 32, d0 = d & 0xFFFFFFFF;
+    mfLimb lo1 = lo >> 32, lo0 = lo & 0xFFFFFFFF;
+    mfLimb q1 = hi / d1, rhat = hi - q1 * d1;
+    while( q1 >= b || q1 * d0 > b * rhat + lo1 ) {
+        q1--;
+        rhat += d1;
+        if( rhat >= b ) break;
+    }
+    mfLimb middle = hi * b + lo1 - q1 * d;
+    mfLimb q0 = middle / d1;
+    rhat = middle - q0 * d1;
+    while( q0 >= b || q0 * d0 > b * rhat + lo0 ) {
+        q0--;
+        rhat += d1;
+        if( rhat >= b ) break;
+    }
+    *r = middle * b + lo0 - q0 * d;
+    return q1 * b + q0;
+#endif
+}
+
+// Multi-word long division, Knuth TAOCP vol. 2, 4.3.1 Algorithm D, on 64-bit limbs
+MF_INLINE int mfBackendDivide( const mfU8 *n, const mfU8 *d, mfU8 *q, mfU8 *r, unsigned int bytes )
+{
+    MF_STATS_CALL(mfMathOperationDivide, bytes);
+    mfLimb u[MF_MAX_LIMBS + 1], v[MF_MAX_LIMBS], ql[MF_MAX_LIMBS], rl[MF_MAX_LIMBS];
+    unsigned int count = bytes / 8;
+    unsigned int i, j;
+    mfLoadLimbs(n, u, count);
+    mfLoadLimbs(d, v, count);
+
+    unsigned int dn = count;
+    while( dn > 0 && v[dn - 1] == 0 ) dn--;
+    if( dn == 0 ) return -1;
+    unsigned int nn = count;
+    while( nn > 0 && u[nn - 1] == 0 ) nn--;
+
+    for( i = 0; i < count; i++ ) { ql[i] = 0; rl[i] = 0; }
+    if( nn < dn ) {
+        // n < d
+        mfStoreLimbs(ql, q, count);
+        mfStoreLimbs(u, r, count);
+        return 0;
+    }
+
+    // Normalize so the most significant bit of the divisor is set, n gains a limb
+    unsigned int shift = mfCountLeadingZerosLimb(v[dn - 1]);
+    u[nn] = 0;
+    if( shift != 0 ) {
+        for( i = dn - 1; i > 0; i-- ) v[i] = (v[i] << shift) | (v[i - 1] >> (64 - shift));
+        v[0] <<= shift;
+        u[nn] = u[nn - 1] >> (64 - shift);
+        for( i = nn - 1; i > 0; i-- ) u[i] = (u[i] << shift) | (u[i - 1] >> (64 - shift));
+        u[0] <<= shift;
+    }
+
+    mfLimb top = v[dn - 1];
+    mfLimb next = dn > 1 ? v[dn - 2] : 0;
+    for( j = nn - dn + 1; j-- > 0; ) {
+        // Estimate the quotient limb from the top limbs, then refine it with the second limb of the
+        // divisor; the estimate is then at most one too large
+        mfLimb qhat, rhat;
+        int rhat_overflow = 0;
+        if( u[j + dn] >= top ) {
+            qhat = ~(mfLimb)0;
+            rhat = u[j + dn - 1] + top;
+            rhat_overflow = rhat < top;
+        } else {
+            qhat = mfDivideLimb(u[j + dn], u[j + dn - 1], top, &rhat);
+        }
+        if( dn > 1 ) {
+            while( rhat_overflow == 0 ) {
+                mfLimb product_hi, product_lo = mfMultiplyAddLimb(qhat, next, 0, 0, &product_hi);
+                if( product_hi < rhat || (product_hi == rhat && product_lo <= u[j + dn - 2]) ) break;
+                qhat--;
+                rhat += top;
+                rhat_overflow = rhat < top;
+            }
+        }
+
+        // Multiply and substract qhat * d
+        mfLimb carry = 0, borrow = 0, t, b;
+        for( i = 0; i < dn; i++ ) {
+            mfLimb product_hi, product_lo = mfMultiplyAddLimb(qhat, v[i], carry, 0, &product_hi);
+            carry = product_hi;
+            t = u[i + j] - product_lo;
+            b = (u[i + j] < product_lo);
+            u[i + j] = t - borrow;
+            borrow = b | (t < borrow);
+        }
+        t = u[j + dn] - carry;
+        b = (u[j + dn] < carry);
+        u[j + dn] = t - borrow;
+        borrow = b | (t < borrow);
+
+        // The estimate was one too large, add the divisor back
+        if( borrow ) {
+            qhat--;
+            u[j + dn] += mfAddLimbs(&u[j], v, &u[j], dn);
+        }
+        ql[j] = qhat;
+    }
+
+    // The remainder is left in the low limbs of u, normalized
+    for( i = 0; i < dn; i++ ) {
+        rl[i] = u[i] >> shift;
+        if( shift != 0 && i + 1 < dn ) rl[i] |= u[i + 1] << (64 - shift);
+    }
+    mfStoreLimbs(ql, q, count);
+    mfStoreLimbs(rl, r, count);
+    return 0;
+}
+
+#elif MFMATHLIB_BACKEND == MFMATHLIB_BACKEND_GMP
+
+const char *mfBackendName( void ) { return "gmp"; }
+const char *mfMultiplyKernelName( void ) { return "gmp"; }
+
+MF_INLINE int mfBackendAdd( const mfU8 *a1, const mfU8 *a2, mfU8 *d, unsigned int bytes )
+{
+    MF_STATS_CALL(mfMathOperationAdd, bytes);
+    mp_limb_t x[MF_MAX_LIMBS], y[MF_MAX_LIMBS];
+    unsigned int count = bytes / 8;
+    mfLoadLimbs(a1, x, count);
+    mfLoadLimbs(a2, y, count);
+    mp_limb_t carry = mpn_add_n(x, x, y, count);
+    mfStoreLimbs(x, d, count);
+    return carry ? 1 : 0;
+}
+MF_INLINE int mfBackendSubstract( const mfU8 *s1, const mfU8 *s2, mfU8 *d, unsigned int bytes )
+{
+    MF_STATS_CALL(mfMathOperationSubstract, bytes);
+    mp_limb_t x[MF_MAX_LIMBS], y[MF_MAX_LIMBS];
+    unsigned int count = bytes / 8;
+    mfLoadLimbs(s1, x, count);
+    mfLoadLimbs(s2, y, count);
+    mp_limb_t borrow = mpn_sub_n(x, x, y, count);
+    mfStoreLimbs(x, d, count);
+    return borrow ? 1 : 0;
+}
+MF_INLINE void mfBackendMultiply( const mfU8 *s1, const mfU8 *s2, mfU8 *d, mfU8 *o, unsigned int bytes )
+{
+    MF_STATS_CALL(mfMathOperationMultiply, bytes);
+    mp_limb_t x[MF_MAX_LIMBS], y[MF_MAX_LIMBS], p[2 * MF_MAX_LIMBS];
+    unsigned int count = bytes / 8;
+    mfLoadLimbs(s1, x, count);
+    mfLoadLimbs(s2, y, count);
+    mpn_mul_n(p, x, y, count);
+    mfStoreLimbs(p, d, count);
+    mfStoreLimbs(&p[count], o, count);
+}
+MF_INLINE void mfBackendSquare( const mfU8 *s, mfU8 *d, mfU8 *o, unsigned int bytes )
+{
+    MF_STATS_CALL(mfMathOperationMultiply, bytes);
+    mp_limb_t x[MF_MAX_LIMBS], p[2 * MF_MAX_LIMBS];
+    unsigned int count = bytes / 8;
+    mfLoadLimbs(s, x, count);
+    mpn_sqr(p, x, count);
+    mfStoreLimbs(p, d, count);
+    mfStoreLimbs(&p[count], o, count);
+}
+MF_INLINE int mfBackendDivide( const mfU8 *n, const mfU8 *d, mfU8 *q, mfU8 *r, unsigned int bytes )
+{
+    MF_STATS_CALL(mfMathOperationDivide, bytes);
+    mp_limb_t nl[MF_MAX_LIMBS], dl[MF_MAX_LIMBS], ql[MF_MAX_LIMBS + 1], rl[MF_MAX_LIMBS];
+    unsigned int count = bytes / 8;
+    unsigned int i;
+    mfLoadLimbs(n, nl, count);
+    mfLoadLimbs(d, dl, count);
+
+    // mpn_tdiv_qr requires the most significant limb of the divisor to be non-zero
+    unsigned int dn = count;
+    while( dn > 0 && dl[dn - 1] == 0 ) dn--;
+    if( dn == 0 ) return -1;
+
+    for( i = 0; i < count; i++ ) { ql[i] = 0; rl[i] = 0; }
+    mpn_tdiv_qr(ql, rl, 0, nl, count, dl, dn);
+    mfStoreLimbs(ql, q, count);
+    mfStoreLimbs(rl, r, count);
+    return 0;
+}
+
+#else
+#error "Unknown MFMATHLIB_BACKEND"
+#endif
+#endif
+
 #pragma mark - Add
 // Add a1 to a2, store result in d
 // d can be the same address as a1 or a2.
@@ -85,6 +828,7 @@ void mfZero1024( mfU1024 *d ) { mfZeroX( d->b, sizeof(mfU1024)); }
 // 1 = addition completed with overflow
 int mfAddUX( const mfU8 *a1, const mfU8 *a2, mfU8 *d, unsigned int bytes)
 {
+    MF_STATS_CALL(mfMathOperationAdd, bytes);
     unsigned int t = 0;
     unsigned int i = 0;
     unsigned int a1_u, a2_u;
@@ -100,17 +844,18 @@ int mfAddUX( const mfU8 *a1, const mfU8 *a2, mfU8 *d, unsigned int bytes)
 }
 int mfAddU8( const mfU8 *a1, const mfU8 *a2, mfU8 *d)
 {
+    MF_STATS_CALL(mfMathOperationAdd, 1);
     unsigned int x = *a1 + *a2;
     *d = (unsigned char)(x & 0xFF);
     return (x >> 8) & 0x01;
 }
 int mfAddU16( const mfU16 *a1, const mfU16 *a2, mfU16 *d) { return mfAddUX( a1->b, a2->b, d->b, sizeof(mfU16)); }
 int mfAddU32( const mfU32 *a1, const mfU32 *a2, mfU32 *d) { return mfAddUX( a1->b, a2->b, d->b, sizeof(mfU32)); }
-int mfAddU64( const mfU64 *a1, const mfU64 *a2, mfU64 *d) { return mfAddUX( a1->b, a2->b, d->b, sizeof(mfU64)); }
-int mfAddU128( const mfU128 *a1, const mfU128 *a2, mfU128 *d) { return mfAddUX( a1->b, a2->b, d->b, sizeof(mfU128)); }
-int mfAddU256( const mfU256 *a1, const mfU256 *a2, mfU256 *d) { return mfAddUX( a1->b, a2->b, d->b, sizeof(mfU256)); }
-int mfAddU512( const mfU512 *a1, const mfU512 *a2, mfU512 *d) { return mfAddUX( a1->b, a2->b, d->b, sizeof(mfU512)); }
-int mfAddU1024( const mfU1024 *a1, const mfU1024 *a2, mfU1024 *d) { return mfAddUX( a1->b, a2->b, d->b, sizeof(mfU1024)); }
+int mfAddU64( const mfU64 *a1, const mfU64 *a2, mfU64 *d) { return mfBackendAdd( a1->b, a2->b, d->b, sizeof(mfU64)); }
+int mfAddU128( const mfU128 *a1, const mfU128 *a2, mfU128 *d) { return mfBackendAdd( a1->b, a2->b, d->b, sizeof(mfU128)); }
+int mfAddU256( const mfU256 *a1, const mfU256 *a2, mfU256 *d) { return mfBackendAdd( a1->b, a2->b, d->b, sizeof(mfU256)); }
+int mfAddU512( const mfU512 *a1, const mfU512 *a2, mfU512 *d) { return mfBackendAdd( a1->b, a2->b, d->b, sizeof(mfU512)); }
+int mfAddU1024( const mfU1024 *a1, const mfU1024 *a2, mfU1024 *d) { return mfBackendAdd( a1->b, a2->b, d->b, sizeof(mfU1024)); }
 
 #pragma mark - Substract
 
@@ -120,7 +865,8 @@ int mfAddU1024( const mfU1024 *a1, const mfU1024 *a2, mfU1024 *d) { return mfAdd
 // 1 = substraction completed with underflow (s2 was bigger than s1)
 int mfSubstractUX( const mfU8 *s1, const mfU8 *s2, mfU8 *d, unsigned int bytes)
 {
-    mfU8 *left_over = (mfU8 *)malloc(bytes);
+    MF_STATS_CALL(mfMathOperationSubstract, bytes);
+    mfU8 *left_over = (mfU8 *)MF_MALLOC(mfMathOperationSubstract, bytes);
     mfCopyX(s1, left_over, bytes);
 
     int underflow = 0;
@@ -159,21 +905,23 @@ int mfSubstractUX( const mfU8 *s1, const mfU8 *s2, mfU8 *d, unsigned int bytes)
 int mfSubstractU8( const mfU8 *s1, const mfU8 *s2, mfU8 *d) { return mfSubstractUX(s1, s2, d, sizeof(mfU8)); }
 int mfSubstractU16( const mfU16 *s1, const mfU16 *s2, mfU16 *d) { return mfSubstractUX(s1->b, s2->b, d->b, sizeof(mfU16)); }
 int mfSubstractU32( const mfU32 *s1, const mfU32 *s2, mfU32 *d) { return mfSubstractUX(s1->b, s2->b, d->b, sizeof(mfU32)); }
-int mfSubstractU64( const mfU64 *s1, const mfU64 *s2, mfU64 *d) { return mfSubstractUX(s1->b, s2->b, d->b, sizeof(mfU64)); }
-int mfSubstractU128( const mfU128 *s1, const mfU128 *s2, mfU128 *d) { return mfSubstractUX(s1->b, s2->b, d->b, sizeof(mfU128)); }
-int mfSubstractU256( const mfU256 *s1, const mfU256 *s2, mfU256 *d) { return mfSubstractUX(s1->b, s2->b, d->b, sizeof(mfU256)); }
-int mfSubstractU512( const mfU512 *s1, const mfU512 *s2, mfU512 *d) { return mfSubstractUX(s1->b, s2->b, d->b, sizeof(mfU512)); }
-int mfSubstractU1024( const mfU1024 *s1, const mfU1024 *s2, mfU1024 *d) { return mfSubstractUX(s1->b, s2->b, d->b, sizeof(mfU1024)); }
+int mfSubstractU64( const mfU64 *s1, const mfU64 *s2, mfU64 *d) { return mfBackendSubstract(s1->b, s2->b, d->b, sizeof(mfU64)); }
+int mfSubstractU128( const mfU128 *s1, const mfU128 *s2, mfU128 *d) { return mfBackendSubstract(s1->b, s2->b, d->b, sizeof(mfU128)); }
+int mfSubstractU256( const mfU256 *s1, const mfU256 *s2, mfU256 *d) { return mfBackendSubstract(s1->b, s2->b, d->b, sizeof(mfU256)); }
+int mfSubstractU512( const mfU512 *s1, const mfU512 *s2, mfU512 *d) { return mfBackendSubstract(s1->b, s2->b, d->b, sizeof(mfU512)); }
+int mfSubstractU1024( const mfU1024 *s1, const mfU1024 *s2, mfU1024 *d) { return mfBackendSubstract(s1->b, s2->b, d->b, sizeof(mfU1024)); }
 
 #pragma mark - Shift Right
 void mfShift128Right32( mfU128 *x )
 {
+    MF_STATS_CALL(mfMathOperationShiftRightByN, sizeof(mfU128));
     x->l64.l32 = x->l64.h32;
     x->l64.h32 = x->h64.l32;
     x->h64.l32 = x->h64.h32;
     mfZero32(&x->h64.h32);
 }
 void mfShiftRightXBy1( unsigned char *x, unsigned int bytes ) {
+    MF_STATS_CALL(mfMathOperationShiftRightBy1, bytes);
     while( bytes > 1 ) {
         x[0] = ((x[0] >> 1) & 0x7F) | ((x[1] << 7) & 0x80);
         x = &x[1];
@@ -181,7 +929,7 @@ void mfShiftRightXBy1( unsigned char *x, unsigned int bytes ) {
     }
     x[0] = x[0] >> 1;
 }
-void mfShiftRight8By1( mfU8 *x) { *x = *x >> 1; }
+void mfShiftRight8By1( mfU8 *x) { MF_STATS_CALL(mfMathOperationShiftRightBy1, 1); *x = *x >> 1; }
 void mfShiftRight16By1( mfU16 *x) { mfShiftRightXBy1( x->b, sizeof(mfU16)); }
 void mfShiftRight32By1( mfU32 *x) { mfShiftRightXBy1( x->b, sizeof(mfU32)); }
 void mfShiftRight64By1( mfU64 *x) { mfShiftRightXBy1( x->b, sizeof(mfU64)); }
@@ -190,15 +938,40 @@ void mfShiftRight256By1( mfU256 *x ) { mfShiftRightXBy1(x->b, sizeof(mfU256)); }
 void mfShiftRight512By1( mfU512 *x ) { mfShiftRightXBy1(x->b, sizeof(mfU512)); }
 void mfShiftRight1024By1( mfU1024 *x ) { mfShiftRightXBy1(x->b, sizeof(mfU1024)); }
 
+void mfShiftRightUXByN( mfU8 *x, unsigned int n, unsigned int bytes )
+{
+    MF_STATS_CALL(mfMathOperationShiftRightByN, bytes);
+    unsigned int byte_shift = n / 8;
+    unsigned int bit_shift = n % 8;
+    unsigned int i;
+    for( i = 0; i < bytes; i++ ) {
+        unsigned int v = 0;
+        if( byte_shift < bytes - i ) {
+            v = x[i + byte_shift] >> bit_shift;
+            if( bit_shift != 0 && byte_shift < bytes - i - 1 ) v |= x[i + byte_shift + 1] << (8 - bit_shift);
+        }
+        x[i] = (mfU8)v;
+    }
+}
+void mfShiftRightU8ByN( mfU8 *x, unsigned int n ) { mfShiftRightUXByN( x, n, sizeof(mfU8)); }
+void mfShiftRightU16ByN( mfU16 *x, unsigned int n ) { mfShiftRightUXByN( x->b, n, sizeof(mfU16)); }
+void mfShiftRightU32ByN( mfU32 *x, unsigned int n ) { mfShiftRightUXByN( x->b, n, sizeof(mfU32)); }
+void mfShiftRightU64ByN( mfU64 *x, unsigned int n ) { mfBackendShiftRight( x->b, n, sizeof(mfU64)); }
+void mfShiftRightU128ByN( mfU128 *x, unsigned int n ) { mfBackendShiftRight( x->b, n, sizeof(mfU128)); }
+void mfShiftRightU256ByN( mfU256 *x, unsigned int n ) { mfBackendShiftRight( x->b, n, sizeof(mfU256)); }
+void mfShiftRightU512ByN( mfU512 *x, unsigned int n ) { mfBackendShiftRight( x->b, n, sizeof(mfU512)); }
+void mfShiftRightU1024ByN( mfU1024 *x, unsigned int n ) { mfBackendShiftRight( x->b, n, sizeof(mfU1024)); }
+
 #pragma mark - Shift Left
 void mfShiftLeftXBy1( unsigned char *x, unsigned int bytes ) {
+    MF_STATS_CALL(mfMathOperationShiftLeftBy1, bytes);
     while( bytes > 1 ) {
         bytes--;
         x[bytes] = ((x[bytes] << 1) & 0xFE) | ((x[bytes-1] >> 7) & 0x01);
     }
     x[0] = x[0] << 1;
 }
-void mfShiftLeft8By1( mfU8 *x) { *x = *x << 1; }
+void mfShiftLeft8By1( mfU8 *x) { MF_STATS_CALL(mfMathOperationShiftLeftBy1, 1); *x = *x << 1; }
 void mfShiftLeft16By1( mfU16 *x) { mfShiftLeftXBy1( x->b, sizeof(mfU16) ); }
 void mfShiftLeft32By1( mfU32 *x) { mfShiftLeftXBy1( x->b, sizeof(mfU32) ); }
 void mfShiftLeft64By1( mfU64 *x) { mfShiftLeftXBy1( x->b, sizeof(mfU64) ); }
@@ -207,10 +980,35 @@ void mfShiftLeft256By1( mfU256 *x) { mfShiftLeftXBy1( x->b, sizeof(mfU256) ); }
 void mfShiftLeft512By1( mfU512 *x) { mfShiftLeftXBy1( x->b, sizeof(mfU512) ); }
 void mfShiftLeft1024By1( mfU1024 *x) { mfShiftLeftXBy1( x->b, sizeof(mfU1024) ); }
 
+void mfShiftLeftUXByN( mfU8 *x, unsigned int n, unsigned int bytes )
+{
+    MF_STATS_CALL(mfMathOperationShiftLeftByN, bytes);
+    unsigned int byte_shift = n / 8;
+    unsigned int bit_shift = n % 8;
+    unsigned int i = bytes;
+    while( i-- > 0 ) {
+        unsigned int v = 0;
+        if( i >= byte_shift ) {
+            v = x[i - byte_shift] << bit_shift;
+            if( bit_shift != 0 && i > byte_shift ) v |= x[i - byte_shift - 1] >> (8 - bit_shift);
+        }
+        x[i] = (mfU8)v;
+    }
+}
+void mfShiftLeftU8ByN( mfU8 *x, unsigned int n ) { mfShiftLeftUXByN( x, n, sizeof(mfU8)); }
+void mfShiftLeftU16ByN( mfU16 *x, unsigned int n ) { mfShiftLeftUXByN( x->b, n, sizeof(mfU16)); }
+void mfShiftLeftU32ByN( mfU32 *x, unsigned int n ) { mfShiftLeftUXByN( x->b, n, sizeof(mfU32)); }
+void mfShiftLeftU64ByN( mfU64 *x, unsigned int n ) { mfBackendShiftLeft( x->b, n, sizeof(mfU64)); }
+void mfShiftLeftU128ByN( mfU128 *x, unsigned int n ) { mfBackendShiftLeft( x->b, n, sizeof(mfU128)); }
+void mfShiftLeftU256ByN( mfU256 *x, unsigned int n ) { mfBackendShiftLeft( x->b, n, sizeof(mfU256)); }
+void mfShiftLeftU512ByN( mfU512 *x, unsigned int n ) { mfBackendShiftLeft( x->b, n, sizeof(mfU512)); }
+void mfShiftLeftU1024ByN( mfU1024 *x, unsigned int n ) { mfBackendShiftLeft( x->b, n, sizeof(mfU1024)); }
+
 
 #pragma mark - Compare
 mfComparisonResult mfCompareUX( mfU8 *e, mfU8 *r, unsigned int bytes )
 {
+    MF_STATS_CALL(mfMathOperationCompare, bytes);
     mfU8 eb, rb;
     while( bytes-- ) {
         eb = e[bytes];
@@ -221,6 +1019,7 @@ mfComparisonResult mfCompareUX( mfU8 *e, mfU8 *r, unsigned int bytes )
     return mfCompareEqual;
 }
 mfComparisonResult mfCompareU8( mfU8 *e, mfU8 *r ) {
+    MF_STATS_CALL(mfMathOperationCompare, 1);
     if( *e > *r ) return mfCompareGreater;
     if( *e < *r ) return mfCompareSmaller;
     return mfCompareEqual;
@@ -236,13 +1035,14 @@ mfComparisonResult mfCompareU1024( mfU1024 *e, mfU1024 *r ) { return mfCompareUX
 #pragma mark - Zero Test
 unsigned int mfIsZeroX( const mfU8 *e, unsigned int bytes )
 {
+    MF_STATS_CALL(mfMathOperationIsZero, bytes);
     mfU8 eb = 0;
     while( bytes-- ) {
         eb = eb | e[bytes];
     }
     return (eb == 0) ? 1 : 0;
 }
-unsigned int mfIsZero8( const mfU8 *e ) { return (*e == 0) ? 1 : 0; }
+unsigned int mfIsZero8( const mfU8 *e ) { MF_STATS_CALL(mfMathOperationIsZero, 1); return (*e == 0) ? 1 : 0; }
 unsigned int mfIsZero16( const mfU16 *e ) { return mfIsZeroX( e->b, sizeof(mfU16) ); }
 unsigned int mfIsZero32( const mfU32 *e ) { return mfIsZeroX( e->b, sizeof(mfU32) ); }
 unsigned int mfIsZero64( const mfU64 *e ) { return mfIsZeroX( e->b, sizeof(mfU64) ); }
@@ -251,14 +1051,38 @@ unsigned int mfIsZero256( const mfU256 *e ) { return mfIsZeroX( e->b, sizeof(mfU
 unsigned int mfIsZero512( const mfU512 *e ) { return mfIsZeroX( e->b, sizeof(mfU512) ); }
 unsigned int mfIsZero1024( const mfU1024 *e ) { return mfIsZeroX( e->b, sizeof(mfU1024) ); }
 
+#pragma mark - Bit Length
+unsigned int mfBitLengthUX( const mfU8 *x, unsigned int bytes )
+{
+    MF_STATS_CALL(mfMathOperationBitLength, bytes);
+    while( bytes-- ) {
+        if( x[bytes] != 0 ) {
+            unsigned int bits = bytes * 8 + 1;
+            mfU8 top = x[bytes];
+            while( top >>= 1 ) bits++;
+            return bits;
+        }
+    }
+    return 0;
+}
+unsigned int mfBitLengthU8( const mfU8 *x ) { return mfBitLengthUX( x, sizeof(mfU8) ); }
+unsigned int mfBitLengthU16( const mfU16 *x ) { return mfBitLengthUX( x->b, sizeof(mfU16) ); }
+unsigned int mfBitLengthU32( const mfU32 *x ) { return mfBitLengthUX( x->b, sizeof(mfU32) ); }
+unsigned int mfBitLengthU64( const mfU64 *x ) { return mfBackendBitLength( x->b, sizeof(mfU64) ); }
+unsigned int mfBitLengthU128( const mfU128 *x ) { return mfBackendBitLength( x->b, sizeof(mfU128) ); }
+unsigned int mfBitLengthU256( const mfU256 *x ) { return mfBackendBitLength( x->b, sizeof(mfU256) ); }
+unsigned int mfBitLengthU512( const mfU512 *x ) { return mfBackendBitLength( x->b, sizeof(mfU512) ); }
+unsigned int mfBitLengthU1024( const mfU1024 *x ) { return mfBackendBitLength( x->b, sizeof(mfU1024) ); }
+
 #pragma mark - Bitwise or
 void mforX( const mfU8 *s1, const mfU8 *s2, mfU8 *d, unsigned bytes )
 {
+    MF_STATS_CALL(mfMathOperationOr, bytes);
     while( bytes-- ) {
         d[bytes] = s1[bytes] | s2[bytes];
     }
 }
-void mfor8( const mfU8 *s1, const mfU8 *s2, mfU8 *d ) { *d = *s1 | *s2; }
+void mfor8( const mfU8 *s1, const mfU8 *s2, mfU8 *d ) { MF_STATS_CALL(mfMathOperationOr, 1); *d = *s1 | *s2; }
 void mfor16( const mfU16 *s1, const mfU16 *s2, mfU16 *d ) { mforX(s1->b, s2->b, d->b, sizeof(mfU16)); }
 void mfor32( const mfU32 *s1, const mfU32 *s2, mfU32 *d ) { mforX(s1->b, s2->b, d->b, sizeof(mfU32)); }
 void mfor64( const mfU64 *s1, const mfU64 *s2, mfU64 *d ) { mforX(s1->b, s2->b, d->b, sizeof(mfU64)); }
@@ -272,10 +1096,11 @@ void mfor1024( const mfU1024 *s1, const mfU1024 *s2, mfU1024 *d ) { mforX(s1->b,
 // Multiply s1 with s2, store result in d with overflow in o
 void mfMultiplyUX( const mfU8 *s1, const mfU8 *s2, mfU8 *d, mfU8 *o, unsigned int bytes)
 {
-    mfU8 *dt = (mfU8 *)malloc(bytes);
-    mfU8 *ot = (mfU8 *)malloc(bytes);
-    mfU8 *accumulator = (mfU8 *)malloc(bytes);
-    mfU8 *temp = (mfU8 *)malloc(bytes);
+    MF_STATS_CALL(mfMathOperationMultiply, bytes);
+    mfU8 *dt = (mfU8 *)MF_MALLOC(mfMathOperationMultiply, bytes);
+    mfU8 *ot = (mfU8 *)MF_MALLOC(mfMathOperationMultiply, bytes);
+    mfU8 *accumulator = (mfU8 *)MF_MALLOC(mfMathOperationMultiply, bytes);
+    mfU8 *temp = (mfU8 *)MF_MALLOC(mfMathOperationMultiply, bytes);
 
     unsigned int lower_bound = 0;
     unsigned int upper_bound = 0;
@@ -330,17 +1155,78 @@ void mfMultiplyUX( const mfU8 *s1, const mfU8 *s2, mfU8 *d, mfU8 *o, unsigned in
 }
 void mfMultiplyU8( const mfU8 *s1, const mfU8 *s2, mfU8 *d, mfU8 *o)
 {
+    MF_STATS_CALL(mfMathOperationMultiply, 1);
     unsigned int x = *s1 * *s2;
     *d = (unsigned char)(x & 0xFF);
     *o = (unsigned char)(x >> 8);
 }
 void mfMultiplyU16( const mfU16 *s1, const mfU16 *s2, mfU16 *d, mfU16 *o) { mfMultiplyUX( s1->b, s2->b, d->b, o->b, sizeof(mfU16)); }
 void mfMultiplyU32( const mfU32 *s1, const mfU32 *s2, mfU32 *d, mfU32 *o) { mfMultiplyUX( s1->b, s2->b, d->b, o->b, sizeof(mfU32)); }
-void mfMultiplyU64( const mfU64 *s1, const mfU64 *s2, mfU64 *d, mfU64 *o) { mfMultiplyUX( s1->b, s2->b, d->b, o->b, sizeof(mfU64)); }
-void mfMultiplyU128( const mfU128 *s1, const mfU128 *s2, mfU128 *d, mfU128 *o) { mfMultiplyUX( s1->b, s2->b, d->b, o->b, sizeof(mfU128)); }
-void mfMultiplyU256( const mfU256 *s1, const mfU256 *s2, mfU256 *d, mfU256 *o) { mfMultiplyUX( s1->b, s2->b, d->b, o->b, sizeof(mfU256)); }
-void mfMultiplyU512( const mfU512 *s1, const mfU512 *s2, mfU512 *d, mfU512 *o) { mfMultiplyUX( s1->b, s2->b, d->b, o->b, sizeof(mfU512)); }
-void mfMultiplyU1024( const mfU1024 *s1, const mfU1024 *s2, mfU1024 *d, mfU1024 *o) { mfMultiplyUX( s1->b, s2->b, d->b, o->b, sizeof(mfU1024)); }
+void mfMultiplyU64( const mfU64 *s1, const mfU64 *s2, mfU64 *d, mfU64 *o) { mfBackendMultiply( s1->b, s2->b, d->b, o->b, sizeof(mfU64)); }
+void mfMultiplyU128( const mfU128 *s1, const mfU128 *s2, mfU128 *d, mfU128 *o) { mfBackendMultiply( s1->b, s2->b, d->b, o->b, sizeof(mfU128)); }
+void mfMultiplyU256( const mfU256 *s1, const mfU256 *s2, mfU256 *d, mfU256 *o) { mfBackendMultiply( s1->b, s2->b, d->b, o->b, sizeof(mfU256)); }
+void mfMultiplyU512( const mfU512 *s1, const mfU512 *s2, mfU512 *d, mfU512 *o) { mfBackendMultiply( s1->b, s2->b, d->b, o->b, sizeof(mfU512)); }
+void mfMultiplyU1024( const mfU1024 *s1, const mfU1024 *s2, mfU1024 *d, mfU1024 *o) { mfBackendMultiply( s1->b, s2->b, d->b, o->b, sizeof(mfU1024)); }
+
+#pragma mark - Square
+// Square s, store result in d with overflow in o
+// Each column of partial products is symmetric: the products s[i] * s[j] with i < j are computed once
+// and doubled, giving the column sums of mfMultiplyUX( s, s, d, o, bytes) with about half the products.
+void mfSquareUX( const mfU8 *s, mfU8 *d, mfU8 *o, unsigned int bytes)
+{
+    MF_STATS_CALL(mfMathOperationMultiply, bytes);
+    mfU8 *dt = (mfU8 *)MF_MALLOC(mfMathOperationMultiply, bytes);
+    mfU8 *ot = (mfU8 *)MF_MALLOC(mfMathOperationMultiply, bytes);
+    mfU8 *accumulator = (mfU8 *)MF_MALLOC(mfMathOperationMultiply, bytes);
+    mfU8 *temp = (mfU8 *)MF_MALLOC(mfMathOperationMultiply, bytes);
+
+    unsigned int column;
+    unsigned int a_i;
+
+    mfZeroX(accumulator, bytes);
+
+    for( column = 0; column < 2 * bytes - 1; column++ ) {
+        unsigned int s1_i = column < bytes ? 0 : column - bytes + 1;
+        unsigned int s2_i = column - s1_i;
+        unsigned int t = 0;
+        while( s1_i < s2_i ) {
+            t += s[s1_i] * s[s2_i];
+            s1_i ++;
+            s2_i --;
+        }
+        t <<= 1;
+        if( s1_i == s2_i ) {
+            t += s[s1_i] * s[s1_i];
+        }
+        mfUintExtX(t, temp, bytes);
+        mfAddUX( accumulator, temp, accumulator, bytes);
+        if( column < bytes ) {
+            dt[column] = accumulator[0];
+        } else {
+            ot[column - bytes] = accumulator[0];
+        }
+        a_i = 0;
+        while( ++a_i < bytes ) {
+            accumulator[a_i -1] = accumulator[a_i];
+        }
+    }
+    ot[bytes-1] = accumulator[0];
+    mfCopyX(dt, d, bytes);
+    mfCopyX(ot, o, bytes);
+    free( temp );
+    free( accumulator );
+    free( ot );
+    free( dt );
+    return;
+}
+void mfSquareU8( const mfU8 *s, mfU8 *d, mfU8 *o) { mfMultiplyU8( s, s, d, o); }
+void mfSquareU16( const mfU16 *s, mfU16 *d, mfU16 *o) { mfSquareUX( s->b, d->b, o->b, sizeof(mfU16)); }
+void mfSquareU32( const mfU32 *s, mfU32 *d, mfU32 *o) { mfSquareUX( s->b, d->b, o->b, sizeof(mfU32)); }
+void mfSquareU64( const mfU64 *s, mfU64 *d, mfU64 *o) { mfBackendSquare( s->b, d->b, o->b, sizeof(mfU64)); }
+void mfSquareU128( const mfU128 *s, mfU128 *d, mfU128 *o) { mfBackendSquare( s->b, d->b, o->b, sizeof(mfU128)); }
+void mfSquareU256( const mfU256 *s, mfU256 *d, mfU256 *o) { mfBackendSquare( s->b, d->b, o->b, sizeof(mfU256)); }
+void mfSquareU512( const mfU512 *s, mfU512 *d, mfU512 *o) { mfBackendSquare( s->b, d->b, o->b, sizeof(mfU512)); }
+void mfSquareU1024( const mfU1024 *s, mfU1024 *d, mfU1024 *o) { mfBackendSquare( s->b, d->b, o->b, sizeof(mfU1024)); }
 
 #pragma mark - Divide
 // Divide n by d, quotient stored in q with remainder in r
@@ -349,11 +1235,12 @@ void mfMultiplyU1024( const mfU1024 *s1, const mfU1024 *s2, mfU1024 *d, mfU1024
 // -1 = error, division by 0
 int mfDivideUX( const mfU8 *n, const mfU8 *d, mfU8 *q, mfU8 *r, unsigned int bytes )
 {
+    MF_STATS_CALL(mfMathOperationDivide, bytes);
     if( mfIsZeroX(d, bytes)) return -1;
 
-    mfU8 *left_over = (mfU8 *)malloc(bytes);
-    mfU8 *shifted_quotient = (mfU8 *)malloc(bytes);
-    mfU8 *bit = (mfU8 *)malloc(bytes);
+    mfU8 *left_over = (mfU8 *)MF_MALLOC(mfMathOperationDivide, bytes);
+    mfU8 *shifted_quotient = (mfU8 *)MF_MALLOC(mfMathOperationDivide, bytes);
+    mfU8 *bit = (mfU8 *)MF_MALLOC(mfMathOperationDivide, bytes);
 
     mfZeroX( bit, bytes );
     bit[0] = 1;
@@ -362,10 +1249,10 @@ int mfDivideUX( const mfU8 *n, const mfU8 *d, mfU8 *q, mfU8 *r, unsigned int byt
     mfCopyX(n, left_over, bytes);
     mfCopyX(d, shifted_quotient, bytes);
 
-    while( (shifted_quotient[bytes-1] & 0x80) == 0) {
-        mfShiftLeftXBy1(shifted_quotient, bytes);
-        mfShiftLeftXBy1(bit, bytes);
-    }
+    // Align the most significant bit of the divisor with the most significant bit of the value
+    unsigned int normalization = bytes * 8 - mfBitLengthUX(d, bytes);
+    mfShiftLeftUXByN(shifted_quotient, normalization, bytes);
+    mfShiftLeftUXByN(bit, normalization, bytes);
     while( mfIsZeroX(bit, bytes) == 0 ) {
         if( mfCompareUX(left_over, shifted_quotient, bytes) != mfCompareSmaller ) {
             mfSubstractUX(left_over, shifted_quotient, left_over, bytes);
@@ -383,6 +1270,7 @@ int mfDivideUX( const mfU8 *n, const mfU8 *d, mfU8 *q, mfU8 *r, unsigned int byt
 }
 int mfDivideU8( const mfU8 *n, const mfU8 *d, mfU8 *q, mfU8 *r)
 {
+    MF_STATS_CALL(mfMathOperationDivide, 1);
     // Check for division by 0
     if( *d == 0 ) {
         return -1;
@@ -394,6 +1282,7 @@ int mfDivideU8( const mfU8 *n, const mfU8 *d, mfU8 *q, mfU8 *r)
 }
 int mfDivideU16( const mfU16 *n, const mfU16 *d, mfU16 *q, mfU16 *r)
 {
+    MF_STATS_CALL(mfMathOperationDivide, sizeof(mfU16));
     // Check for division by 0
     if( (d->l8 | d->h8) == 0 ) {
         return -1;
@@ -411,6 +1300,7 @@ int mfDivideU16( const mfU16 *n, const mfU16 *d, mfU16 *q, mfU16 *r)
 }
 int mfDivideU32( const mfU32 *n, const mfU32 *d, mfU32 *q, mfU32 *r)
 {
+    MF_STATS_CALL(mfMathOperationDivide, sizeof(mfU32));
     unsigned int d32 = (
                         ((unsigned int)(d->h16.h8) << 24) |
                         ((unsigned int)(d->h16.l8) << 16) |
@@ -437,9 +1327,75 @@ int mfDivideU32( const mfU32 *n, const mfU32 *d, mfU32 *q, mfU32 *r)
     return 0;
     
 }
-int mfDivideU64( const mfU64 *n, const mfU64 *d, mfU64 *q, mfU64 *r) { return mfDivideUX(n->b, d->b, q->b, r->b, sizeof(mfU64)); }
-int mfDivideU128( const mfU128 *n, const mfU128 *d, mfU128 *q, mfU128 *r) { return mfDivideUX(n->b, d->b, q->b, r->b, sizeof(mfU128)); }
-int mfDivideU256( const mfU256 *n, const mfU256 *d, mfU256 *q, mfU256 *r) { return mfDivideUX(n->b, d->b, q->b, r->b, sizeof(mfU256)); }
-int mfDivideU512( const mfU512 *n, const mfU512 *d, mfU512 *q, mfU512 *r) { return mfDivideUX(n->b, d->b, q->b, r->b, sizeof(mfU512)); }
-int mfDivideU1024( const mfU1024 *n, const mfU1024 *d, mfU1024 *q, mfU1024 *r) { return mfDivideUX(n->b, d->b, q->b, r->b, sizeof(mfU1024)); }
+int mfDivideU64( const mfU64 *n, const mfU64 *d, mfU64 *q, mfU64 *r) { return mfBackendDivide(n->b, d->b, q->b, r->b, sizeof(mfU64)); }
+int mfDivideU128( const mfU128 *n, const mfU128 *d, mfU128 *q, mfU128 *r) { return mfBackendDivide(n->b, d->b, q->b, r->b, sizeof(mfU128)); }
+int mfDivideU256( const mfU256 *n, const mfU256 *d, mfU256 *q, mfU256 *r) { return mfBackendDivide(n->b, d->b, q->b, r->b, sizeof(mfU256)); }
+int mfDivideU512( const mfU512 *n, const mfU512 *d, mfU512 *q, mfU512 *r) { return mfBackendDivide(n->b, d->b, q->b, r->b, sizeof(mfU512)); }
+int mfDivideU1024( const mfU1024 *n, const mfU1024 *d, mfU1024 *q, mfU1024 *r) { return mfBackendDivide(n->b, d->b, q->b, r->b, sizeof(mfU1024)); }
+
+#pragma mark - Instrumentation
+int mfMathStatsEnabled( void )
+{
+#ifdef MFMATHLIB_INSTRUMENTATION
+    return 1;
+#else
+    return 0;
+#endif
+}
+
+void mfMathStatsSnapshot( mfMathStats *stats )
+{
+#ifdef MFMATHLIB_INSTRUMENTATION
+    memcpy(stats, &mfMathThreadStats, sizeof(mfMathStats));
+#else
+    memset(stats, 0, sizeof(mfMathStats));
+#endif
+}
 
+void mfMathStatsReset( void )
+{
+#ifdef MFMATHLIB_INSTRUMENTATION
+    memset(&mfMathThreadStats, 0, sizeof(mfMathStats));
+#endif
+}
+
+const char *mfMathOperationName( mfMathOperation operation )
+{
+    switch( operation ) {
+        case mfMathOperationAdd: return "add";
+        case mfMathOperationSubstract: return "substract";
+        case mfMathOperationMultiply: return "multiply";
+        case mfMathOperationDivide: return "divide";
+        case mfMathOperationShiftLeftBy1: return "shift_left_1";
+        case mfMathOperationShiftRightBy1: return "shift_right_1";
+        case mfMathOperationShiftLeftByN: return "shift_left_n";
+        case mfMathOperationShiftRightByN: return "shift_right_n";
+        case mfMathOperationCompare: return "compare";
+        case mfMathOperationIsZero: return "is_zero";
+        case mfMathOperationBitLength: return "bit_length";
+        case mfMathOperationCopy: return "copy";
+        case mfMathOperationZero: return "zero";
+        case mfMathOperationOr: return "or";
+        case mfMathOperationExtend: return "extend";
+        default: return "unknown";
+    }
+}
+
+void mfMathStatsDump( const mfMathStats *stats, FILE *out )
+{
+    unsigned int operation, width_class;
+    for( operation = 0; operation < mfMathOperationCount; operation++ ) {
+        for( width_class = 0; width_class < MF_MATH_WIDTH_CLASSES; width_class++ ) {
+            if( stats->calls[operation][width_class] != 0 ) {
+                fprintf(out, "%s %u calls=%llu\n", mfMathOperationName((mfMathOperation)operation),
+                        8u << width_class, stats->calls[operation][width_class]);
+            }
+        }
+    }
+    for( operation = 0; operation < mfMathOperationCount; operation++ ) {
+        if( stats->allocations[operation] != 0 ) {
+            fprintf(out, "%s allocations=%llu allocated_bytes=%llu\n", mfMathOperationName((mfMathOperation)operation),
+                    stats->allocations[operation], stats->allocated_bytes[operation]);
+        }
+    }
+}
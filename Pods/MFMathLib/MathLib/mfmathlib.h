@@ -37,6 +37,8 @@
 #ifndef MathLib_mfmathlib_h
 #define MathLib_mfmathlib_h
 
+#include <stdio.h>
+
 typedef unsigned char mfU8;
 typedef union { struct { mfU8 l8, h8; }; unsigned char b[2]; } mfU16;
 typedef union { struct { mfU16 l16, h16; }; unsigned char b[4]; } mfU32;
@@ -46,6 +48,39 @@ typedef union { struct { mfU128 l128, h128; }; unsigned char b[32]; mfU32 b32[8]
 typedef union { struct { mfU256 l256, h256; }; unsigned char b[64]; mfU32 b32[16]; } mfU512;
 typedef union { struct { mfU512 l512, h512; }; unsigned char b[128]; mfU32 b32[32]; } mfU1024;
 
+// Arithmetic backends
+// -------------------
+// The fixed width add, substract, multiply and divide operations on 64-bits and larger types are
+// implemented by one of the following backends, selected at build time by defining
+// MFMATHLIB_BACKEND to one of these values:
+//
+// MFMATHLIB_BACKEND_PORTABLE: byte at a time routines (the mf*UX functions), any C compiler
+// MFMATHLIB_BACKEND_NATIVE64: 64-bit limbs, default
+// MFMATHLIB_BACKEND_GMP: GMP mpn_* functions, requires gmp.h and linking with -lgmp
+//
+// All backends produce identical results; the mf*UX functions always use the portable routines.
+#define MFMATHLIB_BACKEND_PORTABLE 0
+#define MFMATHLIB_BACKEND_NATIVE64 1
+#define MFMATHLIB_BACKEND_GMP 2
+
+#ifndef MFMATHLIB_BACKEND
+#define MFMATHLIB_BACKEND MFMATHLIB_BACKEND_NATIVE64
+#endif
+
+// Returns the name of the backend the library was built with ("portable", "native64" or "gmp")
+const char *mfBackendName( void );
+
+// Returns the name of the 128 and 256-bit multiplication kernel in use.  With the native64 backend on
+// x86-64, the MULX/ADCX/ADOX kernels ("mulx/adx") are selected at runtime when the CPU supports BMI2
+// and ADX, otherwise the generic limb multiplication ("generic") is used.  Defining MFMATHLIB_NO_ADX
+// at build time disables the runtime selection.
+//
+// The native64 multiplication and squaring split operands of MFMATHLIB_KARATSUBA_THRESHOLD limbs or
+// more in halves (Karatsuba), recursively down to the kernels.  The default threshold is above the
+// 16 limbs of mfU1024, where the schoolbook routines measured faster; defining a lower threshold at
+// build time enables the split for the wider types.
+const char *mfMultiplyKernelName( void );
+
 typedef enum {
     mfCompareEqual = 0,
     mfCompareGreater = 1,
@@ -149,6 +184,18 @@ void mfMultiplyU256( const mfU256 *s1, const mfU256 *s2, mfU256 *d, mfU256 *o);
 void mfMultiplyU512( const mfU512 *s1, const mfU512 *s2, mfU512 *d, mfU512 *o);
 void mfMultiplyU1024( const mfU1024 *s1, const mfU1024 *s2, mfU1024 *d, mfU1024 *o);
 
+// Square s, store result in d with overflow in o
+// Same result as multiplying s with itself; the symmetric partial products are computed once.
+void mfSquareUX( const mfU8 *s, mfU8 *d, mfU8 *o, unsigned int bytes);
+void mfSquareU8( const mfU8 *s, mfU8 *d, mfU8 *o);
+void mfSquareU16( const mfU16 *s, mfU16 *d, mfU16 *o);
+void mfSquareU32( const mfU32 *s, mfU32 *d, mfU32 *o);
+void mfSquareU64( const mfU64 *s, mfU64 *d, mfU64 *o);
+void mfSquareU128( const mfU128 *s, mfU128 *d, mfU128 *o);
+void mfSquareU256( const mfU256 *s, mfU256 *d, mfU256 *o);
+void mfSquareU512( const mfU512 *s, mfU512 *d, mfU512 *o);
+void mfSquareU1024( const mfU1024 *s, mfU1024 *d, mfU1024 *o);
+
 // Divide n by d, quotient stored in q with remainder in r
 // return value:
 // 0 = division completed
@@ -188,4 +235,97 @@ void mfShiftLeft256By1( mfU256 *x);
 void mfShiftLeft512By1( mfU512 *x);
 void mfShiftLeft1024By1( mfU1024 *x);
 
+// Shift bits to the left by n bits, bits shifted out are lost and n may exceed the width of x
+void mfShiftLeftUXByN( mfU8 *x, unsigned int n, unsigned int bytes );
+void mfShiftLeftU8ByN( mfU8 *x, unsigned int n );
+void mfShiftLeftU16ByN( mfU16 *x, unsigned int n );
+void mfShiftLeftU32ByN( mfU32 *x, unsigned int n );
+void mfShiftLeftU64ByN( mfU64 *x, unsigned int n );
+void mfShiftLeftU128ByN( mfU128 *x, unsigned int n );
+void mfShiftLeftU256ByN( mfU256 *x, unsigned int n );
+void mfShiftLeftU512ByN( mfU512 *x, unsigned int n );
+void mfShiftLeftU1024ByN( mfU1024 *x, unsigned int n );
+
+// Shift bits to the right by n bits, bits shifted out are lost and n may exceed the width of x
+void mfShiftRightUXByN( mfU8 *x, unsigned int n, unsigned int bytes );
+void mfShiftRightU8ByN( mfU8 *x, unsigned int n );
+void mfShiftRightU16ByN( mfU16 *x, unsigned int n );
+void mfShiftRightU32ByN( mfU32 *x, unsigned int n );
+void mfShiftRightU64ByN( mfU64 *x, unsigned int n );
+void mfShiftRightU128ByN( mfU128 *x, unsigned int n );
+void mfShiftRightU256ByN( mfU256 *x, unsigned int n );
+void mfShiftRightU512ByN( mfU512 *x, unsigned int n );
+void mfShiftRightU1024ByN( mfU1024 *x, unsigned int n );
+
+// Number of significant bits in x (index of the most significant bit set plus one)
+// return value:
+// 0 = x is 0
+unsigned int mfBitLengthUX( const mfU8 *x, unsigned int bytes );
+unsigned int mfBitLengthU8( const mfU8 *x );
+unsigned int mfBitLengthU16( const mfU16 *x );
+unsigned int mfBitLengthU32( const mfU32 *x );
+unsigned int mfBitLengthU64( const mfU64 *x );
+unsigned int mfBitLengthU128( const mfU128 *x );
+unsigned int mfBitLengthU256( const mfU256 *x );
+unsigned int mfBitLengthU512( const mfU512 *x );
+unsigned int mfBitLengthU1024( const mfU1024 *x );
+
+// Instrumentation
+// ---------------
+// When the library is compiled with MFMATHLIB_INSTRUMENTATION defined, every function doing the work of
+// an operation (the mf*X/mf*UX routines, the backend routines and the 8-bit functions computing their
+// result directly) counts its calls by operand width, and the heap allocations of the portable routines
+// are counted, in thread-local counters.  Calls made by the library itself are counted as well: a
+// portable mfDivideUX also counts the mfSubstractUX, mfCompareUX and mfShiftRightXBy1 calls it makes.
+// Without MFMATHLIB_INSTRUMENTATION the counters are compiled out and the statistics are always zero.
+typedef enum {
+    mfMathOperationAdd = 0,
+    mfMathOperationSubstract,
+    mfMathOperationMultiply,
+    mfMathOperationDivide,
+    mfMathOperationShiftLeftBy1,
+    mfMathOperationShiftRightBy1,
+    mfMathOperationShiftLeftByN,
+    mfMathOperationShiftRightByN,
+    mfMathOperationCompare,
+    mfMathOperationIsZero,
+    mfMathOperationBitLength,
+    mfMathOperationCopy,
+    mfMathOperationZero,
+    mfMathOperationOr,
+    mfMathOperationExtend,
+    mfMathOperationCount
+} mfMathOperation;
+
+// Operand widths are counted in classes of 1, 2, 4, ... 128 bytes, other widths in the next larger class
+#define MF_MATH_WIDTH_CLASSES 8
+
+// Statistics accumulated by the calling thread
+// calls: number of calls of each operation, by width class
+// bytes: total width in bytes of the operands of each operation
+// allocations, allocated_bytes: number and total size of the memory blocks allocated by each operation
+typedef struct {
+    unsigned long long calls[mfMathOperationCount][MF_MATH_WIDTH_CLASSES];
+    unsigned long long bytes[mfMathOperationCount];
+    unsigned long long allocations[mfMathOperationCount];
+    unsigned long long allocated_bytes[mfMathOperationCount];
+} mfMathStats;
+
+// Returns 1 if the library was compiled with MFMATHLIB_INSTRUMENTATION, 0 otherwise
+int mfMathStatsEnabled( void );
+
+// Copies the statistics accumulated by the calling thread into stats
+void mfMathStatsSnapshot( mfMathStats *stats );
+
+// Resets the statistics accumulated by the calling thread
+void mfMathStatsReset( void );
+
+// Returns a short, constant name for the operation specified ("add", "multiply", "shift_left_1", ...)
+const char *mfMathOperationName( mfMathOperation operation );
+
+// Writes the non-zero counters of stats to out, one line per operation and width:
+// <operation> <bits> calls=<calls>, followed by one line per operation that allocated memory:
+// <operation> allocations=<count> allocated_bytes=<bytes>
+void mfMathStatsDump( const mfMathStats *stats, FILE *out );
+
 #endif
@@ -0,0 +1,265 @@
+//
+//  mflicensingallocatortests.c
+//  MFLicensing
+//  https://github.com/freshcode/MFLicensing
+//
+//  Index allocator tests: indexes are allocated lowest first and never twice, marked and freed
+//  indexes are accounted for, and the indexes allocated by a process killed before closing the file
+//  (in the middle of its allocations, while the digest table grows, or with the update of the space
+//  used lost) are not allocated again once the file is reopened.
+//
+//  Licensing
+//  ---------
+//  Public Domain
+//
+
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include "mflicensingallocator.h"
+#include "mftest.h"
+
+#define MF_TEST_USED_OFFSET 8
+#define MF_TEST_CLEAN_OFFSET 24
+
+static char mfTestPath[64];
+
+static void mfTestVector( mfLicensingVector *vector, unsigned char index_bits )
+{
+    mfLicensingInitializeDefaultVector(vector);
+    mfLicensingSetKeyIndexLength(vector, index_bits);
+}
+
+static mfLicensingDigest mfTestDigest( unsigned int i )
+{
+    unsigned long long state = 0x5000 + i;
+    mfLicensingDigest digest;
+    mfTestRandomBytes(&state, digest.md5hash.b, sizeof(digest.md5hash.b));
+    return digest;
+}
+
+static void mfTestRemoveFile( void )
+{
+    unlink(mfTestPath);
+}
+
+// Runs crash in a child process killed by _exit before the allocator is closed
+static int mfTestCrash( void (*crash)( const mfLicensingVector *vector ), const mfLicensingVector *vector )
+{
+    int status;
+    pid_t pid = fork();
+    if( pid == 0 ) {
+        crash(vector);
+        _exit(0);
+    }
+    return pid > 0 && waitpid(pid, &status, 0) == pid && WIFEXITED(status) && WEXITSTATUS(status) == 0 ? 0 : -1;
+}
+
+static uint64_t mfTestReadHeader( unsigned int offset, unsigned int size )
+{
+    uint64_t value = 0;
+    FILE *file = fopen(mfTestPath, "rb");
+    if( file != NULL ) {
+        if( fseek(file, offset, SEEK_SET) != 0 || fread(&value, size, 1, file) != 1 ) value = 0;
+        fclose(file);
+    }
+    return value;
+}
+
+static void mfTestWriteHeader( unsigned int offset, uint64_t value, unsigned int size )
+{
+    FILE *file = fopen(mfTestPath, "r+b");
+    if( file != NULL ) {
+        fseek(file, offset, SEEK_SET);
+        fwrite(&value, size, 1, file);
+        fclose(file);
+    }
+}
+
+// Indexes are handed out lowest first across leaves, until every index of the digest is in use
+static void testAllocateInOrder( void )
+{
+    mfLicensingIndexAllocator allocator, second;
+    mfLicensingVector vector;
+    mfLicensingDigest digest = mfTestDigest(0), other = mfTestDigest(1);
+    static unsigned int indexes[5000];
+    unsigned int index, i, out_of_order = 0;
+
+    mfTestRemoveFile();
+    mfTestVector(&vector, 13);
+    MF_TEST_ASSERT(mfLicensingOpenIndexAllocator(&allocator, mfTestPath, &vector, 0) == 0);
+    MF_TEST_ASSERT(mfLicensingOpenIndexAllocator(&second, mfTestPath, &vector, 0) == -1);
+
+    MF_TEST_ASSERT(mfLicensingAllocateIndex(&allocator, &digest, &index) == 0 && index == 0);
+    MF_TEST_ASSERT(mfLicensingAllocateIndexes(&allocator, &digest, indexes, 5000) == 5000);
+    for( i = 0; i < 5000; i++ ) {
+        if( indexes[i] != i + 1 ) out_of_order++;
+    }
+    MF_TEST_ASSERT(out_of_order == 0);
+    MF_TEST_ASSERT(mfLicensingAllocateIndexes(&allocator, &digest, indexes, 5000) == 8192 - 5001);
+    MF_TEST_ASSERT(indexes[0] == 5001 && indexes[8192 - 5002] == 8191);
+    MF_TEST_ASSERT(mfLicensingAllocateIndex(&allocator, &digest, &index) == -1);
+    MF_TEST_ASSERT(mfLicensingAllocateIndexes(&allocator, &digest, indexes, 0) == 0);
+
+    // Digests have their own indexes
+    MF_TEST_ASSERT(mfLicensingAllocateIndex(&allocator, &other, &index) == 0 && index == 0);
+    MF_TEST_ASSERT(mfLicensingIsIndexAllocated(&allocator, &other, 1) == 0);
+    MF_TEST_ASSERT(mfLicensingIsIndexAllocated(&allocator, &digest, 8191) == 1);
+    MF_TEST_ASSERT(mfLicensingIsIndexAllocated(&allocator, &digest, 8192) == 0);
+    mfLicensingCloseIndexAllocator(&allocator);
+
+    // Reopened cleanly with the same indexes, refused with other index bits
+    MF_TEST_ASSERT(mfTestReadHeader(MF_TEST_CLEAN_OFFSET, 4) == 1);
+    mfTestVector(&vector, 14);
+    MF_TEST_ASSERT(mfLicensingOpenIndexAllocator(&allocator, mfTestPath, &vector, 0) == -1);
+    mfTestVector(&vector, 13);
+    MF_TEST_ASSERT(mfLicensingOpenIndexAllocator(&allocator, mfTestPath, &vector, MF_LICENSING_ALLOCATOR_SYNC) == 0);
+    MF_TEST_ASSERT(mfLicensingAllocateIndex(&allocator, &other, &index) == 0 && index == 1);
+    MF_TEST_ASSERT(mfLicensingAllocateIndex(&allocator, &digest, &index) == -1);
+    mfLicensingCloseIndexAllocator(&allocator);
+}
+
+// Marked indexes are skipped, freed indexes are allocated again, the lowest first
+static void testMarkAndFree( void )
+{
+    mfLicensingIndexAllocator allocator;
+    mfLicensingVector vector;
+    mfLicensingDigest digest = mfTestDigest(2), unknown = mfTestDigest(3);
+    unsigned int indexes[8], index;
+
+    mfTestRemoveFile();
+    mfTestVector(&vector, 25);
+    MF_TEST_ASSERT(mfLicensingOpenIndexAllocator(&allocator, mfTestPath, &vector, 0) == 0);
+    MF_TEST_ASSERT(mfLicensingMarkIndex(&allocator, &digest, 1) == 1);
+    MF_TEST_ASSERT(mfLicensingMarkIndex(&allocator, &digest, 1) == 0);
+    MF_TEST_ASSERT(mfLicensingMarkIndex(&allocator, &digest, 3000000) == 1);
+    MF_TEST_ASSERT(mfLicensingMarkIndex(&allocator, &digest, 1u << 25) == -1);
+    MF_TEST_ASSERT(mfLicensingAllocateIndexes(&allocator, &digest, indexes, 3) == 3);
+    MF_TEST_ASSERT(indexes[0] == 0 && indexes[1] == 2 && indexes[2] == 3);
+    MF_TEST_ASSERT(mfLicensingIsIndexAllocated(&allocator, &digest, 3000000) == 1);
+
+    MF_TEST_ASSERT(mfLicensingFreeIndex(&allocator, &digest, 2) == 1);
+    MF_TEST_ASSERT(mfLicensingFreeIndex(&allocator, &digest, 2) == 0);
+    MF_TEST_ASSERT(mfLicensingFreeIndex(&allocator, &digest, 5000000) == 0);
+    MF_TEST_ASSERT(mfLicensingFreeIndex(&allocator, &unknown, 0) == 0);
+    MF_TEST_ASSERT(mfLicensingFreeIndex(&allocator, &digest, 1u << 25) == -1);
+    MF_TEST_ASSERT(mfLicensingAllocateIndex(&allocator, &digest, &index) == 0 && index == 2);
+    MF_TEST_ASSERT(mfLicensingAllocateIndex(&allocator, &digest, &index) == 0 && index == 4);
+    MF_TEST_ASSERT(mfLicensingIsIndexAllocated(&allocator, &unknown, 0) == 0);
+    mfLicensingCloseIndexAllocator(&allocator);
+}
+
+static void mfTestCrashAllocating( const mfLicensingVector *vector )
+{
+    mfLicensingIndexAllocator allocator;
+    unsigned int indexes[100], i;
+    if( mfLicensingOpenIndexAllocator(&allocator, mfTestPath, vector, 0) != 0 ) _exit(1);
+    for( i = 0; i < 10; i++ ) {
+        mfLicensingDigest digest = mfTestDigest(100 + i);
+        if( mfLicensingAllocateIndexes(&allocator, &digest, indexes, 100) != 100 ) _exit(1);
+    }
+}
+
+// Indexes allocated by a killed process stay allocated, the file being checked when reopened
+static void testCrashWhileAllocating( void )
+{
+    mfLicensingIndexAllocator allocator;
+    mfLicensingVector vector;
+    unsigned int i, reused = 0;
+
+    mfTestRemoveFile();
+    mfTestVector(&vector, 20);
+    MF_TEST_ASSERT(mfTestCrash(mfTestCrashAllocating, &vector) == 0);
+    MF_TEST_ASSERT(mfTestReadHeader(MF_TEST_CLEAN_OFFSET, 4) == 0);
+    MF_TEST_ASSERT(mfLicensingOpenIndexAllocator(&allocator, mfTestPath, &vector, 0) == 0);
+    for( i = 0; i < 10; i++ ) {
+        mfLicensingDigest digest = mfTestDigest(100 + i);
+        unsigned int index;
+        if( mfLicensingAllocateIndex(&allocator, &digest, &index) != 0 || index != 100 ) reused++;
+    }
+    MF_TEST_ASSERT(reused == 0);
+    mfLicensingCloseIndexAllocator(&allocator);
+}
+
+static void mfTestCrashGrowingTable( const mfLicensingVector *vector )
+{
+    mfLicensingIndexAllocator allocator;
+    unsigned int i, index;
+    if( mfLicensingOpenIndexAllocator(&allocator, mfTestPath, vector, 0) != 0 ) _exit(1);
+    for( i = 0; i < 3000; i++ ) {
+        mfLicensingDigest digest = mfTestDigest(1000 + i);
+        if( mfLicensingAllocateIndex(&allocator, &digest, &index) != 0 || index != 0 ) _exit(1);
+    }
+}
+
+// Digests added while the table grew twice are found again after a crash, the space used by their
+// nodes being recovered when its update in the header is lost
+static void testCrashWhileGrowingTable( void )
+{
+    mfLicensingIndexAllocator allocator;
+    mfLicensingVector vector;
+    unsigned int i, index, reused = 0;
+    uint64_t used;
+
+    mfTestRemoveFile();
+    mfTestVector(&vector, 16);
+    MF_TEST_ASSERT(mfTestCrash(mfTestCrashGrowingTable, &vector) == 0);
+    used = mfTestReadHeader(MF_TEST_USED_OFFSET, 8);
+    MF_TEST_ASSERT(used > 65536);
+    mfTestWriteHeader(MF_TEST_USED_OFFSET, 64 + 32 + 1024 * 32, 8);
+
+    MF_TEST_ASSERT(mfLicensingOpenIndexAllocator(&allocator, mfTestPath, &vector, 0) == 0);
+    MF_TEST_ASSERT(mfTestReadHeader(MF_TEST_USED_OFFSET, 8) == used);
+    for( i = 0; i < 3000; i++ ) {
+        mfLicensingDigest digest = mfTestDigest(1000 + i);
+        if( mfLicensingIsIndexAllocated(&allocator, &digest, 0) != 1 ) reused++;
+    }
+    MF_TEST_ASSERT(reused == 0);
+
+    // New nodes don't overlap the recovered ones
+    for( i = 0; i < 100; i++ ) {
+        mfLicensingDigest digest = mfTestDigest(9000 + i);
+        if( mfLicensingAllocateIndex(&allocator, &digest, &index) != 0 || index != 0 ) reused++;
+    }
+    for( i = 0; i < 3000; i++ ) {
+        mfLicensingDigest digest = mfTestDigest(1000 + i);
+        if( mfLicensingIsIndexAllocated(&allocator, &digest, 0) != 1 || mfLicensingIsIndexAllocated(&allocator, &digest, 1) != 0 ) reused++;
+        if( mfLicensingAllocateIndex(&allocator, &digest, &index) != 0 || index != 1 ) reused++;
+    }
+    MF_TEST_ASSERT(reused == 0);
+    mfLicensingCloseIndexAllocator(&allocator);
+}
+
+// Files that are not allocators, or whose digest table is outside the file, are refused
+static void testCorruptedFiles( void )
+{
+    mfLicensingIndexAllocator allocator;
+    mfLicensingVector vector;
+
+    mfTestRemoveFile();
+    mfTestVector(&vector, 16);
+    MF_TEST_ASSERT(mfLicensingOpenIndexAllocator(&allocator, mfTestPath, &vector, 0) == 0);
+    mfLicensingCloseIndexAllocator(&allocator);
+
+    mfTestWriteHeader(0, 'X', 1);
+    MF_TEST_ASSERT(mfLicensingOpenIndexAllocator(&allocator, mfTestPath, &vector, 0) == -1);
+    mfTestWriteHeader(0, 'M', 1);
+    mfTestWriteHeader(16, 1u << 30, 8);
+    MF_TEST_ASSERT(mfLicensingOpenIndexAllocator(&allocator, mfTestPath, &vector, 0) == -1);
+    mfTestWriteHeader(16, 64, 8);
+    MF_TEST_ASSERT(mfLicensingOpenIndexAllocator(&allocator, mfTestPath, &vector, 0) == 0);
+    mfLicensingCloseIndexAllocator(&allocator);
+}
+
+int main( int argc, const char * argv[] )
+{
+    snprintf(mfTestPath, sizeof(mfTestPath), "/tmp/mflicensingallocatortests.%d", (int)getpid());
+    MF_TEST_RUN(testAllocateInOrder);
+    MF_TEST_RUN(testMarkAndFree);
+    MF_TEST_RUN(testCrashWhileAllocating);
+    MF_TEST_RUN(testCrashWhileGrowingTable);
+    MF_TEST_RUN(testCorruptedFiles);
+    mfTestRemoveFile();
+    return mfTestReport("mflicensingallocatortests");
+}
@@ -0,0 +1,233 @@
+//
+//  mflicensingasynctests.cpp
+//  MFLicensing
+//  https://github.com/freshcode/MFLicensing
+//
+//  Coroutine interface tests: keys generated and validated by the pool are the ones of the C
+//  functions, the queue stays bounded (the submitting thread performs the requests past max_queued)
+//  and coroutines resumed on a worker can keep submitting requests to a full pool.  The longest keys
+//  (255 characters and a check character) fit the requests.
+//
+//  Licensing
+//  ---------
+//  Public Domain
+//
+
+#include "mflicensingasync.hpp"
+
+#include <atomic>
+#include <cstring>
+#include <thread>
+
+extern "C" {
+#include "mftest.h"
+}
+
+namespace {
+
+constexpr unsigned int mfTestRequests = 2000;
+
+mfLicensingPrivateKey mfTestKey;
+
+// Fire and forget coroutine, its frame is destroyed when it returns
+struct Task {
+    struct promise_type {
+        Task get_return_object() { return {}; }
+        std::suspend_never initial_suspend() noexcept { return {}; }
+        std::suspend_never final_suspend() noexcept { return {}; }
+        void return_void() {}
+        void unhandled_exception() { std::abort(); }
+    };
+};
+
+struct Context {
+    mfLicensingVector vector;
+    mfLicensingContext context;
+
+    explicit Context(unsigned char scheme)
+    {
+        mfLicensingInitializeDefaultVector(&vector);
+        mfLicensingSetPrivateKey(&vector, &mfTestKey);
+        mfLicensingSetScheme(&vector, scheme);
+        mfLicensingSetCheckCharacter(&vector, 1);
+        mfLicensingInitializeContext(&context, &vector);
+    }
+    ~Context() { mfLicensingReleaseContext(&context); }
+};
+
+mfLicensingDigest mfTestDigest(unsigned int i)
+{
+    unsigned long long state = 0x1000 + i;
+    mfLicensingDigest digest;
+    mfTestRandomBytes(&state, digest.md5hash.b, sizeof(digest.md5hash.b));
+    return digest;
+}
+
+void mfTestWait(std::atomic<unsigned int> &pending)
+{
+    while( pending.load() != 0 ) std::this_thread::yield();
+}
+
+Task generateOne(mf::Pool &pool, Context &context, unsigned int i, std::string *key, std::atomic<unsigned int> *pending)
+{
+    std::optional<std::string> generated = co_await mf::generate(context.context, mfTestDigest(i), i, pool);
+    *key = generated ? *generated : std::string("-");
+    pending->fetch_sub(1);
+}
+
+Task validateOne(mf::Pool &pool, Context &context, unsigned int i, const std::string *key, std::atomic<unsigned char> *valid, std::atomic<unsigned int> *pending)
+{
+    bool result = co_await mf::validate(context.context, mfTestDigest(i), *key, pool);
+    valid->store(result ? 1 : 0);
+    pending->fetch_sub(1);
+}
+
+// Keys generated by the pool, then validated (a quarter of them altered) for two contexts at once
+void testGenerateAndValidate()
+{
+    mf::Pool::Options options;
+    options.threads = 2;
+    mf::Pool pool(options);
+    Context contexts[2] = { Context(MF_LICENSING_SCHEME_LRAND48), Context(MF_LICENSING_SCHEME_PHILOX) };
+    static std::string keys[mfTestRequests];
+    static std::atomic<unsigned char> valid[mfTestRequests];
+    std::atomic<unsigned int> pending(mfTestRequests);
+
+    for( unsigned int i = 0; i < mfTestRequests; i++ ) {
+        generateOne(pool, contexts[i & 1], i, &keys[i], &pending);
+    }
+    mfTestWait(pending);
+
+    unsigned int mismatches = 0;
+    for( unsigned int i = 0; i < mfTestRequests; i++ ) {
+        unsigned char expected[64];
+        mfLicensingDigest digest = mfTestDigest(i);
+        mfLicensingGenerateLicenseToBuffer(&contexts[i & 1].context, &digest, i, expected, sizeof(expected));
+        if( keys[i] != reinterpret_cast<const char *>(expected) ) mismatches++;
+        if( i % 4 == 3 ) keys[i][i % 25] = keys[i][i % 25] == 'A' ? 'C' : 'A';
+    }
+    MF_TEST_ASSERT(mismatches == 0);
+
+    pending = mfTestRequests;
+    for( unsigned int i = 0; i < mfTestRequests; i++ ) {
+        validateOne(pool, contexts[i & 1], i, &keys[i], &valid[i], &pending);
+    }
+    mfTestWait(pending);
+    mismatches = 0;
+    for( unsigned int i = 0; i < mfTestRequests; i++ ) {
+        mfLicensingDigest digest = mfTestDigest(i);
+        int expected = mfLicensingValidateLicenseWithContext(&contexts[i & 1].context, &digest, reinterpret_cast<const unsigned char *>(keys[i].c_str()));
+        if( valid[i].load() != expected || expected != (i % 4 != 3) ) mismatches++;
+    }
+    MF_TEST_ASSERT(mismatches == 0);
+}
+
+Task generateCountingInline(mf::Pool &pool, Context &context, unsigned int i, std::thread::id submitter, std::atomic<unsigned int> *inline_count, std::atomic<unsigned int> *failures, std::atomic<unsigned int> *pending)
+{
+    std::optional<std::string> key = co_await mf::generate(context.context, mfTestDigest(i), i, pool);
+    if( std::this_thread::get_id() == submitter ) inline_count->fetch_add(1);
+    if( !key ) failures->fetch_add(1);
+    pending->fetch_sub(1);
+}
+
+// A single worker and at most 4 queued requests: the submitter performs the requests it can't queue
+void testBoundedQueue()
+{
+    mf::Pool::Options options;
+    options.threads = 1;
+    options.max_batch = 2;
+    options.max_queued = 4;
+    mf::Pool pool(options);
+    Context context(MF_LICENSING_SCHEME_PHILOX);
+    std::atomic<unsigned int> inline_count(0), failures(0), pending(mfTestRequests);
+
+    for( unsigned int i = 0; i < mfTestRequests; i++ ) {
+        generateCountingInline(pool, context, i, std::this_thread::get_id(), &inline_count, &failures, &pending);
+    }
+    mfTestWait(pending);
+    MF_TEST_ASSERT(failures.load() == 0);
+    MF_TEST_ASSERT(inline_count.load() > 0);
+    MF_TEST_ASSERT(inline_count.load() < mfTestRequests);
+}
+
+Task validateRepeatedly(mf::Pool &pool, Context &context, const std::string *key, unsigned int rounds, std::atomic<unsigned int> *failures, std::atomic<unsigned int> *pending)
+{
+    for( unsigned int round = 0; round < rounds; round++ ) {
+        if( !co_await mf::validate(context.context, mfTestDigest(7), *key, pool) ) failures->fetch_add(1);
+    }
+    pending->fetch_sub(1);
+}
+
+// Coroutines resumed on the worker submit their next request while the queue is full
+void testWorkersSubmitting()
+{
+    mf::Pool::Options options;
+    options.threads = 1;
+    options.max_queued = 1;
+    mf::Pool pool(options);
+    Context context(MF_LICENSING_SCHEME_LRAND48);
+    unsigned char key[64];
+    mfLicensingDigest digest = mfTestDigest(7);
+    MF_TEST_ASSERT(mfLicensingGenerateLicenseToBuffer(&context.context, &digest, 7, key, sizeof(key)) == 0);
+    std::string license(reinterpret_cast<const char *>(key));
+    std::atomic<unsigned int> failures(0), pending(64);
+
+    for( unsigned int i = 0; i < 64; i++ ) {
+        validateRepeatedly(pool, context, &license, 50, &failures, &pending);
+    }
+    mfTestWait(pending);
+    MF_TEST_ASSERT(failures.load() == 0);
+}
+
+Task generateAndValidate(mf::Pool &pool, mfLicensingContext &context, const mfLicensingDigest &digest, unsigned int index, std::string *key, std::atomic<unsigned char> *valid, std::atomic<unsigned int> *pending)
+{
+    std::optional<std::string> generated = co_await mf::generate(context, digest, index, pool);
+    *key = generated ? *generated : std::string("-");
+    valid->store(co_await mf::validate(context, digest, *key, pool) ? 1 : 0);
+    pending->fetch_sub(1);
+}
+
+// Keys of 255 characters and a check character are generated and validated
+void testLongestKeys()
+{
+    mf::Pool::Options options;
+    options.threads = 2;
+    mf::Pool pool(options);
+    mfLicensingVector vector;
+    mfLicensingContext context;
+    mfLicensingInitializeDefaultVector(&vector);
+    mfLicensingSetPrivateKey(&vector, &mfTestKey);
+    mfLicensingSetEncodingCharacters(&vector, reinterpret_cast<const unsigned char *>("01"));
+    mfLicensingSetKeyLength(&vector, mf::max_key_length);
+    mfLicensingSetKeyIndexLength(&vector, 8);
+    mfLicensingSetCheckCharacter(&vector, 1);
+    MF_TEST_ASSERT(mfLicensingInitializeContext(&context, &vector) == 0);
+
+    mfLicensingDigest digest = mfTestDigest(3);
+    unsigned char expected[mf::max_key_length + 2];
+    std::string key;
+    std::atomic<unsigned char> valid(0);
+    std::atomic<unsigned int> pending(1);
+    MF_TEST_ASSERT(mfLicensingGenerateLicenseToBuffer(&context, &digest, 3, expected, sizeof(expected)) == 0);
+    generateAndValidate(pool, context, digest, 3, &key, &valid, &pending);
+    mfTestWait(pending);
+    MF_TEST_ASSERT(key.size() == mf::max_key_length + 1);
+    MF_TEST_ASSERT(key == reinterpret_cast<const char *>(expected));
+    MF_TEST_ASSERT(valid.load() == 1);
+    mfLicensingReleaseContext(&context);
+}
+
+} // namespace
+
+int main(int argc, const char *argv[])
+{
+    if( mfLicensingInitializePrivateKeyFromPrime(&mfTestKey, reinterpret_cast<const unsigned char *>(MF_TEST_PRIVATE_KEY)) != 0 ) {
+        std::fprintf(stderr, "invalid test private key\n");
+        return 1;
+    }
+    MF_TEST_RUN(testGenerateAndValidate);
+    MF_TEST_RUN(testBoundedQueue);
+    MF_TEST_RUN(testWorkersSubmitting);
+    MF_TEST_RUN(testLongestKeys);
+    return mfTestReport("mflicensingasynctests");
+}
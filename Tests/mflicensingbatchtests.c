@@ -0,0 +1,165 @@
+//
+//  mflicensingbatchtests.c
+//  MFLicensing
+//  https://github.com/freshcode/MFLicensing
+//
+//  Batch validation tests: every batch kernel the processor supports must accept and reject the keys
+//  mfLicensingValidateLicenseWithContext accepts and rejects, and validations running in several
+//  threads must keep doing so while the kernel is selected and changed.
+//
+//  Licensing
+//  ---------
+//  Public Domain
+//
+
+#include <string.h>
+#include <pthread.h>
+#include "mflicensingbatch.h"
+#include "mftest.h"
+
+#define MF_TEST_KEYS 61
+#define MF_TEST_THREADS 3
+#define MF_TEST_ROUNDS 40
+
+static const char *mfTestKernels[] = { "portable", "avx2", "avx512" };
+#define MF_TEST_KERNELS (sizeof(mfTestKernels) / sizeof(mfTestKernels[0]))
+
+typedef struct {
+    mfLicensingContext *context;
+    mfLicensingDigest digests[MF_TEST_KEYS];
+    unsigned char keys[MF_TEST_KEYS][256];
+    const unsigned char *licenses[MF_TEST_KEYS];
+    unsigned char expected[MF_TEST_KEYS];
+    unsigned int expected_count;
+} mfTestBatch;
+
+// Keys of random digests and indexes, a third of them altered: a character replaced or the digest changed
+static void mfTestFillBatch( mfTestBatch *batch, mfLicensingContext *context, mfLicensingVector *vector, unsigned long long *state )
+{
+    unsigned int key_i, characters = (unsigned int)strlen((const char *)vector->coded_chars);
+    batch->context = context;
+    batch->expected_count = 0;
+    for( key_i = 0; key_i < MF_TEST_KEYS; key_i++ ) {
+        unsigned int index = vector->index_bits == 0 ? 0 : (unsigned int)mfTestRandom(state) & (unsigned int)((1ULL << vector->index_bits) - 1);
+        mfTestRandomBytes(state, batch->digests[key_i].md5hash.b, sizeof(batch->digests[key_i].md5hash.b));
+        if( mfLicensingGenerateLicenseToBuffer(context, &batch->digests[key_i], index, batch->keys[key_i], sizeof(batch->keys[key_i])) != 0 ) {
+            strcpy((char *)batch->keys[key_i], "A");
+        }
+        switch( key_i % 6 ) {
+            case 1:
+                batch->keys[key_i][mfTestRandom(state) % vector->key_length] = vector->coded_chars[mfTestRandom(state) % characters];
+                break;
+            case 3:
+                batch->digests[key_i].md5hash.b[mfTestRandom(state) % 16] ^= 0x10;
+                break;
+        }
+        batch->licenses[key_i] = batch->keys[key_i];
+        batch->expected[key_i] = (unsigned char)mfLicensingValidateLicenseWithContext(context, &batch->digests[key_i], batch->keys[key_i]);
+        batch->expected_count += batch->expected[key_i];
+    }
+}
+
+static int mfTestValidateBatch( mfTestBatch *batch )
+{
+    unsigned char valid[MF_TEST_KEYS];
+    unsigned int count = mfLicensingValidateLicenses(batch->context, batch->digests, batch->licenses, MF_TEST_KEYS, valid);
+    return count == batch->expected_count && memcmp(valid, batch->expected, MF_TEST_KEYS) == 0;
+}
+
+static void testKernelsMatchSingleValidation( void )
+{
+    static const char *charsets[] = { "ACDEFGHJKLMNPQRSTUVWXYZ2345679", "0123456789", "AB",
+        "ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz0123456789" };
+    static const unsigned char key_lengths[] = { 25, 15, 40, 77, 200 };
+    static const unsigned char index_bits[] = { 25, 0, 1, 32 };
+    unsigned long long state = 7;
+    mfLicensingPrivateKey key;
+    unsigned int scheme, check, charset, length, bits, kernel;
+    static mfTestBatch batch;
+
+    MF_TEST_ASSERT(mfLicensingInitializePrivateKeyFromPrime(&key, (const unsigned char *)MF_TEST_PRIVATE_KEY) == 0);
+    for( scheme = MF_LICENSING_SCHEME_LRAND48; scheme <= MF_LICENSING_SCHEME_PHILOX; scheme++ )
+    for( check = 0; check <= 1; check++ )
+    for( charset = 0; charset < sizeof(charsets) / sizeof(charsets[0]); charset++ )
+    for( length = 0; length < sizeof(key_lengths); length++ )
+    for( bits = 0; bits < sizeof(index_bits); bits++ ) {
+        mfLicensingVector vector;
+        mfLicensingContext context;
+        mfLicensingInitializeDefaultVector(&vector);
+        mfLicensingSetPrivateKey(&vector, &key);
+        mfLicensingSetScheme(&vector, scheme);
+        mfLicensingSetCheckCharacter(&vector, check);
+        vector.coded_chars = (const unsigned char *)charsets[charset];
+        vector.key_length = key_lengths[length];
+        vector.index_bits = index_bits[bits];
+        if( mfLicensingInitializeContext(&context, &vector) != 0 ) continue;
+        mfTestFillBatch(&batch, &context, &vector, &state);
+        for( kernel = 0; kernel < MF_TEST_KERNELS; kernel++ ) {
+            if( mfLicensingSetBatchKernel(mfTestKernels[kernel]) != 0 ) continue;
+            MF_TEST_ASSERT(strcmp(mfLicensingBatchKernelName(), mfTestKernels[kernel]) == 0);
+            MF_TEST_ASSERT(mfTestValidateBatch(&batch));
+        }
+        mfLicensingReleaseContext(&context);
+    }
+    MF_TEST_ASSERT(mfLicensingSetBatchKernel("portable") == 0);
+    MF_TEST_ASSERT(mfLicensingSetBatchKernel("unknown") == -1);
+    MF_TEST_ASSERT(strcmp(mfLicensingBatchKernelName(), "portable") == 0);
+}
+
+static void *mfTestValidateThread( void *argument )
+{
+    mfTestBatch *batch = (mfTestBatch *)argument;
+    unsigned int round;
+    int same = 1;
+    for( round = 0; round < MF_TEST_ROUNDS; round++ ) {
+        same &= mfTestValidateBatch(batch);
+    }
+    return same ? batch : NULL;
+}
+
+// The kernel is changed while other threads validate, a validation uses one kernel from start to end
+static void testConcurrentKernelSelection( void )
+{
+    mfLicensingPrivateKey key;
+    mfLicensingVector vector;
+    mfLicensingContext context;
+    static mfTestBatch batches[MF_TEST_THREADS];
+    pthread_t threads[MF_TEST_THREADS];
+    unsigned long long state = 11;
+    unsigned int thread_i, round;
+    void *result;
+
+    mfLicensingInitializePrivateKeyFromPrime(&key, (const unsigned char *)MF_TEST_PRIVATE_KEY);
+    mfLicensingInitializeDefaultVector(&vector);
+    mfLicensingSetPrivateKey(&vector, &key);
+    mfLicensingSetScheme(&vector, MF_LICENSING_SCHEME_PHILOX);
+    MF_TEST_ASSERT(mfLicensingInitializeContext(&context, &vector) == 0);
+    for( thread_i = 0; thread_i < MF_TEST_THREADS; thread_i++ ) {
+        mfTestFillBatch(&batches[thread_i], &context, &vector, &state);
+    }
+    for( thread_i = 0; thread_i < MF_TEST_THREADS; thread_i++ ) {
+        MF_TEST_ASSERT(pthread_create(&threads[thread_i], NULL, mfTestValidateThread, &batches[thread_i]) == 0);
+    }
+    for( round = 0; round < MF_TEST_ROUNDS; round++ ) {
+        mfLicensingSetBatchKernel(mfTestKernels[round % MF_TEST_KERNELS]);
+        MF_TEST_ASSERT(mfLicensingBatchKernelName() != NULL);
+    }
+    for( thread_i = 0; thread_i < MF_TEST_THREADS; thread_i++ ) {
+        MF_TEST_ASSERT(pthread_join(threads[thread_i], &result) == 0);
+        MF_TEST_ASSERT(result == &batches[thread_i]);
+    }
+    mfLicensingReleaseContext(&context);
+}
+
+int main( int argc, const char * argv[] )
+{
+    MF_TEST_RUN(testConcurrentKernelSelection);
+    MF_TEST_RUN(testKernelsMatchSingleValidation);
+    printf("batch kernels: %s", mfTestKernels[0]);
+    unsigned int kernel;
+    for( kernel = 1; kernel < MF_TEST_KERNELS; kernel++ ) {
+        if( mfLicensingSetBatchKernel(mfTestKernels[kernel]) == 0 ) printf(", %s", mfTestKernels[kernel]);
+    }
+    printf("\n");
+    return mfTestReport("mflicensingbatchtests");
+}
@@ -0,0 +1,162 @@
+//
+//  mflicensingblobtests.c
+//  MFLicensing
+//  https://github.com/freshcode/MFLicensing
+//
+//  Compiled context tests: a context attached to a blob, at any alignment, generates and validates
+//  the keys of the context it was compiled from; truncated, corrupted and inconsistent blobs (with a
+//  valid checksum) are rejected while blobs compiled before the key schemes are attached.  Build with
+//  -fsanitize=alignment,undefined to check the accesses.
+//
+//  Licensing
+//  ---------
+//  Public Domain
+//
+
+#include <string.h>
+#include <stdint.h>
+#include "mflicensingblob.h"
+#include "mftest.h"
+
+#define MF_TEST_PARAMS_OFFSET 16
+#define MF_TEST_CHECKSUM_OFFSET 8
+
+static mfLicensingPrivateKey mfTestKey;
+
+// Recomputes the checksum of a blob altered on purpose, see mfLicensingBlobChecksum
+static void mfTestSealBlob( unsigned char *b )
+{
+    uint32_t sum = 0, sum_of_sums = 0;
+    unsigned int offset, byte_i;
+    for( offset = MF_TEST_PARAMS_OFFSET; offset + 4 <= MF_LICENSING_BLOB_SIZE; offset += 4 ) {
+        sum += (uint32_t)b[offset] | ((uint32_t)b[offset+1] << 8) | ((uint32_t)b[offset+2] << 16) | ((uint32_t)b[offset+3] << 24);
+        sum_of_sums += sum;
+    }
+    uint64_t checksum = ((uint64_t)sum_of_sums << 32) | sum;
+    for( byte_i = 0; byte_i < 8; byte_i++ ) {
+        b[MF_TEST_CHECKSUM_OFFSET + byte_i] = (unsigned char)(checksum >> (byte_i * 8));
+    }
+}
+
+static void mfTestCompile( mfLicensingVector *vector, mfLicensingContext *context, unsigned char *blob, unsigned int scheme )
+{
+    mfLicensingInitializeDefaultVector(vector);
+    mfLicensingSetPrivateKey(vector, &mfTestKey);
+    mfLicensingSetScheme(vector, scheme);
+    mfLicensingSetCheckCharacter(vector, 1);
+    MF_TEST_ASSERT(mfLicensingInitializeContext(context, vector) == 0);
+    MF_TEST_ASSERT(mfLicensingSerializeContext(context, blob, MF_LICENSING_BLOB_SIZE) == MF_LICENSING_BLOB_SIZE);
+}
+
+// Blobs at every offset from 0 to 7 of an aligned buffer give the keys of the original context
+static void testAttachAtAnyAlignment( void )
+{
+    static unsigned char storage[MF_LICENSING_BLOB_SIZE + 64] __attribute__((aligned(64)));
+    unsigned char blob[MF_LICENSING_BLOB_SIZE];
+    unsigned long long state = 23;
+    unsigned int scheme, offset, index;
+    for( scheme = MF_LICENSING_SCHEME_LRAND48; scheme <= MF_LICENSING_SCHEME_PHILOX; scheme++ ) {
+        mfLicensingVector vector;
+        mfLicensingContext context;
+        mfTestCompile(&vector, &context, blob, scheme);
+        for( offset = 0; offset < 8; offset++ ) {
+            mfLicensingCompiledContext compiled;
+            unsigned int mismatches = 0;
+            memcpy(&storage[offset], blob, sizeof(blob));
+            MF_TEST_ASSERT(mfLicensingAttachContext(&compiled, &storage[offset], sizeof(blob)) == 0);
+            MF_TEST_ASSERT(compiled.vector.private_key == &compiled.private_key);
+            MF_TEST_ASSERT(memcmp(compiled.private_key.data.b, mfTestKey.data.b, 32) == 0);
+            for( index = 0; index < 32; index++ ) {
+                mfLicensingDigest digest;
+                unsigned char expected[64], license[64];
+                mfTestRandomBytes(&state, digest.md5hash.b, sizeof(digest.md5hash.b));
+                mfLicensingGenerateLicenseToBuffer(&context, &digest, index, expected, sizeof(expected));
+                if( mfLicensingGenerateLicenseToBuffer(&compiled.context, &digest, index, license, sizeof(license)) != 0 ||
+                    strcmp((const char *)license, (const char *)expected) != 0 ||
+                    mfLicensingValidateLicenseWithContext(&compiled.context, &digest, expected) != 1 ) {
+                    mismatches++;
+                }
+            }
+            MF_TEST_ASSERT(mismatches == 0);
+        }
+        mfLicensingReleaseContext(&context);
+    }
+}
+
+static void testRejectedBlobs( void )
+{
+    unsigned char blob[MF_LICENSING_BLOB_SIZE], altered[MF_LICENSING_BLOB_SIZE];
+    mfLicensingCompiledContext compiled;
+    mfLicensingVector vector;
+    mfLicensingContext context;
+    unsigned int byte_i;
+
+    mfTestCompile(&vector, &context, blob, MF_LICENSING_SCHEME_PHILOX);
+    MF_TEST_ASSERT(mfLicensingAttachContext(&compiled, blob, sizeof(blob) - 1) == -1);
+    MF_TEST_ASSERT(compiled.context.vector == 0);
+
+    // Any byte changed without updating the checksum
+    unsigned int accepted = 0;
+    for( byte_i = 0; byte_i < MF_LICENSING_BLOB_SIZE; byte_i++ ) {
+        memcpy(altered, blob, sizeof(blob));
+        altered[byte_i] ^= 0x01;
+        if( mfLicensingAttachContext(&compiled, altered, sizeof(altered)) == 0 ) accepted++;
+    }
+    MF_TEST_ASSERT(accepted == 0);
+
+    // Parameters inconsistent with each other, with a valid checksum
+    static const struct { unsigned int offset; unsigned char value; } inconsistencies[] = {
+        { MF_TEST_PARAMS_OFFSET + 4, 0 },       // bits_in_key
+        { MF_TEST_PARAMS_OFFSET + 4, 0 },       // bits_in_key - 1, set below
+        { MF_TEST_PARAMS_OFFSET + 2, 24 },      // key_length, without the matching bits_in_key
+        { MF_TEST_PARAMS_OFFSET + 5, 2 },       // check_character
+        { MF_TEST_PARAMS_OFFSET + 6, 3 },       // scheme
+    };
+    unsigned int inconsistency_i;
+    for( inconsistency_i = 0; inconsistency_i < sizeof(inconsistencies) / sizeof(inconsistencies[0]); inconsistency_i++ ) {
+        memcpy(altered, blob, sizeof(blob));
+        altered[inconsistencies[inconsistency_i].offset] = inconsistencies[inconsistency_i].value;
+        if( inconsistency_i == 1 ) altered[MF_TEST_PARAMS_OFFSET + 4] = blob[MF_TEST_PARAMS_OFFSET + 4] - 1;
+        mfTestSealBlob(altered);
+        MF_TEST_ASSERT(mfLicensingAttachContext(&compiled, altered, sizeof(altered)) == -1);
+    }
+    memcpy(altered, blob, sizeof(blob));
+    mfTestSealBlob(altered);
+    MF_TEST_ASSERT(mfLicensingAttachContext(&compiled, altered, sizeof(altered)) == 0);
+    mfLicensingReleaseContext(&context);
+}
+
+// Blobs compiled before the key schemes hold 0 in the scheme byte, the first scheme
+static void testBlobsWithoutScheme( void )
+{
+    mfLicensingVector vector;
+    mfLicensingContext context;
+    mfLicensingCompiledContext compiled;
+    mfLicensingDigest digest;
+    unsigned char blob[MF_LICENSING_BLOB_SIZE], license[64], attached_license[64];
+
+    mfTestCompile(&vector, &context, blob, MF_LICENSING_SCHEME_LRAND48);
+    MF_TEST_ASSERT(blob[MF_TEST_PARAMS_OFFSET + 6] == MF_LICENSING_SCHEME_LRAND48);
+    blob[MF_TEST_PARAMS_OFFSET + 6] = 0;
+    mfTestSealBlob(blob);
+    MF_TEST_ASSERT(mfLicensingAttachContext(&compiled, blob, sizeof(blob)) == 0);
+    MF_TEST_ASSERT(compiled.vector.scheme == MF_LICENSING_SCHEME_LRAND48);
+    memset(&digest, 0x45, sizeof(digest));
+    MF_TEST_ASSERT(mfLicensingGenerateLicenseToBuffer(&context, &digest, 77, license, sizeof(license)) == 0);
+    MF_TEST_ASSERT(mfLicensingGenerateLicenseToBuffer(&compiled.context, &digest, 77, attached_license, sizeof(attached_license)) == 0);
+    MF_TEST_ASSERT(strcmp((const char *)license, (const char *)attached_license) == 0);
+    MF_TEST_ASSERT(mfLicensingValidateLicenseWithContext(&compiled.context, &digest, license) == 1);
+    mfLicensingReleaseContext(&context);
+}
+
+int main( int argc, const char * argv[] )
+{
+    if( mfLicensingInitializePrivateKeyFromPrime(&mfTestKey, (const unsigned char *)MF_TEST_PRIVATE_KEY) != 0 ) {
+        fprintf(stderr, "invalid test private key\n");
+        return 1;
+    }
+    MF_TEST_RUN(testAttachAtAnyAlignment);
+    MF_TEST_RUN(testRejectedBlobs);
+    MF_TEST_RUN(testBlobsWithoutScheme);
+    return mfTestReport("mflicensingblobtests");
+}
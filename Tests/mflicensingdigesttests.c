@@ -0,0 +1,169 @@
+//
+//  mflicensingdigesttests.c
+//  MFLicensing
+//  https://github.com/freshcode/MFLicensing
+//
+//  Digest provider tests: MD5 and truncated SHA-256 known answers (RFC 1321, FIPS 180-2), streamed
+//  in pieces of every size and hashed in batches, with the SHA-256 kernel selected by several threads
+//  hashing at once first.
+//
+//  Licensing
+//  ---------
+//  Public Domain
+//
+
+#include <string.h>
+#include <pthread.h>
+#include "mflicensingdigest.h"
+#include "mftest.h"
+
+#define MF_TEST_THREADS 4
+#define MF_TEST_MESSAGES 33
+
+typedef struct {
+    const mfLicensingDigestProvider *provider;
+    const char *message;
+    unsigned long repeat;
+    const char *digest;
+} mfTestKnownAnswer;
+
+static const mfTestKnownAnswer mfTestKnownAnswers[] = {
+    { &mfLicensingDigestMD5, "", 1, "d41d8cd98f00b204e9800998ecf8427e" },
+    { &mfLicensingDigestMD5, "abc", 1, "900150983cd24fb0d6963f7d28e17f72" },
+    { &mfLicensingDigestMD5, "12345678901234567890123456789012345678901234567890123456789012345678901234567890", 1, "57edf4a22be3c955ac49da2e2107b67a" },
+    { &mfLicensingDigestSHA256, "", 1, "e3b0c44298fc1c149afbf4c8996fb924" },
+    { &mfLicensingDigestSHA256, "abc", 1, "ba7816bf8f01cfea414140de5dae2223" },
+    { &mfLicensingDigestSHA256, "abcdbcdecdefdefgefghfghighijhijkijkljklmklmnlmnomnopnopq", 1, "248d6a61d20638b8e5c026930c3e6039" },
+    { &mfLicensingDigestSHA256, "a", 1000000, "cdc76e5c9914fb9281a1c7e284d73e67" },
+};
+#define MF_TEST_KNOWN_ANSWERS (sizeof(mfTestKnownAnswers) / sizeof(mfTestKnownAnswers[0]))
+
+static int mfTestDigestIs( const mfLicensingDigest *digest, const char *hex )
+{
+    char text[33];
+    unsigned int byte_i;
+    for( byte_i = 0; byte_i < 16; byte_i++ ) {
+        sprintf(&text[byte_i * 2], "%02x", digest->md5hash.b[byte_i]);
+    }
+    return strcmp(text, hex) == 0;
+}
+
+static void *mfTestHashThread( void *argument )
+{
+    const mfTestKnownAnswer *answer = &mfTestKnownAnswers[5];
+    const void *messages[MF_TEST_MESSAGES];
+    unsigned long sizes[MF_TEST_MESSAGES];
+    mfLicensingDigest digests[MF_TEST_MESSAGES];
+    unsigned int message_i;
+    int same = 1;
+    for( message_i = 0; message_i < MF_TEST_MESSAGES; message_i++ ) {
+        messages[message_i] = answer->message;
+        sizes[message_i] = strlen(answer->message);
+    }
+    mfLicensingComputeDigests(answer->provider, messages, sizes, MF_TEST_MESSAGES, digests);
+    for( message_i = 0; message_i < MF_TEST_MESSAGES; message_i++ ) {
+        same &= mfTestDigestIs(&digests[message_i], answer->digest);
+    }
+    return same ? argument : NULL;
+}
+
+// The first SHA-256 digests select the kernel, concurrently here
+static void testConcurrentKernelSelection( void )
+{
+    pthread_t threads[MF_TEST_THREADS];
+    void *result;
+    size_t i;
+    for( i = 0; i < MF_TEST_THREADS; i++ ) {
+        MF_TEST_ASSERT(pthread_create(&threads[i], NULL, mfTestHashThread, (void *)(i + 1)) == 0);
+    }
+    for( i = 0; i < MF_TEST_THREADS; i++ ) {
+        MF_TEST_ASSERT(pthread_join(threads[i], &result) == 0);
+        MF_TEST_ASSERT(result == (void *)(i + 1));
+    }
+    MF_TEST_ASSERT(mfLicensingSHA256KernelName() != NULL);
+}
+
+static void testKnownAnswers( void )
+{
+    mfLicensingDigestContext context;
+    mfLicensingDigest digest;
+    unsigned int answer_i;
+    unsigned long repeat;
+    for( answer_i = 0; answer_i < MF_TEST_KNOWN_ANSWERS; answer_i++ ) {
+        const mfTestKnownAnswer *answer = &mfTestKnownAnswers[answer_i];
+        if( answer->repeat == 1 ) {
+            mfLicensingComputeDigest(answer->provider, answer->message, strlen(answer->message), &digest);
+            MF_TEST_ASSERT(mfTestDigestIs(&digest, answer->digest));
+        }
+        mfLicensingDigestInit(&context, answer->provider);
+        for( repeat = 0; repeat < answer->repeat; repeat++ ) {
+            mfLicensingDigestUpdate(&context, answer->message, strlen(answer->message));
+        }
+        mfLicensingDigestFinal(&context, &digest);
+        MF_TEST_ASSERT(mfTestDigestIs(&digest, answer->digest));
+    }
+}
+
+// A message streamed in pieces of every size from 1 to 130 bytes has the digest computed at once
+static void testStreaming( void )
+{
+    const mfLicensingDigestProvider *providers[] = { &mfLicensingDigestMD5, &mfLicensingDigestSHA256 };
+    unsigned long long state = 3;
+    unsigned char message[1000];
+    mfLicensingDigestContext context;
+    mfLicensingDigest expected, digest;
+    unsigned int provider_i, piece, offset;
+    mfTestRandomBytes(&state, message, sizeof(message));
+    for( provider_i = 0; provider_i < 2; provider_i++ ) {
+        unsigned int mismatches = 0;
+        mfLicensingComputeDigest(providers[provider_i], message, sizeof(message), &expected);
+        for( piece = 1; piece <= 130; piece++ ) {
+            mfLicensingDigestInit(&context, providers[provider_i]);
+            for( offset = 0; offset < sizeof(message); offset += piece ) {
+                unsigned int size = sizeof(message) - offset < piece ? (unsigned int)sizeof(message) - offset : piece;
+                mfLicensingDigestUpdate(&context, &message[offset], size);
+            }
+            mfLicensingDigestFinal(&context, &digest);
+            if( memcmp(digest.md5hash.b, expected.md5hash.b, 16) != 0 ) mismatches++;
+        }
+        MF_TEST_ASSERT(mismatches == 0);
+    }
+}
+
+// Batches of messages of different sizes, sharing blocks or not, have the digests computed one by one
+static void testBatches( void )
+{
+    const mfLicensingDigestProvider *providers[] = { &mfLicensingDigestMD5, &mfLicensingDigestSHA256 };
+    unsigned long long state = 5;
+    static unsigned char data[MF_TEST_MESSAGES][300];
+    const void *messages[MF_TEST_MESSAGES];
+    unsigned long sizes[MF_TEST_MESSAGES];
+    mfLicensingDigest digests[MF_TEST_MESSAGES], expected;
+    unsigned int provider_i, count, message_i;
+    for( message_i = 0; message_i < MF_TEST_MESSAGES; message_i++ ) {
+        mfTestRandomBytes(&state, data[message_i], sizeof(data[message_i]));
+        messages[message_i] = data[message_i];
+        sizes[message_i] = mfTestRandom(&state) % sizeof(data[message_i]);
+    }
+    for( provider_i = 0; provider_i < 2; provider_i++ ) {
+        for( count = 0; count <= MF_TEST_MESSAGES; count++ ) {
+            unsigned int mismatches = 0;
+            mfLicensingComputeDigests(providers[provider_i], messages, sizes, count, digests);
+            for( message_i = 0; message_i < count; message_i++ ) {
+                mfLicensingComputeDigest(providers[provider_i], messages[message_i], sizes[message_i], &expected);
+                if( memcmp(digests[message_i].md5hash.b, expected.md5hash.b, 16) != 0 ) mismatches++;
+            }
+            MF_TEST_ASSERT(mismatches == 0);
+        }
+    }
+}
+
+int main( int argc, const char * argv[] )
+{
+    MF_TEST_RUN(testConcurrentKernelSelection);
+    MF_TEST_RUN(testKnownAnswers);
+    MF_TEST_RUN(testStreaming);
+    MF_TEST_RUN(testBatches);
+    printf("sha-256 kernel: %s\n", mfLicensingSHA256KernelName());
+    return mfTestReport("mflicensingdigesttests");
+}
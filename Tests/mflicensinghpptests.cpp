@@ -0,0 +1,119 @@
+//
+//  mflicensinghpptests.cpp
+//  MFLicensing
+//  https://github.com/freshcode/MFLicensing
+//
+//  C++ interface tests: a vector shared by several threads, making the first calls of the process
+//  (SHA-256 digests, generation, batch validation) at once, generates the keys generated by a single
+//  thread and validates them.  Build with -fsanitize=thread to check the sharing.
+//
+//  Licensing
+//  ---------
+//  Public Domain
+//
+
+#include "mflicensing.hpp"
+
+extern "C" {
+#include "mflicensingbatch.h"
+#include "mftest.h"
+}
+
+#include <atomic>
+#include <string>
+#include <thread>
+#include <vector>
+
+namespace {
+
+constexpr unsigned int mfTestThreads = 4;
+constexpr unsigned int mfTestKeys = 200;
+
+struct Results {
+    std::vector<std::string> keys;
+    unsigned int failures = 0;
+};
+
+// Every thread generates the same keys; the batch of them is validated, a key of another digest is not
+void generateAndValidate(const mf::Vector *vector, std::atomic<bool> *start, Results *results)
+{
+    mfLicensingDigest digests[mfTestKeys];
+    mf::LicenseKey keys[mfTestKeys];
+    const unsigned char *licenses[mfTestKeys];
+    unsigned char valid[mfTestKeys];
+
+    while( !start->load() ) std::this_thread::yield();
+    for( unsigned int i = 0; i < mfTestKeys; i++ ) {
+        digests[i] = mf::digest_of("customer " + std::to_string(i), mfLicensingDigestSHA256);
+        std::optional<mf::LicenseKey> key = vector->generate(digests[i], i);
+        if( !key ) {
+            results->failures++;
+            continue;
+        }
+        keys[i] = *key;
+        licenses[i] = keys[i].data();
+        results->keys.push_back(key->str());
+        if( !vector->validate(digests[i], *key) ) results->failures++;
+        if( i > 0 && vector->validate(digests[i - 1], *key) ) results->failures++;
+    }
+    if( mfLicensingValidateLicenses(&vector->context(), digests, licenses, mfTestKeys, valid) != mfTestKeys ) {
+        results->failures++;
+    }
+}
+
+void testSharedVector()
+{
+    std::optional<mf::Vector> vector = mf::Vector::create({
+        .private_key = MF_TEST_PRIVATE_KEY,
+        .index_bits = 16,
+        .check_character = true,
+        .scheme = MF_LICENSING_SCHEME_PHILOX,
+    });
+    MF_TEST_ASSERT(vector.has_value());
+    if( !vector ) return;
+
+    std::atomic<bool> start(false);
+    Results results[mfTestThreads];
+    std::vector<std::thread> threads;
+    for( unsigned int thread_i = 0; thread_i < mfTestThreads; thread_i++ ) {
+        threads.emplace_back(generateAndValidate, &*vector, &start, &results[thread_i]);
+    }
+    start = true;
+    for( std::thread &thread : threads ) thread.join();
+
+    Results single;
+    std::atomic<bool> started(true);
+    generateAndValidate(&*vector, &started, &single);
+    MF_TEST_ASSERT(single.failures == 0);
+    MF_TEST_ASSERT(single.keys.size() == mfTestKeys);
+    for( unsigned int thread_i = 0; thread_i < mfTestThreads; thread_i++ ) {
+        MF_TEST_ASSERT(results[thread_i].failures == 0);
+        MF_TEST_ASSERT(results[thread_i].keys == single.keys);
+    }
+}
+
+// A moved vector keeps generating the same keys, the moved from vector is released
+void testMovedVector()
+{
+    std::optional<mf::Vector> vector = mf::Vector::create({ .private_key = MF_TEST_PRIVATE_KEY });
+    MF_TEST_ASSERT(vector.has_value());
+    if( !vector ) return;
+    mf::Digest digest = mf::digest_of(std::string_view("John Appleseed"));
+    std::optional<mf::LicenseKey> key = vector->generate(digest, 1);
+    MF_TEST_ASSERT(key.has_value());
+
+    mf::Vector moved(std::move(*vector));
+    MF_TEST_ASSERT(vector->context().vector == nullptr);
+    std::optional<mf::LicenseKey> again = moved.generate(digest, 1);
+    MF_TEST_ASSERT(again.has_value() && key.has_value() && *again == *key);
+    MF_TEST_ASSERT(key.has_value() && moved.validate(digest, key->view()));
+}
+
+} // namespace
+
+int main(int argc, const char *argv[])
+{
+    MF_TEST_RUN(testSharedVector);
+    MF_TEST_RUN(testMovedVector);
+    return mfTestReport("mflicensinghpptests");
+}
@@ -0,0 +1,281 @@
+//
+//  mflicensingjournaltests.c
+//  MFLicensing
+//  https://github.com/freshcode/MFLicensing
+//
+//  Journal tests: the keys issued by several threads are replayed from the journal, a record torn
+//  at the end of the file by a crash is dropped when it is reopened, while a corrupted record synced
+//  before and a journal of another vector (same parameters, other seeds, characters or scheme) are
+//  refused.
+//
+//  Licensing
+//  ---------
+//  Public Domain
+//
+
+#include <string.h>
+#include <stdint.h>
+#include <unistd.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include "mflicensingjournal.h"
+#include "mftest.h"
+
+#define MF_TEST_THREADS 4
+#define MF_TEST_KEYS_PER_THREAD 500
+#define MF_TEST_KEYS (MF_TEST_THREADS * MF_TEST_KEYS_PER_THREAD)
+
+static char mfTestPath[64];
+static mfLicensingPrivateKey mfTestKey;
+
+typedef struct {
+    mfLicensingJournal *journal;
+    unsigned int first;
+    unsigned int failures;
+} mfTestIssuer;
+
+static void mfTestVector( mfLicensingVector *vector )
+{
+    mfLicensingInitializeDefaultVector(vector);
+    mfLicensingSetPrivateKey(vector, &mfTestKey);
+    mfLicensingSetCheckCharacter(vector, 1);
+}
+
+static mfLicensingDigest mfTestDigest( unsigned int i )
+{
+    unsigned long long state = 0x7000 + i;
+    mfLicensingDigest digest;
+    mfTestRandomBytes(&state, digest.md5hash.b, sizeof(digest.md5hash.b));
+    return digest;
+}
+
+static void mfTestCorrupt( unsigned long offset )
+{
+    FILE *file = fopen(mfTestPath, "r+b");
+    if( file != NULL ) {
+        int byte;
+        fseek(file, (long)offset, SEEK_SET);
+        byte = fgetc(file);
+        fseek(file, (long)offset, SEEK_SET);
+        fputc(byte ^ 0x10, file);
+        fclose(file);
+    }
+}
+
+static long mfTestFileSize( void )
+{
+    struct stat info;
+    return stat(mfTestPath, &info) == 0 ? (long)info.st_size : -1;
+}
+
+static void *mfTestIssue( void *argument )
+{
+    mfTestIssuer *issuer = (mfTestIssuer *)argument;
+    unsigned int i;
+    for( i = issuer->first; i < issuer->first + MF_TEST_KEYS_PER_THREAD; i++ ) {
+        mfLicensingDigest digest = mfTestDigest(i);
+        unsigned char license[64];
+        if( mfLicensingJournalIssueLicense(issuer->journal, &digest, i, license, sizeof(license)) != 0 ) {
+            issuer->failures++;
+        }
+    }
+    return 0;
+}
+
+// Replays the journal, checking every record rebuilds the key of its digest and index; returns the
+// number of records, -1 on a mismatch or a corrupted record
+static long mfTestReplay( mfLicensingContext *context, unsigned char *seen )
+{
+    mfLicensingJournalReader reader;
+    mfLicensingJournalEntry entry;
+    long records = 0;
+    int result;
+
+    if( mfLicensingOpenJournalReader(&reader, mfTestPath) != 0 ) {
+        return -1;
+    }
+    while( (result = mfLicensingJournalReaderNext(&reader, &entry)) == 1 ) {
+        mfLicensingDigest digest = mfTestDigest(entry.index);
+        unsigned char license[64], expected[64];
+        if( entry.sequence != (unsigned long long)records || entry.index >= MF_TEST_KEYS ||
+            memcmp(entry.digest.md5hash.b, digest.md5hash.b, 16) != 0 ||
+            mfLicensingJournalEntryLicense(context, &entry, license, sizeof(license)) != 0 ||
+            mfLicensingGenerateLicenseToBuffer(context, &digest, entry.index, expected, sizeof(expected)) != 0 ||
+            strcmp((const char *)license, (const char *)expected) != 0 ) {
+            records = -1;
+            break;
+        }
+        seen[entry.index]++;
+        records++;
+    }
+    if( result == -1 ) {
+        records = -1;
+    }
+    mfLicensingCloseJournalReader(&reader);
+    return records;
+}
+
+// Keys issued by several threads at once are all in the journal, once each
+static void testReplayIssuedKeys( void )
+{
+    mfLicensingVector vector;
+    mfLicensingContext context;
+    mfLicensingJournal journal;
+    mfLicensingJournalOptions options;
+    mfTestIssuer issuers[MF_TEST_THREADS];
+    pthread_t threads[MF_TEST_THREADS];
+    static unsigned char seen[MF_TEST_KEYS];
+    unsigned int thread_i, i, missing = 0;
+
+    unlink(mfTestPath);
+    mfTestVector(&vector);
+    MF_TEST_ASSERT(mfLicensingInitializeContext(&context, &vector) == 0);
+    mfLicensingInitializeJournalOptions(&options);
+    options.capacity = 64;
+    options.commit_records = 100;
+    MF_TEST_ASSERT(mfLicensingOpenJournal(&journal, mfTestPath, &context, &options) == 0);
+    for( thread_i = 0; thread_i < MF_TEST_THREADS; thread_i++ ) {
+        issuers[thread_i].journal = &journal;
+        issuers[thread_i].first = thread_i * MF_TEST_KEYS_PER_THREAD;
+        issuers[thread_i].failures = 0;
+        pthread_create(&threads[thread_i], 0, mfTestIssue, &issuers[thread_i]);
+    }
+    for( thread_i = 0; thread_i < MF_TEST_THREADS; thread_i++ ) {
+        pthread_join(threads[thread_i], 0);
+        MF_TEST_ASSERT(issuers[thread_i].failures == 0);
+    }
+
+    // A key of another index isn't recorded
+    {
+        mfLicensingDigest digest = mfTestDigest(0);
+        unsigned char license[64];
+        const unsigned char *character;
+        unsigned int appended = 0;
+        mfLicensingGenerateLicenseToBuffer(&context, &digest, 1, license, sizeof(license));
+        MF_TEST_ASSERT(mfLicensingJournalAppend(&journal, &digest, 0, license) == -1);
+        // Nor a key whose value doesn't fit in the bits of the key, replayed as another key, whatever its
+        // check character
+        memset(license, 'X', vector.key_length);
+        license[vector.key_length + 1] = 0;
+        for( character = vector.coded_chars; *character != 0; character++ ) {
+            license[vector.key_length] = *character;
+            if( mfLicensingJournalAppend(&journal, &digest, 0, license) != -1 ) appended++;
+        }
+        MF_TEST_ASSERT(appended == 0);
+    }
+    MF_TEST_ASSERT(mfLicensingCloseJournal(&journal) == 0);
+    MF_TEST_ASSERT(mfTestFileSize() == MF_LICENSING_JOURNAL_HEADER_SIZE + MF_TEST_KEYS * MF_LICENSING_JOURNAL_RECORD_SIZE);
+
+    memset(seen, 0, sizeof(seen));
+    MF_TEST_ASSERT(mfTestReplay(&context, seen) == MF_TEST_KEYS);
+    for( i = 0; i < MF_TEST_KEYS; i++ ) {
+        if( seen[i] != 1 ) missing++;
+    }
+    MF_TEST_ASSERT(missing == 0);
+
+    // Records appended after reopening follow the ones already there
+    MF_TEST_ASSERT(mfLicensingOpenJournal(&journal, mfTestPath, &context, 0) == 0);
+    {
+        mfLicensingDigest digest = mfTestDigest(7);
+        unsigned char license[64];
+        mfLicensingGenerateLicenseToBuffer(&context, &digest, 7, license, sizeof(license));
+        MF_TEST_ASSERT(mfLicensingJournalAppend(&journal, &digest, 7, license) == MF_TEST_KEYS);
+    }
+    MF_TEST_ASSERT(mfLicensingCloseJournal(&journal) == 0);
+    memset(seen, 0, sizeof(seen));
+    MF_TEST_ASSERT(mfTestReplay(&context, seen) == MF_TEST_KEYS + 1);
+    MF_TEST_ASSERT(seen[7] == 2);
+    mfLicensingReleaseContext(&context);
+}
+
+static void mfTestWriteJournal( mfLicensingContext *context, unsigned int count )
+{
+    mfLicensingJournal journal;
+    unsigned int i;
+    unlink(mfTestPath);
+    MF_TEST_ASSERT(mfLicensingOpenJournal(&journal, mfTestPath, context, 0) == 0);
+    for( i = 0; i < count; i++ ) {
+        mfLicensingDigest digest = mfTestDigest(i);
+        unsigned char license[64];
+        mfLicensingJournalIssueLicense(&journal, &digest, i, license, sizeof(license));
+    }
+    MF_TEST_ASSERT(mfLicensingCloseJournal(&journal) == 0);
+}
+
+// A torn record at the end of the file is dropped; a record synced before that is corrupted is reported
+static void testTornAndCorruptedRecords( void )
+{
+    mfLicensingVector vector;
+    mfLicensingContext context;
+    mfLicensingJournal journal;
+    static unsigned char seen[MF_TEST_KEYS];
+    static const unsigned char torn[MF_LICENSING_JOURNAL_RECORD_SIZE + 20] = { 1, 2, 3 };
+    FILE *file;
+
+    mfTestVector(&vector);
+    MF_TEST_ASSERT(mfLicensingInitializeContext(&context, &vector) == 0);
+    mfTestWriteJournal(&context, 10);
+
+    // A record of garbage and one cut short, as left by a crash after the last sync
+    file = fopen(mfTestPath, "ab");
+    MF_TEST_ASSERT(file != NULL);
+    if( file != NULL ) {
+        fwrite(torn, 1, sizeof(torn), file);
+        fclose(file);
+    }
+    MF_TEST_ASSERT(mfTestReplay(&context, seen) == 10);
+    MF_TEST_ASSERT(mfLicensingOpenJournal(&journal, mfTestPath, &context, 0) == 0);
+    MF_TEST_ASSERT(mfLicensingCloseJournal(&journal) == 0);
+    MF_TEST_ASSERT(mfTestFileSize() == MF_LICENSING_JOURNAL_HEADER_SIZE + 10 * MF_LICENSING_JOURNAL_RECORD_SIZE);
+
+    // The fourth record, synced, corrupted
+    mfTestCorrupt(MF_LICENSING_JOURNAL_HEADER_SIZE + 3 * MF_LICENSING_JOURNAL_RECORD_SIZE + 30);
+    MF_TEST_ASSERT(mfTestReplay(&context, seen) == -1);
+    MF_TEST_ASSERT(mfLicensingOpenJournal(&journal, mfTestPath, &context, 0) == -1);
+    MF_TEST_ASSERT(mfTestFileSize() == MF_LICENSING_JOURNAL_HEADER_SIZE + 10 * MF_LICENSING_JOURNAL_RECORD_SIZE);
+    mfLicensingReleaseContext(&context);
+}
+
+// A journal is only reopened with the vector it was written for
+static void testOtherVectors( void )
+{
+    unsigned short seed[3] = { 1, 2, 3 };
+    mfLicensingVector vector, other;
+    mfLicensingContext context, other_context;
+    mfLicensingJournal journal;
+    unsigned int change;
+
+    mfTestVector(&vector);
+    MF_TEST_ASSERT(mfLicensingInitializeContext(&context, &vector) == 0);
+    mfTestWriteJournal(&context, 3);
+    for( change = 0; change < 5; change++ ) {
+        mfTestVector(&other);
+        switch( change ) {
+            case 0: mfLicensingSetScramblingSeed(&other, seed); break;
+            case 1: mfLicensingSetSaltSeed(&other, seed); break;
+            case 2: mfLicensingSetEncodingCharacters(&other, (const unsigned char *)"CADEFGHJKLMNPQRSTUVWXYZ2345679"); break;
+            case 3: mfLicensingSetScheme(&other, MF_LICENSING_SCHEME_PHILOX); break;
+            case 4: mfLicensingSetKeyLength(&other, vector.key_length + 1); break;
+        }
+        MF_TEST_ASSERT(mfLicensingInitializeContext(&other_context, &other) == 0);
+        MF_TEST_ASSERT(mfLicensingOpenJournal(&journal, mfTestPath, &other_context, 0) == -1);
+        mfLicensingReleaseContext(&other_context);
+    }
+    MF_TEST_ASSERT(mfLicensingOpenJournal(&journal, mfTestPath, &context, 0) == 0);
+    MF_TEST_ASSERT(mfLicensingCloseJournal(&journal) == 0);
+    mfLicensingReleaseContext(&context);
+}
+
+int main( int argc, const char * argv[] )
+{
+    if( mfLicensingInitializePrivateKeyFromPrime(&mfTestKey, (const unsigned char *)MF_TEST_PRIVATE_KEY) != 0 ) {
+        fprintf(stderr, "invalid test private key\n");
+        return 1;
+    }
+    snprintf(mfTestPath, sizeof(mfTestPath), "/tmp/mflicensingjournaltests.%d", (int)getpid());
+    MF_TEST_RUN(testReplayIssuedKeys);
+    MF_TEST_RUN(testTornAndCorruptedRecords);
+    MF_TEST_RUN(testOtherVectors);
+    unlink(mfTestPath);
+    return mfTestReport("mflicensingjournaltests");
+}
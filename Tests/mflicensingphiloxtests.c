@@ -0,0 +1,141 @@
+//
+//  mflicensingphiloxtests.c
+//  MFLicensing
+//  https://github.com/freshcode/MFLicensing
+//
+//  MF_LICENSING_SCHEME_PHILOX tests: Philox4x32-10 against the known answers of the Random123
+//  distribution (kat_vectors), the index blocks and salt built from its blocks in little-endian
+//  word order, and keys of the scheme pinned so a change to the generator or the encoding is caught.
+//  The pinned keys are validated by every batch kernel as well.
+//
+//  Licensing
+//  ---------
+//  Public Domain
+//
+
+#include <string.h>
+#include "mflicensingbatch.h"
+#include "mflicensinginternal.h"
+#include "mftest.h"
+
+static mfLicensingPrivateKey mfTestKey;
+
+static void testKnownAnswers( void )
+{
+    static const struct {
+        unsigned int key[2];
+        unsigned int counter[4];
+        unsigned int output[4];
+    } vectors[] = {
+        { { 0x00000000, 0x00000000 }, { 0x00000000, 0x00000000, 0x00000000, 0x00000000 },
+          { 0x6627e8d5, 0xe169c58d, 0xbc57ac4c, 0x9b00dbd8 } },
+        { { 0xffffffff, 0xffffffff }, { 0xffffffff, 0xffffffff, 0xffffffff, 0xffffffff },
+          { 0x408f276d, 0x41c83b0e, 0xa20bc7c6, 0x6d5451fd } },
+        { { 0xa4093822, 0x299f31d0 }, { 0x243f6a88, 0x85a308d3, 0x13198a2e, 0x03707344 },
+          { 0xd16cfe09, 0x94fdcceb, 0x5001e420, 0x24126ea1 } },
+    };
+    unsigned int vector_i;
+    for( vector_i = 0; vector_i < sizeof(vectors) / sizeof(vectors[0]); vector_i++ ) {
+        unsigned int output[4];
+        mfLicensingPhilox(vectors[vector_i].key, vectors[vector_i].counter, output);
+        MF_TEST_ASSERT(memcmp(output, vectors[vector_i].output, sizeof(output)) == 0);
+    }
+}
+
+static void mfTestStoreWords( const unsigned int *words, unsigned int count, unsigned char *b )
+{
+    unsigned int byte_i;
+    for( byte_i = 0; byte_i < count * 4; byte_i++ ) {
+        b[byte_i] = (unsigned char)(words[byte_i / 4] >> (byte_i % 4 * 8));
+    }
+}
+
+// The key comes from the salt seed; index blocks are the blocks of (index, 0, 0, 0), the salt the blocks
+// of (0, 0, 0, 1) and (1, 0, 0, 1)
+static void testBlocksAndSalt( void )
+{
+    unsigned short seed[3] = { 0x1234, 0xABCD, 0x0F0F };
+    static const unsigned int indexes[] = { 0, 1, 12345, 0xFFFFFFFF };
+    mfLicensingVector vector;
+    unsigned int key[2], counter[4] = { 0, 0, 0, 1 }, words[8], index_i;
+    unsigned char expected[32];
+    mfU256 salt;
+
+    mfLicensingInitializeDefaultVector(&vector);
+    mfLicensingSetSaltSeed(&vector, seed);
+    mfLicensingCounterKey(&vector, key);
+    MF_TEST_ASSERT(key[0] == 0xABCD1234 && key[1] == 0x0F0F);
+
+    for( index_i = 0; index_i < sizeof(indexes) / sizeof(indexes[0]); index_i++ ) {
+        unsigned int index_counter[4] = { indexes[index_i], 0, 0, 0 };
+        mfU128 block;
+        mfLicensingPhilox(key, index_counter, words);
+        mfTestStoreWords(words, 4, expected);
+        mfLicensingCounterIndexBlock(key, indexes[index_i], &block);
+        MF_TEST_ASSERT(memcmp(block.b, expected, 16) == 0);
+    }
+
+    mfLicensingPhilox(key, counter, words);
+    counter[0] = 1;
+    mfLicensingPhilox(key, counter, words + 4);
+    mfTestStoreWords(words, 8, expected);
+    mfLicensingCounterSalt(key, &salt);
+    MF_TEST_ASSERT(memcmp(salt.b, expected, 32) == 0);
+}
+
+// Keys of the default vector with the Philox scheme, for the digest of bytes 0x00, 0x11, ... 0xFF
+static void testPinnedKeys( void )
+{
+    static const char *kernels[] = { "portable", "avx2", "avx512" };
+    static const struct {
+        unsigned int index;
+        const char *license;
+    } keys[] = {
+        { 0, "ZCQ9MWZGCYLSYHZ6Y9NXQANNM" },
+        { 12345, "G45W43N5EU3JDRCEK2JSRJGEF" },
+        { 0xFFFFFF, "FL4V3JDY96TW2X6QE2AVTGNX7" },
+    };
+    static const char check_characters[] = { 'R', 'U', '7' };
+    const unsigned char *licenses[3];
+    mfLicensingDigest digests[3];
+    unsigned char valid[3];
+    unsigned int check, key_i, byte_i, kernel_i;
+
+    for( key_i = 0; key_i < 3; key_i++ ) {
+        for( byte_i = 0; byte_i < 16; byte_i++ ) digests[key_i].md5hash.b[byte_i] = (unsigned char)(byte_i * 17);
+    }
+    for( check = 0; check <= 1; check++ ) {
+        mfLicensingVector vector;
+        mfLicensingContext context;
+        unsigned char expected[3][32];
+        mfLicensingInitializeDefaultVector(&vector);
+        mfLicensingSetPrivateKey(&vector, &mfTestKey);
+        mfLicensingSetScheme(&vector, MF_LICENSING_SCHEME_PHILOX);
+        mfLicensingSetCheckCharacter(&vector, check);
+        MF_TEST_ASSERT(mfLicensingInitializeContext(&context, &vector) == 0);
+        for( key_i = 0; key_i < 3; key_i++ ) {
+            unsigned char license[32];
+            snprintf((char *)expected[key_i], sizeof(expected[key_i]), "%s%.*s", keys[key_i].license, (int)check, &check_characters[key_i]);
+            licenses[key_i] = expected[key_i];
+            MF_TEST_ASSERT(mfLicensingGenerateLicenseToBuffer(&context, &digests[key_i], keys[key_i].index, license, sizeof(license)) == 0);
+            MF_TEST_ASSERT(strcmp((const char *)license, (const char *)expected[key_i]) == 0);
+        }
+        for( kernel_i = 0; kernel_i < sizeof(kernels) / sizeof(kernels[0]); kernel_i++ ) {
+            if( mfLicensingSetBatchKernel(kernels[kernel_i]) != 0 ) continue;
+            MF_TEST_ASSERT(mfLicensingValidateLicenses(&context, digests, licenses, 3, valid) == 3);
+        }
+        mfLicensingReleaseContext(&context);
+    }
+}
+
+int main( int argc, const char * argv[] )
+{
+    if( mfLicensingInitializePrivateKeyFromPrime(&mfTestKey, (const unsigned char *)MF_TEST_PRIVATE_KEY) != 0 ) {
+        fprintf(stderr, "invalid test private key\n");
+        return 1;
+    }
+    MF_TEST_RUN(testKnownAnswers);
+    MF_TEST_RUN(testBlocksAndSalt);
+    MF_TEST_RUN(testPinnedKeys);
+    return mfTestReport("mflicensingphiloxtests");
+}
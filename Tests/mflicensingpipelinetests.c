@@ -0,0 +1,231 @@
+//
+//  mflicensingpipelinetests.c
+//  MFLicensing
+//  https://github.com/freshcode/MFLicensing
+//
+//  Pipeline tests: items submitted by one or several threads go through every stage exactly once,
+//  whatever the number of threads per stage, the batch sizes and the queue capacity, and come out with
+//  the keys the single calls generate; items whose key can't be generated are skipped by the later
+//  licensing stages.  The longest keys (255 characters and a check character) fit the issuance
+//  buffers, formatted in groups of one character.  Build with -fsanitize=thread to check the queues.
+//
+//  Licensing
+//  ---------
+//  Public Domain
+//
+
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include "mflicensingpipeline.h"
+#include "mftest.h"
+
+#define MF_TEST_ITEMS 20000
+#define MF_TEST_SUBMITTERS 3
+#define MF_TEST_INVALID_ITEM 7
+
+static mfLicensingPrivateKey mfTestKey;
+static mfLicensingIssuance mfTestIssuances[MF_TEST_ITEMS];
+static char mfTestNames[MF_TEST_ITEMS][32];
+static void *mfTestItems[MF_TEST_ITEMS];
+static atomic_uchar mfTestSeen[MF_TEST_ITEMS];
+
+typedef struct {
+    mfLicensingPipeline *pipeline;
+    void **items;
+    unsigned int count;
+} mfTestSubmitter;
+
+// Counts the items reaching the stage, with several threads running it
+static void mfTestTouchStage( void *context, void **items, unsigned int count )
+{
+    unsigned int item_i;
+    for( item_i = 0; item_i < count; item_i++ ) {
+        mfLicensingIssuance *issuance = (mfLicensingIssuance *)items[item_i];
+        issuance->user = (void *)((char *)issuance->user + 1);
+    }
+}
+
+static void mfTestCountStage( void *context, void **items, unsigned int count )
+{
+    unsigned int item_i;
+    for( item_i = 0; item_i < count; item_i++ ) {
+        atomic_fetch_add(&mfTestSeen[(mfLicensingIssuance *)items[item_i] - mfTestIssuances], 1);
+    }
+}
+
+static void *mfTestSubmit( void *argument )
+{
+    mfTestSubmitter *submitter = (mfTestSubmitter *)argument;
+    unsigned int item_i;
+    for( item_i = 0; item_i < submitter->count; item_i++ ) {
+        mfLicensingPipelineSubmit(submitter->pipeline, submitter->items + item_i, 1);
+    }
+    mfLicensingFinishPipeline(submitter->pipeline);
+    return 0;
+}
+
+// The key of the item, generated by the single calls and formatted in groups of 5
+static void mfTestExpectedKey( mfLicensingContext *context, unsigned int item_i, char *formatted )
+{
+    mfLicensingDigest digest;
+    unsigned char license[64];
+    unsigned int c;
+    mfLicensingComputeDigest(&mfLicensingDigestMD5, mfTestNames[item_i], strlen(mfTestNames[item_i]), &digest);
+    mfLicensingGenerateLicenseToBuffer(context, &digest, item_i, license, sizeof(license));
+    for( c = 0; license[c] != 0; c++ ) {
+        if( c != 0 && c % 5 == 0 ) *formatted++ = '-';
+        *formatted++ = (char)license[c];
+    }
+    *formatted = 0;
+}
+
+static void testStageConfigurations( void )
+{
+    static const struct {
+        unsigned int threads[4];
+        unsigned int digest_batch;
+        unsigned int capacity;
+        unsigned int submitters;
+    } configurations[] = {
+        { { 1, 1, 1, 1 }, 0, 64, 1 },
+        { { 2, 3, 1, 1 }, 7, 64, 1 },
+        { { 1, 4, 2, 1 }, 1, 64, 1 },
+        { { 3, 1, 1, 2 }, 300, 2, 1 },
+        { { 1, 1, 1, 1 }, 0, 64, MF_TEST_SUBMITTERS },
+        { { 4, 4, 4, 4 }, 0, 16, MF_TEST_SUBMITTERS },
+    };
+    mfLicensingKeyGrouping grouping = { 5, '-' };
+    mfLicensingVector vector;
+    mfLicensingContext context;
+    unsigned int configuration_i, item_i;
+
+    mfLicensingInitializeDefaultVector(&vector);
+    mfLicensingSetPrivateKey(&vector, &mfTestKey);
+    MF_TEST_ASSERT(mfLicensingInitializeContext(&context, &vector) == 0);
+    for( configuration_i = 0; configuration_i < sizeof(configurations) / sizeof(configurations[0]); configuration_i++ ) {
+        const unsigned int *threads = configurations[configuration_i].threads;
+        mfLicensingStage stages[5] = {
+            { mfLicensingDigestStage, (void *)&mfLicensingDigestMD5, threads[0], configurations[configuration_i].digest_batch },
+            { mfLicensingGenerateStage, &context, threads[1], 0 },
+            { mfLicensingFormatStage, &grouping, threads[2], 0 },
+            { mfTestTouchStage, 0, threads[3], 1 },
+            { mfTestCountStage, 0, 1, 0 },
+        };
+        mfLicensingPipelineOptions options;
+        mfLicensingPipeline pipeline;
+        unsigned int missed = 0, mismatches = 0;
+
+        for( item_i = 0; item_i < MF_TEST_ITEMS; item_i++ ) {
+            snprintf(mfTestNames[item_i], sizeof(mfTestNames[item_i]), "licensee-%u", item_i);
+            memset(&mfTestIssuances[item_i], 0, sizeof(mfLicensingIssuance));
+            mfTestIssuances[item_i].data = mfTestNames[item_i];
+            mfTestIssuances[item_i].size = strlen(mfTestNames[item_i]);
+            mfTestIssuances[item_i].index = item_i;
+            mfTestItems[item_i] = &mfTestIssuances[item_i];
+            atomic_store(&mfTestSeen[item_i], 0);
+        }
+        // Beyond the 25 index bits of the vector, no key is generated
+        mfTestIssuances[MF_TEST_INVALID_ITEM].index = 1u << 30;
+
+        mfLicensingInitializePipelineOptions(&options);
+        options.capacity = configurations[configuration_i].capacity;
+        options.submitters = configurations[configuration_i].submitters;
+        MF_TEST_ASSERT(mfLicensingOpenPipeline(&pipeline, stages, 5, &options) == 0);
+        if( options.submitters == 1 ) {
+            for( item_i = 0; item_i < MF_TEST_ITEMS; item_i += 100 ) {
+                mfLicensingPipelineSubmit(&pipeline, mfTestItems + item_i, MF_TEST_ITEMS - item_i < 100 ? MF_TEST_ITEMS - item_i : 100);
+            }
+            mfLicensingFinishPipeline(&pipeline);
+        } else {
+            mfTestSubmitter submitters[MF_TEST_SUBMITTERS];
+            pthread_t submitter_threads[MF_TEST_SUBMITTERS];
+            unsigned int submitter_i, per_submitter = MF_TEST_ITEMS / MF_TEST_SUBMITTERS;
+            for( submitter_i = 0; submitter_i < MF_TEST_SUBMITTERS; submitter_i++ ) {
+                submitters[submitter_i].pipeline = &pipeline;
+                submitters[submitter_i].items = mfTestItems + submitter_i * per_submitter;
+                submitters[submitter_i].count = submitter_i == MF_TEST_SUBMITTERS - 1 ? MF_TEST_ITEMS - submitter_i * per_submitter : per_submitter;
+                pthread_create(&submitter_threads[submitter_i], 0, mfTestSubmit, &submitters[submitter_i]);
+            }
+            for( submitter_i = 0; submitter_i < MF_TEST_SUBMITTERS; submitter_i++ ) {
+                pthread_join(submitter_threads[submitter_i], 0);
+            }
+        }
+
+        for( item_i = 0; item_i < MF_TEST_ITEMS; item_i++ ) {
+            const mfLicensingIssuance *issuance = &mfTestIssuances[item_i];
+            if( atomic_load(&mfTestSeen[item_i]) != 1 || issuance->user != (void *)1 ) missed++;
+            if( item_i == MF_TEST_INVALID_ITEM ) {
+                if( issuance->status != -1 || issuance->formatted[0] != 0 ) mismatches++;
+            } else if( issuance->status != 0 ) {
+                mismatches++;
+            } else if( item_i % 97 == 0 ) {
+                char expected[64];
+                mfTestExpectedKey(&context, item_i, expected);
+                if( strcmp(expected, (const char *)issuance->formatted) != 0 ) mismatches++;
+            }
+        }
+        MF_TEST_ASSERT(missed == 0);
+        MF_TEST_ASSERT(mismatches == 0);
+    }
+    mfLicensingReleaseContext(&context);
+}
+
+// Keys of 255 characters and a check character, formatted with a separator after every character
+static void testLongestKeys( void )
+{
+    mfLicensingKeyGrouping grouping = { 1, '.' };
+    mfLicensingVector vector;
+    mfLicensingContext context;
+    mfLicensingPipeline pipeline;
+    mfLicensingStage stages[2] = {
+        { mfLicensingGenerateStage, &context, 2, 0 },
+        { mfLicensingFormatStage, &grouping, 1, 0 },
+    };
+    unsigned int item_i, mismatches = 0;
+
+    MF_TEST_ASSERT(MF_LICENSING_ISSUANCE_KEY_SIZE >= 255 + 1 + 1);
+    mfLicensingInitializeDefaultVector(&vector);
+    mfLicensingSetPrivateKey(&vector, &mfTestKey);
+    mfLicensingSetEncodingCharacters(&vector, (const unsigned char *)"01");
+    mfLicensingSetKeyLength(&vector, 255);
+    mfLicensingSetKeyIndexLength(&vector, 8);
+    mfLicensingSetCheckCharacter(&vector, 1);
+    MF_TEST_ASSERT(mfLicensingInitializeContext(&context, &vector) == 0);
+    for( item_i = 0; item_i < 64; item_i++ ) {
+        memset(&mfTestIssuances[item_i], 0x5A, sizeof(mfLicensingIssuance));
+        memset(&mfTestIssuances[item_i].digest, (int)item_i + 1, sizeof(mfLicensingDigest));
+        mfTestIssuances[item_i].index = item_i;
+        mfTestIssuances[item_i].status = 0;
+        mfTestItems[item_i] = &mfTestIssuances[item_i];
+    }
+    MF_TEST_ASSERT(mfLicensingOpenPipeline(&pipeline, stages, 2, 0) == 0);
+    mfLicensingPipelineSubmit(&pipeline, mfTestItems, 64);
+    mfLicensingFinishPipeline(&pipeline);
+
+    for( item_i = 0; item_i < 64; item_i++ ) {
+        const mfLicensingIssuance *issuance = &mfTestIssuances[item_i];
+        unsigned char expected[MF_LICENSING_ISSUANCE_KEY_SIZE];
+        mfLicensingDigest digest = issuance->digest;
+        if( issuance->status != 0 ||
+            mfLicensingGenerateLicenseToBuffer(&context, &digest, item_i, expected, sizeof(expected)) != 0 ||
+            strcmp((const char *)issuance->license, (const char *)expected) != 0 ||
+            strlen((const char *)issuance->formatted) != 256 + 255 ||
+            issuance->formatted[1] != '.' || issuance->formatted[510] != expected[255] ) {
+            mismatches++;
+        }
+    }
+    MF_TEST_ASSERT(mismatches == 0);
+    mfLicensingReleaseContext(&context);
+}
+
+int main( int argc, const char * argv[] )
+{
+    if( mfLicensingInitializePrivateKeyFromPrime(&mfTestKey, (const unsigned char *)MF_TEST_PRIVATE_KEY) != 0 ) {
+        fprintf(stderr, "invalid test private key\n");
+        return 1;
+    }
+    MF_TEST_RUN(testStageConfigurations);
+    MF_TEST_RUN(testLongestKeys);
+    return mfTestReport("mflicensingpipelinetests");
+}
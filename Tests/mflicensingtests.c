@@ -0,0 +1,206 @@
+//
+//  mflicensingtests.c
+//  MFLicensing
+//  https://github.com/freshcode/MFLicensing
+//
+//  Vector validation and key round trip tests: contexts are only initialized from vectors with a
+//  check_character of 0 or 1 and a known scheme (0 being the first one), the keys generated have key_length + check_character
+//  characters and validate, and the registry finds the vectors of the longest keys.
+//
+//  Licensing
+//  ---------
+//  Public Domain
+//
+
+#include <string.h>
+#include "mflicensing.h"
+#include "mflicensingregistry.h"
+#include "mftest.h"
+
+static mfLicensingPrivateKey mfTestKey;
+
+static void mfTestVector( mfLicensingVector *vector )
+{
+    mfLicensingInitializeDefaultVector(vector);
+    mfLicensingSetPrivateKey(vector, &mfTestKey);
+}
+
+static void testVectorValidation( void )
+{
+    mfLicensingVector vector;
+    mfLicensingContext context;
+    mfLicensingDigest digest;
+    unsigned char license[64];
+
+    mfTestVector(&vector);
+    MF_TEST_ASSERT(mfLicensingSetCheckCharacter(&vector, 2) == -1);
+    MF_TEST_ASSERT(mfLicensingSetScheme(&vector, 0) == -1);
+    MF_TEST_ASSERT(mfLicensingSetScheme(&vector, 3) == -1);
+
+    // Fields set directly bypass the setters, the context initialization rejects them
+    memset(&digest, 0, sizeof(digest));
+    vector.check_character = 2;
+    MF_TEST_ASSERT(mfLicensingInitializeContext(&context, &vector) == -1);
+    MF_TEST_ASSERT(mfLicensingGenerateLicense(&vector, &digest, 1) == NULL);
+    MF_TEST_ASSERT(mfLicensingValidateLicense(&vector, &digest, (const unsigned char *)"ACDEFGHJKLMNPQRSTUVWXYZ234") == 0);
+    vector.check_character = 255;
+    MF_TEST_ASSERT(mfLicensingInitializeContext(&context, &vector) == -1);
+    vector.check_character = 1;
+    vector.scheme = 7;
+    MF_TEST_ASSERT(mfLicensingInitializeContext(&context, &vector) == -1);
+
+    vector.scheme = MF_LICENSING_SCHEME_PHILOX;
+    MF_TEST_ASSERT(mfLicensingInitializeContext(&context, &vector) == 0);
+    MF_TEST_ASSERT(mfLicensingGenerateLicenseToBuffer(&context, &digest, 1, license, vector.key_length + 1) == -1);
+    MF_TEST_ASSERT(mfLicensingGenerateLicenseToBuffer(&context, &digest, 1, license, vector.key_length + 2) == 0);
+    MF_TEST_ASSERT(strlen((const char *)license) == vector.key_length + 1u);
+    MF_TEST_ASSERT(mfLicensingValidateLicenseWithContext(&context, &digest, license) == 1);
+    mfLicensingReleaseContext(&context);
+}
+
+// A vector zeroed and filled field by field, its scheme left at 0, gives the keys of the first scheme
+static void testZeroedVector( void )
+{
+    mfLicensingVector vector, zeroed;
+    mfLicensingContext context, zeroed_context;
+    mfLicensingDigest digest;
+    unsigned char license[64], zeroed_license[64];
+
+    mfTestVector(&vector);
+    memset(&zeroed, 0, sizeof(zeroed));
+    zeroed.private_key = vector.private_key;
+    zeroed.coded_chars = vector.coded_chars;
+    memcpy(zeroed.scrambling_seed, vector.scrambling_seed, sizeof(zeroed.scrambling_seed));
+    memcpy(zeroed.salt_seed, vector.salt_seed, sizeof(zeroed.salt_seed));
+    zeroed.key_length = vector.key_length;
+    zeroed.index_bits = vector.index_bits;
+    MF_TEST_ASSERT(mfLicensingInitializeContext(&context, &vector) == 0);
+    MF_TEST_ASSERT(mfLicensingInitializeContext(&zeroed_context, &zeroed) == 0);
+    memset(&digest, 0x21, sizeof(digest));
+    MF_TEST_ASSERT(mfLicensingGenerateLicenseToBuffer(&context, &digest, 42, license, sizeof(license)) == 0);
+    MF_TEST_ASSERT(mfLicensingGenerateLicenseToBuffer(&zeroed_context, &digest, 42, zeroed_license, sizeof(zeroed_license)) == 0);
+    MF_TEST_ASSERT(strcmp((const char *)license, (const char *)zeroed_license) == 0);
+    MF_TEST_ASSERT(mfLicensingValidateLicenseWithContext(&zeroed_context, &digest, license) == 1);
+    mfLicensingReleaseContext(&zeroed_context);
+    mfLicensingReleaseContext(&context);
+}
+
+// Keys of every scheme, with and without check character, round trip through generation, decoding and
+// validation; a changed character is rejected
+static void testRoundTrips( void )
+{
+    static const char *charsets[] = { "ACDEFGHJKLMNPQRSTUVWXYZ2345679", "01", "0123456789" };
+    static const unsigned char key_lengths[] = { 25, 16, 60 };
+    unsigned long long state = 17;
+    unsigned int scheme, check, set, trial;
+    for( scheme = MF_LICENSING_SCHEME_LRAND48; scheme <= MF_LICENSING_SCHEME_PHILOX; scheme++ )
+    for( check = 0; check <= 1; check++ )
+    for( set = 0; set < 3; set++ ) {
+        mfLicensingVector vector;
+        mfLicensingContext context;
+        unsigned int failures = 0;
+        mfTestVector(&vector);
+        mfLicensingSetScheme(&vector, scheme);
+        mfLicensingSetCheckCharacter(&vector, check);
+        mfLicensingSetEncodingCharacters(&vector, (const unsigned char *)charsets[set]);
+        mfLicensingSetKeyLength(&vector, key_lengths[set]);
+        mfLicensingSetKeyIndexLength(&vector, 8);
+        MF_TEST_ASSERT(mfLicensingInitializeContext(&context, &vector) == 0);
+        for( trial = 0; trial < 64; trial++ ) {
+            mfLicensingDigest digest;
+            unsigned char license[257];
+            unsigned int index = trial * 3, decoded_index = 0;
+            mfU256 validator;
+            mfTestRandomBytes(&state, digest.md5hash.b, sizeof(digest.md5hash.b));
+            if( mfLicensingGenerateLicenseToBuffer(&context, &digest, index, license, sizeof(license)) != 0 ) {
+                failures++;
+                continue;
+            }
+            if( strlen((const char *)license) != vector.key_length + check ) failures++;
+            if( mfLicensingValidateLicenseWithContext(&context, &digest, license) != 1 ) failures++;
+            if( mfLicensingDecodeLicense(&context, license, &decoded_index, &validator) != 1 || decoded_index != index ) failures++;
+            license[trial % vector.key_length] = license[trial % vector.key_length] == (unsigned char)charsets[set][0] ? (unsigned char)charsets[set][1] : (unsigned char)charsets[set][0];
+            if( mfLicensingValidateLicenseWithContext(&context, &digest, license) != 0 ) failures++;
+        }
+        MF_TEST_ASSERT(failures == 0);
+        mfLicensingReleaseContext(&context);
+    }
+}
+
+// Keys whose value doesn't fit in bits_in_key, the top character repeated for instance, aren't decoded:
+// their high bits would be dropped and the key taken for the key of another index
+static void testOutOfRangeKeys( void )
+{
+    mfLicensingVector vector;
+    mfLicensingContext context;
+    unsigned char license[64];
+    const unsigned char *licenses[2];
+    unsigned int indexes[2], index = 0;
+    unsigned char decoded[2];
+    mfU256 validator_bits;
+
+    mfTestVector(&vector);
+    MF_TEST_ASSERT(mfLicensingInitializeContext(&context, &vector) == 0);
+    MF_TEST_ASSERT(mfLicensingDecodeLicense(&context, (const unsigned char *)"XXXXXXXXXXXXXXXXXXXXXXXXX", &index, &validator_bits) == 0);
+    memset(license, context.codec_params.codec_characters[context.codec_params.encoding_base - 1], vector.key_length);
+    license[vector.key_length] = 0;
+    MF_TEST_ASSERT(mfLicensingDecodeLicense(&context, license, &index, &validator_bits) == 0);
+
+    // In a batch, the keys around it are still decoded
+    {
+        mfLicensingDigest digest;
+        unsigned char valid_license[64];
+        memset(&digest, 0x33, sizeof(digest));
+        MF_TEST_ASSERT(mfLicensingGenerateLicenseToBuffer(&context, &digest, 9, valid_license, sizeof(valid_license)) == 0);
+        licenses[0] = license;
+        licenses[1] = valid_license;
+        MF_TEST_ASSERT(mfLicensingDecodeLicenses(&context, licenses, 2, indexes, 0, decoded) == 1);
+        MF_TEST_ASSERT(decoded[0] == 0 && decoded[1] == 1 && indexes[1] == 9);
+    }
+    mfLicensingReleaseContext(&context);
+}
+
+// Keys of 255 characters and a check character, the longest possible, are found by the registry
+static void testRegistryLongestKeys( void )
+{
+    mfLicensingRegistry registry;
+    mfLicensingVector vectors[2];
+    mfLicensingDigest digest;
+    unsigned char license[257];
+    int vector_id[2];
+    unsigned int i;
+
+    memset(&digest, 0x5A, sizeof(digest));
+    mfLicensingInitializeRegistry(&registry);
+    for( i = 0; i < 2; i++ ) {
+        mfTestVector(&vectors[i]);
+        mfLicensingSetEncodingCharacters(&vectors[i], (const unsigned char *)(i == 0 ? "01" : "AB"));
+        mfLicensingSetKeyLength(&vectors[i], 255);
+        mfLicensingSetKeyIndexLength(&vectors[i], 4);
+        mfLicensingSetCheckCharacter(&vectors[i], 1);
+        vector_id[i] = mfLicensingRegistryAddVector(&registry, &vectors[i]);
+        MF_TEST_ASSERT(vector_id[i] == (int)i);
+    }
+    for( i = 0; i < 2; i++ ) {
+        MF_TEST_ASSERT(mfLicensingGenerateLicenseToBuffer(mfLicensingRegistryContext(&registry, vector_id[i]), &digest, 3, license, sizeof(license)) == 0);
+        MF_TEST_ASSERT(strlen((const char *)license) == 256);
+        MF_TEST_ASSERT(mfLicensingRegistryValidateLicense(&registry, &digest, license) == vector_id[i]);
+    }
+    vectors[0].check_character = 2;
+    MF_TEST_ASSERT(mfLicensingRegistryAddVector(&registry, &vectors[0]) == -1);
+    mfLicensingReleaseRegistry(&registry);
+}
+
+int main( int argc, const char * argv[] )
+{
+    if( mfLicensingInitializePrivateKeyFromPrime(&mfTestKey, (const unsigned char *)MF_TEST_PRIVATE_KEY) != 0 ) {
+        fprintf(stderr, "invalid test private key\n");
+        return 1;
+    }
+    MF_TEST_RUN(testVectorValidation);
+    MF_TEST_RUN(testZeroedVector);
+    MF_TEST_RUN(testRoundTrips);
+    MF_TEST_RUN(testOutOfRangeKeys);
+    MF_TEST_RUN(testRegistryLongestKeys);
+    return mfTestReport("mflicensingtests");
+}
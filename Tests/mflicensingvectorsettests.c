@@ -0,0 +1,222 @@
+//
+//  mflicensingvectorsettests.c
+//  MFLicensing
+//  https://github.com/freshcode/MFLicensing
+//
+//  Vector set tests: keys of the current snapshot validate with 1, keys of the previous one with 2
+//  during its grace window only, and threads validating single keys and batches while snapshots are
+//  published (each one created for the publication and freed once replaced) never see a key of the
+//  snapshot just published rejected.  Build with -fsanitize=thread or -fsanitize=address to check the
+//  snapshots are only freed once no thread uses them.
+//
+//  Licensing
+//  ---------
+//  Public Domain
+//
+
+#include <string.h>
+#include <stdatomic.h>
+#include <pthread.h>
+#include <unistd.h>
+#include "mflicensingvectorset.h"
+#include "mflicensingbatch.h"
+#include "mftest.h"
+
+#define MF_TEST_VECTORS 4
+#define MF_TEST_KEYS 64
+#define MF_TEST_THREADS 4
+#define MF_TEST_PUBLICATIONS 300
+
+static mfLicensingPrivateKey mfTestKey;
+static mfLicensingVector mfTestVectors[MF_TEST_VECTORS];
+static mfLicensingDigest mfTestDigests[MF_TEST_KEYS];
+static unsigned char mfTestKeys[MF_TEST_VECTORS][MF_TEST_KEYS][32];
+
+typedef struct {
+    mfLicensingVectorSet *set;
+    atomic_int *published;
+    atomic_int *publishing;
+    atomic_int *stopping;
+    unsigned long long state;
+    unsigned int rejected;
+    unsigned int validations;
+} mfTestReader;
+
+// Vectors differing by their salt seed and scheme, and their keys
+static void mfTestCreateVectors( void )
+{
+    unsigned long long state = 31;
+    unsigned int vector_i, key_i;
+
+    for( key_i = 0; key_i < MF_TEST_KEYS; key_i++ ) {
+        mfTestRandomBytes(&state, mfTestDigests[key_i].md5hash.b, sizeof(mfTestDigests[key_i].md5hash.b));
+    }
+    for( vector_i = 0; vector_i < MF_TEST_VECTORS; vector_i++ ) {
+        unsigned short seed[3] = { (unsigned short)(vector_i + 1), (unsigned short)(vector_i * 7), (unsigned short)(vector_i * 13) };
+        mfLicensingVector *vector = &mfTestVectors[vector_i];
+        mfLicensingContext context;
+        mfLicensingInitializeDefaultVector(vector);
+        mfLicensingSetPrivateKey(vector, &mfTestKey);
+        mfLicensingSetSaltSeed(vector, seed);
+        mfLicensingSetScheme(vector, vector_i & 1 ? MF_LICENSING_SCHEME_PHILOX : MF_LICENSING_SCHEME_LRAND48);
+        mfLicensingInitializeContext(&context, vector);
+        for( key_i = 0; key_i < MF_TEST_KEYS; key_i++ ) {
+            mfLicensingGenerateLicenseToBuffer(&context, &mfTestDigests[key_i], key_i, mfTestKeys[vector_i][key_i], sizeof(mfTestKeys[vector_i][key_i]));
+        }
+        mfLicensingReleaseContext(&context);
+    }
+}
+
+static void testGraceWindow( void )
+{
+    mfLicensingSnapshot *snapshots[3];
+    mfLicensingVectorSet set;
+    mfLicensingVector vector;
+    unsigned int vector_i;
+
+    for( vector_i = 0; vector_i < 3; vector_i++ ) {
+        snapshots[vector_i] = mfLicensingCreateSnapshot(&mfTestVectors[vector_i]);
+        MF_TEST_ASSERT(snapshots[vector_i] != 0);
+    }
+    // The snapshot doesn't refer to the vector it was created from
+    vector = mfTestVectors[0];
+    mfLicensingSetKeyLength(&vector, 10);
+    mfLicensingReleaseSnapshot(snapshots[0]);
+    snapshots[0] = mfLicensingCreateSnapshot(&mfTestVectors[0]);
+
+    MF_TEST_ASSERT(mfLicensingInitializeVectorSet(&set, snapshots[0]) == 0);
+    MF_TEST_ASSERT(mfLicensingVectorSetValidateLicense(&set, &mfTestDigests[1], mfTestKeys[0][1]) == 1);
+    MF_TEST_ASSERT(mfLicensingVectorSetValidateLicense(&set, &mfTestDigests[1], mfTestKeys[1][1]) == 0);
+
+    MF_TEST_ASSERT(mfLicensingPublishSnapshot(&set, snapshots[1], 50) == 0);
+    MF_TEST_ASSERT(mfLicensingVectorSetValidateLicense(&set, &mfTestDigests[1], mfTestKeys[1][1]) == 1);
+    MF_TEST_ASSERT(mfLicensingVectorSetValidateLicense(&set, &mfTestDigests[1], mfTestKeys[0][1]) == 2);
+    MF_TEST_ASSERT(mfLicensingVectorSetValidateLicense(&set, &mfTestDigests[1], mfTestKeys[2][1]) == 0);
+    MF_TEST_ASSERT(mfLicensingVectorSetValidateLicense(&set, &mfTestDigests[2], mfTestKeys[0][1]) == 0);
+    usleep(60000);
+    MF_TEST_ASSERT(mfLicensingVectorSetValidateLicense(&set, &mfTestDigests[1], mfTestKeys[0][1]) == 0);
+
+    // A previous snapshot still in its grace window is dropped by the next publication
+    MF_TEST_ASSERT(mfLicensingPublishSnapshot(&set, snapshots[2], 60000) == 0);
+    MF_TEST_ASSERT(mfLicensingPublishSnapshot(&set, snapshots[0], 60000) == 0);
+    MF_TEST_ASSERT(mfLicensingVectorSetValidateLicense(&set, &mfTestDigests[3], mfTestKeys[2][3]) == 2);
+    MF_TEST_ASSERT(mfLicensingVectorSetValidateLicense(&set, &mfTestDigests[3], mfTestKeys[1][3]) == 0);
+    MF_TEST_ASSERT(mfLicensingEndVectorSetGrace(&set) == 0);
+    MF_TEST_ASSERT(mfLicensingVectorSetValidateLicense(&set, &mfTestDigests[3], mfTestKeys[2][3]) == 0);
+    MF_TEST_ASSERT(mfLicensingVectorSetValidateLicense(&set, &mfTestDigests[3], mfTestKeys[0][3]) == 1);
+
+    // Batches: valid[i] as the single validation returns
+    {
+        const unsigned char *licenses[3] = { mfTestKeys[0][4], mfTestKeys[2][5], mfTestKeys[1][6] };
+        unsigned char valid[3];
+        MF_TEST_ASSERT(mfLicensingPublishSnapshot(&set, snapshots[2], 60000) == 0);
+        MF_TEST_ASSERT(mfLicensingVectorSetValidateLicenses(&set, &mfTestDigests[4], licenses, 3, valid) == 2);
+        MF_TEST_ASSERT(valid[0] == 2 && valid[1] == 1 && valid[2] == 0);
+    }
+
+    mfLicensingReleaseVectorSet(&set);
+    for( vector_i = 0; vector_i < 3; vector_i++ ) {
+        MF_TEST_ASSERT(atomic_load(&snapshots[vector_i]->references) == 1);
+        mfLicensingReleaseSnapshot(snapshots[vector_i]);
+    }
+}
+
+// A key of the snapshot published last, read before validating, is accepted as long as no more than one
+// publication started since: the snapshot is then current or previous, in its grace window
+static void *mfTestValidate( void *argument )
+{
+    mfTestReader *reader = (mfTestReader *)argument;
+
+    while( !atomic_load(reader->stopping) ) {
+        int published = atomic_load(reader->published);
+        unsigned int vector_i = (unsigned int)published % MF_TEST_VECTORS;
+        unsigned int key_i = (unsigned int)(mfTestRandom(&reader->state) % MF_TEST_KEYS);
+        int valid = mfLicensingVectorSetValidateLicense(reader->set, &mfTestDigests[key_i], mfTestKeys[vector_i][key_i]);
+        if( valid == 0 && atomic_load(reader->publishing) <= published + 1 ) {
+            reader->rejected++;
+        }
+        if( key_i == 0 ) {
+            const unsigned char *licenses[MF_TEST_KEYS];
+            unsigned char valid_keys[MF_TEST_KEYS];
+            unsigned int i;
+            for( i = 0; i < MF_TEST_KEYS; i++ ) licenses[i] = mfTestKeys[vector_i][i];
+            if( mfLicensingVectorSetValidateLicenses(reader->set, mfTestDigests, licenses, MF_TEST_KEYS, valid_keys) != MF_TEST_KEYS &&
+                atomic_load(reader->publishing) <= published + 1 ) {
+                reader->rejected++;
+            }
+        } else if( key_i == 1 ) {
+            // A snapshot acquired stays usable while others are published
+            mfLicensingSnapshot *snapshot = mfLicensingAcquireSnapshot(reader->set);
+            unsigned int i, matches = 0;
+            for( i = 0; i < 8; i++ ) {
+                unsigned int vector_j;
+                for( vector_j = 0; vector_j < MF_TEST_VECTORS; vector_j++ ) {
+                    matches += mfLicensingValidateLicenseWithContext(&snapshot->compiled.context, &mfTestDigests[i], mfTestKeys[vector_j][i]);
+                }
+            }
+            if( matches != 8 ) reader->rejected++;
+            mfLicensingReleaseSnapshot(snapshot);
+        }
+        reader->validations++;
+    }
+    return 0;
+}
+
+// Snapshots created for each publication, the set holding their only reference
+static void testPublishWhileValidating( void )
+{
+    mfLicensingVectorSet set;
+    mfTestReader readers[MF_TEST_THREADS];
+    pthread_t threads[MF_TEST_THREADS];
+    atomic_int published, publishing, stopping;
+    unsigned int thread_i, rejected = 0, validations = 0;
+    int publication;
+
+    atomic_init(&published, 0);
+    atomic_init(&publishing, 0);
+    atomic_init(&stopping, 0);
+    {
+        mfLicensingSnapshot *snapshot = mfLicensingCreateSnapshot(&mfTestVectors[0]);
+        MF_TEST_ASSERT(mfLicensingInitializeVectorSet(&set, snapshot) == 0);
+        mfLicensingReleaseSnapshot(snapshot);
+    }
+    for( thread_i = 0; thread_i < MF_TEST_THREADS; thread_i++ ) {
+        readers[thread_i].set = &set;
+        readers[thread_i].published = &published;
+        readers[thread_i].publishing = &publishing;
+        readers[thread_i].stopping = &stopping;
+        readers[thread_i].state = thread_i + 1;
+        readers[thread_i].rejected = 0;
+        readers[thread_i].validations = 0;
+        pthread_create(&threads[thread_i], 0, mfTestValidate, &readers[thread_i]);
+    }
+    for( publication = 1; publication <= MF_TEST_PUBLICATIONS; publication++ ) {
+        mfLicensingSnapshot *snapshot = mfLicensingCreateSnapshot(&mfTestVectors[publication % MF_TEST_VECTORS]);
+        atomic_store(&publishing, publication);
+        MF_TEST_ASSERT(mfLicensingPublishSnapshot(&set, snapshot, 100000) == 0);
+        mfLicensingReleaseSnapshot(snapshot);
+        atomic_store(&published, publication);
+        usleep(200);
+    }
+    atomic_store(&stopping, 1);
+    for( thread_i = 0; thread_i < MF_TEST_THREADS; thread_i++ ) {
+        pthread_join(threads[thread_i], 0);
+        rejected += readers[thread_i].rejected;
+        validations += readers[thread_i].validations;
+    }
+    MF_TEST_ASSERT(rejected == 0);
+    MF_TEST_ASSERT(validations > 0);
+    mfLicensingReleaseVectorSet(&set);
+}
+
+int main( int argc, const char * argv[] )
+{
+    if( mfLicensingInitializePrivateKeyFromPrime(&mfTestKey, (const unsigned char *)MF_TEST_PRIVATE_KEY) != 0 ) {
+        fprintf(stderr, "invalid test private key\n");
+        return 1;
+    }
+    mfTestCreateVectors();
+    MF_TEST_RUN(testGraceWindow);
+    MF_TEST_RUN(testPublishWhileValidating);
+    return mfTestReport("mflicensingvectorsettests");
+}
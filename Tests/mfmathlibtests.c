@@ -0,0 +1,188 @@
+//
+//  mfmathlibtests.c
+//  MFLicensing
+//  https://github.com/freshcode/MFLicensing
+//
+//  MFMathLib multiplication tests: the products of the fixed width functions, computed with the
+//  backend and processor kernels selected (mulx/adx on x86-64 with BMI2 and ADX), must be the ones of
+//  the portable byte at a time mfMultiplyUX on edge and random operands, for multiplications and
+//  squarings.  The kernels are resolved from several threads at once first, build with
+//  -fsanitize=thread to check the resolution.
+//
+//  Licensing
+//  ---------
+//  Public Domain
+//
+
+#include <string.h>
+#include <pthread.h>
+#include "mfmathlib.h"
+#include "mftest.h"
+
+#define MF_TEST_RANDOM_OPERANDS 20000
+#define MF_TEST_THREADS 4
+
+typedef void (*mfTestMultiply)( const mfU8 *s1, const mfU8 *s2, mfU8 *d, mfU8 *o );
+typedef void (*mfTestSquare)( const mfU8 *s, mfU8 *d, mfU8 *o );
+
+static void mfTestMultiply64( const mfU8 *s1, const mfU8 *s2, mfU8 *d, mfU8 *o ) { mfMultiplyU64((const mfU64 *)s1, (const mfU64 *)s2, (mfU64 *)d, (mfU64 *)o); }
+static void mfTestMultiply128( const mfU8 *s1, const mfU8 *s2, mfU8 *d, mfU8 *o ) { mfMultiplyU128((const mfU128 *)s1, (const mfU128 *)s2, (mfU128 *)d, (mfU128 *)o); }
+static void mfTestMultiply256( const mfU8 *s1, const mfU8 *s2, mfU8 *d, mfU8 *o ) { mfMultiplyU256((const mfU256 *)s1, (const mfU256 *)s2, (mfU256 *)d, (mfU256 *)o); }
+static void mfTestMultiply512( const mfU8 *s1, const mfU8 *s2, mfU8 *d, mfU8 *o ) { mfMultiplyU512((const mfU512 *)s1, (const mfU512 *)s2, (mfU512 *)d, (mfU512 *)o); }
+static void mfTestMultiply1024( const mfU8 *s1, const mfU8 *s2, mfU8 *d, mfU8 *o ) { mfMultiplyU1024((const mfU1024 *)s1, (const mfU1024 *)s2, (mfU1024 *)d, (mfU1024 *)o); }
+static void mfTestSquare64( const mfU8 *s, mfU8 *d, mfU8 *o ) { mfSquareU64((const mfU64 *)s, (mfU64 *)d, (mfU64 *)o); }
+static void mfTestSquare128( const mfU8 *s, mfU8 *d, mfU8 *o ) { mfSquareU128((const mfU128 *)s, (mfU128 *)d, (mfU128 *)o); }
+static void mfTestSquare256( const mfU8 *s, mfU8 *d, mfU8 *o ) { mfSquareU256((const mfU256 *)s, (mfU256 *)d, (mfU256 *)o); }
+static void mfTestSquare512( const mfU8 *s, mfU8 *d, mfU8 *o ) { mfSquareU512((const mfU512 *)s, (mfU512 *)d, (mfU512 *)o); }
+static void mfTestSquare1024( const mfU8 *s, mfU8 *d, mfU8 *o ) { mfSquareU1024((const mfU1024 *)s, (mfU1024 *)d, (mfU1024 *)o); }
+
+static const struct {
+    unsigned int bytes;
+    mfTestMultiply multiply;
+    mfTestSquare square;
+} mfTestWidths[] = {
+    { 8, mfTestMultiply64, mfTestSquare64 },
+    { 16, mfTestMultiply128, mfTestSquare128 },
+    { 32, mfTestMultiply256, mfTestSquare256 },
+    { 64, mfTestMultiply512, mfTestSquare512 },
+    { 128, mfTestMultiply1024, mfTestSquare1024 },
+};
+#define MF_TEST_WIDTHS (sizeof(mfTestWidths) / sizeof(mfTestWidths[0]))
+
+// Edge operand number n of a width: zero, one, all ones, top bit only, alternating bits, one limb of
+// ones, low half or high half of ones
+#define MF_TEST_EDGE_OPERANDS 8
+static void mfTestEdgeOperand( unsigned int n, mfU8 *x, unsigned int bytes )
+{
+    unsigned int i;
+    memset(x, 0, bytes);
+    for( i = 0; i < bytes; i++ ) {
+        switch( n ) {
+            case 1: x[i] = (i == 0) ? 1 : 0; break;
+            case 2: x[i] = 0xFF; break;
+            case 3: x[i] = (i == bytes - 1) ? 0x80 : 0; break;
+            case 4: x[i] = 0xAA; break;
+            case 5: x[i] = (i >= 8 && i < 16) ? 0xFF : 0; break;
+            case 6: x[i] = (i < bytes / 2) ? 0xFF : 0; break;
+            case 7: x[i] = (i >= bytes / 2) ? 0xFF : 0; break;
+        }
+    }
+}
+
+// Checks the multiplication and the squarings of one width against the portable functions
+static int mfTestCompare( unsigned int width, const mfU8 *x, const mfU8 *y )
+{
+    mfU8 d[128], o[128], expected_d[128], expected_o[128];
+    unsigned int bytes = mfTestWidths[width].bytes;
+    int same = 1;
+
+    mfMultiplyUX(x, y, expected_d, expected_o, bytes);
+    mfTestWidths[width].multiply(x, y, d, o);
+    same &= (memcmp(d, expected_d, bytes) == 0 && memcmp(o, expected_o, bytes) == 0);
+
+    mfMultiplyUX(x, x, expected_d, expected_o, bytes);
+    mfTestWidths[width].square(x, d, o);
+    same &= (memcmp(d, expected_d, bytes) == 0 && memcmp(o, expected_o, bytes) == 0);
+    mfSquareUX(x, d, o, bytes);
+    same &= (memcmp(d, expected_d, bytes) == 0 && memcmp(o, expected_o, bytes) == 0);
+    // Multiplying a value by itself takes the squaring path of the backends
+    mfTestWidths[width].multiply(x, x, d, o);
+    same &= (memcmp(d, expected_d, bytes) == 0 && memcmp(o, expected_o, bytes) == 0);
+    return same;
+}
+
+static void *mfTestMultiplyThread( void *argument )
+{
+    unsigned long long state = 0x9E3779B97F4A7C15ULL + (unsigned long long)(size_t)argument;
+    mfU8 x[32], y[32];
+    unsigned int i;
+    int same = 1;
+    for( i = 0; i < 1000; i++ ) {
+        mfTestRandomBytes(&state, x, sizeof(x));
+        mfTestRandomBytes(&state, y, sizeof(y));
+        same &= mfTestCompare(1, x, y);
+        same &= mfTestCompare(2, x, y);
+    }
+    return same ? argument : NULL;
+}
+
+// The first multiplications resolve the kernels, concurrently here
+static void testConcurrentKernelResolution( void )
+{
+    pthread_t threads[MF_TEST_THREADS];
+    void *result;
+    size_t i;
+    for( i = 0; i < MF_TEST_THREADS; i++ ) {
+        MF_TEST_ASSERT(pthread_create(&threads[i], NULL, mfTestMultiplyThread, (void *)(i + 1)) == 0);
+    }
+    for( i = 0; i < MF_TEST_THREADS; i++ ) {
+        MF_TEST_ASSERT(pthread_join(threads[i], &result) == 0);
+        MF_TEST_ASSERT(result == (void *)(i + 1));
+    }
+    const char *kernel = mfMultiplyKernelName();
+    MF_TEST_ASSERT(kernel != NULL);
+    MF_TEST_ASSERT(kernel == mfMultiplyKernelName());
+}
+
+static void testEdgeOperands( void )
+{
+    mfU8 x[128], y[128];
+    unsigned int width, a, b;
+    for( width = 0; width < MF_TEST_WIDTHS; width++ ) {
+        for( a = 0; a < MF_TEST_EDGE_OPERANDS; a++ ) {
+            for( b = 0; b < MF_TEST_EDGE_OPERANDS; b++ ) {
+                mfTestEdgeOperand(a, x, mfTestWidths[width].bytes);
+                mfTestEdgeOperand(b, y, mfTestWidths[width].bytes);
+                MF_TEST_ASSERT(mfTestCompare(width, x, y));
+            }
+        }
+    }
+}
+
+static void testRandomOperands( void )
+{
+    unsigned long long state = 0x0123456789ABCDEFULL;
+    mfU8 x[128], y[128];
+    unsigned int width, i;
+    for( width = 0; width < MF_TEST_WIDTHS; width++ ) {
+        unsigned int bytes = mfTestWidths[width].bytes;
+        unsigned int mismatches = 0;
+        unsigned int count = MF_TEST_RANDOM_OPERANDS * 8 / bytes;
+        for( i = 0; i < count; i++ ) {
+            mfTestRandomBytes(&state, x, bytes);
+            mfTestRandomBytes(&state, y, bytes);
+            // Carries through runs of ones in the ADX chains
+            if( (i & 7) == 1 ) memset(x, 0xFF, bytes / 2);
+            if( (i & 7) == 2 ) memset(&y[bytes / 2], 0xFF, bytes / 2);
+            if( !mfTestCompare(width, x, y) ) mismatches++;
+        }
+        MF_TEST_ASSERT(mismatches == 0);
+    }
+}
+
+// Products of the same operands in place of the outputs
+static void testAliasedOutputs( void )
+{
+    unsigned long long state = 42;
+    mfU256 x, y, d, o, expected_d, expected_o;
+    unsigned int i;
+    for( i = 0; i < 1000; i++ ) {
+        mfTestRandomBytes(&state, x.b, sizeof(x.b));
+        mfTestRandomBytes(&state, y.b, sizeof(y.b));
+        mfMultiplyUX(x.b, y.b, expected_d.b, expected_o.b, sizeof(x.b));
+        d = x;
+        o = y;
+        mfMultiplyU256(&d, &o, &d, &o);
+        MF_TEST_ASSERT(memcmp(d.b, expected_d.b, sizeof(d.b)) == 0 && memcmp(o.b, expected_o.b, sizeof(o.b)) == 0);
+    }
+}
+
+int main( int argc, const char * argv[] )
+{
+    MF_TEST_RUN(testConcurrentKernelResolution);
+    MF_TEST_RUN(testEdgeOperands);
+    MF_TEST_RUN(testRandomOperands);
+    MF_TEST_RUN(testAliasedOutputs);
+    printf("multiply kernel: %s\n", mfMultiplyKernelName());
+    return mfTestReport("mfmathlibtests");
+}
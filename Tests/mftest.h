@@ -0,0 +1,61 @@
+//
+//  mftest.h
+//  MFLicensing
+//  https://github.com/freshcode/MFLicensing
+//
+//  Minimal assertion helpers shared by the behavior tests, each test program reports its checks and
+//  failures and exits with status 1 when one failed.
+//
+//  Licensing
+//  ---------
+//  Public Domain
+//
+
+#ifndef MFLicensing_mftest_h
+#define MFLicensing_mftest_h
+
+#include <stdio.h>
+#include <stdlib.h>
+
+// Private key shared by the test vectors
+#define MF_TEST_PRIVATE_KEY "104879082971311758664630764208593364096202589226484812035848152338939626324659"
+
+static unsigned long mfTestChecks = 0;
+static unsigned long mfTestFailures = 0;
+
+#define MF_TEST_ASSERT(condition) do { \
+    mfTestChecks++; \
+    if( !(condition) ) { \
+        mfTestFailures++; \
+        fprintf(stderr, "%s:%d: assertion failed: %s\n", __FILE__, __LINE__, #condition); \
+    } \
+} while( 0 )
+
+#define MF_TEST_RUN(test) do { \
+    unsigned long failures = mfTestFailures; \
+    test(); \
+    printf("%-48s %s\n", #test, failures == mfTestFailures ? "ok" : "FAILED"); \
+} while( 0 )
+
+static inline int mfTestReport( const char *name )
+{
+    printf("%s: %lu checks, %lu failures\n", name, mfTestChecks, mfTestFailures);
+    return mfTestFailures == 0 ? 0 : 1;
+}
+
+// xorshift64*, deterministic operands for the tests
+static inline unsigned long long mfTestRandom( unsigned long long *state )
+{
+    *state ^= *state >> 12;
+    *state ^= *state << 25;
+    *state ^= *state >> 27;
+    return *state * 0x2545F4914F6CDD1DULL;
+}
+
+static inline void mfTestRandomBytes( unsigned long long *state, unsigned char *bytes, unsigned int count )
+{
+    unsigned int i;
+    for( i = 0; i < count; i++ ) bytes[i] = (unsigned char)(mfTestRandom(state) >> 56);
+}
+
+#endif
@@ -0,0 +1,602 @@
+//
+//  mflicensingbench.c
+//  MFLicensing
+//  https://github.com/freshcode/MFLicensing
+//
+//  End-to-end licensing throughput benchmark.
+//
+//  Measures mfLicensingGenerateLicense and mfLicensingValidateLicense, with valid keys and with
+//  keys altered by one character, for every combination of the key lengths, index bits, numbers
+//  of encoding characters and thread counts requested.  Each thread generates and validates its
+//  own keys; the throughput is computed over the wall time of all threads and the latency of every
+//  call is recorded to report the median and 99th percentile.
+//
+//  When the library is compiled with MFLICENSING_INSTRUMENTATION and/or MFMATHLIB_INSTRUMENTATION,
+//  the memory allocations counted by the libraries are reported per key.  On Linux, -p reads the
+//  cycles, instructions, branch misses and cache misses of each thread with perf_event_open;
+//  counters the kernel refuses to open are reported as null.
+//
+//  The results can be written as JSON (-o), one result per line, and compared with a previous
+//  JSON output (-B): a configuration whose throughput dropped by more than the threshold (-T,
+//  percent) is reported as a regression and the exit status is 3.
+//
+//  Character sets are the first n characters of digits, upper case letters, lower case letters and
+//  ASCII punctuation; sets of more than 94 characters are completed with bytes 0xC0 and above.
+//  Configurations needing more than 256 bits of key data are reported as unsupported.
+//
+//  Build
+//  -----
+//  cc -O2 -pthread -IMFLicensing -IPods/MFMathLib/MathLib -o mflicensingbench
+//     Tools/mflicensingbench.c MFLicensing/mflicensing.c MFLicensing/md5.c
+//     Pods/MFMathLib/MathLib/mfmathlib.c
+//
+//  Add -DMFLICENSING_INSTRUMENTATION -DMFMATHLIB_INSTRUMENTATION to count allocations.
+//
+//  Usage
+//  -----
+//  mflicensingbench [-l lengths] [-b index_bits] [-c character_counts] [-t threads] [-n keys]
+//                   [-a vector|context] [-x] [-s scheme] [-p] [-k private_key] [-o output.json]
+//                   [-B baseline.json] [-T threshold]
+//
+//  Lists are comma separated, the defaults are -l 15,25,40 -b 8,20,32 -c 10,30,100 -t 1,<cpus>
+//  and 2000 keys per thread.  -a context measures the *WithContext functions with a context
+//  initialized once, -x enables the check character and -s selects the key scheme (1 lrand48, the
+//  default, 2 Philox).
+//
+//  Licensing
+//  ---------
+//  Public Domain
+//  By Freshcode, Cutting edge Mac, iPhone & iPad software development. http://madefresh.ca/
+//
+
+#include "mflicensing.h"
+#include "mfmathlib.h"
+#include "md5.h"
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+#ifdef __linux__
+#include <linux/perf_event.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#endif
+
+#define BENCH_MAX_LIST 16
+#define BENCH_MAX_CHARACTERS 100
+#define BENCH_DIGESTS 64
+#define BENCH_PERF_COUNTERS 4
+#define BENCH_ID_LENGTH 96
+
+static unsigned char samplePrivateKey[] = "104879082971311758664630764208593364096202589226484812035848152338939626324659";
+
+typedef enum {
+    benchGenerate = 0,
+    benchValidateValid,
+    benchValidateInvalid,
+    benchOperationCount
+} benchOperation;
+
+static const char *benchOperationNames[benchOperationCount] = { "generate", "validate_valid", "validate_invalid" };
+static const char *benchPerfNames[BENCH_PERF_COUNTERS] = { "cycles", "instructions", "branch_misses", "cache_misses" };
+
+typedef struct {
+    mfLicensingVector *vector;
+    mfLicensingContext *context;    // 0 to measure the functions taking a vector
+    mfLicensingDigest *digests;
+    const unsigned char *characters;
+    unsigned int keys;
+    int perf;
+} benchJob;
+
+typedef struct {
+    benchJob *job;
+    benchOperation operation;
+    unsigned char **licenses;       // keys generated by this thread, kept for the validation
+    unsigned long long *latencies;  // nanoseconds, one per call
+    unsigned long long started;
+    unsigned long long finished;
+    unsigned long long errors;
+    unsigned long long allocations;
+    long long perf[BENCH_PERF_COUNTERS]; // -1 when not available
+} benchThread;
+
+typedef struct {
+    char id[BENCH_ID_LENGTH];
+    double keys_per_sec;
+} benchBaseline;
+
+static unsigned long long benchNow( void )
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (unsigned long long)ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+}
+
+static int benchParseList( const char *arg, unsigned int *values, unsigned int *count )
+{
+    *count = 0;
+    while( *arg ) {
+        char *end;
+        unsigned long value = strtoul(arg, &end, 10);
+        if( end == arg || *count == BENCH_MAX_LIST ) return -1;
+        values[(*count)++] = (unsigned int)value;
+        arg = end;
+        if( *arg == ',' ) arg++;
+        else if( *arg != 0 ) return -1;
+    }
+    return *count > 0 ? 0 : -1;
+}
+
+// First count characters of digits, letters, punctuation and bytes 0xC0 and above
+static void benchCharacters( unsigned char *characters, unsigned int count )
+{
+    static const char ascii[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz!\"#$%&'()*+,-./:;<=>?@[\\]^_`{|}~";
+    unsigned int character_i;
+    for( character_i = 0; character_i < count; character_i++ ) {
+        if( character_i < sizeof(ascii) - 1 ) {
+            characters[character_i] = (unsigned char)ascii[character_i];
+        } else {
+            characters[character_i] = (unsigned char)(0xC0 + character_i - (sizeof(ascii) - 1));
+        }
+    }
+    characters[count] = 0;
+}
+
+#pragma mark - Hardware counters
+#ifdef __linux__
+static int benchPerfOpen( int fds[BENCH_PERF_COUNTERS] )
+{
+    static const unsigned long long configs[BENCH_PERF_COUNTERS] = {
+        PERF_COUNT_HW_CPU_CYCLES, PERF_COUNT_HW_INSTRUCTIONS, PERF_COUNT_HW_BRANCH_MISSES, PERF_COUNT_HW_CACHE_MISSES
+    };
+    int opened = 0;
+    unsigned int counter_i;
+    for( counter_i = 0; counter_i < BENCH_PERF_COUNTERS; counter_i++ ) {
+        struct perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.type = PERF_TYPE_HARDWARE;
+        attr.size = sizeof(attr);
+        attr.config = configs[counter_i];
+        attr.disabled = 1;
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        // Counts the calling thread only
+        fds[counter_i] = (int)syscall(__NR_perf_event_open, &attr, 0, -1, -1, 0);
+        if( fds[counter_i] >= 0 ) opened++;
+    }
+    return opened;
+}
+static void benchPerfStart( int fds[BENCH_PERF_COUNTERS] )
+{
+    unsigned int counter_i;
+    for( counter_i = 0; counter_i < BENCH_PERF_COUNTERS; counter_i++ ) {
+        if( fds[counter_i] < 0 ) continue;
+        ioctl(fds[counter_i], PERF_EVENT_IOC_RESET, 0);
+        ioctl(fds[counter_i], PERF_EVENT_IOC_ENABLE, 0);
+    }
+}
+static void benchPerfStop( int fds[BENCH_PERF_COUNTERS], long long values[BENCH_PERF_COUNTERS] )
+{
+    unsigned int counter_i;
+    for( counter_i = 0; counter_i < BENCH_PERF_COUNTERS; counter_i++ ) {
+        unsigned long long value;
+        values[counter_i] = -1;
+        if( fds[counter_i] < 0 ) continue;
+        ioctl(fds[counter_i], PERF_EVENT_IOC_DISABLE, 0);
+        if( read(fds[counter_i], &value, sizeof(value)) == sizeof(value) ) values[counter_i] = (long long)value;
+        close(fds[counter_i]);
+    }
+}
+#else
+static int benchPerfOpen( int fds[BENCH_PERF_COUNTERS] )
+{
+    unsigned int counter_i;
+    for( counter_i = 0; counter_i < BENCH_PERF_COUNTERS; counter_i++ ) fds[counter_i] = -1;
+    return 0;
+}
+static void benchPerfStart( int fds[BENCH_PERF_COUNTERS] ) { (void)fds; }
+static void benchPerfStop( int fds[BENCH_PERF_COUNTERS], long long values[BENCH_PERF_COUNTERS] )
+{
+    unsigned int counter_i;
+    (void)fds;
+    for( counter_i = 0; counter_i < BENCH_PERF_COUNTERS; counter_i++ ) values[counter_i] = -1;
+}
+#endif
+
+#pragma mark - Measurement
+static unsigned long long benchAllocations( void )
+{
+    mfLicensingStats licensing_stats;
+    mfMathStats math_stats;
+    unsigned long long allocations;
+    unsigned int operation;
+
+    mfLicensingStatsSnapshot(&licensing_stats);
+    mfMathStatsSnapshot(&math_stats);
+    allocations = licensing_stats.allocations;
+    for( operation = 0; operation < mfMathOperationCount; operation++ ) {
+        allocations += math_stats.allocations[operation];
+    }
+    return allocations;
+}
+
+// Replaces one character of license with another character of the set, the key remains well formed
+static void benchAlterLicense( const unsigned char *characters, unsigned int key_i, unsigned char *license )
+{
+    unsigned int length = (unsigned int)strlen((const char *)license);
+    unsigned int count = (unsigned int)strlen((const char *)characters);
+    unsigned int position = key_i % length;
+    const unsigned char *found = (const unsigned char *)strchr((const char *)characters, license[position]);
+    unsigned int weight = found ? (unsigned int)(found - characters) : 0;
+    license[position] = characters[(weight + 1 + key_i % (count - 1)) % count];
+}
+
+static void *benchThreadRun( void *arg )
+{
+    benchThread *thread = arg;
+    benchJob *job = thread->job;
+    unsigned char *altered = malloc(512);
+    int fds[BENCH_PERF_COUNTERS];
+    unsigned int key_i;
+
+    if( job->perf ) benchPerfOpen(fds);
+    mfLicensingStatsReset();
+    mfMathStatsReset();
+    if( job->perf ) benchPerfStart(fds);
+    thread->started = benchNow();
+
+    for( key_i = 0; key_i < job->keys; key_i++ ) {
+        mfLicensingDigest *digest = &job->digests[key_i % BENCH_DIGESTS];
+        unsigned int index = (key_i * 2654435761u) & ((1ULL << job->vector->index_bits) - 1);
+        unsigned long long call_started;
+        int valid;
+
+        switch( thread->operation ) {
+            case benchGenerate:
+                call_started = benchNow();
+                thread->licenses[key_i] = job->context ?
+                    mfLicensingGenerateLicenseWithContext(job->context, digest, index) :
+                    mfLicensingGenerateLicense(job->vector, digest, index);
+                thread->latencies[key_i] = benchNow() - call_started;
+                if( thread->licenses[key_i] == 0 ) thread->errors++;
+                break;
+
+            case benchValidateValid:
+                call_started = benchNow();
+                valid = job->context ?
+                    mfLicensingValidateLicenseWithContext(job->context, digest, thread->licenses[key_i]) :
+                    mfLicensingValidateLicense(job->vector, digest, thread->licenses[key_i]);
+                thread->latencies[key_i] = benchNow() - call_started;
+                if( valid == 0 ) thread->errors++;
+                break;
+
+            default:
+                // Altering the key is not measured
+                strcpy((char *)altered, (const char *)thread->licenses[key_i]);
+                benchAlterLicense(job->characters, key_i, altered);
+                call_started = benchNow();
+                valid = job->context ?
+                    mfLicensingValidateLicenseWithContext(job->context, digest, altered) :
+                    mfLicensingValidateLicense(job->vector, digest, altered);
+                thread->latencies[key_i] = benchNow() - call_started;
+                if( valid != 0 ) thread->errors++;
+                break;
+        }
+    }
+
+    thread->finished = benchNow();
+    if( job->perf ) benchPerfStop(fds, thread->perf);
+    thread->allocations = benchAllocations();
+    free(altered);
+    return 0;
+}
+
+static int benchCompareLatencies( const void *a, const void *b )
+{
+    unsigned long long x = *(const unsigned long long *)a;
+    unsigned long long y = *(const unsigned long long *)b;
+    return x < y ? -1 : (x > y ? 1 : 0);
+}
+
+#pragma mark - Baseline
+// Loads the id and keys_per_sec of every result line of a JSON output of this tool
+static benchBaseline *benchLoadBaseline( const char *path, unsigned int *count )
+{
+    FILE *file = fopen(path, "r");
+    benchBaseline *baseline = 0;
+    unsigned int capacity = 0;
+    char line[1024];
+
+    *count = 0;
+    if( file == 0 ) return 0;
+    while( fgets(line, sizeof(line), file) ) {
+        char *id = strstr(line, "\"id\": \"");
+        char *throughput = strstr(line, "\"keys_per_sec\": ");
+        if( id == 0 || throughput == 0 ) continue;
+        id += 7;
+        char *id_end = strchr(id, '"');
+        if( id_end == 0 || id_end - id >= BENCH_ID_LENGTH ) continue;
+        if( *count == capacity ) {
+            capacity = capacity ? capacity * 2 : 64;
+            benchBaseline *grown = realloc(baseline, capacity * sizeof(benchBaseline));
+            if( grown == 0 ) break;
+            baseline = grown;
+        }
+        memcpy(baseline[*count].id, id, id_end - id);
+        baseline[*count].id[id_end - id] = 0;
+        baseline[*count].keys_per_sec = atof(throughput + 16);
+        (*count)++;
+    }
+    fclose(file);
+    return baseline;
+}
+
+static const benchBaseline *benchFindBaseline( const benchBaseline *baseline, unsigned int count, const char *id )
+{
+    while( count-- ) {
+        if( strcmp(baseline[count].id, id) == 0 ) return &baseline[count];
+    }
+    return 0;
+}
+
+#pragma mark - Main
+int main( int argc, char *argv[] )
+{
+    unsigned int lengths[BENCH_MAX_LIST] = { 15, 25, 40 }, length_count = 3;
+    unsigned int index_bits[BENCH_MAX_LIST] = { 8, 20, 32 }, index_bits_count = 3;
+    unsigned int character_counts[BENCH_MAX_LIST] = { 10, 30, 100 }, character_count_count = 3;
+    unsigned int threads[BENCH_MAX_LIST], thread_count_count = 2;
+    unsigned int keys = 2000;
+    int use_context = 0, check_character = 0, perf = 0;
+    unsigned int scheme = MF_LICENSING_SCHEME_LRAND48;
+    const char *private_key_string = (const char *)samplePrivateKey;
+    const char *output_path = 0, *baseline_path = 0;
+    double threshold = 5.0;
+    int opt;
+
+    threads[0] = 1;
+    threads[1] = (unsigned int)sysconf(_SC_NPROCESSORS_ONLN);
+    if( threads[1] <= 1 ) thread_count_count = 1;
+
+    while( (opt = getopt(argc, argv, "l:b:c:t:n:a:xs:pk:o:B:T:")) != -1 ) {
+        int invalid = 0;
+        switch( opt ) {
+            case 'l': invalid = benchParseList(optarg, lengths, &length_count); break;
+            case 'b': invalid = benchParseList(optarg, index_bits, &index_bits_count); break;
+            case 'c': invalid = benchParseList(optarg, character_counts, &character_count_count); break;
+            case 't': invalid = benchParseList(optarg, threads, &thread_count_count); break;
+            case 'n': keys = (unsigned int)atoi(optarg); break;
+            case 'a': use_context = strcmp(optarg, "context") == 0; invalid = !use_context && strcmp(optarg, "vector") != 0; break;
+            case 'x': check_character = 1; break;
+            case 's': scheme = (unsigned int)atoi(optarg); invalid = scheme != MF_LICENSING_SCHEME_LRAND48 && scheme != MF_LICENSING_SCHEME_PHILOX; break;
+            case 'p': perf = 1; break;
+            case 'k': private_key_string = optarg; break;
+            case 'o': output_path = optarg; break;
+            case 'B': baseline_path = optarg; break;
+            case 'T': threshold = atof(optarg); break;
+            default: invalid = 1; break;
+        }
+        if( invalid ) {
+            fprintf(stderr, "usage: %s [-l lengths] [-b index_bits] [-c character_counts] [-t threads] [-n keys] "
+                    "[-a vector|context] [-x] [-s scheme] [-p] [-k private_key] [-o output.json] [-B baseline.json] [-T threshold]\n", argv[0]);
+            return 1;
+        }
+    }
+    if( keys == 0 ) keys = 1;
+
+    mfLicensingPrivateKey private_key;
+    if( mfLicensingInitializePrivateKeyFromPrime(&private_key, (const unsigned char *)private_key_string) != 0 ) {
+        fprintf(stderr, "invalid private key\n");
+        return 1;
+    }
+
+    benchBaseline *baseline = 0;
+    unsigned int baseline_count = 0;
+    if( baseline_path ) {
+        baseline = benchLoadBaseline(baseline_path, &baseline_count);
+        if( baseline == 0 ) {
+            fprintf(stderr, "no results found in %s\n", baseline_path);
+            return 1;
+        }
+    }
+
+    FILE *output = 0;
+    if( output_path ) {
+        output = fopen(output_path, "w");
+        if( output == 0 ) {
+            perror(output_path);
+            return 1;
+        }
+        fprintf(output, "{\n  \"tool\": \"mflicensingbench\",\n  \"format\": 1,\n  \"api\": \"%s\",\n  \"check_character\": %d,\n  \"scheme\": %u,\n"
+                "  \"keys_per_thread\": %u,\n  \"math_backend\": \"%s\",\n  \"multiply_kernel\": \"%s\",\n  \"results\": [\n",
+                use_context ? "context" : "vector", check_character, scheme, keys, mfBackendName(), mfMultiplyKernelName());
+    }
+
+    // Sample digests: MD5 of "bench-<n>"
+    mfLicensingDigest digests[BENCH_DIGESTS];
+    unsigned int digest_i;
+    for( digest_i = 0; digest_i < BENCH_DIGESTS; digest_i++ ) {
+        char sample[32];
+        MD5_CTX md5ctx;
+        snprintf(sample, sizeof(sample), "bench-%u", digest_i);
+        MD5_Init(&md5ctx);
+        MD5_Update(&md5ctx, sample, strlen(sample));
+        MD5_Final(digests[digest_i].md5hash.b, &md5ctx);
+    }
+
+    int allocations_counted = mfLicensingStatsEnabled() || mfMathStatsEnabled();
+    unsigned int regressions = 0, compared = 0, results = 0;
+    unsigned long long errors = 0;
+    int perf_warned = 0;
+    unsigned int length_i, index_bits_i, character_i, thread_i;
+
+    printf("%-44s %12s %10s %10s %10s\n", "configuration", "keys/sec", "p50 ns", "p99 ns", "allocs/key");
+    for( length_i = 0; length_i < length_count; length_i++ ) {
+    for( index_bits_i = 0; index_bits_i < index_bits_count; index_bits_i++ ) {
+    for( character_i = 0; character_i < character_count_count; character_i++ ) {
+        unsigned char characters[BENCH_MAX_CHARACTERS + 1];
+        mfLicensingVector vector;
+        mfLicensingContext context;
+
+        if( character_counts[character_i] < 2 || character_counts[character_i] > BENCH_MAX_CHARACTERS ) {
+            printf("c=%u: unsupported number of characters\n", character_counts[character_i]);
+            continue;
+        }
+        benchCharacters(characters, character_counts[character_i]);
+        mfLicensingInitializeDefaultVector(&vector);
+        mfLicensingSetPrivateKey(&vector, &private_key);
+        vector.coded_chars = characters;
+        vector.key_length = (unsigned char)lengths[length_i];
+        vector.index_bits = (unsigned char)index_bits[index_bits_i];
+        mfLicensingSetCheckCharacter(&vector, check_character);
+        mfLicensingSetScheme(&vector, (unsigned char)scheme);
+        if( lengths[length_i] > 255 || index_bits[index_bits_i] > 32 ||
+            mfLicensingInitializeContext(&context, &vector) != 0 ||
+            vector.index_bits >= context.codec_params.bits_in_key ) {
+            printf("l=%u b=%u c=%u: unsupported\n", lengths[length_i], index_bits[index_bits_i], character_counts[character_i]);
+            continue;
+        }
+
+        for( thread_i = 0; thread_i < thread_count_count; thread_i++ ) {
+            unsigned int thread_count = threads[thread_i] ? threads[thread_i] : 1;
+            benchJob job;
+            job.vector = &vector;
+            job.context = use_context ? &context : 0;
+            job.digests = digests;
+            job.characters = characters;
+            job.keys = keys;
+            job.perf = perf;
+
+            benchThread *workers = calloc(thread_count, sizeof(benchThread));
+            pthread_t *thread_ids = calloc(thread_count, sizeof(pthread_t));
+            unsigned long long *latencies = malloc((size_t)thread_count * keys * sizeof(unsigned long long));
+            if( workers == 0 || thread_ids == 0 || latencies == 0 ) {
+                fprintf(stderr, "out of memory\n");
+                return 1;
+            }
+            unsigned int worker_i;
+            for( worker_i = 0; worker_i < thread_count; worker_i++ ) {
+                workers[worker_i].job = &job;
+                workers[worker_i].licenses = calloc(keys, sizeof(unsigned char *));
+                workers[worker_i].latencies = &latencies[(size_t)worker_i * keys];
+                if( workers[worker_i].licenses == 0 ) {
+                    fprintf(stderr, "out of memory\n");
+                    return 1;
+                }
+            }
+
+            benchOperation operation;
+            unsigned long long generate_errors = 0;
+            for( operation = benchGenerate; operation < benchOperationCount; operation++ ) {
+                unsigned long long allocations = 0, operation_errors = 0;
+                long long perf_totals[BENCH_PERF_COUNTERS] = { 0, 0, 0, 0 };
+                unsigned long long started = ~0ULL, finished = 0;
+                unsigned int counter_i;
+
+                // Validation needs every key generated
+                if( generate_errors != 0 ) break;
+
+                for( worker_i = 0; worker_i < thread_count; worker_i++ ) {
+                    workers[worker_i].operation = operation;
+                    workers[worker_i].errors = 0;
+                    pthread_create(&thread_ids[worker_i], 0, benchThreadRun, &workers[worker_i]);
+                }
+                for( worker_i = 0; worker_i < thread_count; worker_i++ ) {
+                    pthread_join(thread_ids[worker_i], 0);
+                    benchThread *worker = &workers[worker_i];
+                    if( worker->started < started ) started = worker->started;
+                    if( worker->finished > finished ) finished = worker->finished;
+                    allocations += worker->allocations;
+                    operation_errors += worker->errors;
+                    for( counter_i = 0; counter_i < BENCH_PERF_COUNTERS; counter_i++ ) {
+                        if( perf_totals[counter_i] < 0 || worker->perf[counter_i] < 0 ) perf_totals[counter_i] = -1;
+                        else perf_totals[counter_i] += worker->perf[counter_i];
+                    }
+                }
+                errors += operation_errors;
+                if( operation == benchGenerate ) generate_errors = operation_errors;
+
+                unsigned long long calls = (unsigned long long)thread_count * keys;
+                qsort(latencies, calls, sizeof(unsigned long long), benchCompareLatencies);
+                double keys_per_sec = finished > started ? calls * 1e9 / (finished - started) : 0.0;
+                unsigned long long p50 = latencies[(calls - 1) * 50 / 100];
+                unsigned long long p99 = latencies[(calls - 1) * 99 / 100];
+
+                char id[BENCH_ID_LENGTH];
+                snprintf(id, sizeof(id), "%s l=%u b=%u c=%u t=%u", benchOperationNames[operation],
+                         lengths[length_i], index_bits[index_bits_i], character_counts[character_i], thread_count);
+                char allocations_text[32];
+                if( allocations_counted ) snprintf(allocations_text, sizeof(allocations_text), "%.2f", (double)allocations / calls);
+                else strcpy(allocations_text, "null");
+
+                printf("%-44s %12.0f %10llu %10llu %10s", id, keys_per_sec, p50, p99, allocations_counted ? allocations_text : "-");
+                if( perf ) {
+                    if( perf_totals[0] >= 0 && perf_totals[1] >= 0 ) {
+                        printf("  %.0f cycles/key, ipc %.2f", (double)perf_totals[0] / calls,
+                               perf_totals[0] ? (double)perf_totals[1] / perf_totals[0] : 0.0);
+                    } else if( perf_warned == 0 ) {
+                        fprintf(stderr, "hardware counters not available\n");
+                        perf_warned = 1;
+                    }
+                }
+                if( operation_errors ) printf("  %llu ERRORS", operation_errors);
+                if( baseline ) {
+                    const benchBaseline *previous = benchFindBaseline(baseline, baseline_count, id);
+                    if( previous && previous->keys_per_sec > 0 ) {
+                        double change = (keys_per_sec / previous->keys_per_sec - 1.0) * 100.0;
+                        compared++;
+                        printf("  %+.1f%%", change);
+                        if( change < -threshold ) {
+                            printf(" REGRESSION");
+                            regressions++;
+                        }
+                    }
+                }
+                printf("\n");
+
+                if( output ) {
+                    fprintf(output, "%s    { \"id\": \"%s\", \"operation\": \"%s\", \"key_length\": %u, \"index_bits\": %u, "
+                            "\"characters\": %u, \"threads\": %u, \"keys\": %llu, \"keys_per_sec\": %.1f, \"p50_ns\": %llu, "
+                            "\"p99_ns\": %llu, \"allocations_per_key\": %s, \"errors\": %llu",
+                            results ? ",\n" : "", id, benchOperationNames[operation], lengths[length_i], index_bits[index_bits_i],
+                            character_counts[character_i], thread_count, calls, keys_per_sec, p50, p99, allocations_text,
+                            operation_errors);
+                    if( perf ) {
+                        for( counter_i = 0; counter_i < BENCH_PERF_COUNTERS; counter_i++ ) {
+                            if( perf_totals[counter_i] < 0 ) fprintf(output, ", \"%s_per_key\": null", benchPerfNames[counter_i]);
+                            else fprintf(output, ", \"%s_per_key\": %.1f", benchPerfNames[counter_i], (double)perf_totals[counter_i] / calls);
+                        }
+                    }
+                    fprintf(output, " }");
+                }
+                results++;
+            }
+
+            for( worker_i = 0; worker_i < thread_count; worker_i++ ) {
+                unsigned int key_i;
+                for( key_i = 0; key_i < keys; key_i++ ) free(workers[worker_i].licenses[key_i]);
+                free(workers[worker_i].licenses);
+            }
+            free(latencies);
+            free(thread_ids);
+            free(workers);
+        }
+        mfLicensingReleaseContext(&context);
+    }
+    }
+    }
+
+    if( output ) {
+        fprintf(output, "\n  ]\n}\n");
+        fclose(output);
+    }
+    if( baseline ) {
+        printf("%u results compared with %s, %u regressions beyond %.1f%%\n", compared, baseline_path, regressions, threshold);
+        free(baseline);
+    }
+    if( errors ) return 2;
+    return regressions ? 3 : 0;
+}
@@ -0,0 +1,632 @@
+//
+//  mflicensinggolden.c
+//  MFLicensing
+//  https://github.com/freshcode/MFLicensing
+//
+//  Golden key corpus recorder and differential checker.
+//
+//  Every key issued must keep validating, and every key generation path must produce exactly the
+//  key mfLicensingGenerateLicense produces: a faster arithmetic kernel or codec giving a different
+//  key for a single vector, digest and index breaks the licenses issued with it.
+//
+//  "record" generates a corpus of (vector, digest, index) -> key entries with mfLicensingGenerateLicense,
+//  the reference implementation, for every combination of the key schemes, check character, character
+//  sets (2 to 99 characters, shuffled, including bytes 0xC0 and above), key lengths (1 to 255) and index
+//  bits (0 to 32) below, with three private keys (smallest and largest top bits) and seeds of 0, 0xFFFF
+//  or random.  The digests include 0 and all ones, the indexes 0, 1, the largest index of the vector and
+//  the one after it; the pairs for which no key can be generated are recorded as such.  The corpus is
+//  deterministic for a sample seed, its MD5 is reported: with the defaults (-n 64 -r 1) it must be the
+//  one below, any other value means the keys generated changed.  Record the corpus with a release
+//  build and keep it to check the builds that follow.
+//
+//      MD5 of the default corpus: e43f3ca4c536244f401359949ca92ea4
+//
+//  "check" reads a corpus and compares every path of the library with it: mfLicensingGenerateLicense
+//  and mfLicensingValidateLicense, the *WithContext and *ToBuffer functions, a context compiled into
+//  a blob, the key iterator, mfLicensingDecodeLicense(s), mfLicensingValidateFormattedLicense with a
+//  key format without separators, a registry holding the vector, the key rebuilt from a journal entry
+//  of the decoded index and validator bits, and mfLicensingValidateLicenses with every batch kernel
+//  the processor supports.  Keys altered by one character must be accepted or rejected by the key
+//  format, the registry and the batch kernels as mfLicensingValidateLicenseWithContext does.  The math backend is chosen at
+//  build time: build the checker once per MFMATHLIB_BACKEND (and with MFMATHLIB_NO_ADX) to cover them.
+//  The exit status is 3 when a path disagrees with the corpus.
+//
+//  Build
+//  -----
+//  cc -O2 -pthread -IMFLicensing -IPods/MFMathLib/MathLib -o mflicensinggolden
+//     Tools/mflicensinggolden.c MFLicensing/mflicensing.c MFLicensing/mflicensingbatch.c
+//     MFLicensing/mflicensingblob.c MFLicensing/mflicensingregistry.c MFLicensing/mflicensingjournal.c
+//     MFLicensing/mflicensingdigest.c MFLicensing/md5.c Pods/MFMathLib/MathLib/mfmathlib.c
+//
+//  Usage
+//  -----
+//  mflicensinggolden record [-n keys_per_vector] [-r sample_seed] corpus
+//  mflicensinggolden check corpus
+//
+//  Licensing
+//  ---------
+//  Public Domain
+//  By Freshcode, Cutting edge Mac, iPhone & iPad software development. http://madefresh.ca/
+//
+
+#include "mflicensing.h"
+#include "mflicensingbatch.h"
+#include "mflicensingblob.h"
+#include "mflicensingjournal.h"
+#include "mflicensingregistry.h"
+#include "md5.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+#include <unistd.h>
+
+#define GOLDEN_VERSION 1
+#define GOLDEN_MAX_KEY 258              // 255 characters, check character and terminator
+#define GOLDEN_MAX_LINE 1024
+#define GOLDEN_MAX_CHARACTERS 99
+#define GOLDEN_MAX_REPORTED 20
+#define GOLDEN_BATCH_KERNELS 3
+
+static const char *goldenPrivateKeys[] = {
+    "104879082971311758664630764208593364096202589226484812035848152338939626324659",
+    "452312848583266388373324160190187140051835877600158453279131187530910662737",          // 2^248 + 81
+    "115792089237316195423570985008687907853269984665640564039457584007913129639747",       // 2^256 - 189
+};
+static const unsigned int goldenCharacterCounts[] = { 2, 10, 16, 32, 36, 62, 94, 99 };
+static const unsigned int goldenKeyLengths[] = { 1, 8, 15, 25, 32, 40, 64, 128, 255 };
+static const unsigned int goldenIndexBits[] = { 0, 1, 8, 16, 20, 31, 32 };
+static const char *goldenBatchKernels[GOLDEN_BATCH_KERNELS] = { "portable", "avx2", "avx512" };
+
+#define GOLDEN_COUNT(array) (sizeof(array) / sizeof(array[0]))
+
+typedef enum {
+    goldenGenerate = 0,
+    goldenValidate,
+    goldenContext,
+    goldenBuffer,
+    goldenCompiled,
+    goldenIterator,
+    goldenDecode,
+    goldenDecodeBatch,
+    goldenValidateContext,
+    goldenFormatted,
+    goldenRegistry,
+    goldenJournal,
+    goldenBatch,                        // one per batch kernel
+    goldenPathCount = goldenBatch + GOLDEN_BATCH_KERNELS
+} goldenPath;
+
+static const char *goldenPathNames[goldenBatch] = {
+    "generate", "validate", "context", "buffer", "compiled", "iterator", "decode", "decode_batch", "validate_context",
+    "formatted", "registry", "journal"
+};
+
+// Entries of the vector being checked; keys[i] is empty when no key could be generated
+typedef struct {
+    mfLicensingDigest *digests;
+    unsigned int *indexes;
+    unsigned char (*keys)[GOLDEN_MAX_KEY];
+    unsigned int count;
+    unsigned int capacity;
+    unsigned int first_line;
+} goldenEntries;
+
+typedef struct {
+    unsigned long long checks[goldenPathCount];
+    unsigned long long mismatches[goldenPathCount];
+    unsigned long long reported;
+    int kernel_available[GOLDEN_BATCH_KERNELS];
+} goldenReport;
+
+static double goldenNow( void )
+{
+    struct timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (double)ts.tv_sec + (double)ts.tv_nsec * 1e-9;
+}
+
+// splitmix64, independent of the generators of the library
+static unsigned long long goldenRandom( unsigned long long *state )
+{
+    unsigned long long z = (*state += 0x9E3779B97F4A7C15ULL);
+    z = (z ^ (z >> 30)) * 0xBF58476D1CE4E5B9ULL;
+    z = (z ^ (z >> 27)) * 0x94D049BB133111EBULL;
+    return z ^ (z >> 31);
+}
+
+#pragma mark - Hexadecimal
+
+// Writes size bytes, most significant first when reversed is set
+static void goldenHex( const unsigned char *bytes, unsigned int size, int reversed, char *hex )
+{
+    static const char digits[] = "0123456789abcdef";
+    unsigned int byte_i;
+    for( byte_i = 0; byte_i < size; byte_i++ ) {
+        unsigned char byte = bytes[reversed ? size - 1 - byte_i : byte_i];
+        hex[2 * byte_i] = digits[byte >> 4];
+        hex[2 * byte_i + 1] = digits[byte & 0x0F];
+    }
+    hex[2 * size] = 0;
+}
+
+// Returns the number of bytes read, -1 if hex isn't an hexadecimal string of at most size bytes
+static int goldenUnhex( const char *hex, unsigned char *bytes, unsigned int size, int reversed )
+{
+    size_t length = strlen(hex);
+    unsigned int byte_i;
+    if( (length & 1) != 0 || length / 2 > size ) return -1;
+    for( byte_i = 0; byte_i < length / 2; byte_i++ ) {
+        unsigned int value;
+        if( sscanf(&hex[2 * byte_i], "%2x", &value) != 1 ) return -1;
+        bytes[reversed ? length / 2 - 1 - byte_i : byte_i] = (unsigned char)value;
+    }
+    return (int)(length / 2);
+}
+
+#pragma mark - Record
+
+// First count characters of digits, letters, punctuation and bytes 0xC0 and above, shuffled
+static void goldenCharacters( unsigned char *characters, unsigned int count, unsigned long long *state )
+{
+    static const char ascii[] = "0123456789ABCDEFGHIJKLMNOPQRSTUVWXYZabcdefghijklmnopqrstuvwxyz!\"#$%&'()*+,-./:;<=>?@[\\]^_`{|}~";
+    unsigned int character_i;
+    for( character_i = 0; character_i < count; character_i++ ) {
+        if( character_i < sizeof(ascii) - 1 ) {
+            characters[character_i] = (unsigned char)ascii[character_i];
+        } else {
+            characters[character_i] = (unsigned char)(0xC0 + character_i - (sizeof(ascii) - 1));
+        }
+    }
+    for( character_i = count; character_i > 1; character_i-- ) {
+        unsigned int other = (unsigned int)(goldenRandom(state) % character_i);
+        unsigned char c = characters[character_i - 1];
+        characters[character_i - 1] = characters[other];
+        characters[other] = c;
+    }
+    characters[count] = 0;
+}
+
+static void goldenSeed( unsigned short int seed[3], unsigned int vector_i, unsigned long long *state )
+{
+    unsigned int seed_i;
+    for( seed_i = 0; seed_i < 3; seed_i++ ) {
+        if( vector_i % 7 == 0 ) seed[seed_i] = 0;
+        else if( vector_i % 7 == 1 ) seed[seed_i] = 0xFFFF;
+        else seed[seed_i] = (unsigned short int)goldenRandom(state);
+    }
+}
+
+// Writes line into corpus and adds it to the MD5 of the corpus
+static void goldenWrite( FILE *corpus, MD5_CTX *md5, const char *line )
+{
+    fputs(line, corpus);
+    MD5_Update(md5, (void *)line, (unsigned long)strlen(line));
+}
+
+static int goldenRecord( const char *path, unsigned int keys_per_vector, unsigned long long sample_seed )
+{
+    mfLicensingPrivateKey private_keys[GOLDEN_COUNT(goldenPrivateKeys)];
+    unsigned int key_i;
+    for( key_i = 0; key_i < GOLDEN_COUNT(goldenPrivateKeys); key_i++ ) {
+        if( mfLicensingInitializePrivateKeyFromPrime(&private_keys[key_i], (const unsigned char *)goldenPrivateKeys[key_i]) != 0 ) {
+            fprintf(stderr, "invalid private key\n");
+            return 1;
+        }
+    }
+    FILE *corpus = fopen(path, "w");
+    if( corpus == 0 ) {
+        perror(path);
+        return 1;
+    }
+
+    MD5_CTX md5;
+    MD5_Init(&md5);
+    char line[GOLDEN_MAX_LINE];
+    snprintf(line, sizeof(line), "mflicensinggolden %u\n", GOLDEN_VERSION);
+    goldenWrite(corpus, &md5, line);
+
+    unsigned long long state = sample_seed;
+    unsigned long long key_count = 0, missing_count = 0;
+    unsigned int vector_i = 0;
+    double started = goldenNow();
+    unsigned int scheme, check, count_i, length_i, bits_i;
+    for( scheme = MF_LICENSING_SCHEME_LRAND48; scheme <= MF_LICENSING_SCHEME_PHILOX; scheme++ ) {
+    for( check = 0; check <= 1; check++ ) {
+    for( count_i = 0; count_i < GOLDEN_COUNT(goldenCharacterCounts); count_i++ ) {
+    for( length_i = 0; length_i < GOLDEN_COUNT(goldenKeyLengths); length_i++ ) {
+    for( bits_i = 0; bits_i < GOLDEN_COUNT(goldenIndexBits); bits_i++ ) {
+        mfLicensingVector vector;
+        unsigned char characters[GOLDEN_MAX_CHARACTERS + 1];
+        char key_hex[65], characters_hex[2 * GOLDEN_MAX_CHARACTERS + 1];
+        const mfLicensingPrivateKey *private_key = &private_keys[vector_i % GOLDEN_COUNT(goldenPrivateKeys)];
+
+        mfLicensingInitializeDefaultVector(&vector);
+        goldenCharacters(characters, goldenCharacterCounts[count_i], &state);
+        goldenSeed(vector.scrambling_seed, vector_i, &state);
+        goldenSeed(vector.salt_seed, vector_i, &state);
+        mfLicensingSetPrivateKey(&vector, private_key);
+        mfLicensingSetEncodingCharacters(&vector, characters);
+        mfLicensingSetKeyLength(&vector, (unsigned char)goldenKeyLengths[length_i]);
+        mfLicensingSetKeyIndexLength(&vector, (unsigned char)goldenIndexBits[bits_i]);
+        mfLicensingSetCheckCharacter(&vector, (unsigned char)check);
+        mfLicensingSetScheme(&vector, (unsigned char)scheme);
+
+        goldenHex(private_key->data.b, sizeof(private_key->data.b), 1, key_hex);
+        goldenHex(characters, goldenCharacterCounts[count_i], 0, characters_hex);
+        snprintf(line, sizeof(line), "V %u %u %u %u %u,%u,%u %u,%u,%u %s %s\n", scheme, check, vector.key_length, vector.index_bits,
+                 vector.scrambling_seed[0], vector.scrambling_seed[1], vector.scrambling_seed[2],
+                 vector.salt_seed[0], vector.salt_seed[1], vector.salt_seed[2], key_hex, characters_hex);
+        goldenWrite(corpus, &md5, line);
+
+        unsigned int last_index = vector.index_bits == 32 ? 0xFFFFFFFFu : (1u << vector.index_bits) - 1;
+        for( key_i = 0; key_i < keys_per_vector; key_i++ ) {
+            mfLicensingDigest digest;
+            unsigned int index, byte_i;
+            for( byte_i = 0; byte_i < sizeof(digest.md5hash.b); byte_i++ ) {
+                digest.md5hash.b[byte_i] = key_i == 0 ? 0 : key_i == 1 ? 0xFF : (unsigned char)goldenRandom(&state);
+            }
+            switch( key_i ) {
+                case 0: index = 0; break;
+                case 1: index = 1; break;
+                case 2: index = last_index; break;
+                case 3: index = last_index + 1; break;
+                default: index = (unsigned int)goldenRandom(&state) & last_index; break;
+            }
+
+            char digest_hex[33], license_hex[2 * GOLDEN_MAX_KEY + 1];
+            unsigned char *license = mfLicensingGenerateLicense(&vector, &digest, index);
+            goldenHex(digest.md5hash.b, sizeof(digest.md5hash.b), 1, digest_hex);
+            if( license != 0 ) {
+                goldenHex(license, (unsigned int)strlen((const char *)license), 0, license_hex);
+                free(license);
+                key_count++;
+            } else {
+                strcpy(license_hex, "-");
+                missing_count++;
+            }
+            snprintf(line, sizeof(line), "K %s %u %s\n", digest_hex, index, license_hex);
+            goldenWrite(corpus, &md5, line);
+        }
+        vector_i++;
+    }
+    }
+    }
+    }
+    }
+
+    if( fclose(corpus) != 0 ) {
+        perror(path);
+        return 1;
+    }
+    unsigned char digest[16];
+    char digest_hex[33];
+    MD5_Final(digest, &md5);
+    goldenHex(digest, sizeof(digest), 0, digest_hex);
+    printf("%u vectors, %llu keys, %llu entries without key, %.1f s\n", vector_i, key_count, missing_count, goldenNow() - started);
+    printf("md5 %s\n", digest_hex);
+    return 0;
+}
+
+#pragma mark - Check
+
+static void goldenMismatch( goldenReport *report, goldenPath path, const goldenEntries *entries, unsigned int entry_i, const char *found )
+{
+    report->mismatches[path]++;
+    if( report->reported++ >= GOLDEN_MAX_REPORTED ) return;
+    const char *name = path < goldenBatch ? goldenPathNames[path] : goldenBatchKernels[path - goldenBatch];
+    char digest_hex[33];
+    goldenHex(entries->digests[entry_i].md5hash.b, sizeof(entries->digests[entry_i].md5hash.b), 1, digest_hex);
+    printf("line %u: %s%s: digest %s index %u, expected %s, found %s\n", entries->first_line + entry_i,
+           path < goldenBatch ? "" : "batch ", name, digest_hex, entries->indexes[entry_i],
+           entries->keys[entry_i][0] ? (const char *)entries->keys[entry_i] : "no key", found);
+}
+
+// Compares a key generated by a path with the corpus, license being 0 when the path generated none
+static void goldenCompareKey( goldenReport *report, goldenPath path, const goldenEntries *entries, unsigned int entry_i, const unsigned char *license )
+{
+    report->checks[path]++;
+    const unsigned char *expected = entries->keys[entry_i];
+    if( license == 0 ? expected[0] != 0 : strcmp((const char *)license, (const char *)expected) != 0 ) {
+        goldenMismatch(report, path, entries, entry_i, license ? (const char *)license : "no key");
+    }
+}
+
+static void goldenCompareResult( goldenReport *report, goldenPath path, const goldenEntries *entries, unsigned int entry_i, int expected, int found )
+{
+    report->checks[path]++;
+    if( expected != found ) {
+        char text[32];
+        snprintf(text, sizeof(text), "result %d instead of %d", found, expected);
+        goldenMismatch(report, path, entries, entry_i, text);
+    }
+}
+
+static void goldenCheckVector( goldenReport *report, mfLicensingVector *vector, const goldenEntries *entries )
+{
+    mfLicensingContext context;
+    mfLicensingCompiledContext compiled;
+    static unsigned char blob[MF_LICENSING_BLOB_SIZE];
+    unsigned char license[GOLDEN_MAX_KEY];
+    unsigned int entry_i;
+
+    // Reference path, and the only one defined for vectors no context can be initialized for
+    for( entry_i = 0; entry_i < entries->count; entry_i++ ) {
+        unsigned char *generated = mfLicensingGenerateLicense(vector, &entries->digests[entry_i], entries->indexes[entry_i]);
+        goldenCompareKey(report, goldenGenerate, entries, entry_i, generated);
+        free(generated);
+        if( entries->keys[entry_i][0] ) {
+            goldenCompareResult(report, goldenValidate, entries, entry_i, 1,
+                                mfLicensingValidateLicense(vector, &entries->digests[entry_i], entries->keys[entry_i]));
+        }
+    }
+    if( mfLicensingInitializeContext(&context, vector) != 0 ) {
+        return;
+    }
+    int has_compiled = mfLicensingSerializeContext(&context, blob, sizeof(blob)) != 0 &&
+                       mfLicensingAttachContext(&compiled, blob, sizeof(blob)) == 0;
+    // Keys entered without separators, and routed by a registry to its only vector; a format or registry
+    // that can't be set up for the vector rejects every key
+    mfLicensingKeyFormat format;
+    mfLicensingRegistry registry;
+    int has_format = mfLicensingInitializeKeyFormat(&format, &context, 0, mfLicensingCaseSensitive) == 0;
+    mfLicensingInitializeRegistry(&registry);
+    int has_registry = mfLicensingRegistryAddVector(&registry, vector) == 0;
+
+    // Keys of the corpus followed by the same keys with their first character changed
+    const unsigned char **batch_licenses = malloc(2 * entries->count * sizeof(const unsigned char *));
+    mfLicensingDigest *batch_digests = malloc(2 * entries->count * sizeof(mfLicensingDigest));
+    unsigned int *batch_entries = malloc(2 * entries->count * sizeof(unsigned int));
+    unsigned char *batch_expected = malloc(2 * entries->count);
+    unsigned char *batch_valid = malloc(2 * entries->count);
+    unsigned int *batch_indexes = malloc(2 * entries->count * sizeof(unsigned int));
+    unsigned char (*altered)[GOLDEN_MAX_KEY] = malloc(entries->count * GOLDEN_MAX_KEY);
+    unsigned int batch_count = 0;
+    if( batch_licenses == 0 || batch_digests == 0 || batch_entries == 0 || batch_expected == 0 || batch_valid == 0 || batch_indexes == 0 || altered == 0 ) {
+        fprintf(stderr, "out of memory\n");
+        exit(1);
+    }
+
+    unsigned int character_count = context.codec_params.encoding_base;
+    for( entry_i = 0; entry_i < entries->count; entry_i++ ) {
+        mfLicensingDigest *digest = &entries->digests[entry_i];
+        unsigned int index = entries->indexes[entry_i];
+        unsigned char *generated = mfLicensingGenerateLicenseWithContext(&context, digest, index);
+        goldenCompareKey(report, goldenContext, entries, entry_i, generated);
+        free(generated);
+        int written = mfLicensingGenerateLicenseToBuffer(&context, digest, index, license, sizeof(license));
+        goldenCompareKey(report, goldenBuffer, entries, entry_i, written == 0 ? license : 0);
+        if( has_compiled ) {
+            written = mfLicensingGenerateLicenseToBuffer(&compiled.context, digest, index, license, sizeof(license));
+            goldenCompareKey(report, goldenCompiled, entries, entry_i, written == 0 ? license : 0);
+        }
+
+        // The iterator skips the indexes without key, it must not return one for them
+        mfLicensingKeyIterator iterator;
+        unsigned int iterator_index;
+        int iterated = mfLicensingOpenKeyIterator(&iterator, &context, digest, index) == 0 &&
+                       mfLicensingKeyIteratorNext(&iterator, license, &iterator_index) == 1 && iterator_index == index;
+        goldenCompareKey(report, goldenIterator, entries, entry_i, iterated ? license : 0);
+
+        if( entries->keys[entry_i][0] == 0 ) continue;
+        const unsigned char *expected = entries->keys[entry_i];
+        unsigned int decoded_index = 0;
+        goldenCompareResult(report, goldenDecode, entries, entry_i, 1, mfLicensingDecodeLicense(&context, expected, &decoded_index, 0) == 1 && decoded_index == index);
+        goldenCompareResult(report, goldenValidateContext, entries, entry_i, 1, mfLicensingValidateLicenseWithContext(&context, digest, expected));
+        goldenCompareResult(report, goldenFormatted, entries, entry_i, 1, has_format ? mfLicensingValidateFormattedLicense(&format, digest, expected) : 0);
+        goldenCompareResult(report, goldenRegistry, entries, entry_i, 0, has_registry ? mfLicensingRegistryValidateLicense(&registry, digest, expected) : -1);
+
+        // The journal records the key as its index and validator bits
+        mfLicensingJournalEntry journal_entry;
+        memset(&journal_entry, 0, sizeof(journal_entry));
+        journal_entry.digest = *digest;
+        int rebuilt = mfLicensingDecodeLicense(&context, expected, &journal_entry.index, &journal_entry.validator_bits) == 1 &&
+                      mfLicensingJournalEntryLicense(&context, &journal_entry, license, sizeof(license)) == 0;
+        goldenCompareKey(report, goldenJournal, entries, entry_i, rebuilt ? license : 0);
+
+        strcpy((char *)altered[entry_i], (const char *)expected);
+        const unsigned char *position = (const unsigned char *)memchr(context.codec_params.codec_characters, expected[0], character_count);
+        if( position != 0 ) {
+            altered[entry_i][0] = context.codec_params.codec_characters[(position - context.codec_params.codec_characters + 1) % character_count];
+        }
+        int altered_valid = mfLicensingValidateLicenseWithContext(&context, digest, altered[entry_i]);
+        goldenCompareResult(report, goldenFormatted, entries, entry_i, altered_valid, has_format ? mfLicensingValidateFormattedLicense(&format, digest, altered[entry_i]) : 0);
+        goldenCompareResult(report, goldenRegistry, entries, entry_i, altered_valid ? 0 : -1,
+                            has_registry ? mfLicensingRegistryValidateLicense(&registry, digest, altered[entry_i]) : -1);
+        batch_licenses[batch_count] = expected;
+        batch_digests[batch_count] = *digest;
+        batch_entries[batch_count] = entry_i;
+        batch_expected[batch_count++] = 1;
+        batch_licenses[batch_count] = altered[entry_i];
+        batch_digests[batch_count] = *digest;
+        batch_entries[batch_count] = entry_i;
+        batch_expected[batch_count++] = (unsigned char)altered_valid;
+    }
+
+    if( batch_count != 0 ) {
+        unsigned int batch_i, kernel_i;
+        mfLicensingDecodeLicenses(&context, batch_licenses, batch_count, batch_indexes, 0, batch_valid);
+        for( batch_i = 0; batch_i < batch_count; batch_i += 2 ) {
+            entry_i = batch_entries[batch_i];
+            goldenCompareResult(report, goldenDecodeBatch, entries, entry_i, 1, batch_valid[batch_i] == 1 && batch_indexes[batch_i] == entries->indexes[entry_i]);
+        }
+        for( kernel_i = 0; kernel_i < GOLDEN_BATCH_KERNELS; kernel_i++ ) {
+            if( !report->kernel_available[kernel_i] ) continue;
+            mfLicensingSetBatchKernel(goldenBatchKernels[kernel_i]);
+            mfLicensingValidateLicenses(has_compiled ? &compiled.context : &context, batch_digests, batch_licenses, batch_count, batch_valid);
+            for( batch_i = 0; batch_i < batch_count; batch_i++ ) {
+                goldenCompareResult(report, (goldenPath)(goldenBatch + kernel_i), entries, batch_entries[batch_i], batch_expected[batch_i], batch_valid[batch_i]);
+            }
+        }
+    }
+
+    free(altered);
+    free(batch_indexes);
+    free(batch_valid);
+    free(batch_expected);
+    free(batch_entries);
+    free(batch_digests);
+    free(batch_licenses);
+    mfLicensingReleaseRegistry(&registry);
+    mfLicensingReleaseContext(&context);
+}
+
+static int goldenAddEntry( goldenEntries *entries, const char *line, unsigned int line_number )
+{
+    char digest_hex[GOLDEN_MAX_LINE], license_hex[GOLDEN_MAX_LINE];
+    unsigned int index;
+    if( sscanf(line, "K %s %u %s", digest_hex, &index, license_hex) != 3 ) return -1;
+    if( entries->count == entries->capacity ) {
+        unsigned int capacity = entries->capacity ? 2 * entries->capacity : 64;
+        mfLicensingDigest *digests = realloc(entries->digests, capacity * sizeof(mfLicensingDigest));
+        if( digests ) entries->digests = digests;
+        unsigned int *indexes = realloc(entries->indexes, capacity * sizeof(unsigned int));
+        if( indexes ) entries->indexes = indexes;
+        unsigned char (*keys)[GOLDEN_MAX_KEY] = realloc(entries->keys, capacity * GOLDEN_MAX_KEY);
+        if( keys ) entries->keys = keys;
+        if( digests == 0 || indexes == 0 || keys == 0 ) return -1;
+        entries->capacity = capacity;
+    }
+    if( entries->count == 0 ) entries->first_line = line_number;
+    unsigned int entry_i = entries->count;
+    memset(&entries->digests[entry_i], 0, sizeof(mfLicensingDigest));
+    if( goldenUnhex(digest_hex, entries->digests[entry_i].md5hash.b, sizeof(entries->digests[entry_i].md5hash.b), 1) != 16 ) return -1;
+    entries->indexes[entry_i] = index;
+    if( strcmp(license_hex, "-") == 0 ) {
+        entries->keys[entry_i][0] = 0;
+    } else {
+        int length = goldenUnhex(license_hex, entries->keys[entry_i], GOLDEN_MAX_KEY - 1, 0);
+        if( length <= 0 ) return -1;
+        entries->keys[entry_i][length] = 0;
+    }
+    entries->count++;
+    return 0;
+}
+
+static int goldenCheck( const char *path )
+{
+    FILE *corpus = fopen(path, "r");
+    if( corpus == 0 ) {
+        perror(path);
+        return 1;
+    }
+    char line[GOLDEN_MAX_LINE];
+    unsigned int version;
+    if( fgets(line, sizeof(line), corpus) == 0 || sscanf(line, "mflicensinggolden %u", &version) != 1 || version != GOLDEN_VERSION ) {
+        fprintf(stderr, "%s: not a corpus of version %u\n", path, GOLDEN_VERSION);
+        fclose(corpus);
+        return 1;
+    }
+
+    goldenReport report;
+    memset(&report, 0, sizeof(report));
+    unsigned int kernel_i;
+    printf("math backend %s, multiply kernel %s, batch kernels", mfBackendName(), mfMultiplyKernelName());
+    const char *default_kernel = mfLicensingBatchKernelName();
+    for( kernel_i = 0; kernel_i < GOLDEN_BATCH_KERNELS; kernel_i++ ) {
+        report.kernel_available[kernel_i] = mfLicensingSetBatchKernel(goldenBatchKernels[kernel_i]) == 0;
+        if( report.kernel_available[kernel_i] ) printf(" %s", goldenBatchKernels[kernel_i]);
+    }
+    printf("\n");
+
+    mfLicensingVector vector;
+    mfLicensingPrivateKey private_key;
+    unsigned char characters[GOLDEN_MAX_CHARACTERS + 1];
+    goldenEntries entries;
+    memset(&entries, 0, sizeof(entries));
+    int has_vector = 0, status = 0;
+    unsigned int line_number = 1, vector_count = 0;
+    double started = goldenNow();
+    while( status == 0 ) {
+        int more = fgets(line, sizeof(line), corpus) != 0;
+        line_number++;
+        if( more && line[0] == 'K' && has_vector ) {
+            if( goldenAddEntry(&entries, line, line_number) != 0 ) status = -1;
+            continue;
+        }
+        if( has_vector ) {
+            goldenCheckVector(&report, &vector, &entries);
+            entries.count = 0;
+            vector_count++;
+        }
+        if( !more ) break;
+
+        unsigned int scheme, check, key_length, index_bits;
+        unsigned int s[3], t[3];
+        char key_hex[GOLDEN_MAX_LINE], characters_hex[GOLDEN_MAX_LINE];
+        int character_count;
+        mfLicensingInitializeDefaultVector(&vector);
+        memset(&private_key, 0, sizeof(private_key));
+        if( sscanf(line, "V %u %u %u %u %u,%u,%u %u,%u,%u %s %s", &scheme, &check, &key_length, &index_bits,
+                   &s[0], &s[1], &s[2], &t[0], &t[1], &t[2], key_hex, characters_hex) != 12 ||
+            goldenUnhex(key_hex, private_key.data.b, sizeof(private_key.data.b), 1) != (int)sizeof(private_key.data.b) ||
+            (character_count = goldenUnhex(characters_hex, characters, GOLDEN_MAX_CHARACTERS, 0)) < 0 ) {
+            status = -1;
+            break;
+        }
+        characters[character_count] = 0;
+        unsigned short int scrambling_seed[3] = { (unsigned short int)s[0], (unsigned short int)s[1], (unsigned short int)s[2] };
+        unsigned short int salt_seed[3] = { (unsigned short int)t[0], (unsigned short int)t[1], (unsigned short int)t[2] };
+        if( mfLicensingSetPrivateKey(&vector, &private_key) != 0 ||
+            mfLicensingSetEncodingCharacters(&vector, characters) != 0 ||
+            mfLicensingSetKeyLength(&vector, (unsigned char)key_length) != 0 ||
+            mfLicensingSetKeyIndexLength(&vector, (unsigned char)index_bits) != 0 ||
+            mfLicensingSetCheckCharacter(&vector, (unsigned char)check) != 0 ||
+            mfLicensingSetScheme(&vector, (unsigned char)scheme) != 0 ) {
+            status = -1;
+            break;
+        }
+        mfLicensingSetScramblingSeed(&vector, scrambling_seed);
+        mfLicensingSetSaltSeed(&vector, salt_seed);
+        has_vector = 1;
+    }
+    fclose(corpus);
+    free(entries.keys);
+    free(entries.indexes);
+    free(entries.digests);
+    mfLicensingSetBatchKernel(default_kernel);
+    if( status != 0 ) {
+        fprintf(stderr, "%s: invalid line %u\n", path, line_number);
+        return 1;
+    }
+
+    double elapsed = goldenNow() - started;
+    unsigned long long checks = 0, mismatches = 0;
+    unsigned int path_i;
+    for( path_i = 0; path_i < goldenPathCount; path_i++ ) {
+        if( path_i >= goldenBatch && !report.kernel_available[path_i - goldenBatch] ) continue;
+        char name[32];
+        if( path_i < goldenBatch ) snprintf(name, sizeof(name), "%s", goldenPathNames[path_i]);
+        else snprintf(name, sizeof(name), "batch %s", goldenBatchKernels[path_i - goldenBatch]);
+        printf("%-18s %10llu checks %8llu mismatches\n", name, report.checks[path_i], report.mismatches[path_i]);
+        checks += report.checks[path_i];
+        mismatches += report.mismatches[path_i];
+    }
+    printf("%u vectors, %llu checks in %.1f s (%.0f checks/s), %llu mismatches\n", vector_count, checks, elapsed,
+           elapsed > 0 ? (double)checks / elapsed : 0.0, mismatches);
+    return mismatches != 0 ? 3 : 0;
+}
+
+int main( int argc, char *argv[] )
+{
+    unsigned int keys_per_vector = 64;
+    unsigned long long sample_seed = 1;
+    int record = argc > 1 && strcmp(argv[1], "record") == 0;
+    int check = argc > 1 && strcmp(argv[1], "check") == 0;
+    int opt;
+
+    optind = 2;
+    while( (record || check) && (opt = getopt(argc, argv, "n:r:")) != -1 ) {
+        switch( opt ) {
+            case 'n': keys_per_vector = (unsigned int)atoi(optarg); break;
+            case 'r': sample_seed = strtoull(optarg, 0, 10); break;
+            default: record = check = 0; break;
+        }
+    }
+    if( (!record && !check) || optind != argc - 1 ) {
+        fprintf(stderr, "usage: %s record [-n keys_per_vector] [-r sample_seed] corpus\n"
+                        "       %s check corpus\n", argv[0], argv[0]);
+        return 1;
+    }
+    return record ? goldenRecord(argv[optind], keys_per_vector, sample_seed) : goldenCheck(argv[optind]);
+}
@@ -0,0 +1,421 @@
+//
+//  mflicensingscan.c
+//  MFLicensing
+//  https://github.com/freshcode/MFLicensing
+//
+//  Key-space collision and uniqueness scanner.
+//
+//  Generates the license keys of a licensing vector for every index of the index range and a
+//  sample of digests, then verifies that no two distinct (digest, index) pairs produced the same
+//  key.  Each key is packed into a fixed-size binary record (character weights in the order of the
+//  characters, from the first bit, the pad bits at the end) and stored in one of 256 partitions
+//  selected by the first byte of the record, the weight of the first character and the top bits of
+//  the next one.
+//  Once all keys are generated, each partition is radix sorted and scanned for duplicates.
+//
+//  The validator bits of every key are also decoded to report how balanced they are; a bit that
+//  is set noticeably more or less than half of the time indicates a weakness of the vector.
+//
+//  Generation and sorting are both spread over the requested number of threads.
+//
+//  Build
+//  -----
+//  cc -O2 -pthread -IMFLicensing -IPods/MFMathLib/MathLib -o mflicensingscan
+//     Tools/mflicensingscan.c MFLicensing/mflicensing.c MFLicensing/md5.c
+//     Pods/MFMathLib/MathLib/mfmathlib.c -lm
+//
+//  Usage
+//  -----
+//  mflicensingscan [-k private_key] [-c characters] [-l key_length] [-b index_bits]
+//                  [-s seed1,seed2,seed3] [-S seed1,seed2,seed3] [-d digests] [-n indexes]
+//                  [-t threads] [-r sample_seed] [-v scheme]
+//
+//  By default the vector returned by mfLicensingInitializeDefaultVector is scanned with 4 digests
+//  and the full index range (capped to 2^25).  -v selects the key scheme (1 lrand48, 2 Philox).
+//
+//  Licensing
+//  ---------
+//  Public Domain
+//  By Freshcode, Cutting edge Mac, iPhone & iPad software development. http://madefresh.ca/
+//
+
+#include "mflicensing.h"
+#include "md5.h"
+#include <math.h>
+#include <pthread.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <sys/time.h>
+#include <unistd.h>
+
+#define SCAN_PARTITIONS 256
+#define SCAN_CHUNK 4096
+#define SCAN_MAX_REPORTED 20
+
+static unsigned char samplePrivateKey[] = "104879082971311758664630764208593364096202589226484812035848152338939626324659";
+
+// Key record: packed key followed by the digest number and the index
+typedef struct {
+    unsigned char *data;
+    size_t count;
+    size_t capacity;
+} scanBuffer;
+
+typedef struct {
+    mfLicensingContext *context;
+    mfLicensingDigest *digests;
+    unsigned int digest_count;
+    unsigned long long index_count;
+    unsigned int bits_per_char;
+    unsigned int packed_bytes;
+    unsigned int record_bytes;
+    unsigned int validator_bits;
+    unsigned int thread_count;
+    unsigned long long chunk_count;
+    volatile unsigned long long next_chunk;
+    volatile unsigned int next_partition;
+    scanBuffer *partitions;         // thread_count x SCAN_PARTITIONS buffers
+    pthread_mutex_t report_lock;
+    unsigned long long collisions;
+    unsigned long long reported;
+} scanJob;
+
+typedef struct {
+    scanJob *job;
+    unsigned int thread_i;
+    unsigned long long generated;
+    unsigned long long failures;
+    unsigned long long mismatches;
+    unsigned long long *ones;       // per validator bit
+} scanThread;
+
+static double scanNow( void )
+{
+    struct timeval tv;
+    gettimeofday(&tv, 0);
+    return tv.tv_sec + tv.tv_usec / 1000000.0;
+}
+
+static int scanParseSeed( const char *arg, unsigned short int seed[3] )
+{
+    unsigned int s0, s1, s2;
+    if( sscanf(arg, "%u,%u,%u", &s0, &s1, &s2) != 3 || s0 > 0xFFFF || s1 > 0xFFFF || s2 > 0xFFFF ) {
+        return -1;
+    }
+    seed[0] = s0; seed[1] = s1; seed[2] = s2;
+    return 0;
+}
+
+static int scanAppend( scanBuffer *buffer, const unsigned char *record, unsigned int record_bytes )
+{
+    if( buffer->count == buffer->capacity ) {
+        size_t capacity = buffer->capacity == 0 ? 1024 : buffer->capacity * 2;
+        unsigned char *data = realloc(buffer->data, capacity * record_bytes);
+        if( data == 0 ) return -1;
+        buffer->data = data;
+        buffer->capacity = capacity;
+    }
+    memcpy(&buffer->data[buffer->count * record_bytes], record, record_bytes);
+    buffer->count++;
+    return 0;
+}
+
+// Packs the character weights of the key into record from its first bit, in the order of the characters
+// and most significant bit first; the pad bits are left at the end so the first byte, the partition,
+// holds the weight of the first character
+static void scanPackKey( scanJob *job, const unsigned char *license, unsigned char *record )
+{
+    unsigned int length = job->context->vector->key_length;
+    unsigned int bit_i = 0, char_i;
+    memset(record, 0, job->packed_bytes);
+    for( char_i = 0; char_i < length; char_i++ ) {
+        unsigned int weight = job->context->character_weights[ license[char_i] ];
+        unsigned int b = job->bits_per_char;
+        while( b-- ) {
+            if( (weight >> b) & 0x01 ) record[bit_i >> 3] |= 0x80 >> (bit_i & 0x07);
+            bit_i++;
+        }
+    }
+}
+
+static void *scanGenerateThread( void *arg )
+{
+    scanThread *thread = arg;
+    scanJob *job = thread->job;
+    unsigned char *record = malloc(job->record_bytes);
+    scanBuffer *partitions = &job->partitions[thread->thread_i * SCAN_PARTITIONS];
+    unsigned long long chunks_per_digest = (job->index_count + SCAN_CHUNK - 1) / SCAN_CHUNK;
+
+    for(;;) {
+        unsigned long long chunk = __sync_fetch_and_add(&job->next_chunk, 1);
+        if( chunk >= job->chunk_count ) break;
+
+        unsigned int digest_i = (unsigned int)(chunk / chunks_per_digest);
+        unsigned long long first = (chunk % chunks_per_digest) * SCAN_CHUNK;
+        unsigned long long last = first + SCAN_CHUNK;
+        if( last > job->index_count ) last = job->index_count;
+
+        for( unsigned long long index = first; index < last; index++ ) {
+            unsigned char *license = mfLicensingGenerateLicenseWithContext(job->context, &job->digests[digest_i], (unsigned int)index);
+            if( license == 0 ) {
+                thread->failures++;
+                continue;
+            }
+            thread->generated++;
+
+            // Cross check the decoder and gather the validator bits balance
+            unsigned int decoded_index;
+            mfU256 validator_bits;
+            if( mfLicensingDecodeLicense(job->context, license, &decoded_index, &validator_bits) == 0 ||
+                decoded_index != (unsigned int)index ) {
+                thread->mismatches++;
+            } else {
+                for( unsigned int bit_i = 0; bit_i < job->validator_bits; bit_i++ ) {
+                    thread->ones[bit_i] += (validator_bits.b[bit_i >> 3] >> (bit_i & 0x07)) & 0x01;
+                }
+            }
+
+            scanPackKey(job, license, record);
+            unsigned int index32 = (unsigned int)index;
+            memcpy(&record[job->packed_bytes], &digest_i, 4);
+            memcpy(&record[job->packed_bytes + 4], &index32, 4);
+            if( scanAppend(&partitions[record[0]], record, job->record_bytes) != 0 ) {
+                fprintf(stderr, "out of memory\n");
+                exit(1);
+            }
+            free(license);
+        }
+    }
+    free(record);
+    return 0;
+}
+
+// LSD radix sort of the records on bytes 1 to packed_bytes-1 (byte 0 is the partition)
+static int scanSortPartition( scanJob *job, unsigned char *records, size_t count )
+{
+    unsigned int record_bytes = job->record_bytes;
+    unsigned char *scratch = malloc(count * record_bytes);
+    if( scratch == 0 ) return -1;
+
+    unsigned char *from = records, *to = scratch;
+    unsigned int byte_i = job->packed_bytes;
+    while( --byte_i > 0 ) {
+        size_t offsets[256];
+        memset(offsets, 0, sizeof(offsets));
+        for( size_t i = 0; i < count; i++ ) offsets[ from[i * record_bytes + byte_i] ]++;
+        size_t total = 0;
+        for( unsigned int b = 0; b < 256; b++ ) { size_t n = offsets[b]; offsets[b] = total; total += n; }
+        for( size_t i = 0; i < count; i++ ) {
+            memcpy(&to[ offsets[ from[i * record_bytes + byte_i] ]++ * record_bytes ], &from[i * record_bytes], record_bytes);
+        }
+        unsigned char *swap = from; from = to; to = swap;
+    }
+    if( from != records ) memcpy(records, from, count * record_bytes);
+    free(scratch);
+    return 0;
+}
+
+static void scanReportCollision( scanJob *job, const unsigned char *a, const unsigned char *b )
+{
+    pthread_mutex_lock(&job->report_lock);
+    job->collisions++;
+    if( job->reported < SCAN_MAX_REPORTED ) {
+        unsigned int digest_a, index_a, digest_b, index_b;
+        memcpy(&digest_a, &a[job->packed_bytes], 4); memcpy(&index_a, &a[job->packed_bytes + 4], 4);
+        memcpy(&digest_b, &b[job->packed_bytes], 4); memcpy(&index_b, &b[job->packed_bytes + 4], 4);
+        unsigned char *license = mfLicensingGenerateLicenseWithContext(job->context, &job->digests[digest_a], index_a);
+        printf("collision: %s = digest #%u index %u = digest #%u index %u\n", license ? (char *)license : "?", digest_a, index_a, digest_b, index_b);
+        free(license);
+        job->reported++;
+    }
+    pthread_mutex_unlock(&job->report_lock);
+}
+
+static void *scanSortThread( void *arg )
+{
+    scanThread *thread = arg;
+    scanJob *job = thread->job;
+
+    for(;;) {
+        unsigned int partition = __sync_fetch_and_add(&job->next_partition, 1);
+        if( partition >= SCAN_PARTITIONS ) break;
+
+        // Gather the records produced by every thread for this partition
+        size_t count = 0;
+        for( unsigned int t = 0; t < job->thread_count; t++ ) count += job->partitions[t * SCAN_PARTITIONS + partition].count;
+        if( count < 2 ) {
+            for( unsigned int t = 0; t < job->thread_count; t++ ) {
+                free(job->partitions[t * SCAN_PARTITIONS + partition].data);
+                job->partitions[t * SCAN_PARTITIONS + partition].data = 0;
+            }
+            continue;
+        }
+        unsigned char *records = malloc(count * job->record_bytes);
+        if( records == 0 ) { fprintf(stderr, "out of memory\n"); exit(1); }
+        size_t offset = 0;
+        for( unsigned int t = 0; t < job->thread_count; t++ ) {
+            scanBuffer *buffer = &job->partitions[t * SCAN_PARTITIONS + partition];
+            memcpy(&records[offset], buffer->data, buffer->count * job->record_bytes);
+            offset += buffer->count * job->record_bytes;
+            free(buffer->data);
+            buffer->data = 0;
+        }
+
+        if( scanSortPartition(job, records, count) != 0 ) { fprintf(stderr, "out of memory\n"); exit(1); }
+        for( size_t i = 1; i < count; i++ ) {
+            unsigned char *previous = &records[(i - 1) * job->record_bytes];
+            unsigned char *current = &records[i * job->record_bytes];
+            if( memcmp(previous, current, job->packed_bytes) == 0 ) {
+                scanReportCollision(job, previous, current);
+            }
+        }
+        free(records);
+    }
+    return 0;
+}
+
+int main( int argc, char *argv[] )
+{
+    mfLicensingPrivateKey private_key;
+    mfLicensingVector vector;
+    mfLicensingContext context;
+    const char *private_key_string = (const char *)samplePrivateKey;
+    unsigned int digest_count = 4;
+    long long index_count = -1;
+    unsigned int thread_count = (unsigned int)sysconf(_SC_NPROCESSORS_ONLN);
+    unsigned int sample_seed = 1;
+    int opt;
+
+    mfLicensingInitializeDefaultVector(&vector);
+    while( (opt = getopt(argc, argv, "k:c:l:b:s:S:d:n:t:r:v:")) != -1 ) {
+        switch( opt ) {
+            case 'k': private_key_string = optarg; break;
+            case 'c': vector.coded_chars = (const unsigned char *)optarg; break;
+            case 'l': vector.key_length = (unsigned char)atoi(optarg); break;
+            case 'b': vector.index_bits = (unsigned char)atoi(optarg); break;
+            case 's': if( scanParseSeed(optarg, vector.scrambling_seed) != 0 ) { fprintf(stderr, "invalid scrambling seed\n"); return 1; } break;
+            case 'S': if( scanParseSeed(optarg, vector.salt_seed) != 0 ) { fprintf(stderr, "invalid salt seed\n"); return 1; } break;
+            case 'd': digest_count = (unsigned int)atoi(optarg); break;
+            case 'n': index_count = atoll(optarg); break;
+            case 't': thread_count = (unsigned int)atoi(optarg); break;
+            case 'r': sample_seed = (unsigned int)atoi(optarg); break;
+            case 'v': if( mfLicensingSetScheme(&vector, (unsigned char)atoi(optarg)) != 0 ) { fprintf(stderr, "invalid scheme\n"); return 1; } break;
+            default:
+                fprintf(stderr, "usage: %s [-k private_key] [-c characters] [-l key_length] [-b index_bits] "
+                        "[-s seed1,seed2,seed3] [-S seed1,seed2,seed3] [-d digests] [-n indexes] [-t threads] [-r sample_seed] [-v scheme]\n", argv[0]);
+                return 1;
+        }
+    }
+    if( thread_count == 0 ) thread_count = 1;
+    if( digest_count == 0 ) digest_count = 1;
+
+    if( mfLicensingInitializePrivateKeyFromPrime(&private_key, (const unsigned char *)private_key_string) != 0 ||
+        mfLicensingSetPrivateKey(&vector, &private_key) != 0 ) {
+        fprintf(stderr, "invalid private key\n");
+        return 1;
+    }
+    if( mfLicensingInitializeContext(&context, &vector) != 0 ) {
+        fprintf(stderr, "invalid licensing vector\n");
+        return 1;
+    }
+
+    // Default to the full index range, capped to 2^25
+    unsigned long long index_range = 1ULL << vector.index_bits;
+    if( index_count < 0 ) index_count = index_range < (1ULL << 25) ? (long long)index_range : (1LL << 25);
+    if( (unsigned long long)index_count > index_range ) index_count = (long long)index_range;
+    if( index_count == 0 ) index_count = 1;
+
+    scanJob job;
+    memset(&job, 0, sizeof(job));
+    job.context = &context;
+    job.digest_count = digest_count;
+    job.index_count = (unsigned long long)index_count;
+    job.thread_count = thread_count;
+    job.validator_bits = context.codec_params.bits_in_key - vector.index_bits;
+    job.bits_per_char = 1;
+    while( (1u << job.bits_per_char) < context.codec_params.encoding_base ) job.bits_per_char++;
+    job.packed_bytes = (vector.key_length * job.bits_per_char + 7) / 8;
+    job.record_bytes = job.packed_bytes + 8;
+    job.chunk_count = (unsigned long long)digest_count * ((job.index_count + SCAN_CHUNK - 1) / SCAN_CHUNK);
+    pthread_mutex_init(&job.report_lock, 0);
+
+    // Sample digests: MD5 of "sample-<seed>-<n>"
+    job.digests = malloc(digest_count * sizeof(mfLicensingDigest));
+    job.partitions = calloc((size_t)thread_count * SCAN_PARTITIONS, sizeof(scanBuffer));
+    scanThread *threads = calloc(thread_count, sizeof(scanThread));
+    pthread_t *thread_ids = calloc(thread_count, sizeof(pthread_t));
+    if( job.digests == 0 || job.partitions == 0 || threads == 0 || thread_ids == 0 ) {
+        fprintf(stderr, "out of memory\n");
+        return 1;
+    }
+    for( unsigned int digest_i = 0; digest_i < digest_count; digest_i++ ) {
+        char sample[64];
+        MD5_CTX md5ctx;
+        snprintf(sample, sizeof(sample), "sample-%u-%u", sample_seed, digest_i);
+        MD5_Init(&md5ctx);
+        MD5_Update(&md5ctx, sample, strlen(sample));
+        MD5_Final(job.digests[digest_i].md5hash.b, &md5ctx);
+    }
+
+    printf("vector: key_length=%u encoding_base=%u bits_in_key=%u index_bits=%u validator_bits=%u\n",
+           vector.key_length, context.codec_params.encoding_base, context.codec_params.bits_in_key,
+           vector.index_bits, job.validator_bits);
+    printf("scanning %u digests x %llu indexes using %u threads, %u bytes per record\n",
+           digest_count, job.index_count, thread_count, job.record_bytes);
+
+    // Generate
+    double started = scanNow();
+    for( unsigned int t = 0; t < thread_count; t++ ) {
+        threads[t].job = &job;
+        threads[t].thread_i = t;
+        threads[t].ones = calloc(job.validator_bits + 1, sizeof(unsigned long long));
+        pthread_create(&thread_ids[t], 0, scanGenerateThread, &threads[t]);
+    }
+    for( unsigned int t = 0; t < thread_count; t++ ) pthread_join(thread_ids[t], 0);
+    double generated = scanNow();
+
+    // Sort and detect collisions
+    for( unsigned int t = 0; t < thread_count; t++ ) pthread_create(&thread_ids[t], 0, scanSortThread, &threads[t]);
+    for( unsigned int t = 0; t < thread_count; t++ ) pthread_join(thread_ids[t], 0);
+    double sorted = scanNow();
+
+    // Report
+    unsigned long long total = 0, failures = 0, mismatches = 0;
+    for( unsigned int t = 0; t < thread_count; t++ ) {
+        total += threads[t].generated;
+        failures += threads[t].failures;
+        mismatches += threads[t].mismatches;
+    }
+    printf("keys generated: %llu (%.0f keys/sec)\n", total, total / (generated - started));
+    printf("generation failures: %llu\n", failures);
+    printf("decoded index mismatches: %llu\n", mismatches);
+    printf("collisions: %llu\n", job.collisions);
+    if( job.validator_bits < 128 ) {
+        // keys of distinct indexes always differ, only digests sharing an index may collide
+        double pairs = (double)job.index_count * digest_count * (digest_count - 1) / 2.0;
+        printf("expected collisions for %u random validator bits: %.6g\n", job.validator_bits, pairs / ldexp(1.0, job.validator_bits));
+    }
+    if( total > 0 && job.validator_bits > 0 ) {
+        double lowest = 1.0, highest = 0.0;
+        unsigned int lowest_bit = 0, highest_bit = 0;
+        for( unsigned int bit_i = 0; bit_i < job.validator_bits; bit_i++ ) {
+            unsigned long long ones = 0;
+            for( unsigned int t = 0; t < thread_count; t++ ) ones += threads[t].ones[bit_i];
+            double ratio = (double)ones / total;
+            if( ratio < lowest ) { lowest = ratio; lowest_bit = bit_i; }
+            if( ratio > highest ) { highest = ratio; highest_bit = bit_i; }
+        }
+        printf("validator bit balance: lowest %.4f%% (bit %u), highest %.4f%% (bit %u)\n",
+               lowest * 100.0, lowest_bit, highest * 100.0, highest_bit);
+    }
+    printf("time: generation %.2fs, sort %.2fs\n", generated - started, sorted - generated);
+
+    for( unsigned int t = 0; t < thread_count; t++ ) free(threads[t].ones);
+    free(thread_ids);
+    free(threads);
+    free(job.partitions);
+    free(job.digests);
+    mfLicensingReleaseContext(&context);
+    return (job.collisions == 0 && failures == 0 && mismatches == 0) ? 0 : 2;
+}